@@ -0,0 +1,130 @@
+/*
+ * Copyright (c) 2013 Bellerophon Mobile, LLC.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Times tj_array appends, growing from empty and into a presized array,
+ * sequential gets, finding items with and without the index, and
+ * emptying the array by swap removal.
+ *
+ * Usage: bench-tj_array [bench options] [items]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "tj_array.h"
+#include "tj_bench.h"
+
+int main(int argc, char *argv[]) {
+    tj_bench *bench = tj_bench_create("tj_array", &argc, argv);
+    if (bench == NULL) {
+        return 1;
+    }
+
+    size_t n = (argc > 1) ? strtoul(argv[1], NULL, 10) : 1000000;
+    size_t i, linear = (n < 100) ? n : 100;
+    volatile size_t sink = 0;
+    tj_array *array;
+
+    int *values = malloc(n * sizeof(int));
+    if (values == NULL) {
+        fprintf(stderr, "Out of memory.\n");
+        return 1;
+    }
+
+    tj_bench_begin(bench, n, "append from empty");
+    while (tj_bench_next(bench)) {
+        array = tj_array_create(0);
+        tj_bench_start(bench);
+        for (i = 0; i < n; i++) {
+            tj_array_append(array, &values[i]);
+        }
+        tj_bench_stop(bench);
+        tj_array_finalize(array);
+    }
+
+    tj_bench_begin(bench, n, "append presized");
+    while (tj_bench_next(bench)) {
+        array = tj_array_create(n);
+        tj_bench_start(bench);
+        for (i = 0; i < n; i++) {
+            tj_array_append(array, &values[i]);
+        }
+        tj_bench_stop(bench);
+        tj_array_finalize(array);
+    }
+
+    array = tj_array_create(n);
+    for (i = 0; i < n; i++) {
+        tj_array_append(array, &values[i]);
+    }
+
+    tj_bench_begin(bench, n, "get");
+    while (tj_bench_next(bench)) {
+        tj_bench_start(bench);
+        for (i = 0; i < n; i++) {
+            sink += (tj_array_get(array, i) == &values[i]);
+        }
+        tj_bench_stop(bench);
+    }
+
+    /* Without the index each find is a scan, so look for fewer items. */
+    tj_bench_begin(bench, linear, "find unindexed");
+    while (tj_bench_next(bench)) {
+        tj_bench_start(bench);
+        for (i = 0; i < linear; i++) {
+            sink += tj_array_find(array, &values[n - 1 - i * (n / linear)]);
+        }
+        tj_bench_stop(bench);
+    }
+
+    tj_array_enableIndex(array);
+    tj_bench_begin(bench, n, "find indexed");
+    while (tj_bench_next(bench)) {
+        tj_bench_start(bench);
+        for (i = 0; i < n; i++) {
+            sink += tj_array_find(array, &values[i]);
+        }
+        tj_bench_stop(bench);
+    }
+    tj_array_finalize(array);
+
+    tj_bench_begin(bench, n, "swapRemove from front");
+    while (tj_bench_next(bench)) {
+        array = tj_array_create(n);
+        for (i = 0; i < n; i++) {
+            tj_array_append(array, &values[i]);
+        }
+        tj_bench_start(bench);
+        for (i = 0; i < n; i++) {
+            tj_array_swapRemove(array, 0);
+        }
+        tj_bench_stop(bench);
+        tj_array_finalize(array);
+    }
+
+    (void) sink;
+    free(values);
+    return tj_bench_finalize(bench);
+}
@@ -0,0 +1,251 @@
+/*
+ * Copyright (c) 2013 Bellerophon Mobile, LLC.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Compares tj_bitset, as built and after tj_bitset_optimize(), against keeping a
+ * uthash entry per member: building the set, membership tests, counting,
+ * iteration, and intersecting two sets, on random members and then on
+ * clustered ones.
+ *
+ * Usage: bench-tj_bitset [bench options] [universe] [members]
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "tj_bench.h"
+#include "tj_bitset.h"
+#include "uthash.h"
+
+typedef struct {
+    int id;
+    UT_hash_handle hh;
+} member;
+
+static member *hash_build(const int *ids, size_t n) {
+    member *set = NULL, *m;
+    size_t i;
+    for (i = 0; i < n; i++) {
+        HASH_FIND_INT(set, &ids[i], m);
+        if (m == NULL) {
+            m = malloc(sizeof(*m));
+            m->id = ids[i];
+            HASH_ADD_INT(set, id, m);
+        }
+    }
+    return set;
+}
+
+static void hash_free(member *set) {
+    member *m, *tmp;
+    HASH_ITER(hh, set, m, tmp) {
+        HASH_DEL(set, m);
+        free(m);
+    }
+}
+
+static tj_bitset *bitset_build(const int *ids, size_t n, int optimize) {
+    tj_bitset *set = tj_bitset_create(0);
+    size_t i;
+    for (i = 0; i < n; i++) {
+        tj_bitset_set(set, ids[i]);
+    }
+    if (optimize) {
+        tj_bitset_optimize(set);
+    }
+    return set;
+}
+
+static void run(tj_bench *bench, const char *name, const int *a,
+                const int *b, size_t n, size_t universe, int optimize) {
+    tj_bitset *x, *y;
+    size_t i, found = 0, count;
+    volatile size_t sink;
+    ssize_t bit;
+
+    tj_bench_begin(bench, n, "%s build", name);
+    while (tj_bench_next(bench)) {
+        tj_bench_start(bench);
+        x = bitset_build(a, n, optimize);
+        tj_bench_stop(bench);
+        tj_bitset_finalize(x);
+    }
+    x = bitset_build(a, n, optimize);
+    y = bitset_build(b, n, optimize);
+
+    tj_bench_begin(bench, universe, "%s test", name);
+    while (tj_bench_next(bench)) {
+        found = 0;
+        tj_bench_start(bench);
+        for (i = 0; i < universe; i++) {
+            found += tj_bitset_test(x, i);
+        }
+        tj_bench_stop(bench);
+    }
+    tj_bench_metric(bench, "members", found);
+
+    tj_bench_begin(bench, 100, "%s count", name);
+    while (tj_bench_next(bench)) {
+        tj_bench_start(bench);
+        for (i = 0; i < 100; i++) {
+            sink = tj_bitset_count(x);
+        }
+        tj_bench_stop(bench);
+    }
+
+    tj_bench_begin(bench, tj_bitset_count(x), "%s iterate", name);
+    while (tj_bench_next(bench)) {
+        count = 0;
+        tj_bench_start(bench);
+        for (bit = tj_bitset_next(x, 0); bit >= 0;
+             bit = tj_bitset_next(x, bit + 1)) {
+            count++;
+        }
+        tj_bench_stop(bench);
+        sink = count;
+    }
+
+    tj_bench_begin(bench, n, "%s and", name);
+    while (tj_bench_next(bench)) {
+        tj_bitset *z = bitset_build(a, n, optimize);
+        tj_bench_start(bench);
+        tj_bitset_and(z, y);
+        tj_bench_stop(bench);
+        tj_bitset_finalize(z);
+    }
+    (void) sink;
+
+    tj_bitset_and(x, y);
+    tj_bench_metric(bench, "in common", tj_bitset_count(x));
+    tj_bench_metric(bench, "bytes", tj_bitset_memoryUsage(y));
+    tj_bench_metric(bench, "compressed", tj_bitset_isCompressed(y));
+
+    tj_bitset_finalize(x);
+    tj_bitset_finalize(y);
+}
+
+/* Removes members of x not in y, as tj_bitset_and() does. */
+static member *hash_and(member *x, member *y) {
+    member *m, *tmp, *other;
+    HASH_ITER(hh, x, m, tmp) {
+        HASH_FIND_INT(y, &m->id, other);
+        if (other == NULL) {
+            HASH_DEL(x, m);
+            free(m);
+        }
+    }
+    return x;
+}
+
+int main(int argc, char *argv[]) {
+    tj_bench *bench = tj_bench_create("tj_bitset", &argc, argv);
+    if (bench == NULL) {
+        return 1;
+    }
+
+    size_t universe = (argc > 1) ? strtoul(argv[1], NULL, 10) : 1000000;
+    size_t n = (argc > 2) ? strtoul(argv[2], NULL, 10) : universe / 4;
+    member *x, *y, *m, *tmp;
+    size_t i, found = 0, count;
+
+    int *a = malloc(n * sizeof(int));
+    int *b = malloc(n * sizeof(int));
+    int *clustered = malloc(n * sizeof(int));
+    int *clustered2 = malloc(n * sizeof(int));
+    if (!a || !b || !clustered || !clustered2) {
+        fprintf(stderr, "Out of memory.\n");
+        return 1;
+    }
+
+    srand(42);
+    for (i = 0; i < n; i++) {
+        a[i] = rand() % universe;
+        b[i] = rand() % universe;
+        clustered[i] = i;
+        clustered2[i] = i + n / 2;
+    }
+
+    /* Random members. */
+    tj_bench_begin(bench, n, "uthash build");
+    while (tj_bench_next(bench)) {
+        tj_bench_start(bench);
+        x = hash_build(a, n);
+        tj_bench_stop(bench);
+        hash_free(x);
+    }
+    x = hash_build(a, n);
+    y = hash_build(b, n);
+
+    tj_bench_begin(bench, universe, "uthash test");
+    while (tj_bench_next(bench)) {
+        found = 0;
+        tj_bench_start(bench);
+        for (i = 0; i < universe; i++) {
+            int id = i;
+            HASH_FIND_INT(x, &id, m);
+            found += (m != NULL);
+        }
+        tj_bench_stop(bench);
+    }
+    tj_bench_metric(bench, "members", found);
+
+    tj_bench_begin(bench, HASH_COUNT(x), "uthash iterate");
+    while (tj_bench_next(bench)) {
+        count = 0;
+        tj_bench_start(bench);
+        HASH_ITER(hh, x, m, tmp) {
+            count++;
+        }
+        tj_bench_stop(bench);
+    }
+
+    tj_bench_begin(bench, n, "uthash and");
+    while (tj_bench_next(bench)) {
+        member *z = hash_build(a, n);
+        tj_bench_start(bench);
+        z = hash_and(z, y);
+        tj_bench_stop(bench);
+        hash_free(z);
+    }
+    x = hash_and(x, y);
+    tj_bench_metric(bench, "in common", HASH_COUNT(x));
+
+    hash_free(x);
+    hash_free(y);
+
+    run(bench, "tj_bitset", a, b, n, universe, 0);
+    run(bench, "tj_bitset optimized", a, b, n, universe, 1);
+
+    run(bench, "clustered tj_bitset", clustered, clustered2, n, universe, 0);
+    run(bench, "clustered tj_bitset optimized", clustered, clustered2, n,
+        universe, 1);
+
+    free(a);
+    free(b);
+    free(clustered);
+    free(clustered2);
+
+    return tj_bench_finalize(bench);
+}
@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2013 Bellerophon Mobile, LLC.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Times the common tj_buffer operations: appending short strings and
+ * raw bytes to a buffer grown from empty, formatted appends through
+ * tj_buffer_printf(), and refilling a buffer after tj_buffer_reset(),
+ * which reuses its memory.
+ *
+ * Usage: bench-tj_buffer [bench options] [appends]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "tj_bench.h"
+#include "tj_buffer.h"
+
+static const char line[] = "GET /index.html HTTP/1.1\r\n";
+
+int main(int argc, char *argv[]) {
+    tj_bench *bench = tj_bench_create("tj_buffer", &argc, argv);
+    if (bench == NULL) {
+        return 1;
+    }
+
+    size_t n = (argc > 1) ? strtoul(argv[1], NULL, 10) : 1000000;
+    tj_buffer *b;
+    size_t i;
+
+    tj_bench_begin(bench, n, "appendString from empty");
+    while (tj_bench_next(bench)) {
+        b = tj_buffer_create(0);
+        tj_bench_start(bench);
+        for (i = 0; i < n; i++) {
+            tj_buffer_appendString(b, line);
+        }
+        tj_bench_stop(bench);
+        tj_buffer_finalize(b);
+    }
+
+    tj_bench_begin(bench, n, "append 8 bytes from empty");
+    while (tj_bench_next(bench)) {
+        b = tj_buffer_create(0);
+        tj_bench_start(bench);
+        for (i = 0; i < n; i++) {
+            tj_buffer_append(b, (const tj_buffer_byte *) &i, sizeof(i));
+        }
+        tj_bench_stop(bench);
+        tj_buffer_finalize(b);
+    }
+
+    tj_bench_begin(bench, n, "printf from empty");
+    while (tj_bench_next(bench)) {
+        b = tj_buffer_create(0);
+        tj_bench_start(bench);
+        for (i = 0; i < n; i++) {
+            tj_buffer_printf(b, "%s %zu: %s", "record", i, line);
+        }
+        tj_bench_stop(bench);
+        tj_buffer_finalize(b);
+    }
+
+    b = tj_buffer_create(0);
+    tj_bench_begin(bench, n, "appendString after reset");
+    while (tj_bench_next(bench)) {
+        tj_buffer_reset(b);
+        tj_bench_start(bench);
+        for (i = 0; i < n; i++) {
+            tj_buffer_appendString(b, line);
+        }
+        tj_bench_stop(bench);
+    }
+    tj_bench_metric(bench, "bytes", tj_buffer_getUsed(b));
+    tj_buffer_finalize(b);
+
+    return tj_bench_finalize(bench);
+}
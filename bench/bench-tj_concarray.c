@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) 2013 Bellerophon Mobile, LLC.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Measures append throughput from 1 to N threads into one shared
+ * tj_concarray, against a tj_array behind a mutex.
+ *
+ * Usage: bench-tj_concarray [bench options] [appends] [max threads]
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "tj_array.h"
+#include "tj_bench.h"
+#include "tj_concarray.h"
+
+typedef struct {
+    tj_concarray *concarray;
+    tj_array *array;
+    pthread_mutex_t *lock;
+    size_t n;
+} worker;
+
+static size_t values[64];
+
+static void *concarray_worker(void *arg) {
+    worker *w = arg;
+    size_t i;
+    for (i = 0; i < w->n; i++) {
+        tj_concarray_append(w->concarray, &i);
+    }
+    return NULL;
+}
+
+static void *mutex_worker(void *arg) {
+    worker *w = arg;
+    size_t i;
+    for (i = 0; i < w->n; i++) {
+        pthread_mutex_lock(w->lock);
+        tj_array_append(w->array, &values[i % 64]);
+        pthread_mutex_unlock(w->lock);
+    }
+    return NULL;
+}
+
+static void run(tj_bench *bench, void *(*f)(void *), worker *proto,
+                int threads, size_t total) {
+    pthread_t tids[threads];
+    worker workers[threads];
+    int i;
+
+    tj_bench_start(bench);
+    for (i = 0; i < threads; i++) {
+        workers[i] = *proto;
+        workers[i].n = total / threads;
+        pthread_create(&tids[i], NULL, f, &workers[i]);
+    }
+    for (i = 0; i < threads; i++) {
+        pthread_join(tids[i], NULL);
+    }
+    tj_bench_stop(bench);
+}
+
+int main(int argc, char *argv[]) {
+    tj_bench *bench = tj_bench_create("tj_concarray", &argc, argv);
+    if (bench == NULL) {
+        return 1;
+    }
+
+    size_t total = (argc > 1) ? strtoul(argv[1], NULL, 10) : 4000000;
+    int max = (argc > 2) ? atoi(argv[2]) : 2 * sysconf(_SC_NPROCESSORS_ONLN);
+    pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+    int threads;
+
+    for (threads = 1; threads <= max; threads *= 2) {
+        worker w = { 0 };
+
+        tj_bench_begin(bench, total, "concarray %d threads", threads);
+        while (tj_bench_next(bench)) {
+            w.concarray = tj_concarray_create(sizeof(size_t));
+            run(bench, &concarray_worker, &w, threads, total);
+            tj_concarray_finalize(w.concarray);
+        }
+
+        tj_bench_begin(bench, total, "mutex %d threads", threads);
+        while (tj_bench_next(bench)) {
+            w.array = tj_array_create(0);
+            w.lock = &lock;
+            run(bench, &mutex_worker, &w, threads, total);
+            tj_array_finalize(w.array);
+        }
+    }
+
+    return tj_bench_finalize(bench);
+}
@@ -0,0 +1,225 @@
+/*
+ * Copyright (c) 2013 Bellerophon Mobile, LLC.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Push and pop throughput of TJ_HEAP_DECL heaps of 2, 4 and 8 children
+ * per node, with keys interleaved with values or split from them, at
+ * sizes from 1e3 up to the given maximum.  Keys are random 64 bit
+ * integers and values 24 byte records.  The "pointer" heap calls its
+ * comparator through a function pointer, as TJ_HEAP_DECL used to,
+ * for comparison with the inlined comparators of the others.  The
+ * "build" cases load each 4-ary heap with _buildFrom() rather than
+ * pushing its keys one by one.
+ *
+ * The "monotone" cases set the comparison heaps beside
+ * TJ_RADIX_HEAP_DECL on a monotone load, as from timers: holding n
+ * keys, repeatedly pop the minimum and push a new key a random distance
+ * past it.
+ *
+ * Usage: bench-tj_heap [bench options] [max]
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tj_bench.h"
+#include "tj_heap.h"
+
+typedef struct {
+    uint64_t a, b, c;
+} record;
+
+static int u64less(uint64_t a, uint64_t b) { return a < b; }
+static int (*volatile u64less_ptr)(uint64_t, uint64_t) = &u64less;
+static int u64indirect(uint64_t a, uint64_t b) { return u64less_ptr(a, b); }
+#define U64_LESS(a, b) ((a) < (b))
+
+TJ_HEAP_DECL_ARITY(heap2, uint64_t, record, u64less, 2)
+TJ_HEAP_IMPL(heap2)
+TJ_HEAP_DECL_ARITY(heap4, uint64_t, record, u64less, 4)
+TJ_HEAP_IMPL(heap4)
+TJ_HEAP_DECL_ARITY(macro4, uint64_t, record, U64_LESS, 4)
+TJ_HEAP_IMPL(macro4)
+TJ_HEAP_DECL_ARITY(pointer4, uint64_t, record, u64indirect, 4)
+TJ_HEAP_IMPL(pointer4)
+TJ_HEAP_DECL_ARITY(heap8, uint64_t, record, u64less, 8)
+TJ_HEAP_IMPL(heap8)
+TJ_HEAP_DECL_SPLIT(split4, uint64_t, record, u64less, 4)
+TJ_HEAP_IMPL(split4)
+TJ_HEAP_DECL_SPLIT(split8, uint64_t, record, u64less, 8)
+TJ_HEAP_IMPL(split8)
+TJ_RADIX_HEAP_DECL(radix, uint64_t, record)
+TJ_RADIX_HEAP_IMPL(radix)
+
+static uint64_t checksum;
+
+/*
+ * Fill the heap with n keys and drain it, cycles times per repetition,
+ * timing the pushes and the pops as separate cases.
+ */
+#define BENCH(heaptype, label, keys, n, cycles) do {                    \
+        heaptype *h = heaptype##_create(n);                             \
+        record r = { 0, 0, 0 };                                         \
+        uint64_t k;                                                     \
+        size_t cycle, i;                                                \
+        tj_bench_begin(bench, (n) * (cycles), "%s push %zu",            \
+                       label, (size_t) (n));                            \
+        while (tj_bench_next(bench)) {                                  \
+            for (cycle = 0; cycle < (cycles); cycle++) {                \
+                tj_bench_start(bench);                                  \
+                for (i = 0; i < (n); i++) {                             \
+                    r.a = i;                                            \
+                    heaptype##_add(h, (keys)[i], r);                    \
+                }                                                       \
+                tj_bench_stop(bench);                                   \
+                while (heaptype##_pop(h, &k, &r)) {                     \
+                    checksum += k ^ r.a;                                \
+                }                                                       \
+            }                                                           \
+        }                                                               \
+        tj_bench_begin(bench, (n) * (cycles), "%s pop %zu",             \
+                       label, (size_t) (n));                            \
+        while (tj_bench_next(bench)) {                                  \
+            for (cycle = 0; cycle < (cycles); cycle++) {                \
+                for (i = 0; i < (n); i++) {                             \
+                    r.a = i;                                            \
+                    heaptype##_add(h, (keys)[i], r);                    \
+                }                                                       \
+                tj_bench_start(bench);                                  \
+                while (heaptype##_pop(h, &k, &r)) {                     \
+                    checksum += k ^ r.a;                                \
+                }                                                       \
+                tj_bench_stop(bench);                                   \
+            }                                                           \
+        }                                                               \
+        heaptype##_finalize(h);                                         \
+    } while (0)
+
+/* As BENCH's push case, but loading the heap with a single _buildFrom(). */
+#define BENCH_BUILD(heaptype, label, elements, n, cycles) do {          \
+        heaptype *h = heaptype##_create(n);                             \
+        record r;                                                       \
+        uint64_t k;                                                     \
+        size_t cycle;                                                   \
+        tj_bench_begin(bench, (n) * (cycles), "%s %zu",                 \
+                       label, (size_t) (n));                            \
+        while (tj_bench_next(bench)) {                                  \
+            for (cycle = 0; cycle < (cycles); cycle++) {                \
+                tj_bench_start(bench);                                  \
+                heaptype##_buildFrom(h, (elements), (n));               \
+                tj_bench_stop(bench);                                   \
+                while (heaptype##_pop(h, &k, &r)) {                     \
+                    checksum += k ^ r.a;                                \
+                }                                                       \
+            }                                                           \
+        }                                                               \
+        heaptype##_finalize(h);                                         \
+    } while (0)
+
+/*
+ * Hold n keys and time ops pops each followed by a push of the popped
+ * key plus a random delta under 2^20, per pop and push pair.
+ */
+#define BENCH_MONOTONE(heaptype, label, deltas, n, ops) do {            \
+        heaptype *h = heaptype##_create(n);                             \
+        record r = { 0, 0, 0 };                                         \
+        uint64_t k;                                                     \
+        size_t i;                                                       \
+        tj_bench_begin(bench, (ops), "monotone %s %zu",                 \
+                       label, (size_t) (n));                            \
+        while (tj_bench_next(bench)) {                                  \
+            for (i = 0; i < (n); i++)                                   \
+                heaptype##_add(h, (deltas)[i], r);                      \
+            tj_bench_start(bench);                                      \
+            for (i = 0; i < (ops); i++) {                               \
+                heaptype##_pop(h, &k, &r);                              \
+                r.a++;                                                  \
+                heaptype##_add(h, k + (deltas)[i], r);                  \
+            }                                                           \
+            tj_bench_stop(bench);                                       \
+            while (heaptype##_pop(h, &k, &r)) {                         \
+                checksum += k ^ r.a;                                    \
+            }                                                           \
+        }                                                               \
+        heaptype##_finalize(h);                                         \
+    } while (0)
+
+int main(int argc, char *argv[]) {
+    tj_bench *bench = tj_bench_create("tj_heap", &argc, argv);
+    if (bench == NULL) {
+        return 1;
+    }
+
+    size_t max = (argc > 1) ? strtoul(argv[1], NULL, 10) : 1000000;
+    size_t n, i;
+
+    uint64_t *keys = malloc(max * sizeof(uint64_t));
+    uint64_t *deltas = malloc(max * sizeof(uint64_t));
+    macro4_element *elements = malloc(max * sizeof(macro4_element));
+    if (keys == NULL || deltas == NULL || elements == NULL) {
+        fprintf(stderr, "Out of memory.\n");
+        return 1;
+    }
+
+    srand(42);
+    for (i = 0; i < max; i++) {
+        keys[i] = ((uint64_t) rand() << 32) ^ rand();
+        deltas[i] = keys[i] & ((1 << 20) - 1);
+        elements[i].m_key = keys[i];
+        elements[i].m_value.a = i;
+        elements[i].m_value.b = elements[i].m_value.c = 0;
+    }
+
+    for (n = 1000; n <= max; n *= 10) {
+        /* Repeat small sizes to time about as many operations as max. */
+        size_t cycles = (max / n < 100) ? max / n : 100;
+        BENCH(heap2, "2-ary", keys, n, cycles);
+        BENCH(pointer4, "4-ary pointer", keys, n, cycles);
+        BENCH(heap4, "4-ary", keys, n, cycles);
+        BENCH(macro4, "4-ary macro", keys, n, cycles);
+        BENCH_BUILD(macro4, "4-ary build", elements, n, cycles);
+        BENCH(heap8, "8-ary", keys, n, cycles);
+        BENCH(split4, "4-ary split", keys, n, cycles);
+        BENCH(split8, "8-ary split", keys, n, cycles);
+        BENCH(radix, "radix", keys, n, cycles);
+    }
+
+    for (n = 1000; n <= max; n *= 10) {
+        BENCH_MONOTONE(heap2, "2-ary", deltas, n, max);
+        BENCH_MONOTONE(macro4, "4-ary macro", deltas, n, max);
+        BENCH_MONOTONE(split4, "4-ary split", deltas, n, max);
+        BENCH_MONOTONE(radix, "radix", deltas, n, max);
+    }
+
+    free(elements);
+    free(deltas);
+    free(keys);
+
+    /* Keep the checksum, and so the popping behind it, live. */
+    volatile uint64_t sink = checksum;
+    (void) sink;
+    return tj_bench_finalize(bench);
+}
@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) 2013 Bellerophon Mobile, LLC.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Times tj_log_log() calls, each formatting a message and passing it
+ * down the channel stack: to a channel that discards it, which leaves
+ * the formatting and dispatch, and to the fprintf channel writing to
+ * /dev/null.  The disabled level case logs below the channel's level,
+ * costing only the check of the level mask.  The async cases log
+ * through the writer thread instead, first timing only the calls,
+ * dropping messages when the ring is full, then until they are all
+ * flushed to the channel.
+ *
+ * Usage: bench-tj_log [bench options] [messages]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "tj_bench.h"
+#include "tj_log.h"
+
+static size_t logged;
+
+static void discard(void *data, tj_log_level level, const char *component,
+                    const char *file, const char *func, int line,
+                    tj_error *error, const char *msg) {
+    logged++;
+}
+
+static void run(tj_bench *bench, const char *label, size_t n, int flush) {
+    size_t i;
+
+    tj_bench_begin(bench, n, "%s", label);
+    while (tj_bench_next(bench)) {
+        tj_bench_start(bench);
+        for (i = 0; i < n; i++) {
+            TJ_LOG_LOG(TJ_LOG_LEVEL_COMPONENT, "bench", 0,
+                       "Request %zu from %s took %d ms.", i, "10.0.0.1", 42);
+        }
+        if (flush) {
+            tj_log_flush();
+        }
+        tj_bench_stop(bench);
+        tj_log_flush();
+    }
+}
+
+static void run_async(tj_bench *bench, const char *label, size_t n) {
+    size_t dropped = tj_log_getDropped();
+    char name[64];
+
+    snprintf(name, sizeof(name), "async %s calls", label);
+    tj_log_startAsync(0, TJ_LOG_OVERFLOW_DROP_COUNT);
+    run(bench, name, n, 0);
+    tj_log_stopAsync();
+    tj_bench_metric(bench, "dropped", tj_log_getDropped() - dropped);
+
+    snprintf(name, sizeof(name), "async %s flushed", label);
+    tj_log_startAsync(0, TJ_LOG_OVERFLOW_BLOCK);
+    run(bench, name, n, 1);
+    tj_log_stopAsync();
+}
+
+int main(int argc, char *argv[]) {
+    tj_bench *bench = tj_bench_create("tj_log", &argc, argv);
+    if (bench == NULL) {
+        return 1;
+    }
+
+    size_t n = (argc > 1) ? strtoul(argv[1], NULL, 10) : 200000;
+
+    FILE *devnull = fopen("/dev/null", "w");
+    if (devnull == NULL) {
+        perror("/dev/null");
+        return 1;
+    }
+
+    tj_log_removePrintfChannel();
+    tj_log_outchannel *out = tj_log_outchannel_create(0, &discard, 0);
+    tj_log_addOutChannel(out);
+    run(bench, "discarding channel", n, 0);
+    run_async(bench, "discarding channel", n);
+    tj_log_setLevel(out, TJ_LOG_LEVEL_CRITICAL);
+    run(bench, "disabled level", n, 0);
+    tj_log_setLevel(out, TJ_LOG_LEVEL_VERBOSE);
+    tj_log_removeOutChannel(out);
+
+    tj_log_setData(&tj_log_fprintfChannel, devnull);
+    tj_log_addOutChannel(&tj_log_fprintfChannel);
+    run(bench, "fprintf channel", n, 0);
+    run_async(bench, "fprintf channel", n);
+
+    return tj_bench_finalize(bench);
+}
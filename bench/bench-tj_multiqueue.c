@@ -0,0 +1,297 @@
+/*
+ * Copyright (c) 2013 Bellerophon Mobile, LLC.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Measures throughput and rank error of a tj_multiqueue from 1 to N
+ * threads, against a TJ_HEAP_DECL heap behind a mutex.
+ *
+ * The queue is prefilled, then each thread repeatedly pops an element
+ * and pushes a new random key.  Rank error is measured in a separate,
+ * shorter run that stamps every operation from a global counter and
+ * replays them in that order against a Fenwick tree of the keys
+ * present, counting the smaller keys each pop passed over.  Stamps are
+ * taken just outside the queue's locks, so the replay order is only
+ * approximate and even the mutex heap shows a small error.
+ *
+ * Usage: bench-tj_multiqueue [bench options] [ops] [max threads]
+ */
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tj_bench.h"
+#include "tj_heap.h"
+#include "tj_multiqueue.h"
+
+#define KEY_BITS 22
+#define PREFILL 100000
+#define RANK_OPS 200000
+
+#define KEY_LESS(a, b) ((a) < (b))
+TJ_HEAP_DECL(lockedheap, uint64_t, void *, KEY_LESS)
+TJ_HEAP_IMPL(lockedheap)
+
+/* A mutex around a heap, the baseline. */
+typedef struct {
+    pthread_mutex_t lock;
+    lockedheap *heap;
+} locked;
+
+typedef struct {
+    const char *label;
+    size_t perthread;   /* Heaps per thread, or 0 for the locked heap. */
+    int choices;
+} config;
+
+static const config configs[] = {
+    { "mutex heap", 0, 0 },
+    { "mq c=2 d=2", 2, 2 },
+    { "mq c=4 d=2", 4, 2 },
+    { "mq c=2 d=4", 2, 4 },
+};
+
+typedef struct {
+    uint64_t stamp;
+    uint64_t key;
+    int pop;
+} record;
+
+typedef struct {
+    const config *config;
+    tj_multiqueue *queue;
+    locked *heap;
+    size_t n;
+    uint64_t rng;
+    record *log;
+    size_t logged;
+} worker;
+
+static uint64_t clock_stamp;
+
+static uint64_t next_key(uint64_t *rng) {
+    *rng ^= *rng << 13;
+    *rng ^= *rng >> 7;
+    *rng ^= *rng << 17;
+    return *rng >> (64 - KEY_BITS);
+}
+
+static int push(worker *w, uint64_t key) {
+    int ok;
+    if (w->queue != NULL) {
+        return tj_multiqueue_push(w->queue, key, NULL);
+    }
+    pthread_mutex_lock(&w->heap->lock);
+    ok = lockedheap_add(w->heap->heap, key, NULL);
+    pthread_mutex_unlock(&w->heap->lock);
+    return ok;
+}
+
+static int pop(worker *w, uint64_t *key) {
+    void *value;
+    int ok;
+    if (w->queue != NULL) {
+        return tj_multiqueue_pop(w->queue, key, &value);
+    }
+    pthread_mutex_lock(&w->heap->lock);
+    ok = lockedheap_pop(w->heap->heap, key, &value);
+    pthread_mutex_unlock(&w->heap->lock);
+    return ok;
+}
+
+static void stamp(worker *w, uint64_t key, int popped) {
+    record *r = &w->log[w->logged++];
+    r->stamp = __atomic_fetch_add(&clock_stamp, 1, __ATOMIC_RELAXED);
+    r->key = key;
+    r->pop = popped;
+}
+
+static void *run_worker(void *arg) {
+    worker *w = arg;
+    uint64_t key;
+    size_t i;
+
+    for (i = 0; i < w->n; i++) {
+        if (pop(w, &key) && w->log != NULL) {
+            stamp(w, key, 1);
+        }
+        key = next_key(&w->rng);
+        if (w->log != NULL) {
+            stamp(w, key, 0);
+        }
+        push(w, key);
+    }
+    return NULL;
+}
+
+static int by_stamp(const void *a, const void *b) {
+    uint64_t x = ((const record *) a)->stamp, y = ((const record *) b)->stamp;
+    return (x > y) - (x < y);
+}
+
+/* Fenwick tree over the key space, counting the keys present. */
+static void fenwick_add(int *tree, uint64_t key, int delta) {
+    for (key++; key <= (1 << KEY_BITS); key += key & -key) {
+        tree[key - 1] += delta;
+    }
+}
+
+static uint64_t fenwick_below(const int *tree, uint64_t key) {
+    uint64_t sum = 0;
+    for (; key > 0; key -= key & -key) {
+        sum += tree[key - 1];
+    }
+    return sum;
+}
+
+/*
+ * Runs ops operations over the threads, timing them if bench is given.
+ * If log is given, records every operation there and fills in the mean
+ * and maximum rank error of the pops.
+ */
+static void run(tj_bench *bench, const config *c, int threads, size_t ops,
+                record *log, double *mean, uint64_t *max) {
+    pthread_t tids[threads];
+    worker workers[threads];
+    tj_multiqueue *queue = NULL;
+    locked heap;
+    int *tree = NULL;
+    uint64_t rng = 88172645463325252ULL;
+    size_t i, total = 0;
+    int t;
+
+    if (c->perthread > 0) {
+        queue = tj_multiqueue_create(c->perthread * threads, c->choices);
+    } else {
+        pthread_mutex_init(&heap.lock, NULL);
+        heap.heap = lockedheap_create(PREFILL + threads);
+    }
+    if (log != NULL) {
+        tree = calloc(1 << KEY_BITS, sizeof(int));
+    }
+
+    for (i = 0; i < PREFILL; i++) {
+        worker w = { c, queue, &heap };
+        uint64_t key = next_key(&rng);
+        push(&w, key);
+        if (tree != NULL) {
+            fenwick_add(tree, key, 1);
+        }
+    }
+
+    if (bench != NULL) {
+        tj_bench_start(bench);
+    }
+    for (t = 0; t < threads; t++) {
+        worker *w = &workers[t];
+        memset(w, 0, sizeof(*w));
+        w->config = c;
+        w->queue = queue;
+        w->heap = &heap;
+        w->n = ops / threads;
+        w->rng = rng + t * 0x9e3779b97f4a7c15ULL;
+        w->log = (log != NULL) ? log + 2 * w->n * t : NULL;
+        pthread_create(&tids[t], NULL, &run_worker, w);
+    }
+    for (t = 0; t < threads; t++) {
+        pthread_join(tids[t], NULL);
+    }
+    if (bench != NULL) {
+        tj_bench_stop(bench);
+    }
+
+    if (log != NULL) {
+        /* Gather each thread's log, then replay them in stamp order. */
+        for (t = 0; t < threads; t++) {
+            memmove(log + total, workers[t].log,
+                    workers[t].logged * sizeof(record));
+            total += workers[t].logged;
+        }
+        qsort(log, total, sizeof(record), &by_stamp);
+
+        double sum = 0;
+        size_t pops = 0;
+        *max = 0;
+        for (i = 0; i < total; i++) {
+            if (log[i].pop) {
+                uint64_t rank = fenwick_below(tree, log[i].key);
+                sum += rank;
+                pops++;
+                if (rank > *max) {
+                    *max = rank;
+                }
+                fenwick_add(tree, log[i].key, -1);
+            } else {
+                fenwick_add(tree, log[i].key, 1);
+            }
+        }
+        *mean = (pops > 0) ? sum / pops : 0;
+        free(tree);
+    }
+
+    if (queue != NULL) {
+        tj_multiqueue_finalize(queue);
+    } else {
+        lockedheap_finalize(heap.heap);
+        pthread_mutex_destroy(&heap.lock);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    tj_bench *bench = tj_bench_create("tj_multiqueue", &argc, argv);
+    if (bench == NULL) {
+        return 1;
+    }
+
+    size_t ops = (argc > 1) ? strtoul(argv[1], NULL, 10) : 1000000;
+    int max = (argc > 2) ? atoi(argv[2]) : 64;
+    record *log = malloc(2 * RANK_OPS * sizeof(record));
+    size_t c;
+    int threads;
+
+    if (log == NULL) {
+        fprintf(stderr, "Out of memory.\n");
+        return 1;
+    }
+
+    for (threads = 1; threads <= max; threads *= 2) {
+        for (c = 0; c < sizeof(configs) / sizeof(configs[0]); c++) {
+            double mean;
+            uint64_t worst;
+            tj_bench_begin(bench, ops, "%s %d threads", configs[c].label,
+                           threads);
+            while (tj_bench_next(bench)) {
+                run(bench, &configs[c], threads, ops, NULL, NULL, NULL);
+            }
+            run(NULL, &configs[c], threads, RANK_OPS, log, &mean, &worst);
+            tj_bench_metric(bench, "mean rank error", mean);
+            tj_bench_metric(bench, "max rank error", worst);
+        }
+    }
+
+    free(log);
+    return tj_bench_finalize(bench);
+}
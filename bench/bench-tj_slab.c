@@ -0,0 +1,151 @@
+/*
+ * Copyright (c) 2013 Bellerophon Mobile, LLC.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Compares malloc()/free() against tj_slab under a churn workload: each
+ * thread keeps a working set of live objects and repeatedly frees a
+ * random one and allocates a replacement.
+ *
+ * Usage: bench-tj_slab [bench options] [operations] [threads] [live]
+ *                      [objsize]
+ */
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tj_bench.h"
+#include "tj_slab.h"
+
+typedef struct {
+    tj_slab *slab;
+    size_t ops;
+    size_t live;
+    size_t objsize;
+    unsigned seed;
+} worker;
+
+static void *churn(void *arg) {
+    worker *w = arg;
+    void **live = calloc(w->live, sizeof(void *));
+    size_t i;
+
+    for (i = 0; i < w->ops; i++) {
+        size_t k = rand_r(&w->seed) % w->live;
+        if (w->slab != NULL) {
+            if (live[k] != NULL) {
+                tj_slab_free(w->slab, live[k]);
+            }
+            live[k] = tj_slab_alloc(w->slab);
+        } else {
+            free(live[k]);
+            live[k] = malloc(w->objsize);
+        }
+        memset(live[k], 0, sizeof(void *));
+    }
+
+    for (i = 0; i < w->live; i++) {
+        if (w->slab != NULL) {
+            if (live[i] != NULL) {
+                tj_slab_free(w->slab, live[i]);
+            }
+        } else {
+            free(live[i]);
+        }
+    }
+    free(live);
+    return NULL;
+}
+
+/*
+ * Runs a case of the churn, on a fresh slab created with the given
+ * flags for each repetition, or on malloc() and free() for flags -1.
+ */
+static void run(tj_bench *bench, const char *label, int flags, size_t ops,
+                int threads, size_t live, size_t objsize) {
+    pthread_t tid[threads];
+    worker w[threads];
+    tj_slab *slab = NULL;
+    tj_slab_stats stats = { 0 };
+    int i;
+
+    tj_bench_begin(bench, ops, "%s %d threads", label, threads);
+    while (tj_bench_next(bench)) {
+        if (flags >= 0) {
+            slab = tj_slab_create(objsize, flags);
+        }
+        tj_bench_start(bench);
+        for (i = 0; i < threads; i++) {
+            w[i].slab = slab;
+            w[i].ops = ops / threads;
+            w[i].live = live;
+            w[i].objsize = objsize;
+            w[i].seed = i + 1;
+            pthread_create(&tid[i], NULL, &churn, &w[i]);
+        }
+        for (i = 0; i < threads; i++) {
+            pthread_join(tid[i], NULL);
+        }
+        tj_bench_stop(bench);
+
+        if (slab != NULL) {
+            tj_slab_getStats(slab, &stats);
+            tj_slab_finalize(slab);
+        }
+    }
+
+    if (flags >= 0) {
+        tj_bench_metric(bench, "slabs", stats.slabs);
+        tj_bench_metric(bench, "slab bytes", stats.slabsize);
+        tj_bench_metric(bench, "objects per slab", stats.perslab);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    tj_bench *bench = tj_bench_create("tj_slab", &argc, argv);
+    if (bench == NULL) {
+        return 1;
+    }
+
+    size_t ops = (argc > 1) ? strtoul(argv[1], NULL, 10) : 4000000;
+    int maxthreads = (argc > 2) ? atoi(argv[2]) : 4;
+    size_t live = (argc > 3) ? strtoul(argv[3], NULL, 10) : 100000;
+    size_t objsize = (argc > 4) ? strtoul(argv[4], NULL, 10) : 48;
+    int threads;
+
+    for (threads = 1; threads <= maxthreads; threads *= 2) {
+        run(bench, "malloc/free", -1, ops, threads, live, objsize);
+        if (threads == 1) {
+            run(bench, "tj_slab", 0, ops, threads, live, objsize);
+        }
+        run(bench, "tj_slab locked", TJ_SLAB_LOCKED, ops, threads, live,
+            objsize);
+        run(bench, "tj_slab magazines", TJ_SLAB_MAGAZINES, ops, threads,
+            live, objsize);
+    }
+
+    return tj_bench_finalize(bench);
+}
@@ -0,0 +1,153 @@
+/*
+ * Copyright (c) 2013 Bellerophon Mobile, LLC.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Compares qsort() against the tj_sort.h generated sorts, on plain
+ * uint64_t arrays and on a tj_array of pointers to ints.
+ *
+ * Usage: bench-tj_sort [bench options] [count] [threads]
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "tj_array.h"
+#include "tj_bench.h"
+#include "tj_sort.h"
+
+#define U64_LESS(a, b) ((a) < (b))
+#define U64_KEY(a) (a)
+#define ITEM_LESS(a, b) (*(int *) (a) < *(int *) (b))
+#define ITEM_KEY(a) ((uint64_t) (uint32_t) *(int *) (a))
+
+TJ_SORT_DECL(u64_sort, uint64_t, U64_LESS)
+TJ_RADIX_SORT_DECL(u64_radix, uint64_t, U64_KEY)
+TJ_ARRAY_SORT_DECL(item_sort, ITEM_LESS)
+TJ_ARRAY_RADIX_SORT_DECL(item_radix, ITEM_KEY)
+
+static int u64_cmp(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *) a, y = *(const uint64_t *) b;
+    return (x > y) - (x < y);
+}
+
+static int item_qsort_cmp(const void *a, const void *b) {
+    int x = **(int * const *) a, y = **(int * const *) b;
+    return (x > y) - (x < y);
+}
+
+static int item_cmp(const void *a, const void *b) {
+    int x = *(const int *) a, y = *(const int *) b;
+    return (x > y) - (x < y);
+}
+
+int main(int argc, char *argv[]) {
+    tj_bench *bench = tj_bench_create("tj_sort", &argc, argv);
+    if (bench == NULL) {
+        return 1;
+    }
+
+    size_t n = (argc > 1) ? strtoul(argv[1], NULL, 10) : 1000000;
+    int threads = (argc > 2) ? atoi(argv[2]) : sysconf(_SC_NPROCESSORS_ONLN);
+    size_t i;
+
+    uint64_t *orig = malloc(n * sizeof(uint64_t));
+    uint64_t *a = malloc(n * sizeof(uint64_t));
+    int *values = malloc(n * sizeof(int));
+    void **items = malloc(n * sizeof(void *));
+    tj_array *array = tj_array_create(n);
+    if (!orig || !a || !values || !items || !array) {
+        fprintf(stderr, "Out of memory.\n");
+        return 1;
+    }
+
+    srand(42);
+    for (i = 0; i < n; i++) {
+        orig[i] = ((uint64_t) rand() << 32) ^ rand();
+        values[i] = rand();
+    }
+
+    /* Time one sort of the unsorted keys per repetition. */
+#define BENCH_U64(label, sort) do {                                     \
+        tj_bench_begin(bench, n, label);                                \
+        while (tj_bench_next(bench)) {                                  \
+            memcpy(a, orig, n * sizeof(uint64_t));                      \
+            tj_bench_start(bench);                                      \
+            sort;                                                       \
+            tj_bench_stop(bench);                                       \
+        }                                                               \
+    } while (0)
+
+    BENCH_U64("uint64 qsort", qsort(a, n, sizeof(uint64_t), &u64_cmp));
+    BENCH_U64("uint64 TJ_SORT_DECL", u64_sort(a, n));
+    tj_bench_begin(bench, n, "uint64 TJ_SORT_DECL %d threads", threads);
+    while (tj_bench_next(bench)) {
+        memcpy(a, orig, n * sizeof(uint64_t));
+        tj_bench_start(bench);
+        u64_sort_parallel(a, n, threads);
+        tj_bench_stop(bench);
+    }
+    BENCH_U64("uint64 TJ_RADIX_SORT_DECL", u64_radix(a, n));
+
+    tj_bench_begin(bench, n, "tj_array items qsort");
+    while (tj_bench_next(bench)) {
+        for (i = 0; i < n; i++) {
+            items[i] = &values[i];
+        }
+        tj_bench_start(bench);
+        qsort(items, n, sizeof(void *), &item_qsort_cmp);
+        tj_bench_stop(bench);
+    }
+
+    /* As BENCH_U64, on the tj_array of pointers to the values. */
+#define BENCH_ARRAY(sort) do {                                          \
+        while (tj_bench_next(bench)) {                                  \
+            tj_array_clear(array);                                      \
+            for (i = 0; i < n; i++)                                     \
+                tj_array_append(array, &values[i]);                     \
+            tj_bench_start(bench);                                      \
+            sort;                                                       \
+            tj_bench_stop(bench);                                       \
+        }                                                               \
+    } while (0)
+
+    tj_bench_begin(bench, n, "tj_array_sort");
+    BENCH_ARRAY(tj_array_sort(array, &item_cmp));
+    tj_bench_begin(bench, n, "tj_array TJ_ARRAY_SORT_DECL");
+    BENCH_ARRAY(item_sort(array));
+    tj_bench_begin(bench, n, "tj_array ... %d threads", threads);
+    BENCH_ARRAY(item_sort_parallel(array, threads));
+    tj_bench_begin(bench, n, "tj_array ..._RADIX_SORT_DECL");
+    BENCH_ARRAY(item_radix(array));
+
+    tj_array_finalize(array);
+    free(items);
+    free(values);
+    free(a);
+    free(orig);
+
+    return tj_bench_finalize(bench);
+}
@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2013 Bellerophon Mobile, LLC.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Times expanding a template of text and variables with tj_template,
+ * with short and long substitutions, into a reused target buffer.
+ *
+ * Usage: bench-tj_template [bench options] [variables]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "tj_bench.h"
+#include "tj_buffer.h"
+#include "tj_template.h"
+
+static void run(tj_bench *bench, const char *label, size_t n,
+                const char *value) {
+    tj_template_variables *vars = tj_template_variables_create();
+    tj_buffer *source = tj_buffer_create(0);
+    tj_buffer *target = tj_buffer_create(0);
+    char name[32];
+    size_t i;
+
+    for (i = 0; i < n; i++) {
+        snprintf(name, sizeof(name), "VAR%zu", i);
+        tj_template_variables_setFromString(vars, name, value);
+        tj_buffer_printf(source, "<td class=\"cell\">$%s</td>\n", name);
+    }
+
+    tj_bench_begin(bench, n, "%s", label);
+    while (tj_bench_next(bench)) {
+        tj_buffer_reset(target);
+        tj_bench_start(bench);
+        tj_template_variables_apply(vars, target, source);
+        tj_bench_stop(bench);
+    }
+    tj_bench_metric(bench, "bytes", tj_buffer_getUsed(target));
+
+    tj_buffer_finalize(target);
+    tj_buffer_finalize(source);
+    tj_template_variables_finalize(vars);
+}
+
+int main(int argc, char *argv[]) {
+    tj_bench *bench = tj_bench_create("tj_template", &argc, argv);
+    if (bench == NULL) {
+        return 1;
+    }
+
+    size_t n = (argc > 1) ? strtoul(argv[1], NULL, 10) : 1000;
+
+    run(bench, "apply short values", n, "42");
+    run(bench, "apply long values", n,
+        "Lorem ipsum dolor sit amet, consectetur adipiscing elit, sed do "
+        "eiusmod tempor incididunt ut labore et dolore magna aliqua.");
+
+    return tj_bench_finalize(bench);
+}
@@ -0,0 +1,259 @@
+/*
+ * Copyright (c) 2013 Bellerophon Mobile, LLC.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "tj_bench.h"
+
+#define NAME_SIZE 128
+
+struct tj_bench {
+    const char *suite;
+    int reps;
+    int warmup;
+    const char *filter;
+    FILE *out;          /* The table. */
+    FILE *json;
+    int cases;          /* Cases written to the JSON. */
+
+    /* The current case; rep counts from -1 through warmup + reps. */
+    char name[NAME_SIZE];
+    double ops;
+    int running;
+    int reported;
+    int rep;
+    double started;
+    double elapsed;
+    double *samples;
+    double *sorted;
+};
+
+static void usage(const char *program) {
+    fprintf(stderr,
+            "Usage: %s [--reps N] [--warmup N] [--filter STR] "
+            "[--json PATH] [arguments]\n", program);
+}
+
+static int compare_doubles(const void *a, const void *b) {
+    double x = *(const double *) a, y = *(const double *) b;
+    return (x > y) - (x < y);
+}
+
+static void json_string(FILE *f, const char *s) {
+    fputc('"', f);
+    for (; *s != '\0'; s++) {
+        if (*s == '"' || *s == '\\') {
+            fprintf(f, "\\%c", *s);
+        } else if ((unsigned char) *s < 0x20) {
+            fprintf(f, "\\u%04x", *s);
+        } else {
+            fputc(*s, f);
+        }
+    }
+    fputc('"', f);
+}
+
+/* Closes the JSON object of the last case, left open for metrics. */
+static void close_case(tj_bench *bench) {
+    if (bench->reported && bench->json != NULL) {
+        fprintf(bench->json, " }");
+    }
+    bench->reported = 0;
+}
+
+static void report(tj_bench *bench) {
+    double *s = bench->sorted;
+    int n = bench->reps;
+    double median, p99;
+
+    memcpy(s, bench->samples, n * sizeof(double));
+    qsort(s, n, sizeof(double), &compare_doubles);
+    median = (n % 2) ? s[n / 2] : (s[n / 2 - 1] + s[n / 2]) / 2;
+    p99 = s[(n * 99 + 99) / 100 - 1];
+
+    if (bench->cases == 0) {
+        fprintf(bench->out, "%-40s %12s %12s %12s %12s\n", "case", "ops",
+                "median ns/op", "p99 ns/op", "min ns/op");
+    }
+    fprintf(bench->out, "%-40s %12.0f %12.2f %12.2f %12.2f\n", bench->name,
+            bench->ops, median / bench->ops, p99 / bench->ops,
+            s[0] / bench->ops);
+
+    if (bench->json != NULL) {
+        fprintf(bench->json, "%s\n    { \"name\": ", bench->cases ? "," : "");
+        json_string(bench->json, bench->name);
+        fprintf(bench->json, ", \"ops\": %.0f, \"median_ns\": %.3f, "
+                "\"p99_ns\": %.3f, \"min_ns\": %.3f",
+                bench->ops, median / bench->ops, p99 / bench->ops,
+                s[0] / bench->ops);
+    }
+    bench->cases++;
+    bench->reported = 1;
+}
+
+tj_bench *tj_bench_create(const char *suite, int *argc, char *argv[]) {
+    int reps = 10, warmup = 1;
+    const char *filter = NULL, *json = NULL;
+    int i, kept = 1;
+
+    for (i = 1; i < *argc; i++) {
+        const char *value = (i + 1 < *argc) ? argv[i + 1] : NULL;
+        if (strcmp(argv[i], "--reps") == 0 && value != NULL) {
+            reps = atoi(value);
+            i++;
+        } else if (strcmp(argv[i], "--warmup") == 0 && value != NULL) {
+            warmup = atoi(value);
+            i++;
+        } else if (strcmp(argv[i], "--filter") == 0 && value != NULL) {
+            filter = value;
+            i++;
+        } else if (strcmp(argv[i], "--json") == 0 && value != NULL) {
+            json = value;
+            i++;
+        } else if (strncmp(argv[i], "--", 2) == 0) {
+            usage(argv[0]);
+            return NULL;
+        } else {
+            argv[kept++] = argv[i];
+        }
+    }
+    *argc = kept;
+    argv[kept] = NULL;
+
+    if (reps < 1 || warmup < 0) {
+        usage(argv[0]);
+        return NULL;
+    }
+
+    tj_bench *bench = calloc(1, sizeof(*bench));
+    if (bench == NULL) {
+        return NULL;
+    }
+    bench->suite = suite;
+    bench->reps = reps;
+    bench->warmup = warmup;
+    bench->filter = filter;
+    bench->out = stdout;
+    bench->samples = malloc(reps * sizeof(double));
+    bench->sorted = malloc(reps * sizeof(double));
+    if (bench->samples == NULL || bench->sorted == NULL) {
+        tj_bench_finalize(bench);
+        return NULL;
+    }
+
+    if (json != NULL && strcmp(json, "-") == 0) {
+        bench->json = stdout;
+        bench->out = stderr;
+    } else if (json != NULL && (bench->json = fopen(json, "w")) == NULL) {
+        perror(json);
+        tj_bench_finalize(bench);
+        return NULL;
+    }
+    if (bench->json != NULL) {
+        fprintf(bench->json, "{\n  \"suite\": ");
+        json_string(bench->json, suite);
+        fprintf(bench->json, ",\n  \"reps\": %d,\n  \"warmup\": %d,\n"
+                "  \"results\": [", reps, warmup);
+    }
+
+    return bench;
+}
+
+int tj_bench_finalize(tj_bench *bench) {
+    int failed = 0;
+
+    if (bench->json != NULL) {
+        close_case(bench);
+        fprintf(bench->json, "\n  ]\n}\n");
+        failed = ferror(bench->json);
+        if (bench->json != stdout) {
+            failed |= fclose(bench->json);
+        }
+    }
+    free(bench->samples);
+    free(bench->sorted);
+    free(bench);
+    return failed != 0;
+}
+
+void tj_bench_begin(tj_bench *bench, double ops, const char *format, ...) {
+    va_list ap;
+
+    close_case(bench);
+    va_start(ap, format);
+    vsnprintf(bench->name, sizeof(bench->name), format, ap);
+    va_end(ap);
+
+    bench->ops = (ops > 0) ? ops : 1;
+    bench->rep = -1;
+    bench->running = (bench->filter == NULL ||
+                      strstr(bench->name, bench->filter) != NULL);
+}
+
+int tj_bench_next(tj_bench *bench) {
+    if (!bench->running) {
+        return 0;
+    }
+
+    if (bench->rep >= bench->warmup) {
+        bench->samples[bench->rep - bench->warmup] = bench->elapsed;
+    }
+    if (++bench->rep == bench->warmup + bench->reps) {
+        bench->running = 0;
+        report(bench);
+        return 0;
+    }
+    bench->elapsed = 0;
+    return 1;
+}
+
+void tj_bench_start(tj_bench *bench) {
+    bench->started = tj_bench_now();
+}
+
+void tj_bench_stop(tj_bench *bench) {
+    bench->elapsed += tj_bench_now() - bench->started;
+}
+
+void tj_bench_metric(tj_bench *bench, const char *name, double value) {
+    if (!bench->reported) {
+        return;
+    }
+    fprintf(bench->out, "    %-36s %12.10g\n", name, value);
+    if (bench->json != NULL) {
+        fprintf(bench->json, ", ");
+        json_string(bench->json, name);
+        fprintf(bench->json, ": %.6g", value);
+    }
+}
+
+double tj_bench_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
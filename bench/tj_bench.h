@@ -0,0 +1,112 @@
+/*
+ * Copyright (c) 2013 Bellerophon Mobile, LLC.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * \file tj_bench.h
+ *
+ * Provides a small timing harness for the benchmark programs.
+ *
+ * A benchmark is a series of named cases.  Each case runs a number of
+ * warmup repetitions, which are discarded, then a number of timed
+ * repetitions, each timed on a monotonic clock between calls to
+ * tj_bench_start() and tj_bench_stop(), so setup within a repetition
+ * can go untimed.  Once a case's repetitions are done it reports the
+ * median, the 99th percentile and the minimum time per operation,
+ * with the percentile taken by nearest rank: under 100 repetitions it
+ * is the slowest.  A case looks like:
+ *
+ *     tj_bench_begin(bench, n, "4-ary push");
+ *     while (tj_bench_next(bench)) {
+ *         ... untimed setup ...
+ *         tj_bench_start(bench);
+ *         ... n operations ...
+ *         tj_bench_stop(bench);
+ *     }
+ *
+ * Results are printed as a table and, given --json, written to a file
+ * as JSON for comparison between runs.  The options, taken out of the
+ * command line before the program's own arguments are read, are:
+ *
+ *     --reps N      Timed repetitions per case, default 10.
+ *     --warmup N    Discarded repetitions per case, default 1.
+ *     --filter STR  Run only the cases whose names contain STR.
+ *     --json PATH   Also write results to PATH, or stdout for "-".
+ *
+ * A harness is not thread safe; threaded cases start and stop the clock
+ * around spawning and joining their threads.
+ */
+
+#pragma once
+
+#include <stddef.h>
+
+typedef struct tj_bench tj_bench;
+
+/**
+ * Create a harness, taking its options out of the command line.  On
+ * return argc and argv hold only the program name and its own
+ * arguments.
+ *
+ * \param suite Name of the benchmark program, for the JSON output.
+ *
+ * \return The harness, NULL after printing usage on bad options.
+ */
+tj_bench *tj_bench_create(const char *suite, int *argc, char *argv[]);
+
+/**
+ * Finish the output and free the harness.
+ *
+ * \return 0, or 1 if writing the JSON output failed.
+ */
+int tj_bench_finalize(tj_bench *bench);
+
+/**
+ * Begin a case.  The name is a printf() format.
+ *
+ * \param ops Operations per repetition, for per operation times.
+ */
+void tj_bench_begin(tj_bench *bench, double ops, const char *format, ...);
+
+/**
+ * Advance to the case's next repetition, recording the one before.
+ *
+ * \return 1 while there is a repetition to run, 0 once the case is done
+ * and reported, or filtered out.
+ */
+int tj_bench_next(tj_bench *bench);
+
+/** Start timing the current repetition. */
+void tj_bench_start(tj_bench *bench);
+
+/** Stop timing; a repetition may start and stop several times. */
+void tj_bench_stop(tj_bench *bench);
+
+/**
+ * Attach another measurement to the case just reported, such as an
+ * error rate or a memory size.
+ */
+void tj_bench_metric(tj_bench *bench, const char *name, double value);
+
+/** Returns the time on the monotonic clock, in nanoseconds. */
+double tj_bench_now(void);
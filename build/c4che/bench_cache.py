@@ -0,0 +1,41 @@
+AR = '/usr/bin/ar'
+ARFLAGS = 'rcs'
+BINDIR = '/usr/local/bin'
+CC = ['/usr/bin/gcc']
+CCLNK_SRC_F = []
+CCLNK_TGT_F = ['-o']
+CC_NAME = 'gcc'
+CC_SRC_F = []
+CC_TGT_F = ['-c', '-o']
+CC_VERSION = ('12', '2', '0')
+CFLAGS = ['-std=gnu99', '-Wall', '-Werror', '-O2']
+CFLAGS_MACBUNDLE = ['-fPIC']
+CFLAGS_cshlib = ['-fPIC']
+COMPILER_CC = 'gcc'
+CPPPATH_ST = '-I%s'
+DEFINES = ['NDEBUG']
+DEFINES_ST = '-D%s'
+DEST_BINFMT = 'elf'
+DEST_CPU = 'x86_64'
+DEST_OS = 'linux'
+LIBDIR = '/usr/local/lib'
+LIBPATH_ST = '-L%s'
+LIB_DL = ['dl']
+LIB_PTHREAD = ['pthread']
+LIB_SQLITE3 = ['sqlite3']
+LIB_ST = '-l%s'
+LINKFLAGS_MACBUNDLE = ['-bundle', '-undefined', 'dynamic_lookup']
+LINKFLAGS_cshlib = ['-shared']
+LINKFLAGS_cstlib = ['-Wl,-Bstatic']
+LINK_CC = ['/usr/bin/gcc']
+PREFIX = '/usr/local'
+RPATH_ST = '-Wl,-rpath,%s'
+SHLIB_MARKER = '-Wl,-Bdynamic'
+SONAME_ST = '-Wl,-h,%s'
+STLIBPATH_ST = '-L%s'
+STLIB_MARKER = '-Wl,-Bstatic'
+STLIB_ST = '-l%s'
+cprogram_PATTERN = '%s'
+cshlib_PATTERN = 'lib%s.so'
+cstlib_PATTERN = 'lib%s.a'
+macbundle_PATTERN = '%s.bundle'
@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2013 Bellerophon Mobile, LLC.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "tj_allocator.h"
+
+static void *stdlib_alloc(void *ctx, size_t size) {
+    return malloc(size);
+}
+
+static void *stdlib_realloc(void *ctx, void *ptr, size_t oldsize,
+                            size_t size) {
+    return realloc(ptr, size);
+}
+
+static void stdlib_free(void *ctx, void *ptr, size_t size) {
+    free(ptr);
+}
+
+const tj_allocator tj_allocator_stdlib = {
+    .alloc = &stdlib_alloc,
+    .realloc = &stdlib_realloc,
+    .free = &stdlib_free,
+    .ctx = NULL,
+};
+
+static const tj_allocator *default_allocator = &tj_allocator_stdlib;
+
+void tj_allocator_setDefault(const tj_allocator *allocator) {
+    if (allocator == NULL) {
+        allocator = &tj_allocator_stdlib;
+    }
+    __atomic_store_n(&default_allocator, allocator, __ATOMIC_RELEASE);
+}
+
+const tj_allocator *tj_allocator_getDefault(void) {
+    return __atomic_load_n(&default_allocator, __ATOMIC_ACQUIRE);
+}
+
+const tj_allocator *tj_allocator_orDefault(const tj_allocator *allocator) {
+    return (allocator != NULL) ? allocator : tj_allocator_getDefault();
+}
+
+void *tj_allocator_alloc(const tj_allocator *allocator, size_t size) {
+    return allocator->alloc(allocator->ctx, size);
+}
+
+void *tj_allocator_calloc(const tj_allocator *allocator, size_t size) {
+    void *p = allocator->alloc(allocator->ctx, size);
+    if (p != NULL) {
+        memset(p, 0, size);
+    }
+    return p;
+}
+
+void *tj_allocator_realloc(const tj_allocator *allocator, void *ptr,
+                           size_t oldsize, size_t size) {
+    return allocator->realloc(allocator->ctx, ptr, oldsize, size);
+}
+
+void tj_allocator_free(const tj_allocator *allocator, void *ptr, size_t size) {
+    allocator->free(allocator->ctx, ptr, size);
+}
+
+char *tj_allocator_strdup(const tj_allocator *allocator, const char *str) {
+    size_t n = strlen(str) + 1;
+    char *copy = allocator->alloc(allocator->ctx, n);
+    if (copy != NULL) {
+        memcpy(copy, str, n);
+    }
+    return copy;
+}
+
+void tj_allocator_freeString(const tj_allocator *allocator, char *str) {
+    if (str != NULL) {
+        allocator->free(allocator->ctx, str, strlen(str) + 1);
+    }
+}
@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2013 Bellerophon Mobile, LLC.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * \file tj_allocator.h
+ *
+ * Provides a pluggable allocator interface, used by the tj-tools modules
+ * for all of their memory.
+ *
+ * A tj_allocator is a table of alloc, realloc and free functions plus a
+ * context pointer passed to each, so allocations can be routed to a
+ * pool, an arena, a tracking allocator, or another malloc implementation
+ * without relinking.  Each module has *_createWithAllocator() variants of
+ * its constructors; objects remember the allocator they were created
+ * with and allocate and free through it for their whole life, so the
+ * allocator must outlive them.  The plain constructors use the default
+ * allocator, which is the C library's unless changed with
+ * tj_allocator_setDefault().
+ *
+ * Sizes are passed to realloc and free so that allocators which do not
+ * keep headers, such as pools and arenas, need not track them.
+ */
+
+#pragma once
+
+#include <stddef.h>
+
+typedef struct tj_allocator tj_allocator;
+
+struct tj_allocator {
+    /** Allocate size bytes, suitably aligned for any type.  NULL on failure. */
+    void *(*alloc)(void *ctx, size_t size);
+
+    /**
+     * Resize ptr, which was allocated with oldsize bytes, to size bytes.
+     * NULL on failure, in which case ptr is untouched.  ptr may be NULL.
+     */
+    void *(*realloc)(void *ctx, void *ptr, size_t oldsize, size_t size);
+
+    /** Free ptr, which was allocated with size bytes.  ptr may be NULL. */
+    void (*free)(void *ctx, void *ptr, size_t size);
+
+    /** Passed to each of the functions. */
+    void *ctx;
+};
+
+/** The C library's malloc(), realloc() and free(). */
+extern const tj_allocator tj_allocator_stdlib;
+
+/**
+ * Set the default allocator, used by objects created without one.  Set
+ * this before creating any objects; those created before keep the
+ * allocator they were created with.
+ *
+ * \param allocator The new default, or NULL for tj_allocator_stdlib.
+ */
+void tj_allocator_setDefault(const tj_allocator *allocator);
+
+/** Returns the default allocator. */
+const tj_allocator *tj_allocator_getDefault(void);
+
+/** Returns allocator, or the default allocator if it is NULL. */
+const tj_allocator *tj_allocator_orDefault(const tj_allocator *allocator);
+
+/**
+ * \name Convenience wrappers
+ *
+ * These call through the given allocator, which must not be NULL.
+ * \{
+ */
+void *tj_allocator_alloc(const tj_allocator *allocator, size_t size);
+void *tj_allocator_calloc(const tj_allocator *allocator, size_t size);
+void *tj_allocator_realloc(const tj_allocator *allocator, void *ptr,
+                           size_t oldsize, size_t size);
+void tj_allocator_free(const tj_allocator *allocator, void *ptr, size_t size);
+char *tj_allocator_strdup(const tj_allocator *allocator, const char *str);
+
+/** Free a string from tj_allocator_strdup(). */
+void tj_allocator_freeString(const tj_allocator *allocator, char *str);
+/** \} */
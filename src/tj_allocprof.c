@@ -0,0 +1,423 @@
+/*
+ * Copyright (c) 2013 Bellerophon Mobile, LLC.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "tj_allocprof.h"
+
+/* Sampled pointers are spread over this many independently locked tables. */
+#define STRIPE_BITS 6
+#define STRIPES (1 << STRIPE_BITS)
+#define MIN_SLOTS 16
+
+typedef struct {
+    void *ptr;
+    tj_allocprof_site *site;
+    size_t size;
+    size_t weight;
+} entry;
+
+typedef struct {
+    pthread_mutex_t lock;
+    entry *slots;
+    size_t mask;
+    size_t count;
+} stripe;
+
+static stripe stripes[STRIPES] = {
+    [0 ... STRIPES-1] = { .lock = PTHREAD_MUTEX_INITIALIZER },
+};
+
+static size_t sample_rate;
+
+/* Sampled pointers in the tables, so frees can skip them when empty. */
+static size_t tracked;
+
+static tj_allocprof_site *sites;
+
+static size_t total_allocs;
+static size_t total_bytes;
+static size_t live_bytes;
+static size_t peak_bytes;
+
+static pthread_mutex_t start_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct timespec start;
+
+/* Allocations left before this thread's next sample, 0 if not counting. */
+static __thread size_t countdown;
+
+static uint64_t hash(const void *ptr) {
+    return ((uintptr_t) ptr >> 4) * 0x9e3779b97f4a7c15ULL;
+}
+
+static stripe *stripe_of(uint64_t h) {
+    return &stripes[h >> (64 - STRIPE_BITS)];
+}
+
+static size_t home(const stripe *s, uint64_t h) {
+    return (size_t) (h ^ (h >> 29)) & s->mask;
+}
+
+static void update_peak(size_t *peak, size_t value) {
+    size_t old = __atomic_load_n(peak, __ATOMIC_RELAXED);
+    while (value > old &&
+           !__atomic_compare_exchange_n(peak, &old, value, 1,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+static void set_start(void) {
+    pthread_mutex_lock(&start_lock);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    pthread_mutex_unlock(&start_lock);
+}
+
+/* Returns the weight to sample this allocation with, or 0 to skip it. */
+static size_t sample(void) {
+    if (__builtin_expect(countdown > 1, 1)) {
+        countdown -= 1;
+        return 0;
+    }
+
+    size_t rate = __atomic_load_n(&sample_rate, __ATOMIC_RELAXED);
+    if (rate == 0) {
+        countdown = 0;
+        return 0;
+    }
+    if (countdown == 0 && rate > 1) {
+        countdown = rate - 1;
+        return 0;
+    }
+    countdown = rate;
+    return rate;
+}
+
+static int stripe_grow(stripe *s) {
+    size_t size = (s->slots == NULL) ? MIN_SLOTS : 2 * (s->mask + 1);
+    entry *old = s->slots;
+    size_t old_size = (old == NULL) ? 0 : s->mask + 1;
+    size_t i;
+
+    entry *slots = calloc(size, sizeof(entry));
+    if (slots == NULL) {
+        return 0;
+    }
+
+    s->slots = slots;
+    s->mask = size - 1;
+    for (i = 0; i < old_size; i++) {
+        if (old[i].ptr != NULL) {
+            size_t j = home(s, hash(old[i].ptr));
+            while (slots[j].ptr != NULL) {
+                j = (j + 1) & s->mask;
+            }
+            slots[j] = old[i];
+        }
+    }
+    free(old);
+    return 1;
+}
+
+static void record(tj_allocprof_site *site, void *ptr, size_t size,
+                   size_t weight) {
+    uint64_t h = hash(ptr);
+    stripe *s = stripe_of(h);
+
+    pthread_mutex_lock(&s->lock);
+    if (s->slots == NULL || (s->count + 1) * 4 > (s->mask + 1) * 3) {
+        if (!stripe_grow(s)) {
+            /* Lose the sample rather than the allocation. */
+            pthread_mutex_unlock(&s->lock);
+            return;
+        }
+    }
+
+    size_t i = home(s, h);
+    while (s->slots[i].ptr != NULL) {
+        i = (i + 1) & s->mask;
+    }
+    s->slots[i].ptr = ptr;
+    s->slots[i].site = site;
+    s->slots[i].size = size;
+    s->slots[i].weight = weight;
+    s->count += 1;
+    __atomic_add_fetch(&tracked, 1, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&s->lock);
+
+    if (!__atomic_exchange_n(&site->registered, 1, __ATOMIC_ACQ_REL)) {
+        site->next = __atomic_load_n(&sites, __ATOMIC_RELAXED);
+        while (!__atomic_compare_exchange_n(&sites, &site->next, site, 1,
+                                            __ATOMIC_RELEASE,
+                                            __ATOMIC_RELAXED)) {
+        }
+    }
+
+    size_t bytes = size * weight;
+    __atomic_add_fetch(&site->allocs, weight, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&site->bytes, bytes, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&site->live_allocs, weight, __ATOMIC_RELAXED);
+    update_peak(&site->peak_bytes,
+                __atomic_add_fetch(&site->live_bytes, bytes,
+                                   __ATOMIC_RELAXED));
+
+    __atomic_add_fetch(&total_allocs, weight, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&total_bytes, bytes, __ATOMIC_RELAXED);
+    update_peak(&peak_bytes,
+                __atomic_add_fetch(&live_bytes, bytes, __ATOMIC_RELAXED));
+}
+
+/* Removes ptr from its table, returning whether it was there. */
+static int forget(void *ptr, entry *found) {
+    uint64_t h = hash(ptr);
+    stripe *s = stripe_of(h);
+
+    pthread_mutex_lock(&s->lock);
+    if (s->slots == NULL) {
+        pthread_mutex_unlock(&s->lock);
+        return 0;
+    }
+
+    size_t i = home(s, h);
+    while (s->slots[i].ptr != ptr) {
+        if (s->slots[i].ptr == NULL) {
+            pthread_mutex_unlock(&s->lock);
+            return 0;
+        }
+        i = (i + 1) & s->mask;
+    }
+    *found = s->slots[i];
+
+    /* Shift back later entries of the probe run into the hole. */
+    size_t j = i;
+    s->slots[i].ptr = NULL;
+    while (1) {
+        j = (j + 1) & s->mask;
+        if (s->slots[j].ptr == NULL) {
+            break;
+        }
+        size_t k = home(s, hash(s->slots[j].ptr));
+        if ((j > i && (k <= i || k > j)) || (j < i && k <= i && k > j)) {
+            s->slots[i] = s->slots[j];
+            s->slots[j].ptr = NULL;
+            i = j;
+        }
+    }
+    s->count -= 1;
+    __atomic_sub_fetch(&tracked, 1, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&s->lock);
+    return 1;
+}
+
+void tj_allocprof_setSampleRate(size_t rate) {
+    if (rate != 0 && __atomic_load_n(&sample_rate, __ATOMIC_RELAXED) == 0 &&
+        __atomic_load_n(&total_allocs, __ATOMIC_RELAXED) == 0) {
+        set_start();
+    }
+    __atomic_store_n(&sample_rate, rate, __ATOMIC_RELAXED);
+}
+
+void tj_allocprof_reset(void) {
+    tj_allocprof_site *site;
+    size_t i;
+
+    for (i = 0; i < STRIPES; i++) {
+        stripe *s = &stripes[i];
+        pthread_mutex_lock(&s->lock);
+        free(s->slots);
+        s->slots = NULL;
+        s->mask = 0;
+        __atomic_sub_fetch(&tracked, s->count, __ATOMIC_RELAXED);
+        s->count = 0;
+        pthread_mutex_unlock(&s->lock);
+    }
+
+    for (site = __atomic_load_n(&sites, __ATOMIC_ACQUIRE); site != NULL;
+         site = site->next) {
+        __atomic_store_n(&site->allocs, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&site->bytes, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&site->live_allocs, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&site->live_bytes, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&site->peak_bytes, 0, __ATOMIC_RELAXED);
+    }
+
+    __atomic_store_n(&total_allocs, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&total_bytes, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&live_bytes, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&peak_bytes, 0, __ATOMIC_RELAXED);
+    set_start();
+}
+
+void tj_allocprof_getStats(tj_allocprof_stats *stats) {
+    const tj_allocprof_site *site;
+    struct timespec now;
+
+    stats->rate = __atomic_load_n(&sample_rate, __ATOMIC_RELAXED);
+    stats->sites = 0;
+    for (site = __atomic_load_n(&sites, __ATOMIC_ACQUIRE); site != NULL;
+         site = site->next) {
+        if (__atomic_load_n(&site->allocs, __ATOMIC_RELAXED) != 0) {
+            stats->sites += 1;
+        }
+    }
+    stats->allocs = __atomic_load_n(&total_allocs, __ATOMIC_RELAXED);
+    stats->bytes = __atomic_load_n(&total_bytes, __ATOMIC_RELAXED);
+    stats->live_bytes = __atomic_load_n(&live_bytes, __ATOMIC_RELAXED);
+    stats->peak_bytes = __atomic_load_n(&peak_bytes, __ATOMIC_RELAXED);
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    pthread_mutex_lock(&start_lock);
+    stats->seconds = (start.tv_sec == 0 && start.tv_nsec == 0) ? 0 :
+        (now.tv_sec - start.tv_sec) + (now.tv_nsec - start.tv_nsec) / 1e9;
+    pthread_mutex_unlock(&start_lock);
+}
+
+void tj_allocprof_forEachSite(void (*fn)(const tj_allocprof_site *site,
+                                         void *arg),
+                              void *arg) {
+    const tj_allocprof_site *site;
+    for (site = __atomic_load_n(&sites, __ATOMIC_ACQUIRE); site != NULL;
+         site = site->next) {
+        if (__atomic_load_n(&site->allocs, __ATOMIC_RELAXED) != 0) {
+            fn(site, arg);
+        }
+    }
+}
+
+static int by_live_bytes(const void *a, const void *b) {
+    size_t x = ((const tj_allocprof_site *) a)->live_bytes;
+    size_t y = ((const tj_allocprof_site *) b)->live_bytes;
+    return (x < y) - (x > y);
+}
+
+int tj_allocprof_dump(FILE *out) {
+    tj_allocprof_stats stats;
+    const tj_allocprof_site *site;
+    tj_allocprof_site *sorted;
+    size_t n = 0, i;
+
+    tj_allocprof_getStats(&stats);
+
+    /* Snapshot the counters, so each line is consistent while sorting. */
+    for (site = __atomic_load_n(&sites, __ATOMIC_ACQUIRE); site != NULL;
+         site = site->next) {
+        n += 1;
+    }
+    if ((sorted = malloc((n + 1) * sizeof(*sorted))) == NULL) {
+        return 0;
+    }
+    n = 0;
+    for (site = __atomic_load_n(&sites, __ATOMIC_ACQUIRE); site != NULL;
+         site = site->next) {
+        tj_allocprof_site *copy = &sorted[n];
+        copy->allocs = __atomic_load_n(&site->allocs, __ATOMIC_RELAXED);
+        if (copy->allocs == 0) {
+            continue;
+        }
+        copy->file = site->file;
+        copy->line = site->line;
+        copy->bytes = __atomic_load_n(&site->bytes, __ATOMIC_RELAXED);
+        copy->live_allocs = __atomic_load_n(&site->live_allocs,
+                                            __ATOMIC_RELAXED);
+        copy->live_bytes = __atomic_load_n(&site->live_bytes,
+                                           __ATOMIC_RELAXED);
+        copy->peak_bytes = __atomic_load_n(&site->peak_bytes,
+                                           __ATOMIC_RELAXED);
+        n += 1;
+    }
+    qsort(sorted, n, sizeof(*sorted), &by_live_bytes);
+
+    double seconds = (stats.seconds > 0) ? stats.seconds : 1;
+    fprintf(out, "Allocation profile, sampling 1 in %zu, over %.3f s:\n",
+            stats.rate, stats.seconds);
+    fprintf(out, "  %zu allocations (%.0f/s), %zu bytes (%.0f/s)\n",
+            stats.allocs, stats.allocs / seconds,
+            stats.bytes, stats.bytes / seconds);
+    fprintf(out, "  %zu bytes live, %zu bytes peak, %zu sites\n",
+            stats.live_bytes, stats.peak_bytes, stats.sites);
+    fprintf(out, "%14s %12s %14s %12s %14s  %s\n", "live bytes", "live allocs",
+            "peak bytes", "allocs", "bytes", "site");
+    for (i = 0; i < n; i++) {
+        site = &sorted[i];
+        fprintf(out, "%14zu %12zu %14zu %12zu %14zu  %s:%d\n",
+                site->live_bytes, site->live_allocs, site->peak_bytes,
+                site->allocs, site->bytes, site->file, site->line);
+    }
+
+    free(sorted);
+    return ferror(out) ? 0 : 1;
+}
+
+void *tj_allocprof_malloc(tj_allocprof_site *site, size_t size) {
+    void *ptr = malloc(size);
+    size_t weight;
+    if (ptr != NULL && (weight = sample()) != 0) {
+        record(site, ptr, size, weight);
+    }
+    return ptr;
+}
+
+void *tj_allocprof_calloc(tj_allocprof_site *site, size_t size) {
+    void *ptr = calloc(1, size);
+    size_t weight;
+    if (ptr != NULL && (weight = sample()) != 0) {
+        record(site, ptr, size, weight);
+    }
+    return ptr;
+}
+
+char *tj_allocprof_strdup(tj_allocprof_site *site, const char *str) {
+    size_t n = strlen(str);
+    char *copy = tj_allocprof_malloc(site, n + 1);
+    if (copy != NULL) {
+        memcpy(copy, str, n + 1);
+    }
+    return copy;
+}
+
+char *tj_allocprof_strndup(tj_allocprof_site *site, const char *str,
+                           size_t n) {
+    n = strnlen(str, n);
+    char *copy = tj_allocprof_malloc(site, n + 1);
+    if (copy != NULL) {
+        memcpy(copy, str, n);
+        copy[n] = '\0';
+    }
+    return copy;
+}
+
+void tj_allocprof_free(void *ptr) {
+    entry e;
+    if (ptr != NULL && __atomic_load_n(&tracked, __ATOMIC_RELAXED) != 0 &&
+        forget(ptr, &e)) {
+        size_t bytes = e.size * e.weight;
+        __atomic_sub_fetch(&e.site->live_allocs, e.weight, __ATOMIC_RELAXED);
+        __atomic_sub_fetch(&e.site->live_bytes, bytes, __ATOMIC_RELAXED);
+        __atomic_sub_fetch(&live_bytes, bytes, __ATOMIC_RELAXED);
+    }
+    free(ptr);
+}
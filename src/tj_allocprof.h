@@ -0,0 +1,131 @@
+/*
+ * Copyright (c) 2013 Bellerophon Mobile, LLC.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * \file tj_allocprof.h
+ *
+ * Provides an allocation profiler for the tj_util.h allocation macros.
+ *
+ * Building with TJ_ALLOCPROF defined makes TJ_ALLOC, TJ_CALLOC,
+ * TJ_MALLOC, TJ_STRDUP and TJ_STRNDUP allocate through this module,
+ * each use passing a static record of its own file and line.  Every
+ * Nth allocation on each thread is sampled: its pointer is entered in a
+ * table and its size counted against its call site, weighted by N so
+ * the totals estimate every allocation.  Unsampled allocations cost a
+ * thread-local decrement.  TJ_FREE removes sampled pointers from the
+ * table again, so live bytes per site are tracked; memory freed with
+ * plain free() is harmless but stays counted as live, which is how
+ * leaks show up too.
+ *
+ * Sampling is off until tj_allocprof_setSampleRate() is called, so a
+ * profiling build can ship and have the profiler turned on in the
+ * field.  tj_allocprof_dump() prints the sites sorted by live bytes.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdio.h>
+
+/** A call site.  Define one statically per site with TJ_ALLOCPROF_SITE. */
+typedef struct tj_allocprof_site tj_allocprof_site;
+
+struct tj_allocprof_site {
+    const char *file;
+    int line;
+
+    /* All estimated, and updated atomically. */
+    size_t allocs;
+    size_t bytes;
+    size_t live_allocs;
+    size_t live_bytes;
+    size_t peak_bytes;
+
+    int registered;
+    tj_allocprof_site *next;
+};
+
+/** Initializer for a tj_allocprof_site at the current file and line. */
+#define TJ_ALLOCPROF_SITE { __FILE__, __LINE__, 0, 0, 0, 0, 0, 0, NULL }
+
+typedef struct {
+    size_t rate;        /**< Current sample rate, 0 if off. */
+    size_t sites;       /**< Call sites with a sampled allocation. */
+    size_t allocs;      /**< Estimated allocations. */
+    size_t bytes;       /**< Estimated bytes allocated. */
+    size_t live_bytes;  /**< Estimated bytes not yet freed. */
+    size_t peak_bytes;  /**< Highest estimated live_bytes. */
+    double seconds;     /**< Time since profiling was last reset. */
+} tj_allocprof_stats;
+
+/**
+ * Set how often allocations are sampled.  Changes take effect on each
+ * thread after its current sampling interval.
+ *
+ * \param rate Sample one in rate allocations; 1 records every
+ * allocation, and 0 turns sampling off.
+ */
+void tj_allocprof_setSampleRate(size_t rate);
+
+/**
+ * Zero every site's and the global counters, and restart the clock
+ * used for allocation rates.  Pointers sampled before the reset are
+ * forgotten, so freeing them is not counted.
+ */
+void tj_allocprof_reset(void);
+
+/** Get the global counters. */
+void tj_allocprof_getStats(tj_allocprof_stats *stats);
+
+/**
+ * Call fn on each call site with a sampled allocation, in no particular
+ * order.  The counters may change while this runs.
+ */
+void tj_allocprof_forEachSite(void (*fn)(const tj_allocprof_site *site,
+                                         void *arg),
+                              void *arg);
+
+/**
+ * Print the global counters and allocation rate, then each site's live
+ * bytes and allocations, peak, and totals, from most live bytes down.
+ *
+ * \return 0 on failure, 1 otherwise.
+ */
+int tj_allocprof_dump(FILE *out);
+
+/**
+ * \name Allocation functions
+ *
+ * Behave as their C library namesakes, sampling against site.  Memory
+ * from these may be freed with free(), but should be freed with
+ * tj_allocprof_free() to be counted.
+ * \{
+ */
+void *tj_allocprof_malloc(tj_allocprof_site *site, size_t size);
+void *tj_allocprof_calloc(tj_allocprof_site *site, size_t size);
+char *tj_allocprof_strdup(tj_allocprof_site *site, const char *str);
+char *tj_allocprof_strndup(tj_allocprof_site *site, const char *str,
+                           size_t n);
+void tj_allocprof_free(void *ptr);
+/** \} */
@@ -0,0 +1,254 @@
+/*
+ * Copyright (c) 2013 Bellerophon Mobile, LLC.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tj_allocator.h"
+#include "tj_arena.h"
+
+#ifdef UNIT_TESTING
+#   undef assert
+#   define assert(x) mock_assert((int)(x), #x, __FILE__, __LINE__)
+#endif /* UNIT_TESTING */
+
+#define DEFAULT_CHUNK_SIZE (64 * 1024)
+
+/* Chunk data follows the header, aligned to TJ_ARENA_ALIGN. */
+typedef struct chunk chunk;
+struct chunk {
+    chunk *prev;
+    size_t size;
+    size_t used;
+};
+
+#define CHUNK_HEADER \
+    ((sizeof(chunk) + TJ_ARENA_ALIGN - 1) & ~(size_t)(TJ_ARENA_ALIGN - 1))
+
+struct tj_arena {
+    size_t chunksize;
+    size_t allocated;
+
+    /* Where chunks come from, and the interface onto the arena itself. */
+    const tj_allocator *parent;
+    tj_allocator allocator;
+
+    /* Chunks in use, newest first, and released standard size chunks. */
+    chunk *current;
+    chunk *spare;
+
+    /* The most recent allocation, which may be resized in place. */
+    char *last;
+};
+
+static char *data(chunk *c) {
+    return (char *) c + CHUNK_HEADER;
+}
+
+/* Pushes a chunk able to hold at least need bytes. */
+static chunk *chunk_push(tj_arena *arena, size_t need) {
+    chunk *c;
+
+    if (need <= arena->chunksize && arena->spare != NULL) {
+        c = arena->spare;
+        arena->spare = c->prev;
+    } else {
+        size_t size = (need <= arena->chunksize) ? arena->chunksize : need;
+        if (size > SIZE_MAX - CHUNK_HEADER ||
+                (c = tj_allocator_alloc(arena->parent,
+                                        CHUNK_HEADER + size)) == NULL) {
+            return NULL;
+        }
+        c->size = size;
+        arena->allocated += size;
+    }
+
+    c->used = 0;
+    c->prev = arena->current;
+    arena->current = c;
+    return c;
+}
+
+static void chunk_pop(tj_arena *arena) {
+    chunk *c = arena->current;
+    arena->current = c->prev;
+
+    if (c->size == arena->chunksize) {
+        c->prev = arena->spare;
+        arena->spare = c;
+    } else {
+        arena->allocated -= c->size;
+        tj_allocator_free(arena->parent, c, CHUNK_HEADER + c->size);
+    }
+}
+
+/* Carves an allocation from the current chunk, if it fits. */
+static void *carve(tj_arena *arena, size_t size, size_t align) {
+    chunk *c = arena->current;
+    if (c == NULL) {
+        return NULL;
+    }
+
+    uintptr_t base = (uintptr_t) data(c);
+    size_t offset = ((base + c->used + align - 1) & ~(uintptr_t)(align - 1))
+        - base;
+    if (offset > c->size || size > c->size - offset) {
+        return NULL;
+    }
+
+    c->used = offset + size;
+    arena->last = data(c) + offset;
+    return arena->last;
+}
+
+static void *arena_alloc(void *ctx, size_t size) {
+    return tj_arena_alloc(ctx, size);
+}
+
+static void *arena_realloc(void *ctx, void *ptr, size_t oldsize,
+                           size_t size) {
+    return tj_arena_realloc(ctx, ptr, oldsize, size);
+}
+
+static void arena_free(void *ctx, void *ptr, size_t size) {
+}
+
+tj_arena *tj_arena_create(size_t chunksize) {
+    return tj_arena_createWithAllocator(chunksize, NULL);
+}
+
+tj_arena *tj_arena_createWithAllocator(size_t chunksize,
+                                       const tj_allocator *allocator) {
+    allocator = tj_allocator_orDefault(allocator);
+
+    tj_arena *arena = tj_allocator_calloc(allocator, sizeof(*arena));
+    if (arena == NULL) {
+        return NULL;
+    }
+
+    arena->chunksize = (chunksize > 0) ? chunksize : DEFAULT_CHUNK_SIZE;
+    arena->parent = allocator;
+    arena->allocator.alloc = &arena_alloc;
+    arena->allocator.realloc = &arena_realloc;
+    arena->allocator.free = &arena_free;
+    arena->allocator.ctx = arena;
+    return arena;
+}
+
+void tj_arena_finalize(tj_arena *arena) {
+    tj_arena_reset(arena);
+    while (arena->spare != NULL) {
+        chunk *c = arena->spare;
+        arena->spare = c->prev;
+        tj_allocator_free(arena->parent, c, CHUNK_HEADER + c->size);
+    }
+    tj_allocator_free(arena->parent, arena, sizeof(*arena));
+}
+
+const tj_allocator *tj_arena_getAllocator(tj_arena *arena) {
+    return &arena->allocator;
+}
+
+void *tj_arena_alloc(tj_arena *arena, size_t size) {
+    return tj_arena_allocAligned(arena, size, TJ_ARENA_ALIGN);
+}
+
+void *tj_arena_allocAligned(tj_arena *arena, size_t size, size_t align) {
+    assert(align > 0 && (align & (align - 1)) == 0);
+
+    void *p = carve(arena, size, align);
+    if (p != NULL) {
+        return p;
+    }
+
+    /* Chunk data is only TJ_ARENA_ALIGN aligned, so leave slack. */
+    size_t slack = (align > TJ_ARENA_ALIGN) ? align - 1 : 0;
+    if (size > SIZE_MAX - slack || chunk_push(arena, size + slack) == NULL) {
+        return NULL;
+    }
+    return carve(arena, size, align);
+}
+
+void *tj_arena_realloc(tj_arena *arena, void *ptr, size_t oldsize,
+                       size_t size) {
+    if (ptr == NULL) {
+        return tj_arena_alloc(arena, size);
+    }
+
+    if (ptr == arena->last) {
+        chunk *c = arena->current;
+        size_t offset = (char *) ptr - data(c);
+        if (size <= c->size - offset) {
+            c->used = offset + size;
+            return ptr;
+        }
+    }
+
+    void *p = tj_arena_alloc(arena, size);
+    if (p != NULL) {
+        memcpy(p, ptr, (oldsize < size) ? oldsize : size);
+    }
+    return p;
+}
+
+char *tj_arena_strdup(tj_arena *arena, const char *str) {
+    size_t n = strlen(str) + 1;
+    char *copy = tj_arena_allocAligned(arena, n, 1);
+    if (copy != NULL) {
+        memcpy(copy, str, n);
+    }
+    return copy;
+}
+
+tj_arena_savepoint tj_arena_mark(const tj_arena *arena) {
+    tj_arena_savepoint point;
+    point.chunk = arena->current;
+    point.used = (arena->current != NULL) ? arena->current->used : 0;
+    return point;
+}
+
+void tj_arena_rewind(tj_arena *arena, tj_arena_savepoint point) {
+    while (arena->current != point.chunk) {
+        assert(arena->current != NULL);
+        chunk_pop(arena);
+    }
+    if (arena->current != NULL) {
+        assert(point.used <= arena->current->used);
+        arena->current->used = point.used;
+    }
+    arena->last = NULL;
+}
+
+void tj_arena_reset(tj_arena *arena) {
+    while (arena->current != NULL) {
+        chunk_pop(arena);
+    }
+    arena->last = NULL;
+}
+
+size_t tj_arena_getAllocated(const tj_arena *arena) {
+    return arena->allocated;
+}
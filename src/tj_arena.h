@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) 2013 Bellerophon Mobile, LLC.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * \file tj_arena.h
+ *
+ * Provides a region, or arena, allocator: many allocations are made by
+ * bumping a pointer through large chunks, and released all together.
+ *
+ * Individual allocations are never freed.  Instead, tj_arena_mark() takes
+ * a save point and tj_arena_rewind() releases everything allocated since,
+ * and tj_arena_reset() releases everything.  Chunks are chained as the
+ * arena grows; standard size chunks released by a rewind are kept for
+ * reuse, so a reset arena serving repeated requests stops calling malloc
+ * once it has warmed up.
+ *
+ * tj_arena_getAllocator() exposes an arena as a tj_allocator, whose free
+ * does nothing, so any module's *_createWithAllocator() can build objects
+ * in an arena.  tj_buffer_createWithArena() and tj_array_createWithArena()
+ * are shortcuts for the common case, so that all the work for a request
+ * can be dropped with one reset.
+ */
+
+#pragma once
+
+#include <stddef.h>
+
+#include "tj_allocator.h"
+
+/** Alignment of tj_arena_alloc(), suitable for any type. */
+#define TJ_ARENA_ALIGN 16
+
+typedef struct tj_arena tj_arena;
+
+/** A save point, to be passed back to tj_arena_rewind(). */
+typedef struct {
+    void *chunk;
+    size_t used;
+} tj_arena_savepoint;
+
+/**
+ * Create a new arena.
+ *
+ * \param chunksize Bytes per chunk, or 0 for a default of 64KiB.
+ * Allocations larger than a chunk get a chunk of their own.
+ */
+tj_arena *tj_arena_create(size_t chunksize);
+
+/** Create a new arena, taking its chunks from the given allocator. */
+tj_arena *tj_arena_createWithAllocator(size_t chunksize,
+                                       const tj_allocator *allocator);
+
+/** Frees an arena and everything allocated from it. */
+void tj_arena_finalize(tj_arena *arena);
+
+/**
+ * Returns an allocator drawing from the arena.  Its free does nothing, and
+ * its realloc is tj_arena_realloc().  It is valid as long as the arena is.
+ */
+const tj_allocator *tj_arena_getAllocator(tj_arena *arena);
+
+/**
+ * Allocate memory aligned to TJ_ARENA_ALIGN.
+ *
+ * \return The memory, NULL on failure.
+ */
+void *tj_arena_alloc(tj_arena *arena, size_t size);
+
+/**
+ * Allocate memory with the given alignment.
+ *
+ * \param align A power of two.
+ *
+ * \return The memory, NULL on failure.
+ */
+void *tj_arena_allocAligned(tj_arena *arena, size_t size, size_t align);
+
+/**
+ * Resize an allocation.  The most recent allocation is grown or shrunk in
+ * place when it fits; otherwise new memory is allocated and the contents
+ * copied, and the old memory is not reclaimed until a rewind or reset.
+ *
+ * \param ptr A previous allocation from this arena, or NULL.
+ * \param oldsize The size ptr was allocated with.
+ *
+ * \return The memory, NULL on failure, in which case ptr is unchanged.
+ */
+void *tj_arena_realloc(tj_arena *arena, void *ptr, size_t oldsize,
+                       size_t size);
+
+/**
+ * Copy a string into the arena.
+ *
+ * \return The copy, NULL on failure.
+ */
+char *tj_arena_strdup(tj_arena *arena, const char *str);
+
+/** Take a save point for tj_arena_rewind(). */
+tj_arena_savepoint tj_arena_mark(const tj_arena *arena);
+
+/**
+ * Release everything allocated since the save point was taken.  Save
+ * points taken after it become invalid.
+ */
+void tj_arena_rewind(tj_arena *arena, tj_arena_savepoint point);
+
+/** Release everything allocated from the arena. */
+void tj_arena_reset(tj_arena *arena);
+
+/** Returns the number of bytes held in chunks, in use or spare. */
+size_t tj_arena_getAllocated(const tj_arena *arena);
@@ -23,28 +23,214 @@
  */
 
 #include <assert.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/types.h>
 
+#include "tj_allocator.h"
 #include "tj_array.h"
+#include "tj_sort.h"
 
 #ifdef UNIT_TESTING
 #   undef assert
 #   define assert(x) mock_assert((int)(x), #x, __FILE__, __LINE__)
 #endif /* UNIT_TESTING */
 
+/*
+ * Optional pointer to position index.  Open addressed with linear probing
+ * and backward shift deletion, so there are no tombstones.  A slot is
+ * empty when its dups count is 0, since NULL may legitimately be stored in
+ * the array.  For items stored more than once, pos is the lowest position.
+ */
+typedef struct {
+    void *item;
+    size_t pos;
+    size_t dups;
+} tj_array_index_slot;
+
+typedef struct {
+    size_t mask;
+    size_t used;
+    tj_array_index_slot *slots;
+    const tj_allocator *allocator;
+} tj_array_index;
+
 struct tj_array {
     size_t count;
     size_t capacity;
 
     void **array;
+
+    tj_array_index *index;
+
+    const tj_allocator *allocator;
 };
 
 static const size_t DEFAULT_LIST_SIZE = 5;
+static const size_t DEFAULT_INDEX_SIZE = 16;
+
+/* Comparator for the current tj_array_sort() call on this thread. */
+static __thread int (*sort_cmp)(const void *a, const void *b);
+
+#define SORT_LESS(a, b) (sort_cmp((a), (b)) < 0)
+TJ_SORT_DECL(sort_items, void *, SORT_LESS)
+
+static size_t index_hash(const tj_array_index *index, const void *item) {
+    uint64_t h = (uint64_t)(uintptr_t)item;
+    h ^= h >> 33;
+    h *= UINT64_C(0xff51afd7ed558ccd);
+    h ^= h >> 33;
+    return (size_t)h & index->mask;
+}
+
+static tj_array_index_slot *index_lookup(const tj_array_index *index,
+                                         const void *item) {
+    size_t i = index_hash(index, item);
+    while (index->slots[i].dups != 0) {
+        if (index->slots[i].item == item) {
+            return &index->slots[i];
+        }
+        i = (i + 1) & index->mask;
+    }
+    return NULL;
+}
+
+static int index_resize(tj_array_index *index, size_t size) {
+    tj_array_index_slot *slots = tj_allocator_calloc(index->allocator,
+                                                     size * sizeof(*slots));
+    if (slots == NULL) {
+        return 0;
+    }
+
+    tj_array_index_slot *old = index->slots;
+    size_t old_size = (old == NULL) ? 0 : index->mask + 1;
+
+    index->slots = slots;
+    index->mask = size - 1;
+
+    size_t i;
+    for (i = 0; i < old_size; i++) {
+        if (old[i].dups != 0) {
+            size_t j = index_hash(index, old[i].item);
+            while (slots[j].dups != 0) {
+                j = (j + 1) & index->mask;
+            }
+            slots[j] = old[i];
+        }
+    }
+
+    tj_allocator_free(index->allocator, old, old_size * sizeof(*old));
+    return 1;
+}
+
+static int index_insert(tj_array_index *index, void *item, size_t pos) {
+    tj_array_index_slot *slot = index_lookup(index, item);
+    if (slot != NULL) {
+        slot->dups += 1;
+        if (pos < slot->pos) {
+            slot->pos = pos;
+        }
+        return 1;
+    }
+
+    if ((index->used + 1) * 2 > index->mask + 1) {
+        if (!index_resize(index, (index->mask + 1) * 2)) {
+            return 0;
+        }
+    }
+
+    size_t i = index_hash(index, item);
+    while (index->slots[i].dups != 0) {
+        i = (i + 1) & index->mask;
+    }
+    index->slots[i].item = item;
+    index->slots[i].pos = pos;
+    index->slots[i].dups = 1;
+    index->used += 1;
+
+    return 1;
+}
+
+/*
+ * Must be called before the item at pos is actually removed from the
+ * array, as a duplicate may need to be located to become the new lowest
+ * position.
+ */
+static void index_erase(tj_array *array, void *item, size_t pos) {
+    tj_array_index *index = array->index;
+    tj_array_index_slot *slot = index_lookup(index, item);
+    assert(slot != NULL);
+
+    if (slot->dups > 1) {
+        slot->dups -= 1;
+        if (slot->pos == pos) {
+            size_t i = pos + 1;
+            while (array->array[i] != item) {
+                i++;
+            }
+            slot->pos = i;
+        }
+        return;
+    }
+
+    /* Backward shift the following cluster into the hole. */
+    size_t hole = slot - index->slots;
+    size_t i = hole;
+    while (1) {
+        i = (i + 1) & index->mask;
+        if (index->slots[i].dups == 0) {
+            break;
+        }
+        size_t home = index_hash(index, index->slots[i].item);
+        if (((i - home) & index->mask) >= ((i - hole) & index->mask)) {
+            index->slots[hole] = index->slots[i];
+            hole = i;
+        }
+    }
+    index->slots[hole].dups = 0;
+    index->used -= 1;
+}
+
+/* Items only ever move towards the front of the array. */
+static void index_relocate(tj_array_index *index, void *item,
+                           size_t from, size_t to) {
+    tj_array_index_slot *slot = index_lookup(index, item);
+    assert(slot != NULL);
+    if (slot->pos == from || to < slot->pos) {
+        slot->pos = to;
+    }
+}
+
+static void index_clear(tj_array_index *index) {
+    memset(index->slots, 0, (index->mask + 1) * sizeof(*index->slots));
+    index->used = 0;
+}
+
+static int index_rebuild(tj_array *array) {
+    size_t i;
+    index_clear(array->index);
+    for (i = 0; i < array->count; i++) {
+        if (!index_insert(array->index, array->array[i], i)) {
+            return 0;
+        }
+    }
+    return 1;
+}
 
 tj_array *tj_array_create(size_t capacity) {
-    tj_array *array = malloc(sizeof(*array));
+    return tj_array_createWithAllocator(capacity, NULL);
+}
+
+tj_array *tj_array_createWithArena(size_t capacity, tj_arena *arena) {
+    return tj_array_createWithAllocator(capacity, tj_arena_getAllocator(arena));
+}
+
+tj_array *tj_array_createWithAllocator(size_t capacity,
+                                       const tj_allocator *allocator) {
+    allocator = tj_allocator_orDefault(allocator);
+
+    tj_array *array = tj_allocator_alloc(allocator, sizeof(*array));
     if (array == NULL) {
         return NULL;
     }
@@ -52,11 +238,13 @@ tj_array *tj_array_create(size_t capacity) {
     array->count = 0;
     array->capacity = capacity;
     array->array = NULL;
+    array->index = NULL;
+    array->allocator = allocator;
 
     if (array->capacity > 0) {
-        array->array = malloc(capacity * sizeof(void*));
+        array->array = tj_allocator_alloc(allocator, capacity * sizeof(void*));
         if (array->array == NULL) {
-            free(array);
+            tj_allocator_free(allocator, array, sizeof(*array));
             return NULL;
         }
     }
@@ -65,10 +253,46 @@ tj_array *tj_array_create(size_t capacity) {
 }
 
 void tj_array_finalize(tj_array *array) {
+    tj_array_disableIndex(array);
     if (array->array != NULL) {
-        free(array->array);
+        tj_allocator_free(array->allocator, array->array,
+                          array->capacity * sizeof(void*));
+    }
+    tj_allocator_free(array->allocator, array, sizeof(*array));
+}
+
+int tj_array_enableIndex(tj_array *array) {
+    if (array->index != NULL) {
+        return 1;
+    }
+
+    array->index = tj_allocator_calloc(array->allocator, sizeof(*array->index));
+    if (array->index == NULL) {
+        return 0;
+    }
+    array->index->allocator = array->allocator;
+
+    size_t size = DEFAULT_INDEX_SIZE;
+    while (size < array->count * 2) {
+        size *= 2;
+    }
+
+    if (!index_resize(array->index, size) || !index_rebuild(array)) {
+        tj_array_disableIndex(array);
+        return 0;
+    }
+    return 1;
+}
+
+void tj_array_disableIndex(tj_array *array) {
+    if (array->index != NULL) {
+        tj_allocator_free(array->allocator, array->index->slots,
+                          (array->index->mask + 1) *
+                          sizeof(*array->index->slots));
+        tj_allocator_free(array->allocator, array->index,
+                          sizeof(*array->index));
+        array->index = NULL;
     }
-    free(array);
 }
 
 size_t tj_array_count(const tj_array *array) {
@@ -84,20 +308,61 @@ void *tj_array_get(const tj_array *array, size_t index) {
     return array->array[index];
 }
 
-int tj_array_append(tj_array *array, void *item) {
-    if (array->count == array->capacity) {
-        if (array->array == NULL) {
-            array->capacity = DEFAULT_LIST_SIZE;
-        } else {
-            array->capacity = (array->capacity) * 2;
-        }
+/* Ensures room for n more items, doubling the capacity as needed. */
+static int grow(tj_array *array, size_t n) {
+    if (array->count + n <= array->capacity) {
+        return 1;
+    }
 
-        void **new_array = realloc(array->array,
-                array->capacity * sizeof(void*));
-        if (new_array == NULL) {
-            return 0;
+    size_t capacity = array->capacity;
+    if (capacity == 0) {
+        capacity = DEFAULT_LIST_SIZE;
+    }
+    while (capacity < array->count + n) {
+        capacity *= 2;
+    }
+
+    void **new_array = tj_allocator_realloc(array->allocator, array->array,
+                                            array->capacity * sizeof(void*),
+                                            capacity * sizeof(void*));
+    if (new_array == NULL) {
+        return 0;
+    }
+    array->array = new_array;
+    array->capacity = capacity;
+    return 1;
+}
+
+/* Appends n items at once, for building up set operation results. */
+static int append_items(tj_array *array, void * const *items, size_t n) {
+    if (n == 0) {
+        return 1;
+    }
+    if (!grow(array, n)) {
+        return 0;
+    }
+
+    size_t i;
+    if (array->index != NULL) {
+        for (i = 0; i < n; i++) {
+            if (!index_insert(array->index, items[i], array->count + i)) {
+                tj_array_disableIndex(array);
+                break;
+            }
         }
-        array->array = new_array;
+    }
+    memcpy(array->array + array->count, items, n * sizeof(void*));
+    array->count += n;
+    return 1;
+}
+
+int tj_array_append(tj_array *array, void *item) {
+    if (!grow(array, 1)) {
+        return 0;
+    }
+    if (array->index != NULL &&
+            !index_insert(array->index, item, array->count)) {
+        return 0;
     }
     array->array[array->count] = item;
     array->count += 1;
@@ -106,23 +371,276 @@ int tj_array_append(tj_array *array, void *item) {
 }
 
 void tj_array_remove(tj_array *array, size_t index) {
+    tj_array_removeRange(array, index, 1);
+}
+
+void tj_array_removeItem(tj_array *array, void *item) {
+    tj_array_remove(array, tj_array_find(array, item));
+}
+
+void tj_array_swapRemove(tj_array *array, size_t index) {
     assert(index < array->count);
-    if (index < array->capacity - 1) {
-        size_t remaining = (array->capacity - index - 1) * sizeof(void*);
-        memmove(array->array + index, array->array + index + 1, remaining);
+    if (array->index != NULL) {
+        index_erase(array, array->array[index], index);
     }
     array->count -= 1;
+    array->array[index] = array->array[array->count];
+    if (array->index != NULL && index < array->count) {
+        index_relocate(array->index, array->array[index], array->count,
+                       index);
+    }
 }
 
-void tj_array_removeItem(tj_array *array, void *item) {
-    tj_array_remove(array, tj_array_find(array, item));
+void tj_array_swapRemoveItem(tj_array *array, void *item) {
+    tj_array_swapRemove(array, tj_array_find(array, item));
+}
+
+void tj_array_removeRange(tj_array *array, size_t index, size_t n) {
+    assert(index <= array->count);
+    assert(n <= array->count - index);
+
+    size_t i, remaining = array->count - index - n;
+    if (array->index != NULL) {
+        for (i = index; i < index + n; i++) {
+            index_erase(array, array->array[i], i);
+        }
+        for (i = index + n; i < array->count; i++) {
+            index_relocate(array->index, array->array[i], i, i - n);
+        }
+    }
+    if (remaining > 0) {
+        memmove(array->array + index, array->array + index + n,
+                remaining * sizeof(void*));
+    }
+    array->count -= n;
+}
+
+size_t tj_array_removeIf(tj_array *array,
+                         int (*test)(void *data, void *item), void *data) {
+    size_t i, kept = 0;
+    for (i = 0; i < array->count; i++) {
+        if (!test(data, array->array[i])) {
+            array->array[kept++] = array->array[i];
+        }
+    }
+
+    size_t removed = array->count - kept;
+    array->count = kept;
+    if (array->index != NULL && removed > 0 && !index_rebuild(array)) {
+        /* Fall back to scanning rather than keep a stale index. */
+        tj_array_disableIndex(array);
+    }
+    return removed;
 }
 
 void tj_array_clear(tj_array *array) {
     array->count = 0;
+    if (array->index != NULL) {
+        index_clear(array->index);
+    }
+}
+
+static int sort_reorder(void **items, size_t n, void *data) {
+    return sort_items(items, n);
+}
+
+int tj_array_sort(tj_array *array, int (*cmp)(const void *a, const void *b)) {
+    int (*prev)(const void *a, const void *b) = sort_cmp;
+    sort_cmp = cmp;
+    int res = tj_array_reorder(array, &sort_reorder, NULL);
+    sort_cmp = prev;
+    return res;
+}
+
+int tj_array_reorder(tj_array *array,
+                     int (*reorder)(void **items, size_t n, void *data),
+                     void *data) {
+    int res = reorder(array->array, array->count, data);
+    if (array->index != NULL && !index_rebuild(array)) {
+        tj_array_disableIndex(array);
+    }
+    return res;
+}
+
+size_t tj_array_lowerBound(const tj_array *array, const void *key,
+                           int (*cmp)(const void *a, const void *b)) {
+    size_t lo = 0, hi = array->count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (cmp(array->array[mid], key) < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+size_t tj_array_upperBound(const tj_array *array, const void *key,
+                           int (*cmp)(const void *a, const void *b)) {
+    size_t lo = 0, hi = array->count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (cmp(array->array[mid], key) <= 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+ssize_t tj_array_bsearch(const tj_array *array, const void *key,
+                         int (*cmp)(const void *a, const void *b)) {
+    size_t i = tj_array_lowerBound(array, key, cmp);
+    if (i < array->count && cmp(array->array[i], key) == 0) {
+        return i;
+    }
+    return -1;
+}
+
+int tj_array_insertSorted(tj_array *array, void *item,
+                          int (*cmp)(const void *a, const void *b)) {
+    return tj_array_mergeSorted(array, &item, 1, cmp);
+}
+
+int tj_array_mergeSorted(tj_array *array, void * const *items, size_t n,
+                         int (*cmp)(const void *a, const void *b)) {
+    if (!grow(array, n)) {
+        return 0;
+    }
+
+    /* Merge from the back, so nothing is moved more than once. */
+    size_t i = array->count, j = n, k = array->count + n;
+    while (j > 0) {
+        if (i > 0 && cmp(items[j - 1], array->array[i - 1]) < 0) {
+            array->array[--k] = array->array[--i];
+        } else {
+            array->array[--k] = items[--j];
+        }
+    }
+    array->count += n;
+
+    if (array->index != NULL && !index_rebuild(array)) {
+        tj_array_disableIndex(array);
+    }
+    return 1;
+}
+
+/*
+ * Returns the first position at or after lo whose item is not less than
+ * key, probing exponentially outward from lo before binary searching.
+ * Cheap for short runs, and O(log d) for a run of length d.
+ */
+static size_t gallop(void * const *items, size_t lo, size_t n,
+                     const void *key,
+                     int (*cmp)(const void *a, const void *b)) {
+    size_t step = 1, hi = lo;
+    while (hi < n && cmp(items[hi], key) < 0) {
+        lo = hi + 1;
+        hi += step;
+        step *= 2;
+    }
+    if (hi > n) {
+        hi = n;
+    }
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (cmp(items[mid], key) < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+int tj_array_union(tj_array *dest, const tj_array *a, const tj_array *b,
+                   int (*cmp)(const void *a, const void *b)) {
+    assert(dest != a && dest != b);
+
+    size_t i = 0, j = 0, k;
+    while (i < a->count && j < b->count) {
+        int c = cmp(a->array[i], b->array[j]);
+        if (c < 0) {
+            k = gallop(a->array, i, a->count, b->array[j], cmp);
+            if (!append_items(dest, a->array + i, k - i)) {
+                return 0;
+            }
+            i = k;
+        } else if (c > 0) {
+            k = gallop(b->array, j, b->count, a->array[i], cmp);
+            if (!append_items(dest, b->array + j, k - j)) {
+                return 0;
+            }
+            j = k;
+        } else {
+            if (!append_items(dest, a->array + i, 1)) {
+                return 0;
+            }
+            i++;
+            j++;
+        }
+    }
+
+    return append_items(dest, a->array + i, a->count - i) &&
+        append_items(dest, b->array + j, b->count - j);
+}
+
+int tj_array_intersection(tj_array *dest, const tj_array *a,
+                          const tj_array *b,
+                          int (*cmp)(const void *a, const void *b)) {
+    assert(dest != a && dest != b);
+
+    size_t i = 0, j = 0;
+    while (i < a->count && j < b->count) {
+        int c = cmp(a->array[i], b->array[j]);
+        if (c < 0) {
+            i = gallop(a->array, i, a->count, b->array[j], cmp);
+        } else if (c > 0) {
+            j = gallop(b->array, j, b->count, a->array[i], cmp);
+        } else {
+            if (!append_items(dest, a->array + i, 1)) {
+                return 0;
+            }
+            i++;
+            j++;
+        }
+    }
+    return 1;
+}
+
+int tj_array_difference(tj_array *dest, const tj_array *a, const tj_array *b,
+                        int (*cmp)(const void *a, const void *b)) {
+    assert(dest != a && dest != b);
+
+    size_t i = 0, j = 0, k;
+    while (i < a->count && j < b->count) {
+        int c = cmp(a->array[i], b->array[j]);
+        if (c < 0) {
+            k = gallop(a->array, i, a->count, b->array[j], cmp);
+            if (!append_items(dest, a->array + i, k - i)) {
+                return 0;
+            }
+            i = k;
+        } else if (c > 0) {
+            j = gallop(b->array, j, b->count, a->array[i], cmp);
+        } else {
+            i++;
+            j++;
+        }
+    }
+
+    return append_items(dest, a->array + i, a->count - i);
 }
 
 ssize_t tj_array_find(const tj_array *array, void *item) {
+    if (array->index != NULL) {
+        tj_array_index_slot *slot = index_lookup(array->index, item);
+        return (slot == NULL) ? -1 : (ssize_t)slot->pos;
+    }
+
     size_t i;
     for (i = 0; i < array->count; i++) {
         if (array->array[i] == item) {
@@ -32,6 +32,8 @@
 
 #pragma once
 
+#include "tj_arena.h"
+
 typedef struct tj_array tj_array;
 
 /**
@@ -41,9 +43,45 @@ typedef struct tj_array tj_array;
  */
 tj_array *tj_array_create(size_t capacity);
 
+/**
+ * Create a new dynamic array whose storage, including any index, is
+ * allocated from an arena.  tj_array_finalize() is optional; the array
+ * is released when the arena is rewound or reset past its creation.
+ *
+ * \param capacity Initial capacity, may be 0.
+ * \param arena The arena to allocate from.
+ */
+tj_array *tj_array_createWithArena(size_t capacity, tj_arena *arena);
+
+/**
+ * Create a new dynamic array whose storage, including any index, is
+ * allocated through the given allocator.
+ *
+ * \param capacity Initial capacity, may be 0.
+ * \param allocator The allocator to use, or NULL for the default.
+ */
+tj_array *tj_array_createWithAllocator(size_t capacity,
+                                       const tj_allocator *allocator);
+
 /** Frees a dynamic array. */
 void tj_array_finalize(tj_array *array);
 
+/**
+ * Maintain a hash index from item pointer to position alongside the
+ * array, making tj_array_find() and tj_array_swapRemoveItem() O(1).
+ *
+ * The index is built from the current contents and kept in sync by every
+ * operation.  It costs some memory per distinct item and makes the order
+ * preserving removals somewhat slower, so only enable it on arrays that
+ * are searched frequently.
+ *
+ * \return 0 on failure, 1 otherwise.
+ */
+int tj_array_enableIndex(tj_array *array);
+
+/** Drops the hash index, if any, reverting to linear search. */
+void tj_array_disableIndex(tj_array *array);
+
 /** Returns the number of elements in the array. */
 size_t tj_array_count(const tj_array *array);
 
@@ -56,7 +94,8 @@ void *tj_array_get(const tj_array *array, size_t index);
 /**
  * Append an item to a dynamic array.
  *
- * If the array is full, this will resize the array.
+ * If the array is full, this will resize the array.  On failure the
+ * array is unchanged.
  *
  * \return 0 on failure, 1 otherwise.
  */
@@ -76,12 +115,151 @@ void tj_array_remove(tj_array *array, size_t index);
  */
 void tj_array_removeItem(tj_array *array, void *item);
 
+/**
+ * Remove an item at a particular index by moving the last item into its
+ * place.
+ *
+ * This is O(1) but does not preserve the order of the array.
+ */
+void tj_array_swapRemove(tj_array *array, size_t index);
+
+/**
+ * Remove an item from a dynamic array with tj_array_swapRemove().
+ *
+ * With an index enabled this is O(1).
+ */
+void tj_array_swapRemoveItem(tj_array *array, void *item);
+
+/**
+ * Remove n items starting at a particular index, with a single move of
+ * the items following the range.
+ */
+void tj_array_removeRange(tj_array *array, size_t index, size_t n);
+
+/**
+ * Remove every item for which test returns non-zero, compacting the
+ * remaining items in a single pass.  The order of the remaining items is
+ * preserved.
+ *
+ * \param test Predicate called as test(data, item).
+ * \param data Passed through to test.
+ *
+ * \return The number of items removed.
+ */
+size_t tj_array_removeIf(tj_array *array,
+                         int (*test)(void *data, void *item), void *data);
+
 /** Removes all items from the array. */
 void tj_array_clear(tj_array *array);
 
+/**
+ * Sort the items of an array, stably.
+ *
+ * The comparator is called with the items themselves, not pointers to
+ * them as with qsort().  For faster sorting with an inlined comparator,
+ * radix keys or multiple threads, see TJ_ARRAY_SORT_DECL and
+ * TJ_ARRAY_RADIX_SORT_DECL in tj_sort.h.
+ *
+ * \param cmp Returns <0, 0, or >0 as a sorts before, with, or after b.
+ *
+ * \return 0 on failure, in which case the array is unchanged, 1
+ * otherwise.
+ */
+int tj_array_sort(tj_array *array, int (*cmp)(const void *a, const void *b));
+
+/**
+ * Reorder the items of an array in place with the given function, keeping
+ * any index in sync.  This is the hook used by tj_sort.h.
+ *
+ * \param reorder Called once as reorder(items, count, data).  Must only
+ * permute the items, and return 0 on failure, 1 otherwise.
+ *
+ * \return The result of reorder.
+ */
+int tj_array_reorder(tj_array *array,
+                     int (*reorder)(void **items, size_t n, void *data),
+                     void *data);
+
+/**
+ * \name Sorted arrays
+ *
+ * These operate on arrays kept sorted by a comparator, as with
+ * tj_array_sort().  Results are undefined if the array is not sorted by
+ * the same comparator.  The set operations treat equal items one to one,
+ * so an item present twice in a and once in b appears twice in the union,
+ * once in the intersection, and once in the difference.  They append to
+ * dest, which must be a different array than a and b, and gallop through
+ * runs, costing O(m log(n/m)) comparisons when one input is much smaller.
+ * \{
+ */
+
+/** Returns the index of the first item not less than key. */
+size_t tj_array_lowerBound(const tj_array *array, const void *key,
+                           int (*cmp)(const void *a, const void *b));
+
+/** Returns the index of the first item greater than key. */
+size_t tj_array_upperBound(const tj_array *array, const void *key,
+                           int (*cmp)(const void *a, const void *b));
+
+/**
+ * Binary searches for an item equal to key.
+ *
+ * \return The index of the first equal item, -1 if there is none.
+ */
+ssize_t tj_array_bsearch(const tj_array *array, const void *key,
+                         int (*cmp)(const void *a, const void *b));
+
+/**
+ * Insert an item in sorted position, after any equal items.
+ *
+ * \return 0 on failure, in which case the array is unchanged, 1
+ * otherwise.
+ */
+int tj_array_insertSorted(tj_array *array, void *item,
+                          int (*cmp)(const void *a, const void *b));
+
+/**
+ * Merge a sorted batch of n items into the array in one pass, with at most
+ * one reallocation.  New items are placed after existing equal items.
+ *
+ * \return 0 on failure, in which case the array is unchanged, 1
+ * otherwise.
+ */
+int tj_array_mergeSorted(tj_array *array, void * const *items, size_t n,
+                         int (*cmp)(const void *a, const void *b));
+
+/**
+ * Append the sorted union of a and b to dest.
+ *
+ * \return 0 on failure, 1 otherwise.
+ */
+int tj_array_union(tj_array *dest, const tj_array *a, const tj_array *b,
+                   int (*cmp)(const void *a, const void *b));
+
+/**
+ * Append the sorted items of a that are also in b to dest.
+ *
+ * \return 0 on failure, 1 otherwise.
+ */
+int tj_array_intersection(tj_array *dest, const tj_array *a,
+                          const tj_array *b,
+                          int (*cmp)(const void *a, const void *b));
+
+/**
+ * Append the sorted items of a that are not in b to dest.
+ *
+ * \return 0 on failure, 1 otherwise.
+ */
+int tj_array_difference(tj_array *dest, const tj_array *a, const tj_array *b,
+                        int (*cmp)(const void *a, const void *b));
+
+/** \} */
+
 /**
  * Searches an array for an element, by comparing pointers.
  *
- * \return -1 if item not found.
+ * Linear unless tj_array_enableIndex() has been called.
+ *
+ * \return The lowest index of the item, -1 if item not found.
  */
 ssize_t tj_array_find(const tj_array *array, void *item);
@@ -0,0 +1,717 @@
+/*
+ * Copyright (c) 2013 Bellerophon Mobile, LLC.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include "tj_allocator.h"
+#include "tj_bitset.h"
+
+#ifdef UNIT_TESTING
+#   undef assert
+#   define assert(x) mock_assert((int)(x), #x, __FILE__, __LINE__)
+#endif /* UNIT_TESTING */
+
+#define WORD_BITS 64
+
+/*
+ * Bitmaps are processed VEC_WORDS words at a time through the compiler's
+ * generic vector types, which map onto whatever SIMD registers the target
+ * has.  Bitmaps are always allocated in whole vectors, so there are no
+ * tails to handle.
+ */
+#define VEC_WORDS 4
+typedef uint64_t vec __attribute__((vector_size(VEC_WORDS * 8)));
+
+/* Bit truth tables for combining runs, indexed by (inA << 1) | inB. */
+#define OP_AND    0x8
+#define OP_OR     0xe
+#define OP_XOR    0x6
+#define OP_ANDNOT 0x4
+
+typedef struct {
+    size_t start;
+    size_t length;
+} run;
+
+/*
+ * Exactly one of the representations is in use.  Runs are sorted, and
+ * never overlap or touch.
+ */
+struct tj_bitset {
+    const tj_allocator *allocator;
+    int compressed;
+
+    uint64_t *words;
+    size_t nwords;
+
+    run *runs;
+    size_t nruns;
+    size_t runcap;
+};
+
+static size_t run_end(const run *r) {
+    return r->start + r->length;
+}
+
+//----------------------------------------------------------------------
+// Bitmap helpers
+//----------------------------------------------------------------------
+
+static int words_grow(tj_bitset *set, size_t nwords) {
+    if (nwords <= set->nwords) {
+        return 1;
+    }
+
+    size_t n = (set->nwords > 0) ? set->nwords : VEC_WORDS;
+    while (n < nwords) {
+        n *= 2;
+    }
+
+    uint64_t *words = tj_allocator_realloc(set->allocator, set->words,
+                                           set->nwords * sizeof(uint64_t),
+                                           n * sizeof(uint64_t));
+    if (words == NULL) {
+        return 0;
+    }
+    memset(words + set->nwords, 0, (n - set->nwords) * sizeof(uint64_t));
+    set->words = words;
+    set->nwords = n;
+    return 1;
+}
+
+static size_t words_for(size_t nbits) {
+    size_t n = (nbits + WORD_BITS - 1) / WORD_BITS;
+    return (n + VEC_WORDS - 1) / VEC_WORDS * VEC_WORDS;
+}
+
+#define VEC_OP(name, op)                                                \
+    static void name(uint64_t *a, const uint64_t *b, size_t n) {        \
+        size_t i;                                                       \
+        vec x, y;                                                       \
+        for (i = 0; i < n; i += VEC_WORDS) {                            \
+            memcpy(&x, a + i, sizeof(vec));                             \
+            memcpy(&y, b + i, sizeof(vec));                             \
+            x op;                                                       \
+            memcpy(a + i, &x, sizeof(vec));                             \
+        }                                                               \
+    }
+
+VEC_OP(vec_and, &= y)
+VEC_OP(vec_or, |= y)
+VEC_OP(vec_xor, ^= y)
+VEC_OP(vec_andNot, &= ~y)
+
+#ifdef __POPCNT__
+/* With a popcount instruction, four scalar accumulators keep it busy. */
+static size_t words_count(const uint64_t *words, size_t n) {
+    size_t i, c0 = 0, c1 = 0, c2 = 0, c3 = 0;
+    for (i = 0; i < n; i += VEC_WORDS) {
+        c0 += __builtin_popcountll(words[i]);
+        c1 += __builtin_popcountll(words[i + 1]);
+        c2 += __builtin_popcountll(words[i + 2]);
+        c3 += __builtin_popcountll(words[i + 3]);
+    }
+    return c0 + c1 + c2 + c3;
+}
+#else
+/*
+ * Without one, __builtin_popcountll() is a library call per word, so
+ * count a vector at a time instead: the usual bit slicing reduces each
+ * byte to its own count, and those are summed bytewise across up to 31
+ * vectors, at most 248 per byte, before being folded into the total.
+ */
+static size_t words_count(const uint64_t *words, size_t n) {
+    const uint64_t m1 = 0x5555555555555555ULL, m2 = 0x3333333333333333ULL,
+        m4 = 0x0f0f0f0f0f0f0f0fULL, m8 = 0x00ff00ff00ff00ffULL;
+    size_t i = 0, total = 0;
+
+    while (i < n) {
+        size_t end = (n - i > 31 * VEC_WORDS) ? i + 31 * VEC_WORDS : n;
+        vec sum = { 0 }, x;
+        int j;
+
+        for (; i < end; i += VEC_WORDS) {
+            memcpy(&x, words + i, sizeof(vec));
+            x -= (x >> 1) & m1;
+            x = (x & m2) + ((x >> 2) & m2);
+            sum += (x + (x >> 4)) & m4;
+        }
+
+        /* Pairs of bytes into 16 bit fields, then those into the top. */
+        sum = (sum & m8) + ((sum >> 8) & m8);
+        for (j = 0; j < VEC_WORDS; j++) {
+            total += (sum[j] * 0x0001000100010001ULL) >> 48;
+        }
+    }
+    return total;
+}
+#endif
+
+/* Applies op to bits [start, end), which must lie within the bitmap. */
+#define RANGE_OP(name, op)                                              \
+    static void name(uint64_t *words, size_t start, size_t end) {       \
+        if (start >= end) {                                             \
+            return;                                                     \
+        }                                                               \
+        size_t first = start / WORD_BITS, last = (end - 1) / WORD_BITS; \
+        uint64_t head = ~UINT64_C(0) << (start % WORD_BITS);            \
+        uint64_t tail = ~UINT64_C(0) >> (WORD_BITS - 1 - (end - 1) % WORD_BITS); \
+        if (first == last) {                                            \
+            uint64_t mask = head & tail;                                \
+            words[first] op mask;                                       \
+            return;                                                     \
+        }                                                               \
+        uint64_t mask = head;                                           \
+        words[first] op mask;                                           \
+        size_t i;                                                       \
+        for (i = first + 1; i < last; i++) {                            \
+            mask = ~UINT64_C(0);                                        \
+            words[i] op mask;                                           \
+        }                                                               \
+        mask = tail;                                                    \
+        words[last] op mask;                                            \
+    }
+
+RANGE_OP(range_set, |=)
+RANGE_OP(range_flip, ^=)
+RANGE_OP(range_clear, &= ~)
+
+/* Returns the first bit at or after from with the given value. */
+static size_t words_next(const uint64_t *words, size_t nwords, size_t from,
+                         int value) {
+    size_t i = from / WORD_BITS;
+    if (i >= nwords) {
+        return nwords * WORD_BITS;
+    }
+
+    uint64_t flip = value ? 0 : ~UINT64_C(0);
+    uint64_t w = (words[i] ^ flip) & (~UINT64_C(0) << (from % WORD_BITS));
+    while (w == 0) {
+        if (++i == nwords) {
+            return nwords * WORD_BITS;
+        }
+        w = words[i] ^ flip;
+    }
+    return i * WORD_BITS + __builtin_ctzll(w);
+}
+
+//----------------------------------------------------------------------
+// Run helpers
+//----------------------------------------------------------------------
+
+static int runs_reserve(const tj_allocator *allocator, run **runs,
+                        size_t *cap, size_t n) {
+    if (n <= *cap) {
+        return 1;
+    }
+
+    size_t c = (*cap > 0) ? *cap : 4;
+    while (c < n) {
+        c *= 2;
+    }
+
+    run *r = tj_allocator_realloc(allocator, *runs, *cap * sizeof(run),
+                                  c * sizeof(run));
+    if (r == NULL) {
+        return 0;
+    }
+    *runs = r;
+    *cap = c;
+    return 1;
+}
+
+/* Index of the first run starting after bit. */
+static size_t runs_after(const tj_bitset *set, size_t bit) {
+    size_t lo = 0, hi = set->nruns;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (set->runs[mid].start <= bit) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/* Extracts the runs of a bitmap.  Caller frees *out, of *cap runs. */
+static int words_to_runs(const tj_allocator *allocator,
+                         const uint64_t *words, size_t nwords,
+                         run **out, size_t *nout, size_t *cap) {
+    size_t end = nwords * WORD_BITS;
+    size_t pos = words_next(words, nwords, 0, 1);
+
+    *out = NULL;
+    *nout = 0;
+    *cap = 0;
+    while (pos < end) {
+        size_t stop = words_next(words, nwords, pos, 0);
+        if (!runs_reserve(allocator, out, cap, *nout + 1)) {
+            tj_allocator_free(allocator, *out, *cap * sizeof(run));
+            *out = NULL;
+            *cap = 0;
+            return 0;
+        }
+        (*out)[*nout].start = pos;
+        (*out)[*nout].length = stop - pos;
+        (*nout)++;
+        pos = (stop < end) ? words_next(words, nwords, stop, 1) : end;
+    }
+    return 1;
+}
+
+/*
+ * Sweeps two run lists together, emitting the runs where the truth table
+ * op holds.  Caller frees *out, of *cap runs.
+ */
+static int runs_combine(const tj_allocator *allocator,
+                        const run *a, size_t na, const run *b, size_t nb,
+                        int op, run **out, size_t *nout, size_t *cap) {
+    size_t i = 0, j = 0, pos = 0;
+
+    *out = NULL;
+    *nout = 0;
+    *cap = 0;
+    if (!runs_reserve(allocator, out, cap, na + nb + 1)) {
+        return 0;
+    }
+
+    while (i < na || j < nb) {
+        int ina = 0, inb = 0;
+        size_t next = SIZE_MAX;
+
+        if (i < na) {
+            ina = (pos >= a[i].start);
+            next = ina ? run_end(&a[i]) : a[i].start;
+        }
+        if (j < nb) {
+            inb = (pos >= b[j].start);
+            size_t nextb = inb ? run_end(&b[j]) : b[j].start;
+            if (nextb < next) {
+                next = nextb;
+            }
+        }
+
+        if (op & (1 << ((ina << 1) | inb))) {
+            if (*nout > 0 && run_end(&(*out)[*nout - 1]) == pos) {
+                (*out)[*nout - 1].length += next - pos;
+            } else {
+                (*out)[*nout].start = pos;
+                (*out)[*nout].length = next - pos;
+                (*nout)++;
+            }
+        }
+
+        pos = next;
+        if (i < na && pos == run_end(&a[i])) {
+            i++;
+        }
+        if (j < nb && pos == run_end(&b[j])) {
+            j++;
+        }
+    }
+    return 1;
+}
+
+//----------------------------------------------------------------------
+//----------------------------------------------------------------------
+
+tj_bitset *tj_bitset_create(size_t nbits) {
+    return tj_bitset_createWithAllocator(nbits, NULL);
+}
+
+tj_bitset *tj_bitset_createWithAllocator(size_t nbits,
+                                         const tj_allocator *allocator) {
+    allocator = tj_allocator_orDefault(allocator);
+
+    tj_bitset *set = tj_allocator_calloc(allocator, sizeof(*set));
+    if (set == NULL) {
+        return NULL;
+    }
+    set->allocator = allocator;
+
+    if (!words_grow(set, words_for(nbits))) {
+        tj_allocator_free(allocator, set, sizeof(*set));
+        return NULL;
+    }
+    return set;
+}
+
+void tj_bitset_finalize(tj_bitset *set) {
+    tj_allocator_free(set->allocator, set->words,
+                      set->nwords * sizeof(uint64_t));
+    tj_allocator_free(set->allocator, set->runs, set->runcap * sizeof(run));
+    tj_allocator_free(set->allocator, set, sizeof(*set));
+}
+
+tj_bitset *tj_bitset_copy(const tj_bitset *set) {
+    tj_bitset *copy = tj_bitset_createWithAllocator(0, set->allocator);
+    if (copy == NULL) {
+        return NULL;
+    }
+
+    copy->compressed = set->compressed;
+    if (!words_grow(copy, set->nwords) ||
+            !runs_reserve(copy->allocator, &copy->runs, &copy->runcap,
+                          set->nruns)) {
+        tj_bitset_finalize(copy);
+        return NULL;
+    }
+    if (set->nwords > 0) {
+        memcpy(copy->words, set->words, set->nwords * sizeof(uint64_t));
+    }
+    if (set->nruns > 0) {
+        memcpy(copy->runs, set->runs, set->nruns * sizeof(run));
+    }
+    copy->nruns = set->nruns;
+    return copy;
+}
+
+int tj_bitset_set(tj_bitset *set, size_t bit) {
+    if (!set->compressed) {
+        if (!words_grow(set, words_for(bit + 1))) {
+            return 0;
+        }
+        set->words[bit / WORD_BITS] |= UINT64_C(1) << (bit % WORD_BITS);
+        return 1;
+    }
+
+    size_t i = runs_after(set, bit);
+    run *prev = (i > 0) ? &set->runs[i - 1] : NULL;
+    run *next = (i < set->nruns) ? &set->runs[i] : NULL;
+
+    if (prev != NULL && bit < run_end(prev)) {
+        return 1;
+    }
+
+    int joins_prev = (prev != NULL && run_end(prev) == bit);
+    int joins_next = (next != NULL && next->start == bit + 1);
+    if (joins_prev && joins_next) {
+        prev->length += 1 + next->length;
+        memmove(next, next + 1, (set->nruns - i - 1) * sizeof(run));
+        set->nruns--;
+    } else if (joins_prev) {
+        prev->length++;
+    } else if (joins_next) {
+        next->start--;
+        next->length++;
+    } else {
+        if (!runs_reserve(set->allocator, &set->runs, &set->runcap,
+                          set->nruns + 1)) {
+            return 0;
+        }
+        memmove(set->runs + i + 1, set->runs + i,
+                (set->nruns - i) * sizeof(run));
+        set->runs[i].start = bit;
+        set->runs[i].length = 1;
+        set->nruns++;
+    }
+    return 1;
+}
+
+int tj_bitset_clear(tj_bitset *set, size_t bit) {
+    if (!set->compressed) {
+        if (bit / WORD_BITS < set->nwords) {
+            set->words[bit / WORD_BITS] &= ~(UINT64_C(1) << (bit % WORD_BITS));
+        }
+        return 1;
+    }
+
+    size_t i = runs_after(set, bit);
+    if (i == 0 || bit >= run_end(&set->runs[i - 1])) {
+        return 1;
+    }
+
+    run *r = &set->runs[i - 1];
+    size_t end = run_end(r);
+    if (r->length == 1) {
+        memmove(r, r + 1, (set->nruns - i) * sizeof(run));
+        set->nruns--;
+    } else if (bit == r->start) {
+        r->start++;
+        r->length--;
+    } else if (bit == end - 1) {
+        r->length--;
+    } else {
+        if (!runs_reserve(set->allocator, &set->runs, &set->runcap,
+                          set->nruns + 1)) {
+            return 0;
+        }
+        r = &set->runs[i - 1];
+        memmove(set->runs + i + 1, set->runs + i,
+                (set->nruns - i) * sizeof(run));
+        r->length = bit - r->start;
+        set->runs[i].start = bit + 1;
+        set->runs[i].length = end - bit - 1;
+        set->nruns++;
+    }
+    return 1;
+}
+
+int tj_bitset_test(const tj_bitset *set, size_t bit) {
+    if (!set->compressed) {
+        return bit / WORD_BITS < set->nwords &&
+            ((set->words[bit / WORD_BITS] >> (bit % WORD_BITS)) & 1);
+    }
+
+    size_t i = runs_after(set, bit);
+    return i > 0 && bit < run_end(&set->runs[i - 1]);
+}
+
+void tj_bitset_reset(tj_bitset *set) {
+    if (set->nwords > 0) {
+        memset(set->words, 0, set->nwords * sizeof(uint64_t));
+    }
+    set->nruns = 0;
+}
+
+size_t tj_bitset_count(const tj_bitset *set) {
+    if (!set->compressed) {
+        return words_count(set->words, set->nwords);
+    }
+
+    size_t i, count = 0;
+    for (i = 0; i < set->nruns; i++) {
+        count += set->runs[i].length;
+    }
+    return count;
+}
+
+ssize_t tj_bitset_next(const tj_bitset *set, size_t from) {
+    if (!set->compressed) {
+        size_t bit = words_next(set->words, set->nwords, from, 1);
+        return (bit < set->nwords * WORD_BITS) ? (ssize_t)bit : -1;
+    }
+
+    size_t i = runs_after(set, from);
+    if (i > 0 && from < run_end(&set->runs[i - 1])) {
+        return from;
+    }
+    return (i < set->nruns) ? (ssize_t)set->runs[i].start : -1;
+}
+
+//----------------------------------------------------------------------
+//----------------------------------------------------------------------
+
+/* dest is a bitmap; src is a bitmap. */
+static int bitmap_bitmap(tj_bitset *dest, const tj_bitset *src, int op) {
+    size_t n = src->nwords;
+
+    if (op == OP_OR || op == OP_XOR) {
+        if (!words_grow(dest, n)) {
+            return 0;
+        }
+    } else if (n > dest->nwords) {
+        n = dest->nwords;
+    }
+
+    switch (op) {
+    case OP_AND:
+        vec_and(dest->words, src->words, n);
+        if (dest->nwords > n) {
+            memset(dest->words + n, 0,
+                   (dest->nwords - n) * sizeof(uint64_t));
+        }
+        break;
+    case OP_OR:
+        vec_or(dest->words, src->words, n);
+        break;
+    case OP_XOR:
+        vec_xor(dest->words, src->words, n);
+        break;
+    case OP_ANDNOT:
+        vec_andNot(dest->words, src->words, n);
+        break;
+    }
+    return 1;
+}
+
+/* dest is a bitmap; src is a run list. */
+static int bitmap_runs(tj_bitset *dest, const tj_bitset *src, int op) {
+    size_t i, limit = dest->nwords * WORD_BITS;
+
+    if ((op == OP_OR || op == OP_XOR) && src->nruns > 0) {
+        if (!words_grow(dest, words_for(run_end(&src->runs[src->nruns - 1])))) {
+            return 0;
+        }
+        limit = dest->nwords * WORD_BITS;
+    }
+
+    size_t prev = 0;
+    for (i = 0; i < src->nruns && src->runs[i].start < limit; i++) {
+        size_t start = src->runs[i].start, end = run_end(&src->runs[i]);
+        if (end > limit) {
+            end = limit;
+        }
+
+        switch (op) {
+        case OP_AND:
+            range_clear(dest->words, prev, start);
+            break;
+        case OP_OR:
+            range_set(dest->words, start, end);
+            break;
+        case OP_XOR:
+            range_flip(dest->words, start, end);
+            break;
+        case OP_ANDNOT:
+            range_clear(dest->words, start, end);
+            break;
+        }
+        prev = end;
+    }
+    if (op == OP_AND) {
+        range_clear(dest->words, prev, limit);
+    }
+    return 1;
+}
+
+/* dest is a run list; src is either. */
+static int runs_any(tj_bitset *dest, const tj_bitset *src, int op) {
+    const run *b = src->runs;
+    size_t nb = src->nruns, bcap = 0;
+    run *extracted = NULL;
+
+    if (!src->compressed) {
+        if (!words_to_runs(dest->allocator, src->words, src->nwords,
+                           &extracted, &nb, &bcap)) {
+            return 0;
+        }
+        b = extracted;
+    }
+
+    run *out;
+    size_t nout, cap;
+    int res = runs_combine(dest->allocator, dest->runs, dest->nruns, b, nb, op,
+                           &out, &nout, &cap);
+    tj_allocator_free(dest->allocator, extracted, bcap * sizeof(run));
+    if (!res) {
+        return 0;
+    }
+
+    tj_allocator_free(dest->allocator, dest->runs,
+                      dest->runcap * sizeof(run));
+    dest->runs = out;
+    dest->nruns = nout;
+    dest->runcap = cap;
+    return 1;
+}
+
+static int combine(tj_bitset *dest, const tj_bitset *src, int op) {
+    if (dest->compressed) {
+        return runs_any(dest, src, op);
+    }
+    if (src->compressed) {
+        return bitmap_runs(dest, src, op);
+    }
+    return bitmap_bitmap(dest, src, op);
+}
+
+int tj_bitset_and(tj_bitset *dest, const tj_bitset *src) {
+    return combine(dest, src, OP_AND);
+}
+
+int tj_bitset_or(tj_bitset *dest, const tj_bitset *src) {
+    return combine(dest, src, OP_OR);
+}
+
+int tj_bitset_xor(tj_bitset *dest, const tj_bitset *src) {
+    return combine(dest, src, OP_XOR);
+}
+
+int tj_bitset_andNot(tj_bitset *dest, const tj_bitset *src) {
+    return combine(dest, src, OP_ANDNOT);
+}
+
+//----------------------------------------------------------------------
+//----------------------------------------------------------------------
+
+int tj_bitset_optimize(tj_bitset *set) {
+    if (!set->compressed) {
+        run *runs;
+        size_t nruns, cap;
+        if (!words_to_runs(set->allocator, set->words, set->nwords,
+                           &runs, &nruns, &cap)) {
+            return 0;
+        }
+
+        size_t used = words_for(nruns > 0 ? run_end(&runs[nruns - 1]) : 0);
+        if (nruns * sizeof(run) > used * sizeof(uint64_t)) {
+            tj_allocator_free(set->allocator, runs, cap * sizeof(run));
+            return 1;
+        }
+
+        tj_allocator_free(set->allocator, set->words,
+                          set->nwords * sizeof(uint64_t));
+        set->words = NULL;
+        set->nwords = 0;
+        tj_allocator_free(set->allocator, set->runs,
+                          set->runcap * sizeof(run));
+        set->runs = runs;
+        set->nruns = nruns;
+        set->runcap = cap;
+        set->compressed = 1;
+        return 1;
+    }
+
+    size_t used = words_for(set->nruns > 0 ?
+                            run_end(&set->runs[set->nruns - 1]) : 0);
+    if (set->nruns * sizeof(run) <= used * sizeof(uint64_t)) {
+        return 1;
+    }
+
+    uint64_t *words = tj_allocator_calloc(set->allocator,
+                                          used * sizeof(uint64_t));
+    if (words == NULL) {
+        return 0;
+    }
+
+    size_t i;
+    for (i = 0; i < set->nruns; i++) {
+        range_set(words, set->runs[i].start, run_end(&set->runs[i]));
+    }
+
+    tj_allocator_free(set->allocator, set->words,
+                      set->nwords * sizeof(uint64_t));
+    set->words = words;
+    set->nwords = used;
+    tj_allocator_free(set->allocator, set->runs, set->runcap * sizeof(run));
+    set->runs = NULL;
+    set->nruns = 0;
+    set->runcap = 0;
+    set->compressed = 0;
+    return 1;
+}
+
+int tj_bitset_isCompressed(const tj_bitset *set) {
+    return set->compressed;
+}
+
+size_t tj_bitset_memoryUsage(const tj_bitset *set) {
+    return set->nwords * sizeof(uint64_t) + set->runcap * sizeof(run);
+}
@@ -0,0 +1,137 @@
+/*
+ * Copyright (c) 2013 Bellerophon Mobile, LLC.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * \file tj_bitset.h
+ *
+ * Provides an expandable set of small non-negative integers, as a bitmap
+ * or as a compressed list of runs.
+ *
+ * A bitset starts out as a plain bitmap, which grows as needed when bits
+ * are set.  Whole set operations and counting work on the bitmap a vector
+ * at a time.  tj_bitset_optimize() switches a set to a sorted list of runs
+ * of set bits when that is smaller, which suits sparse or highly clustered
+ * sets.  Every operation works in either mode, and operations between a
+ * bitmap and a run list are done run by run rather than by expanding the
+ * runs.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <sys/types.h>
+
+#include "tj_allocator.h"
+
+typedef struct tj_bitset tj_bitset;
+
+/**
+ * Create a new, empty bitset.
+ *
+ * \param nbits Initial capacity in bits, may be 0.
+ */
+tj_bitset *tj_bitset_create(size_t nbits);
+
+/** As tj_bitset_create(), allocating through allocator. */
+tj_bitset *tj_bitset_createWithAllocator(size_t nbits,
+                                         const tj_allocator *allocator);
+
+/** Frees a bitset. */
+void tj_bitset_finalize(tj_bitset *set);
+
+/**
+ * Create a copy of a bitset, in the same mode and with the same
+ * allocator.
+ *
+ * \return The copy, NULL on failure.
+ */
+tj_bitset *tj_bitset_copy(const tj_bitset *set);
+
+/**
+ * Set a bit, growing the bitset if necessary.  In a run list, a bit that
+ * starts a new run moves every run after it, so build large scattered sets
+ * as bitmaps and optimize afterwards.
+ *
+ * \return 0 on failure, in which case the set is unchanged, 1 otherwise.
+ */
+int tj_bitset_set(tj_bitset *set, size_t bit);
+
+/**
+ * Clear a bit.  Clearing a bit inside a run may split it.
+ *
+ * \return 0 on failure, in which case the set is unchanged, 1 otherwise.
+ */
+int tj_bitset_clear(tj_bitset *set, size_t bit);
+
+/** Returns 1 if the bit is set, 0 otherwise. */
+int tj_bitset_test(const tj_bitset *set, size_t bit);
+
+/** Clears every bit, keeping the memory. */
+void tj_bitset_reset(tj_bitset *set);
+
+/** Returns the number of bits set. */
+size_t tj_bitset_count(const tj_bitset *set);
+
+/**
+ * Find the next set bit.
+ *
+ * \code{.c}
+ * ssize_t bit;
+ * for (bit = tj_bitset_next(set, 0); bit >= 0;
+ *      bit = tj_bitset_next(set, bit + 1)) {
+ *     ...
+ * }
+ * \endcode
+ *
+ * \return The lowest set bit at or after from, -1 if there is none.
+ */
+ssize_t tj_bitset_next(const tj_bitset *set, size_t from);
+
+/**
+ * \name Whole set operations
+ *
+ * Each modifies dest in place, as dest = dest op src, keeping dest's
+ * mode.  dest and src may be the same set.
+ *
+ * \return 0 on failure, in which case dest is unchanged, 1 otherwise.
+ * \{
+ */
+int tj_bitset_and(tj_bitset *dest, const tj_bitset *src);
+int tj_bitset_or(tj_bitset *dest, const tj_bitset *src);
+int tj_bitset_xor(tj_bitset *dest, const tj_bitset *src);
+int tj_bitset_andNot(tj_bitset *dest, const tj_bitset *src);
+/** \} */
+
+/**
+ * Convert the set to whichever of a bitmap or a run list is smaller.
+ *
+ * \return 0 on failure, in which case the set is unchanged, 1 otherwise.
+ */
+int tj_bitset_optimize(tj_bitset *set);
+
+/** Returns 1 if the set is stored as a run list, 0 if as a bitmap. */
+int tj_bitset_isCompressed(const tj_bitset *set);
+
+/** Returns the number of bytes used to store the set's bits or runs. */
+size_t tj_bitset_memoryUsage(const tj_bitset *set);
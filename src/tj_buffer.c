@@ -27,6 +27,8 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "tj_allocator.h"
+#include "tj_arena.h"
 #include "tj_buffer.h"
 
 //----------------------------------------------------------------------
@@ -62,47 +64,95 @@ struct tj_buffer {
   size_t m_used;
   size_t m_n;
   char m_own;
+  char m_geometric;
+  const tj_allocator *m_allocator;
 };
 
+//----------------------------------------------------------------------
+//----------------------------------------------------------------------
+static int
+tj_buffer_grow(tj_buffer *b, size_t n)
+{
+  tj_buffer_byte *nb;
+  if (n <= b->m_n)
+    return 1;
+
+  // Arena memory is only reclaimed on reset, so grow geometrically
+  // rather than leave a trail of exact sized copies behind.
+  if (b->m_geometric && n < b->m_n*2)
+    n = b->m_n*2;
+
+  nb = (tj_buffer_byte *) tj_allocator_realloc(b->m_allocator, b->m_buff,
+                                               b->m_n, n);
+
+  if (nb == 0) {
+    TJ_ERROR("Could not increase buffer from %zu to %zu.", b->m_n, n);
+    return 0;
+  }
+
+  b->m_buff = nb;
+  b->m_n = n;
+  return 1;
+  // end tj_buffer_grow
+}
+
 //----------------------------------------------------------------------
 //----------------------------------------------------------------------
 tj_buffer *
 tj_buffer_create(size_t initial)
+{
+  return tj_buffer_createWithAllocator(initial, 0);
+  // end tj_buffer_create
+}
+
+tj_buffer *
+tj_buffer_createWithArena(size_t initial, tj_arena *arena)
 {
   tj_buffer *b;
-  if ((b = malloc(sizeof(tj_buffer))) == 0) {
-    TJ_ERROR("No memory for tj_buffer [%zu bytes].", sizeof(tj_buffer));
+  if ((b = tj_buffer_createWithAllocator(0, tj_arena_getAllocator(arena))) == 0)
     return 0;
-  }
 
-  if (initial > 0) {
-    if ((b->m_buff = (tj_buffer_byte *) malloc(initial)) == 0) {
-      TJ_ERROR("No memory for tj_buffer_byte[%zu bytes].", initial);
-      b->m_n = 0;
-    } else {
-      b->m_n = initial;
-    }
-  } else {
-    b->m_buff = 0;
-    b->m_n = 0;
+  b->m_geometric = 1;
+  if (initial > 0 && !tj_buffer_grow(b, initial))
+    TJ_ERROR("No memory for tj_buffer_byte[%zu bytes].", initial);
+
+  return b;
+  // end tj_buffer_createWithArena
+}
+
+tj_buffer *
+tj_buffer_createWithAllocator(size_t initial, const tj_allocator *allocator)
+{
+  tj_buffer *b;
+  allocator = tj_allocator_orDefault(allocator);
+  if ((b = tj_allocator_alloc(allocator, sizeof(tj_buffer))) == 0) {
+    TJ_ERROR("No memory for tj_buffer [%zu bytes].", sizeof(tj_buffer));
+    return 0;
   }
 
+  b->m_buff = 0;
+  b->m_n = 0;
   b->m_own = 1;
   b->m_used = 0;
+  b->m_geometric = 0;
+  b->m_allocator = allocator;
+
+  if (initial > 0 && !tj_buffer_grow(b, initial))
+    TJ_ERROR("No memory for tj_buffer_byte[%zu bytes].", initial);
 
   TJ_LOG("Buffer[%zu] created.", initial);
   return b;
-  // end tj_buffer_create
+  // end tj_buffer_createWithAllocator
 }
 
 void
 tj_buffer_finalize(tj_buffer *x)
 {
   if (x->m_own && x->m_buff != 0)
-    free(x->m_buff);
+    tj_allocator_free(x->m_allocator, x->m_buff, x->m_n);
 
   TJ_LOG("Buffer[%zu] finalized.", x->m_n);
-  free(x);
+  tj_allocator_free(x->m_allocator, x, sizeof(tj_buffer));
   // end tj_buffer_finalize
 }
 
@@ -164,16 +214,8 @@ tj_buffer_getBytesAtIndex(tj_buffer *b, size_t i)
 int
 tj_buffer_append(tj_buffer *b, const tj_buffer_byte *data, size_t n)
 {
-  tj_buffer_byte *ot;
-  if (b->m_used + n > b->m_n) {
-    if ((b->m_buff = (tj_buffer_byte *) realloc(ot=b->m_buff,
-                                               b->m_used+n)) == 0) {
-      TJ_ERROR("Could not increase buffer from %zu to %zu.", b->m_n, b->m_used+n);
-      b->m_buff = ot;
-      return 0;
-    }
-    b->m_n = b->m_used + n;
-  }
+  if (!tj_buffer_grow(b, b->m_used + n))
+    return 0;
 
   memcpy(&b->m_buff[b->m_used], data, n);
   b->m_used += n;
@@ -195,16 +237,8 @@ tj_buffer_appendString(tj_buffer *b, const char *str)
 {
   int n = strlen(str)+1;
 
-  tj_buffer_byte *ot;
-  if (b->m_used + n > b->m_n) {
-    if ((b->m_buff = (tj_buffer_byte *) realloc(ot=b->m_buff,
-                                               b->m_used+n)) == 0) {
-      TJ_ERROR("Could not increase buffer from %zu to %zu.", b->m_n, b->m_used+n);
-      b->m_buff = ot;
-      return 0;
-    }
-    b->m_n = b->m_used + n;
-  }
+  if (!tj_buffer_grow(b, b->m_used + n))
+    return 0;
 
   memcpy(&b->m_buff[b->m_used], str, n);
   b->m_used += n;
@@ -224,17 +258,8 @@ tj_buffer_appendAsStringN(tj_buffer *b, const char *str, size_t n)
   if (b->m_used == 0)
     n++;
 
-  tj_buffer_byte *ot;
-  if (b->m_used + n > b->m_n) {
-    if ((b->m_buff = (tj_buffer_byte *) realloc(ot=b->m_buff,
-                                                b->m_used+n)) == 0) {
-      TJ_ERROR("Could not increase buffer from %zu to %zu.",
-               b->m_n, b->m_used+n);
-      b->m_buff = ot;
-      return 0;
-    }
-    b->m_n = b->m_used + n;
-  }
+  if (!tj_buffer_grow(b, b->m_used + n))
+    return 0;
 
   if (b->m_used == 0)
     memcpy(b->m_buff, str, n);
@@ -322,7 +347,6 @@ tj_buffer_vaprintf(tj_buffer *b, const char *fmt, va_list ap)
   int n, t;
 
   int err = 1;
-  tj_buffer_byte *ot;
 
   while (1) {
     va_copy(cp, ap); // Don't do on Windows?  See utstring.
@@ -348,17 +372,11 @@ tj_buffer_vaprintf(tj_buffer *b, const char *fmt, va_list ap)
     if (n > -1) {
 
       //-- Reallocate for the calculated length
-      if ((b->m_buff = (tj_buffer_byte *) realloc(ot=b->m_buff,
-                                                  b->m_used + n + ((b->m_used)?0:1))) == 0) {
-        TJ_ERROR("Could not increase buffer from %zu to %zu.",
-                 b->m_n, b->m_used+n);
-        b->m_buff = ot;
+      if (!tj_buffer_grow(b, b->m_used + n + ((b->m_used)?0:1))) {
         err = 0;
         goto done;
       }
 
-      b->m_n = b->m_used + n + ((b->m_used)?0:1);
-
     } else {
       TJ_ERROR("Could not vsnprintf to tj_buffer.");
       goto done;
@@ -28,6 +28,9 @@
 #include <stdio.h>
 #include <stdarg.h>
 
+#include "tj_allocator.h"
+#include "tj_arena.h"
+
 //----------------------------------------------------------------------
 //----------------------------------------------------------------------
 typedef unsigned char           tj_buffer_byte;
@@ -48,6 +51,31 @@ typedef struct tj_buffer        tj_buffer;
 tj_buffer *
 tj_buffer_create(size_t initial);
 
+/**
+ * Create a tj_buffer whose structure and data are allocated from an
+ * arena.  The buffer grows geometrically, since the arena cannot
+ * reclaim outgrown data until it is reset.  tj_buffer_finalize() is
+ * optional; the buffer is released when the arena is rewound or reset
+ * past its creation.
+ *
+ * \param initial The initial buffer size; can be 0.
+ * \param arena The arena to allocate from.
+ */
+tj_buffer *
+tj_buffer_createWithArena(size_t initial, tj_arena *arena);
+
+/**
+ * Create a tj_buffer whose structure and data are allocated through
+ * the given allocator.  If ownership of the data is released with
+ * tj_buffer_setOwnership(), it must be freed through the same
+ * allocator, with size tj_buffer_getAllocated().
+ *
+ * \param initial The initial buffer size; can be 0.
+ * \param allocator The allocator to use, or 0 for the default.
+ */
+tj_buffer *
+tj_buffer_createWithAllocator(size_t initial, const tj_allocator *allocator);
+
 /**
  * Destroys a buffer and frees its memory.  Behavior of any future
  * calls on the buffer are undefined, but will probably segfault.
@@ -0,0 +1,226 @@
+/*
+ * Copyright (c) 2013 Bellerophon Mobile, LLC.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tj_allocator.h"
+#include "tj_concarray.h"
+
+#ifdef UNIT_TESTING
+#   undef assert
+#   define assert(x) mock_assert((int)(x), #x, __FILE__, __LINE__)
+#endif /* UNIT_TESTING */
+
+/* Chunk k holds FIRST_CHUNK << k elements, as in tj_segarray. */
+#define FIRST_CHUNK_BITS 4
+#define FIRST_CHUNK ((size_t)1 << FIRST_CHUNK_BITS)
+#define MAX_CHUNKS (sizeof(size_t) * 8 - FIRST_CHUNK_BITS)
+
+/*
+ * Each chunk is its elements followed by one ready flag per element, set
+ * once the element has been written.
+ */
+struct tj_concarray {
+    size_t elemsize;
+
+    /* Slots handed out to appending threads. */
+    size_t reserved;
+
+    /* Every slot below this is ready; only ever advances. */
+    size_t published;
+
+    const tj_allocator *allocator;
+
+    char *chunk[MAX_CHUNKS];
+};
+
+static size_t chunk_size(size_t chunk) {
+    return FIRST_CHUNK << chunk;
+}
+
+static void locate(size_t index, size_t *chunk, size_t *offset) {
+    size_t v = index + FIRST_CHUNK;
+    size_t bit = sizeof(unsigned long long) * 8 - 1 - __builtin_clzll(v);
+    *chunk = bit - FIRST_CHUNK_BITS;
+    *offset = v - ((size_t)1 << bit);
+}
+
+static char *ready_flags(const tj_concarray *array, char *chunk, size_t k) {
+    return chunk + chunk_size(k) * array->elemsize;
+}
+
+tj_concarray *tj_concarray_create(size_t elemsize) {
+    return tj_concarray_createWithAllocator(elemsize, NULL);
+}
+
+tj_concarray *tj_concarray_createWithAllocator(size_t elemsize,
+                                               const tj_allocator *allocator) {
+    assert(elemsize > 0);
+
+    allocator = tj_allocator_orDefault(allocator);
+
+    tj_concarray *array = tj_allocator_calloc(allocator, sizeof(*array));
+    if (array == NULL) {
+        return NULL;
+    }
+
+    array->elemsize = elemsize;
+    array->allocator = allocator;
+    return array;
+}
+
+static size_t chunk_bytes(const tj_concarray *array, size_t k) {
+    return chunk_size(k) * (array->elemsize + 1);
+}
+
+void tj_concarray_finalize(tj_concarray *array) {
+    size_t i;
+    for (i = 0; i < MAX_CHUNKS; i++) {
+        if (array->chunk[i] != NULL) {
+            tj_allocator_free(array->allocator, array->chunk[i],
+                              chunk_bytes(array, i));
+        }
+    }
+    tj_allocator_free(array->allocator, array, sizeof(*array));
+}
+
+/*
+ * Returns chunk k, allocating it if necessary.  Racing threads may each
+ * allocate it; all but the one whose pointer is installed free theirs.
+ */
+static char *get_chunk(tj_concarray *array, size_t k) {
+    char *chunk = __atomic_load_n(&array->chunk[k], __ATOMIC_ACQUIRE);
+    if (chunk != NULL) {
+        return chunk;
+    }
+
+    char *mine = tj_allocator_alloc(array->allocator, chunk_bytes(array, k));
+    if (mine == NULL) {
+        return NULL;
+    }
+    memset(ready_flags(array, mine, k), 0, chunk_size(k));
+
+    if (__atomic_compare_exchange_n(&array->chunk[k], &chunk, mine, 0,
+                                    __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        return mine;
+    }
+    tj_allocator_free(array->allocator, mine, chunk_bytes(array, k));
+    return chunk;
+}
+
+int tj_concarray_reserve(tj_concarray *array, size_t n) {
+    size_t k, offset;
+    if (n == 0) {
+        return 1;
+    }
+    locate(n - 1, &k, &offset);
+    for (offset = 0; offset <= k; offset++) {
+        if (get_chunk(array, offset) == NULL) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int tj_concarray_append(tj_concarray *array, const void *item) {
+    size_t index = __atomic_fetch_add(&array->reserved, 1, __ATOMIC_RELAXED);
+
+    size_t k, offset;
+    locate(index, &k, &offset);
+    if (k >= MAX_CHUNKS) {
+        return 0;
+    }
+
+    char *chunk = get_chunk(array, k);
+    if (chunk == NULL) {
+        return 0;
+    }
+
+    memcpy(chunk + offset * array->elemsize, item, array->elemsize);
+    __atomic_store_n(ready_flags(array, chunk, k) + offset, 1,
+                     __ATOMIC_RELEASE);
+    return 1;
+}
+
+static int is_ready(const tj_concarray *array, size_t index) {
+    size_t k, offset;
+    locate(index, &k, &offset);
+
+    char *chunk = __atomic_load_n(&array->chunk[k], __ATOMIC_ACQUIRE);
+    return chunk != NULL &&
+        __atomic_load_n(ready_flags(array, chunk, k) + offset,
+                        __ATOMIC_ACQUIRE);
+}
+
+size_t tj_concarray_count(tj_concarray *array) {
+    size_t start = __atomic_load_n(&array->published, __ATOMIC_ACQUIRE);
+    size_t reserved = __atomic_load_n(&array->reserved, __ATOMIC_RELAXED);
+
+    size_t count = start;
+    while (count < reserved && is_ready(array, count)) {
+        count++;
+    }
+    if (count == start) {
+        return count;
+    }
+
+    /* Advance the shared count, unless another reader got further. */
+    size_t seen = start;
+    while (seen < count &&
+           !__atomic_compare_exchange_n(&array->published, &seen, count, 1,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+    }
+    return (seen > count) ? seen : count;
+}
+
+void *tj_concarray_get(const tj_concarray *array, size_t index) {
+    assert(index < __atomic_load_n(&array->published, __ATOMIC_ACQUIRE));
+
+    size_t k, offset;
+    locate(index, &k, &offset);
+    return array->chunk[k] + offset * array->elemsize;
+}
+
+void *tj_concarray_getChunk(const tj_concarray *array, size_t count,
+                            size_t chunk, size_t *n) {
+    assert(count <= __atomic_load_n(&array->published, __ATOMIC_ACQUIRE));
+
+    *n = 0;
+    if (chunk >= MAX_CHUNKS) {
+        return NULL;
+    }
+
+    size_t start = FIRST_CHUNK * (((size_t)1 << chunk) - 1);
+    if (start >= count) {
+        return NULL;
+    }
+
+    *n = count - start;
+    if (*n > chunk_size(chunk)) {
+        *n = chunk_size(chunk);
+    }
+    return array->chunk[chunk];
+}
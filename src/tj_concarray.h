@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2013 Bellerophon Mobile, LLC.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * \file tj_concarray.h
+ *
+ * Provides an append-only array of fixed size elements which many threads
+ * may append to and read from concurrently, without locks.
+ *
+ * Appending threads reserve a slot with a single atomic increment, and the
+ * backing store is segmented as in tj_segarray, so growth never moves
+ * elements or blocks readers.  Elements become visible to readers in
+ * order: tj_concarray_count() returns a snapshot count such that every
+ * element below it has been completely written.
+ */
+
+#pragma once
+
+#include <stddef.h>
+
+#include "tj_allocator.h"
+
+typedef struct tj_concarray tj_concarray;
+
+/**
+ * Create a new concurrent array.
+ *
+ * \param elemsize Size in bytes of each element, greater than 0.
+ */
+tj_concarray *tj_concarray_create(size_t elemsize);
+
+/**
+ * Create a new concurrent array whose chunks are allocated through the
+ * given allocator.  Appending threads may call it concurrently, so it
+ * must be thread safe.
+ *
+ * \param elemsize Size in bytes of each element, greater than 0.
+ * \param allocator The allocator to use, or NULL for the default.
+ */
+tj_concarray *tj_concarray_createWithAllocator(size_t elemsize,
+                                               const tj_allocator *allocator);
+
+/**
+ * Frees a concurrent array and all of its elements.  No other thread may
+ * be using the array.
+ */
+void tj_concarray_finalize(tj_concarray *array);
+
+/**
+ * Ensure the array can hold at least n elements without allocating.  May
+ * be called concurrently with appends.
+ *
+ * \return 0 on failure, 1 otherwise.
+ */
+int tj_concarray_reserve(tj_concarray *array, size_t n);
+
+/**
+ * Append an element to the array, copying elemsize bytes from item.  Safe
+ * to call from any number of threads.
+ *
+ * If memory for the element's chunk cannot be allocated, its slot can
+ * never be completed, and the count will not advance past it.
+ * tj_concarray_reserve() ahead of time avoids this.
+ *
+ * \return 0 on failure, 1 otherwise.
+ */
+int tj_concarray_append(tj_concarray *array, const void *item);
+
+/**
+ * Returns a snapshot of the number of elements in the array.  All elements
+ * below the count are completely written and may be read with
+ * tj_concarray_get().  Successive calls never return a smaller count.
+ */
+size_t tj_concarray_count(tj_concarray *array);
+
+/**
+ * Returns the address of an element in the array.  The index must be below
+ * a count previously returned by tj_concarray_count().
+ */
+void *tj_concarray_get(const tj_concarray *array, size_t index);
+
+/**
+ * Get one chunk of contiguous elements, as with tj_segarray_getChunk(),
+ * limited to a snapshot count.
+ *
+ * \param count A count previously returned by tj_concarray_count().
+ * \param chunk Number of the chunk, starting from 0.
+ * \param n Set to the number of elements in the chunk.
+ *
+ * \return The first element of the chunk, NULL if the chunk holds no
+ * elements below count.
+ */
+void *tj_concarray_getChunk(const tj_concarray *array, size_t count,
+                            size_t chunk, size_t *n);
@@ -25,8 +25,6 @@
 #include <stdio.h>
 #include <stdarg.h>
 
-#include <utstring.h>
-
 #include "tj_error.h"
 #include "tj_buffer.h"
 
@@ -51,9 +49,11 @@ static const char *k_tj_error_code_label[] =
 //----------------------------------------------------------------------
 //----------------------------------------------------------------------
 struct tj_error {
-  UT_string *m_msg;
+  tj_buffer *m_msg;
 
   tj_error_code m_majorCode;
+
+  const tj_allocator *m_allocator;
 };
 
 
@@ -62,22 +62,14 @@ struct tj_error {
  * This guy is for the case when there isn't even enough memory
  * available to create a tj_error reporting the problem.
  *
- * The commented approach with the static UT_string is feasible, but
- * more susceptible to breakages than the current m_msg = 0 setup,
- * with no real benefit.
+ * A static tj_buffer holding the message is feasible, but more
+ * susceptible to breakages than the current m_msg = 0 setup, with no
+ * real benefit.
  */
 
-// static const UT_string k_noMemoryUTStringHack =
-//   {
-//     .d = "No memory for error.",
-//     .n = 21,
-//     .i = 21,
-//   };
-
 static const char k_noMemoryMessage[] = "No memory for error.";
 static const tj_error k_noMemoryHack =
   {
-    //    .m_msg = (UT_string *) &k_noMemoryUTStringHack,
     .m_msg = 0,
   };
 
@@ -86,23 +78,46 @@ static const tj_error *TJ_ERROR_NO_MEMORY_OBJ = &k_noMemoryHack;
 
 //----------------------------------------------------------------------
 //----------------------------------------------------------------------
-tj_error *
-tj_error_create(tj_error_code code, char *fmt, ...)
+static tj_error *
+tj_error_vacreate(const tj_allocator *allocator,
+                  tj_error_code code, char *fmt, va_list ap)
 {
-  va_list ap;
-
   tj_error *x;
-  if ((x = (tj_error *) malloc(sizeof(tj_error))) == 0) {
+
+  allocator = tj_allocator_orDefault(allocator);
+
+  if ((x = (tj_error *) tj_allocator_alloc(allocator, sizeof(tj_error))) == 0) {
     return (tj_error *) TJ_ERROR_NO_MEMORY_OBJ;
   }
 
+  x->m_allocator = allocator;
   x->m_majorCode =
-    (code <= NUM_TJ_ERROR_CODES) ? code : TJ_ERROR_FAILURE;
+    (code < NUM_TJ_ERROR_CODES) ? code : TJ_ERROR_FAILURE;
+
+  // If the message can't be allocated the error is still returned,
+  // reporting the no memory message.
+  if ((x->m_msg = tj_buffer_createWithAllocator(0, allocator)) != 0) {
+    if (!tj_buffer_printf(x->m_msg, "[%s]: ",
+                          k_tj_error_code_label[x->m_majorCode]) ||
+        !tj_buffer_vaprintf(x->m_msg, fmt, ap)) {
+      tj_buffer_finalize(x->m_msg);
+      x->m_msg = 0;
+    }
+  }
+
+  return x;
+
+  // end tj_error_vacreate
+}
+
+tj_error *
+tj_error_create(tj_error_code code, char *fmt, ...)
+{
+  tj_error *x;
+  va_list ap;
 
-  utstring_new(x->m_msg);
-  utstring_printf(x->m_msg, "[%s]: ", k_tj_error_code_label[x->m_majorCode]);
   va_start(ap,fmt);
-  utstring_printf_va(x->m_msg,fmt,ap);
+  x = tj_error_vacreate(0, code, fmt, ap);
   va_end(ap);
 
   return x;
@@ -110,6 +125,22 @@ tj_error_create(tj_error_code code, char *fmt, ...)
   // end tj_error_create
 }
 
+tj_error *
+tj_error_createWithAllocator(const tj_allocator *allocator,
+                             tj_error_code code, char *fmt, ...)
+{
+  tj_error *x;
+  va_list ap;
+
+  va_start(ap,fmt);
+  x = tj_error_vacreate(allocator, code, fmt, ap);
+  va_end(ap);
+
+  return x;
+
+  // end tj_error_createWithAllocator
+}
+
 void
 tj_error_finalize(tj_error *x)
 {
@@ -117,9 +148,9 @@ tj_error_finalize(tj_error *x)
     return;
 
   if (x->m_msg != 0)
-    utstring_free(x->m_msg);
+    tj_buffer_finalize(x->m_msg);
 
-  free(x);
+  tj_allocator_free(x->m_allocator, x, sizeof(tj_error));
   // end tj_error_finalize
 }
 
@@ -136,9 +167,9 @@ tj_error_appendMessage(tj_error *x, char *fmt, ...)
     return;
   }
 
-  utstring_printf(x->m_msg, "\n[%s]: ", k_tj_error_code_label[x->m_majorCode]);
+  tj_buffer_printf(x->m_msg, "\n[%s]: ", k_tj_error_code_label[x->m_majorCode]);
   va_start(ap,fmt);
-  utstring_printf_va(x->m_msg,fmt,ap);
+  tj_buffer_vaprintf(x->m_msg,fmt,ap);
   va_end(ap);
 
   // end tj_error_appendMessage
@@ -148,7 +179,7 @@ tj_error_appendMessage(tj_error *x, char *fmt, ...)
 const char *
 tj_error_getMessage(tj_error *x)
 {
-  return (x->m_msg == 0) ? k_noMemoryMessage : utstring_body(x->m_msg);
+  return (x->m_msg == 0) ? k_noMemoryMessage : tj_buffer_getAsString(x->m_msg);
   // end tj_error_getMessage
 }
 
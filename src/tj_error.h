@@ -27,6 +27,8 @@
 
 #include <stdio.h>
 
+#include "tj_allocator.h"
+
 //----------------------------------------------------------------------
 //----------------------------------------------------------------------
 #ifndef TJ_DEBUG_STREAM
@@ -77,6 +79,14 @@ typedef struct tj_error tj_error;
 tj_error *
 tj_error_create(tj_error_code code, char *fmt, ...);
 
+/**
+ * As tj_error_create(), but the error and its message are allocated
+ * through the given allocator, or the default allocator if it is 0.
+ */
+tj_error *
+tj_error_createWithAllocator(const tj_allocator *allocator,
+                             tj_error_code code, char *fmt, ...);
+
 void
 tj_error_finalize(tj_error *x);
 
@@ -0,0 +1,274 @@
+/*
+ * Copyright (c) 2013 Bellerophon Mobile, LLC.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <assert.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "tj_filevector.h"
+
+#ifdef UNIT_TESTING
+#   undef assert
+#   define assert(x) mock_assert((int)(x), #x, __FILE__, __LINE__)
+#endif /* UNIT_TESTING */
+
+#define MAGIC 0x56464a54 /* "TJFV" */
+#define VERSION 1
+
+/* The header is padded so the elements start cache line aligned. */
+#define HEADER_SIZE 64
+#define MIN_CAPACITY 16
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t elemsize;
+    uint64_t count;
+    uint64_t checksum;
+    uint32_t clean;
+} header;
+
+struct tj_filevector {
+    int fd;
+    int readonly;
+    size_t elemsize;
+    size_t capacity;
+    size_t mapsize;
+    char *map;
+};
+
+static header *head(const tj_filevector *vector) {
+    return (header *) vector->map;
+}
+
+static char *data(const tj_filevector *vector) {
+    return vector->map + HEADER_SIZE;
+}
+
+/* A word at a time FNV-1a variant, with a final avalanche. */
+static uint64_t checksum(const char *p, size_t len) {
+    uint64_t h = UINT64_C(0xcbf29ce484222325), w;
+    size_t i;
+
+    for (i = 0; i + 8 <= len; i += 8) {
+        memcpy(&w, p + i, 8);
+        h = (h ^ w) * UINT64_C(0x100000001b3);
+    }
+    for (; i < len; i++) {
+        h = (h ^ (unsigned char) p[i]) * UINT64_C(0x100000001b3);
+    }
+
+    h ^= h >> 33;
+    h *= UINT64_C(0xff51afd7ed558ccd);
+    h ^= h >> 33;
+    return h;
+}
+
+/* Maps the file at the given capacity, growing the file if writable. */
+static int remap(tj_filevector *vector, size_t capacity) {
+    if (capacity > (SIZE_MAX - HEADER_SIZE) / vector->elemsize) {
+        return 0;
+    }
+    size_t size = HEADER_SIZE + capacity * vector->elemsize;
+
+    if (!vector->readonly && ftruncate(vector->fd, size) != 0) {
+        return 0;
+    }
+
+    int prot = PROT_READ | (vector->readonly ? 0 : PROT_WRITE);
+    void *map = mmap(NULL, size, prot, MAP_SHARED, vector->fd, 0);
+    if (map == MAP_FAILED) {
+        return 0;
+    }
+
+    if (vector->map != NULL) {
+        munmap(vector->map, vector->mapsize);
+    }
+    vector->map = map;
+    vector->mapsize = size;
+    vector->capacity = capacity;
+    return 1;
+}
+
+static int check(tj_filevector *vector, const header *h, off_t size,
+                 int flags) {
+    if (h->magic != MAGIC || h->version != VERSION ||
+            h->elemsize != vector->elemsize) {
+        return 0;
+    }
+    if (h->count > (size - HEADER_SIZE) / vector->elemsize) {
+        return 0;
+    }
+    if (flags & TJ_FILEVECTOR_VERIFY) {
+        return h->clean && h->checksum == checksum(data(vector),
+                                                   h->count * vector->elemsize);
+    }
+    return 1;
+}
+
+tj_filevector *tj_filevector_open(const char *path, size_t elemsize,
+                                  int flags) {
+    assert(elemsize > 0);
+
+    tj_filevector *vector = calloc(1, sizeof(*vector));
+    if (vector == NULL) {
+        return NULL;
+    }
+    vector->elemsize = elemsize;
+    vector->readonly = (flags & TJ_FILEVECTOR_READONLY) != 0;
+
+    int oflags = vector->readonly ? O_RDONLY : O_RDWR;
+    if (flags & TJ_FILEVECTOR_CREATE) {
+        oflags |= O_CREAT;
+    }
+    if ((vector->fd = open(path, oflags, 0644)) < 0) {
+        free(vector);
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(vector->fd, &st) != 0) {
+        goto error;
+    }
+
+    if (st.st_size == 0) {
+        /* Freshly created. */
+        if (vector->readonly || !remap(vector, MIN_CAPACITY)) {
+            goto error;
+        }
+        header *h = head(vector);
+        h->magic = MAGIC;
+        h->version = VERSION;
+        h->elemsize = elemsize;
+        h->count = 0;
+        h->checksum = checksum(NULL, 0);
+    } else {
+        header h;
+        if (st.st_size < HEADER_SIZE ||
+                pread(vector->fd, &h, sizeof(h), 0) != sizeof(h) ||
+                h.elemsize != elemsize ||
+                !remap(vector, (st.st_size - HEADER_SIZE) / elemsize) ||
+                !check(vector, head(vector), st.st_size, flags)) {
+            goto error;
+        }
+    }
+
+    /* Mark the file in use until it is synced, so a crash is detectable. */
+    if (!vector->readonly) {
+        head(vector)->clean = 0;
+    }
+    return vector;
+
+error:
+    if (vector->map != NULL) {
+        munmap(vector->map, vector->mapsize);
+    }
+    close(vector->fd);
+    free(vector);
+    return NULL;
+}
+
+int tj_filevector_close(tj_filevector *vector) {
+    int res = vector->readonly || tj_filevector_sync(vector);
+
+    munmap(vector->map, vector->mapsize);
+    close(vector->fd);
+    free(vector);
+    return res;
+}
+
+int tj_filevector_sync(tj_filevector *vector) {
+    if (vector->readonly) {
+        return 0;
+    }
+
+    header *h = head(vector);
+    h->checksum = checksum(data(vector), h->count * vector->elemsize);
+    h->clean = 1;
+    return msync(vector->map, vector->mapsize, MS_SYNC) == 0;
+}
+
+size_t tj_filevector_count(const tj_filevector *vector) {
+    return head(vector)->count;
+}
+
+size_t tj_filevector_capacity(const tj_filevector *vector) {
+    return vector->capacity;
+}
+
+void *tj_filevector_data(tj_filevector *vector) {
+    return data(vector);
+}
+
+void *tj_filevector_get(tj_filevector *vector, size_t index) {
+    assert(index < head(vector)->count);
+    return data(vector) + index * vector->elemsize;
+}
+
+int tj_filevector_reserve(tj_filevector *vector, size_t n) {
+    if (n <= vector->capacity) {
+        return 1;
+    }
+    if (vector->readonly) {
+        return 0;
+    }
+
+    size_t capacity = vector->capacity * 2;
+    if (capacity < n) {
+        capacity = n;
+    }
+    return remap(vector, capacity);
+}
+
+void *tj_filevector_append(tj_filevector *vector, const void *item) {
+    size_t count = head(vector)->count;
+    if (vector->readonly || !tj_filevector_reserve(vector, count + 1)) {
+        return NULL;
+    }
+
+    char *p = data(vector) + count * vector->elemsize;
+    if (item != NULL) {
+        memcpy(p, item, vector->elemsize);
+    } else {
+        memset(p, 0, vector->elemsize);
+    }
+
+    header *h = head(vector);
+    h->count = count + 1;
+    h->clean = 0;
+    return p;
+}
+
+void tj_filevector_truncate(tj_filevector *vector, size_t n) {
+    assert(!vector->readonly);
+    assert(n <= head(vector)->count);
+
+    head(vector)->count = n;
+    head(vector)->clean = 0;
+}
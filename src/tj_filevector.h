@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2013 Bellerophon Mobile, LLC.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * \file tj_filevector.h
+ *
+ * Provides a vector of fixed size elements stored in a memory-mapped
+ * file, so that a large array can be reopened by a later process without
+ * being rebuilt or read in.
+ *
+ * The file starts with a small header holding the element size, count,
+ * and a checksum of the elements, followed by the elements themselves.
+ * The file grows by doubling, through ftruncate() and remapping, which
+ * moves the elements in memory; pointers into the vector are only valid
+ * until the next append or reserve.
+ *
+ * The checksum is written by tj_filevector_sync() and
+ * tj_filevector_close().  Opening a file is constant time unless
+ * TJ_FILEVECTOR_VERIFY is given, in which case every element is read to
+ * check it.  Files are in native byte order.
+ */
+
+#pragma once
+
+#include <stddef.h>
+
+/** Create the file if it does not exist. */
+#define TJ_FILEVECTOR_CREATE   0x1
+
+/** Map the file read only; appending and syncing then fail. */
+#define TJ_FILEVECTOR_READONLY 0x2
+
+/**
+ * Refuse files that were not closed or synced cleanly, or whose checksum
+ * does not match.
+ */
+#define TJ_FILEVECTOR_VERIFY   0x4
+
+typedef struct tj_filevector tj_filevector;
+
+/**
+ * Open or create a file-backed vector.
+ *
+ * \param path Path of the file.
+ * \param elemsize Size in bytes of each element, greater than 0.  An
+ * existing file must have been created with the same size.
+ * \param flags A combination of the TJ_FILEVECTOR_ flags.
+ *
+ * \return The vector, NULL if the file could not be opened or is not a
+ * valid vector file.
+ */
+tj_filevector *tj_filevector_open(const char *path, size_t elemsize,
+                                  int flags);
+
+/**
+ * Sync and unmap the vector, and free it.
+ *
+ * \return 0 if the final sync failed, 1 otherwise.  The vector is freed
+ * either way.
+ */
+int tj_filevector_close(tj_filevector *vector);
+
+/**
+ * Write the checksum and flush the vector to disk.
+ *
+ * \return 0 on failure, 1 otherwise.
+ */
+int tj_filevector_sync(tj_filevector *vector);
+
+/** Returns the number of elements in the vector. */
+size_t tj_filevector_count(const tj_filevector *vector);
+
+/** Returns the number of elements the file can hold without growing. */
+size_t tj_filevector_capacity(const tj_filevector *vector);
+
+/** Returns the elements, which are contiguous. */
+void *tj_filevector_data(tj_filevector *vector);
+
+/**
+ * Get a pointer to an element.
+ *
+ * \param index Must be less than tj_filevector_count().
+ */
+void *tj_filevector_get(tj_filevector *vector, size_t index);
+
+/**
+ * Append an element, growing the file if necessary.
+ *
+ * \param item The element to copy in, or NULL to zero it.
+ *
+ * \return A pointer to the new element, NULL on failure.
+ */
+void *tj_filevector_append(tj_filevector *vector, const void *item);
+
+/**
+ * Ensure the file can hold at least n elements.
+ *
+ * \return 0 on failure, 1 otherwise.
+ */
+int tj_filevector_reserve(tj_filevector *vector, size_t n);
+
+/**
+ * Shrink the vector to n elements, keeping the file's size.
+ *
+ * \param n Must not exceed tj_filevector_count().
+ */
+void tj_filevector_truncate(tj_filevector *vector, size_t n);
@@ -26,6 +26,8 @@
 #define __tj_heap_h__
 
 #include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
 
 //----------------------------------------------------------------------
 //----------------------------------------------------------------------
@@ -58,125 +60,942 @@
 /**
  * See documentation in the tj-tools wiki on how to use a tj_heap.
  *           http://code.google.com/p/tj-tools/wiki/tj_heap
+ *
+ * TJ_HEAP_DECL(type, keytype, valuetype, comparator) declares a heap
+ * ordered so that comparator(a, b) is true when a should come out
+ * before b, e.g., a < b for a min heap.  It may go in a header.
+ * TJ_HEAP_IMPL(type) then defines the heap's functions, and must appear
+ * once, in one source file.  The comparator may be a function or a
+ * function-like macro; either way each comparison is expanded inline
+ * in the sift loops rather than called through a pointer, so a static
+ * inline function or macro costs no call at all.
+ *
+ * It is a 4-ary heap: each node has four children, which halves the
+ * depth of a binary heap and puts the children compared at each level
+ * of a pop side by side.
+ *
+ * TJ_HEAP_DECL_ARITY() takes the number of children per node as a
+ * fifth argument.  TJ_HEAP_DECL_SPLIT() also does, and keeps the keys
+ * in an array separate from the values, so sifting only walks keys
+ * through the cache; values are moved but never compared.  That wins
+ * when values are large relative to keys.
+ *
+ * For bulk loading, _buildFrom() replaces the heap's contents with an
+ * array of type##_element in O(n) using Floyd's heapify, and
+ * _addBatch() appends an array, heapifying the whole when the batch is
+ * large relative to the heap.  _popN() extracts up to n elements in
+ * order, _reserve() grows the capacity, and _clear() empties the heap
+ * keeping its capacity.  _replaceTop() swaps the top element for a new
+ * one with a single sift, rather than a pop and an add.
+ *
+ * Node i's children are at arity*i+1 through arity*i+arity, and the
+ * array is offset and aligned so that each set of siblings is aligned
+ * to its combined size, up to TJ_HEAP_ALIGN.  When that size divides
+ * the cache line, as with 4 children of 16 byte elements or 8 of 8
+ * byte keys, comparing the children of a node touches a single line.
  */
 
+#ifndef TJ_HEAP_ALIGN
+#define TJ_HEAP_ALIGN 64
+#endif
+
 #define TJ_HEAP_DECL(type, keytype, valuetype, comparator)              \
+  TJ_HEAP_DECL_ARITY(type, keytype, valuetype, comparator, 4)
+
+#define TJ_HEAP_DECL_ARITY(type, keytype, valuetype, comparator, arity) \
+  TJ_HEAP_STORAGE_INTERLEAVED(type, keytype, valuetype, arity)          \
+  TJ_HEAP_PROTOTYPES(type, keytype, valuetype, comparator, arity)
+
+#define TJ_HEAP_DECL_SPLIT(type, keytype, valuetype, comparator, arity) \
+  TJ_HEAP_STORAGE_SPLIT(type, keytype, valuetype, arity)                \
+  TJ_HEAP_PROTOTYPES(type, keytype, valuetype, comparator, arity)
+
+//----------------------------------------------
+/*
+ * Allocate pad + n elements of size bytes, aligned to TJ_HEAP_ALIGN.
+ */
+static inline void *
+tj_heap_allocAligned(size_t size, size_t pad, size_t n)
+{
+  void *p;
+  if (posix_memalign(&p, TJ_HEAP_ALIGN, size * (pad + n)) != 0)
+    return 0;
+  return p;
+  // end tj_heap_allocAligned
+}
+
+/*
+ * Each layout defines the heap struct and these private helpers, which
+ * the algorithms are written against:
+ *   _keyAt(h, i), _valueAt(h, i)   Read element i.
+ *   _put(h, i, k, v)               Write element i.
+ *   _copy(h, to, from)             Copy element from over element to.
+ *   _resize(h, n)                  Reallocate for n elements.
+ *   _release(h)                    Free the storage.
+ * The arrays are offset by arity-1 elements from their allocations, so
+ * that element arity*i+1 falls at the start of an aligned block.
+ */
+#define TJ_HEAP_STORAGE_INTERLEAVED(type, keytype, valuetype, arity)    \
   typedef struct { keytype m_key;                                       \
                    valuetype m_value;                                   \
                  } type##_element;                                      \
   typedef struct { type##_element *m_array;                             \
                    size_t m_n; size_t m_used;                           \
                  } type;                                                \
-  int (*type##_cmp)(keytype a, keytype b) = &comparator;                \
+  static inline keytype                                                 \
+  type##__keyAt(const type *h, size_t i)                                \
+  {                                                                     \
+    return h->m_array[i].m_key;                                         \
+  }                                                                     \
+  static inline valuetype                                               \
+  type##__valueAt(const type *h, size_t i)                              \
+  {                                                                     \
+    return h->m_array[i].m_value;                                       \
+  }                                                                     \
+  static inline void                                                    \
+  type##__put(type *h, size_t i, keytype k, valuetype v)                \
+  {                                                                     \
+    h->m_array[i].m_key = k;                                            \
+    h->m_array[i].m_value = v;                                          \
+  }                                                                     \
+  static inline void                                                    \
+  type##__copy(type *h, size_t to, size_t from)                         \
+  {                                                                     \
+    h->m_array[to] = h->m_array[from];                                  \
+  }                                                                     \
+  static inline int                                                     \
+  type##__resize(type *h, size_t n)                                     \
+  {                                                                     \
+    type##_element *a;                                                  \
+    if ((a = tj_heap_allocAligned(sizeof(type##_element),               \
+                                  (arity)-1, n)) == 0) {                \
+      TJ_ERROR("Could not allocate " #type "_element[%zu].", n);        \
+      return 0;                                                         \
+    }                                                                   \
+    a += (arity)-1;                                                     \
+    if (h->m_array != 0) {                                              \
+      memcpy(a, h->m_array, sizeof(type##_element) * h->m_used);        \
+      free(h->m_array - ((arity)-1));                                   \
+    }                                                                   \
+    h->m_array = a;                                                     \
+    h->m_n = n;                                                         \
+    return 1;                                                           \
+  }                                                                     \
+  static inline void                                                    \
+  type##__release(type *h)                                              \
+  {                                                                     \
+    if (h->m_array != 0)                                                \
+      free(h->m_array - ((arity)-1));                                   \
+  }
+
+#define TJ_HEAP_STORAGE_SPLIT(type, keytype, valuetype, arity)          \
+  typedef struct { keytype m_key;                                       \
+                   valuetype m_value;                                   \
+                 } type##_element;                                      \
+  typedef struct { keytype *m_keys;                                     \
+                   valuetype *m_values;                                 \
+                   size_t m_n; size_t m_used;                           \
+                 } type;                                                \
+  static inline keytype                                                 \
+  type##__keyAt(const type *h, size_t i)                                \
+  {                                                                     \
+    return h->m_keys[i];                                                \
+  }                                                                     \
+  static inline valuetype                                               \
+  type##__valueAt(const type *h, size_t i)                              \
+  {                                                                     \
+    return h->m_values[i];                                              \
+  }                                                                     \
+  static inline void                                                    \
+  type##__put(type *h, size_t i, keytype k, valuetype v)                \
+  {                                                                     \
+    h->m_keys[i] = k;                                                   \
+    h->m_values[i] = v;                                                 \
+  }                                                                     \
+  static inline void                                                    \
+  type##__copy(type *h, size_t to, size_t from)                         \
+  {                                                                     \
+    h->m_keys[to] = h->m_keys[from];                                    \
+    h->m_values[to] = h->m_values[from];                                \
+  }                                                                     \
+  static inline int                                                     \
+  type##__resize(type *h, size_t n)                                     \
+  {                                                                     \
+    keytype *k;                                                         \
+    valuetype *v;                                                       \
+    if ((k = tj_heap_allocAligned(sizeof(keytype), (arity)-1, n)) == 0) { \
+      TJ_ERROR("Could not allocate " #type " keys[%zu].", n);           \
+      return 0;                                                         \
+    }                                                                   \
+    if ((v = realloc(h->m_values, sizeof(valuetype) * n)) == 0) {       \
+      TJ_ERROR("Could not allocate " #type " values[%zu].", n);         \
+      free(k);                                                          \
+      return 0;                                                         \
+    }                                                                   \
+    k += (arity)-1;                                                     \
+    if (h->m_keys != 0) {                                               \
+      memcpy(k, h->m_keys, sizeof(keytype) * h->m_used);                \
+      free(h->m_keys - ((arity)-1));                                    \
+    }                                                                   \
+    h->m_keys = k;                                                      \
+    h->m_values = v;                                                    \
+    h->m_n = n;                                                         \
+    return 1;                                                           \
+  }                                                                     \
+  static inline void                                                    \
+  type##__release(type *h)                                              \
+  {                                                                     \
+    if (h->m_keys != 0)                                                 \
+      free(h->m_keys - ((arity)-1));                                    \
+    free(h->m_values);                                                  \
+  }
+
+//----------------------------------------------
+/*
+ * The public interface.  The key and value types, arity and comparator
+ * are captured here so that TJ_HEAP_IMPL() needs only the type name.
+ */
+#define TJ_HEAP_PROTOTYPES(type, keytype, valuetype, comparator, arity) \
+  typedef keytype type##_key;                                           \
+  typedef valuetype type##_value;                                       \
+  enum { type##__arity = (arity) };                                     \
+  static inline int                                                     \
+  type##__less(keytype a, keytype b)                                    \
+  {                                                                     \
+    return comparator(a, b);                                            \
+  }                                                                     \
+  type *                                                                \
+  type##_create(int initial);                                           \
+  void                                                                  \
+  type##_finalize(type *x);                                             \
+  int                                                                   \
+  type##_add(type *h, keytype k, valuetype v);                          \
+  int                                                                   \
+  type##_peek(type *h, keytype *k, valuetype *v);                       \
+  int                                                                   \
+  type##_remove(type *h, int index, keytype *k, valuetype *v);          \
+  int                                                                   \
+  type##_pop(type *h, keytype *k, valuetype *v);                        \
+  int                                                                   \
+  type##_replaceTop(type *h, keytype k, valuetype v);                   \
+  int                                                                   \
+  type##_find(type *h, int (*test)(void *h, keytype k, valuetype v),    \
+             void *data);                                               \
+  int                                                                   \
+  type##_reserve(type *h, size_t n);                                    \
+  void                                                                  \
+  type##_clear(type *h);                                                \
+  int                                                                   \
+  type##_buildFrom(type *h, const type##_element *array, size_t n);     \
+  int                                                                   \
+  type##_addBatch(type *h, const type##_element *array, size_t n);      \
+  size_t                                                                \
+  type##_popN(type *h, type##_element *out, size_t n);
+
+//----------------------------------------------
+#define TJ_HEAP_IMPL(type)                                              \
+  static void                                                           \
+  type##__siftUp(type *h, size_t i, type##_key k, type##_value v)       \
+  {                                                                     \
+    while (i > 0) {                                                     \
+      size_t parent = (i-1) / type##__arity;                            \
+      if (!type##__less(k, type##__keyAt(h, parent)))                   \
+        break;                                                          \
+      type##__copy(h, i, parent);                                       \
+      i = parent;                                                       \
+    }                                                                   \
+    type##__put(h, i, k, v);                                            \
+  }                                                                     \
+  static void                                                           \
+  type##__siftDown(type *h, size_t i, type##_key k, type##_value v)     \
+  {                                                                     \
+    size_t child, best, last;                                           \
+    while ((child = type##__arity*i + 1) < h->m_used) {                 \
+      best = child;                                                     \
+      last = (child + type##__arity < h->m_used) ?                      \
+        child + type##__arity : h->m_used;                              \
+      for (child++; child < last; child++)                              \
+        if (type##__less(type##__keyAt(h, child), type##__keyAt(h, best))) \
+          best = child;                                                 \
+      if (!type##__less(type##__keyAt(h, best), k))                     \
+        break;                                                          \
+      type##__copy(h, i, best);                                         \
+      i = best;                                                         \
+    }                                                                   \
+    type##__put(h, i, k, v);                                            \
+  }                                                                     \
   type *                                                                \
   type##_create(int initial)                                            \
   {                                                                     \
     type *t;                                                            \
-    if ((t = malloc(sizeof(type))) == 0) {                              \
+    if ((t = calloc(1, sizeof(type))) == 0) {                           \
       TJ_ERROR("Could not allocate " #type ".");                        \
       return 0;                                                         \
     }                                                                   \
-    if ((t->m_array = malloc(sizeof(type##_element) * initial)) == 0) { \
-      TJ_ERROR("Could not allocate " #type "_element[%d].", initial);   \
+    if (!type##__resize(t, (initial > 0) ? initial : 1)) {              \
       free(t);                                                          \
       return 0;                                                         \
     }                                                                   \
-    t->m_n = initial;                                                   \
-    t->m_used = 0;                                                      \
     return t;                                                           \
   }                                                                     \
   void                                                                  \
   type##_finalize(type *x)                                              \
   {                                                                     \
-    free(x->m_array);                                                   \
+    type##__release(x);                                                 \
     free(x);                                                            \
   }                                                                     \
   int                                                                   \
-  type##_add(type *h, keytype k, valuetype v)                           \
+  type##_add(type *h, type##_key k, type##_value v)                     \
   {                                                                     \
-    if (h->m_used == h->m_n) {                                          \
-      type##_element *oa;                                               \
-      if ((h->m_array = realloc(oa=h->m_array,                          \
-                                sizeof(type##_element) *                \
-                                (h->m_n*2))) == 0) {                    \
-        TJ_ERROR("Could not reallocate " #type "_element[%zu].",        \
-                 h->m_n*2);                                             \
-        h->m_array = oa;                                                \
-        return 0;                                                       \
-      }                                                                 \
-      h->m_n *= 2;                                                      \
-    }                                                                   \
-    size_t newindex = h->m_used, parentindex = h->m_used/2;             \
-    while (newindex>0 && type##_cmp(k,h->m_array[parentindex].m_key)) { \
-      h->m_array[newindex].m_key = h->m_array[parentindex].m_key;       \
-      h->m_array[newindex].m_value = h->m_array[parentindex].m_value;   \
-      newindex = parentindex;                                           \
-      parentindex = newindex/2;                                         \
-    }                                                                   \
-    h->m_array[newindex].m_key = k;                                     \
-    h->m_array[newindex].m_value = v;                                   \
+    if (h->m_used == h->m_n && !type##__resize(h, h->m_n*2))            \
+      return 0;                                                         \
     h->m_used++;                                                        \
+    type##__siftUp(h, h->m_used-1, k, v);                               \
     return 1;                                                           \
   }                                                                     \
   int                                                                   \
-  type##_peek(type *h, keytype *k, valuetype *v)                        \
+  type##_peek(type *h, type##_key *k, type##_value *v)                  \
   {                                                                     \
     if (h->m_used == 0) return 0;                                       \
-    (*k)=h->m_array[0].m_key;                                           \
-    (*v)=h->m_array[0].m_value;                                         \
+    (*k)=type##__keyAt(h, 0);                                           \
+    (*v)=type##__valueAt(h, 0);                                         \
     return 1;                                                           \
   }                                                                     \
   int                                                                   \
-  type##_remove(type *h, int index, keytype *k, valuetype *v)		\
+  type##_remove(type *h, int index, type##_key *k, type##_value *v)     \
   {                                                                     \
-    if (index >= h->m_used || index < 0) return 0;                      \
-    (*k)=h->m_array[index].m_key;                                       \
-    (*v)=h->m_array[index].m_value;                                     \
+    if (index < 0 || index >= h->m_used) return 0;                      \
+    (*k)=type##__keyAt(h, index);                                       \
+    (*v)=type##__valueAt(h, index);                                     \
     h->m_used--;                                                        \
-    h->m_array[index].m_key = h->m_array[h->m_used].m_key;              \
-    h->m_array[index].m_value = h->m_array[h->m_used].m_value;          \
-    if ((index*2)+1 < h->m_used) {					\
-      int root = index, child = (root*2)+1;				\
-      keytype kt;                                                       \
-      valuetype vt;                                                     \
-      do {                                                              \
-        if (child < h->m_used - 1 &&                                    \
-            type##_cmp(h->m_array[child+1].m_key,                       \
-                       h->m_array[child].m_key))                        \
-          child++;                                                      \
-        if (type##_cmp(h->m_array[root].m_key,                          \
-                       h->m_array[child].m_key)) break;                 \
-        kt = h->m_array[root].m_key;                                    \
-        h->m_array[root].m_key = h->m_array[child].m_key;               \
-        h->m_array[child].m_key = kt;                                   \
-        vt = h->m_array[root].m_value;                                  \
-        h->m_array[root].m_value = h->m_array[child].m_value;           \
-        h->m_array[child].m_value = vt;                                 \
-        root = child;                                                   \
-        child = (root*2) + 1;                                           \
-      } while (child < h->m_used);                                      \
-    }                                                                   \
-    return 1;                                                           \
-  }                                                                     \
-  int                                                                   \
-  type##_pop(type *h, keytype *k, valuetype *v)                         \
+    if (index == h->m_used) return 1;                                   \
+    type##_key lk = type##__keyAt(h, h->m_used);                        \
+    type##_value lv = type##__valueAt(h, h->m_used);                    \
+    if (index > 0 &&                                                    \
+        type##__less(lk, type##__keyAt(h, (index-1) / type##__arity)))  \
+      type##__siftUp(h, index, lk, lv);                                 \
+    else                                                                \
+      type##__siftDown(h, index, lk, lv);                               \
+    return 1;                                                           \
+  }                                                                     \
+  int                                                                   \
+  type##_pop(type *h, type##_key *k, type##_value *v)                   \
   {                                                                     \
     return type##_remove(h, 0, k, v);                                   \
   }                                                                     \
   int                                                                   \
-  type##_find(type *h, int (*test)(void *h, keytype k, valuetype v),    \
+  type##_replaceTop(type *h, type##_key k, type##_value v)              \
+  {                                                                     \
+    if (h->m_used == 0) return 0;                                       \
+    type##__siftDown(h, 0, k, v);                                       \
+    return 1;                                                           \
+  }                                                                     \
+  int                                                                   \
+  type##_reserve(type *h, size_t n)                                     \
+  {                                                                     \
+    if (n <= h->m_n) return 1;                                          \
+    return type##__resize(h, n);                                        \
+  }                                                                     \
+  void                                                                  \
+  type##_clear(type *h)                                                 \
+  {                                                                     \
+    h->m_used = 0;                                                      \
+  }                                                                     \
+  /* Floyd's heapify: sift down every parent, from the last one up. */  \
+  static void                                                           \
+  type##__heapify(type *h)                                              \
+  {                                                                     \
+    size_t i = (h->m_used > 1) ? (h->m_used-2) / type##__arity + 1 : 0; \
+    while (i-- > 0)                                                     \
+      type##__siftDown(h, i, type##__keyAt(h, i), type##__valueAt(h, i)); \
+  }                                                                     \
+  int                                                                   \
+  type##_buildFrom(type *h, const type##_element *array, size_t n)      \
+  {                                                                     \
+    size_t i;                                                           \
+    if (!type##_reserve(h, n)) return 0;                                \
+    for (i = 0; i < n; i++)                                             \
+      type##__put(h, i, array[i].m_key, array[i].m_value);              \
+    h->m_used = n;                                                      \
+    type##__heapify(h);                                                 \
+    return 1;                                                           \
+  }                                                                     \
+  int                                                                   \
+  type##_addBatch(type *h, const type##_element *array, size_t n)       \
+  {                                                                     \
+    size_t i, used = h->m_used;                                         \
+    if (used + n > h->m_n &&                                            \
+        !type##_reserve(h, (used + n > h->m_n*2) ? used + n : h->m_n*2)) \
+      return 0;                                                         \
+    if (n < used / 2) {                                                 \
+      for (i = 0; i < n; i++) {                                         \
+        h->m_used++;                                                    \
+        type##__siftUp(h, h->m_used-1, array[i].m_key, array[i].m_value); \
+      }                                                                 \
+    } else {                                                            \
+      for (i = 0; i < n; i++)                                           \
+        type##__put(h, used + i, array[i].m_key, array[i].m_value);     \
+      h->m_used = used + n;                                             \
+      type##__heapify(h);                                               \
+    }                                                                   \
+    return 1;                                                           \
+  }                                                                     \
+  size_t                                                                \
+  type##_popN(type *h, type##_element *out, size_t n)                   \
+  {                                                                     \
+    size_t i;                                                           \
+    for (i = 0; i < n && h->m_used > 0; i++)                            \
+      type##_remove(h, 0, &out[i].m_key, &out[i].m_value);              \
+    return i;                                                           \
+  }                                                                     \
+  int                                                                   \
+  type##_find(type *h, int (*test)(void *h, type##_key k, type##_value v), \
              void *data)                                                \
   {                                                                     \
     int i = 0;                                                          \
     while (i < h->m_used &&                                             \
-           !test(data, h->m_array[i].m_key, h->m_array[i].m_value))     \
+           !test(data, type##__keyAt(h, i), type##__valueAt(h, i)))     \
       i++;                                                              \
     if (i == h->m_used)                                                 \
       return -1;                                                        \
     return i;                                                           \
   }
 
+//----------------------------------------------------------------------
+//----------------------------------------------------------------------
+
+/**
+ * TJ_INDEXED_HEAP_DECL(type, keytype, valuetype, comparator) and
+ * TJ_INDEXED_HEAP_IMPL(type) declare and define a heap, split the same
+ * way as TJ_HEAP_DECL and TJ_HEAP_IMPL, whose elements can be found,
+ * rekeyed and removed after they are added.
+ *
+ * Adding an element hands back a type##_handle for it, which stays
+ * valid until the element is popped or removed; after that it may be
+ * handed out again.  A position map from handles to heap slots makes
+ * _contains() O(1), and _updateKey() and _removeHandle() O(log n),
+ * sifting up or down as the new key requires.
+ *
+ * Values stay put in a table indexed by handle; only keys and handles
+ * move through the 4-ary, cache aligned heap array.
+ */
+
+#define TJ_INDEXED_HEAP_ARITY 4
+
+#define TJ_INDEXED_HEAP_DECL(type, keytype, valuetype, comparator)      \
+  typedef size_t type##_handle;                                         \
+  typedef keytype type##_key;                                           \
+  typedef valuetype type##_value;                                       \
+  typedef struct { keytype m_key;                                       \
+                   size_t m_handle;                                     \
+                 } type##_entry;                                        \
+  typedef struct { valuetype m_value;                                   \
+                   size_t m_pos;                                        \
+                 } type##_slot;                                         \
+  typedef struct { type##_entry *m_heap;                                \
+                   type##_slot *m_slots;                                \
+                   size_t m_n; size_t m_used;                           \
+                   size_t m_top; size_t m_free;                         \
+                 } type;                                                \
+  static inline int                                                     \
+  type##__less(keytype a, keytype b)                                    \
+  {                                                                     \
+    return comparator(a, b);                                            \
+  }                                                                     \
+  type *                                                                \
+  type##_create(int initial);                                           \
+  void                                                                  \
+  type##_finalize(type *x);                                             \
+  size_t                                                                \
+  type##_count(type *h);                                                \
+  int                                                                   \
+  type##_add(type *h, keytype k, valuetype v, type##_handle *handle);   \
+  int                                                                   \
+  type##_peek(type *h, keytype *k, valuetype *v, type##_handle *handle); \
+  int                                                                   \
+  type##_pop(type *h, keytype *k, valuetype *v);                        \
+  int                                                                   \
+  type##_contains(type *h, type##_handle handle);                       \
+  int                                                                   \
+  type##_get(type *h, type##_handle handle, keytype *k, valuetype *v);  \
+  int                                                                   \
+  type##_updateKey(type *h, type##_handle handle, keytype k);           \
+  int                                                                   \
+  type##_removeHandle(type *h, type##_handle handle,                    \
+                      keytype *k, valuetype *v);
+
+//----------------------------------------------
+#define TJ_INDEXED_HEAP_IMPL(type)                                      \
+  static void                                                           \
+  type##__place(type *h, size_t i, type##_entry e)                      \
+  {                                                                     \
+    h->m_heap[i] = e;                                                   \
+    h->m_slots[e.m_handle].m_pos = i;                                   \
+  }                                                                     \
+  static void                                                           \
+  type##__siftUp(type *h, size_t i, type##_entry e)                     \
+  {                                                                     \
+    while (i > 0) {                                                     \
+      size_t parent = (i-1) / TJ_INDEXED_HEAP_ARITY;                    \
+      if (!type##__less(e.m_key, h->m_heap[parent].m_key))              \
+        break;                                                          \
+      type##__place(h, i, h->m_heap[parent]);                           \
+      i = parent;                                                       \
+    }                                                                   \
+    type##__place(h, i, e);                                             \
+  }                                                                     \
+  static void                                                           \
+  type##__siftDown(type *h, size_t i, type##_entry e)                   \
+  {                                                                     \
+    size_t child, best, last;                                           \
+    while ((child = TJ_INDEXED_HEAP_ARITY*i + 1) < h->m_used) {         \
+      best = child;                                                     \
+      last = (child + TJ_INDEXED_HEAP_ARITY < h->m_used) ?              \
+        child + TJ_INDEXED_HEAP_ARITY : h->m_used;                      \
+      for (child++; child < last; child++)                              \
+        if (type##__less(h->m_heap[child].m_key, h->m_heap[best].m_key)) \
+          best = child;                                                 \
+      if (!type##__less(h->m_heap[best].m_key, e.m_key))                \
+        break;                                                          \
+      type##__place(h, i, h->m_heap[best]);                             \
+      i = best;                                                         \
+    }                                                                   \
+    type##__place(h, i, e);                                             \
+  }                                                                     \
+  /* Put e, whose key may have changed, back in order at slot i. */     \
+  static void                                                           \
+  type##__fix(type *h, size_t i, type##_entry e)                        \
+  {                                                                     \
+    if (i > 0 &&                                                        \
+        type##__less(e.m_key,                                           \
+                     h->m_heap[(i-1) / TJ_INDEXED_HEAP_ARITY].m_key))   \
+      type##__siftUp(h, i, e);                                          \
+    else                                                                \
+      type##__siftDown(h, i, e);                                        \
+  }                                                                     \
+  static int                                                            \
+  type##__resize(type *h, size_t n)                                     \
+  {                                                                     \
+    type##_entry *a;                                                    \
+    type##_slot *s;                                                     \
+    if ((a = tj_heap_allocAligned(sizeof(type##_entry),                 \
+                                  TJ_INDEXED_HEAP_ARITY-1, n)) == 0) {  \
+      TJ_ERROR("Could not allocate " #type "_entry[%zu].", n);          \
+      return 0;                                                         \
+    }                                                                   \
+    if ((s = realloc(h->m_slots, sizeof(type##_slot) * n)) == 0) {      \
+      TJ_ERROR("Could not allocate " #type "_slot[%zu].", n);           \
+      free(a);                                                          \
+      return 0;                                                         \
+    }                                                                   \
+    a += TJ_INDEXED_HEAP_ARITY-1;                                       \
+    if (h->m_heap != 0) {                                               \
+      memcpy(a, h->m_heap, sizeof(type##_entry) * h->m_used);           \
+      free(h->m_heap - (TJ_INDEXED_HEAP_ARITY-1));                      \
+    }                                                                   \
+    h->m_heap = a;                                                      \
+    h->m_slots = s;                                                     \
+    h->m_n = n;                                                         \
+    return 1;                                                           \
+  }                                                                     \
+  /* Take element i out of the heap and free its handle. */             \
+  static void                                                           \
+  type##__removeAt(type *h, size_t i, type##_key *k, type##_value *v)   \
+  {                                                                     \
+    size_t handle = h->m_heap[i].m_handle;                              \
+    (*k) = h->m_heap[i].m_key;                                          \
+    (*v) = h->m_slots[handle].m_value;                                  \
+    h->m_used--;                                                        \
+    if (i != h->m_used)                                                 \
+      type##__fix(h, i, h->m_heap[h->m_used]);                          \
+    h->m_slots[handle].m_pos = h->m_free;                               \
+    h->m_free = handle;                                                 \
+  }                                                                     \
+  type *                                                                \
+  type##_create(int initial)                                            \
+  {                                                                     \
+    type *t;                                                            \
+    if ((t = calloc(1, sizeof(type))) == 0) {                           \
+      TJ_ERROR("Could not allocate " #type ".");                        \
+      return 0;                                                         \
+    }                                                                   \
+    t->m_free = (size_t) -1;                                            \
+    if (!type##__resize(t, (initial > 0) ? initial : 1)) {              \
+      free(t);                                                          \
+      return 0;                                                         \
+    }                                                                   \
+    return t;                                                           \
+  }                                                                     \
+  void                                                                  \
+  type##_finalize(type *x)                                              \
+  {                                                                     \
+    free(x->m_heap - (TJ_INDEXED_HEAP_ARITY-1));                        \
+    free(x->m_slots);                                                   \
+    free(x);                                                            \
+  }                                                                     \
+  size_t                                                                \
+  type##_count(type *h)                                                 \
+  {                                                                     \
+    return h->m_used;                                                   \
+  }                                                                     \
+  int                                                                   \
+  type##_add(type *h, type##_key k, type##_value v, type##_handle *handle) \
+  {                                                                     \
+    type##_entry e;                                                     \
+    if (h->m_free != (size_t) -1) {                                     \
+      e.m_handle = h->m_free;                                           \
+      h->m_free = h->m_slots[e.m_handle].m_pos;                         \
+    } else {                                                            \
+      if (h->m_top == h->m_n && !type##__resize(h, h->m_n*2))           \
+        return 0;                                                       \
+      e.m_handle = h->m_top++;                                          \
+    }                                                                   \
+    e.m_key = k;                                                        \
+    h->m_slots[e.m_handle].m_value = v;                                 \
+    h->m_used++;                                                        \
+    type##__siftUp(h, h->m_used-1, e);                                  \
+    if (handle != 0)                                                    \
+      (*handle) = e.m_handle;                                           \
+    return 1;                                                           \
+  }                                                                     \
+  int                                                                   \
+  type##_peek(type *h, type##_key *k, type##_value *v,                  \
+              type##_handle *handle)                                    \
+  {                                                                     \
+    if (h->m_used == 0) return 0;                                       \
+    (*k) = h->m_heap[0].m_key;                                          \
+    (*v) = h->m_slots[h->m_heap[0].m_handle].m_value;                   \
+    if (handle != 0)                                                    \
+      (*handle) = h->m_heap[0].m_handle;                                \
+    return 1;                                                           \
+  }                                                                     \
+  int                                                                   \
+  type##_pop(type *h, type##_key *k, type##_value *v)                   \
+  {                                                                     \
+    if (h->m_used == 0) return 0;                                       \
+    type##__removeAt(h, 0, k, v);                                       \
+    return 1;                                                           \
+  }                                                                     \
+  int                                                                   \
+  type##_contains(type *h, type##_handle handle)                        \
+  {                                                                     \
+    size_t pos;                                                         \
+    if (handle >= h->m_top) return 0;                                   \
+    pos = h->m_slots[handle].m_pos;                                     \
+    return pos < h->m_used && h->m_heap[pos].m_handle == handle;        \
+  }                                                                     \
+  int                                                                   \
+  type##_get(type *h, type##_handle handle, type##_key *k, type##_value *v) \
+  {                                                                     \
+    if (!type##_contains(h, handle)) return 0;                          \
+    (*k) = h->m_heap[h->m_slots[handle].m_pos].m_key;                   \
+    (*v) = h->m_slots[handle].m_value;                                  \
+    return 1;                                                           \
+  }                                                                     \
+  int                                                                   \
+  type##_updateKey(type *h, type##_handle handle, type##_key k)         \
+  {                                                                     \
+    type##_entry e;                                                     \
+    if (!type##_contains(h, handle)) return 0;                          \
+    e.m_key = k;                                                        \
+    e.m_handle = handle;                                                \
+    type##__fix(h, h->m_slots[handle].m_pos, e);                        \
+    return 1;                                                           \
+  }                                                                     \
+  int                                                                   \
+  type##_removeHandle(type *h, type##_handle handle,                    \
+                      type##_key *k, type##_value *v)                   \
+  {                                                                     \
+    if (!type##_contains(h, handle)) return 0;                          \
+    type##__removeAt(h, h->m_slots[handle].m_pos, k, v);                \
+    return 1;                                                           \
+  }
+
+//----------------------------------------------------------------------
+//----------------------------------------------------------------------
+
+/**
+ * TJ_RADIX_HEAP_DECL(type, keytype, valuetype) and
+ * TJ_RADIX_HEAP_IMPL(type) declare and define a min heap for unsigned
+ * integer keys of up to 64 bits that never go below the last key
+ * popped, as with timer deadlines or Dijkstra distances.  Adding a key
+ * smaller than that fails, unless the heap is empty.
+ *
+ * Elements are kept in buckets by the highest bit in which their key
+ * differs from the last key popped: bucket 0 holds keys equal to it,
+ * and bucket b those differing first in bit b-1.  Adding just appends
+ * to a bucket, O(1).  When bucket 0 runs dry, popping finds the lowest
+ * nonempty bucket, makes its minimum the new last key and scatters the
+ * bucket into lower ones.  Each element can only move down, so a pop
+ * costs O(log C) amortized for keys spread over a range of C, and no
+ * keys are compared except in finding a bucket's minimum.
+ *
+ * Elements with equal keys come out in no particular order.  The
+ * initial argument to _create() sizes each bucket when it is first
+ * used; buckets then double as needed.
+ */
+
+#define TJ_RADIX_HEAP_DECL(type, keytype, valuetype)                    \
+  typedef keytype type##_key;                                           \
+  typedef valuetype type##_value;                                       \
+  typedef struct { keytype m_key;                                       \
+                   valuetype m_value;                                   \
+                 } type##_element;                                      \
+  typedef struct { type##_element *m_array;                             \
+                   size_t m_n; size_t m_used;                           \
+                 } type##_bucket;                                       \
+  typedef struct { type##_bucket m_buckets[sizeof(keytype)*8 + 1];      \
+                   keytype m_last;                                      \
+                   size_t m_used;                                       \
+                   size_t m_initial;                                    \
+                 } type;                                                \
+  enum { type##__buckets = sizeof(keytype)*8 + 1 };                     \
+  type *                                                                \
+  type##_create(int initial);                                           \
+  void                                                                  \
+  type##_finalize(type *x);                                             \
+  size_t                                                                \
+  type##_count(type *h);                                                \
+  int                                                                   \
+  type##_add(type *h, keytype k, valuetype v);                          \
+  int                                                                   \
+  type##_peek(type *h, keytype *k, valuetype *v);                       \
+  int                                                                   \
+  type##_pop(type *h, keytype *k, valuetype *v);
+
 //----------------------------------------------
-#define TJ_HEAP_IMPL(type)
+#define TJ_RADIX_HEAP_IMPL(type)                                        \
+  /* One past the highest bit in which k differs from last, or 0. */    \
+  static inline size_t                                                  \
+  type##__bucketOf(type##_key last, type##_key k)                       \
+  {                                                                     \
+    unsigned long long x = (unsigned long long) (k ^ last);             \
+    return (x == 0) ? 0 : 64 - __builtin_clzll(x);                      \
+  }                                                                     \
+  static int                                                            \
+  type##__reserve(type *h, type##_bucket *b, size_t n)                  \
+  {                                                                     \
+    type##_element *a;                                                  \
+    size_t size = (b->m_n > 0) ? b->m_n : h->m_initial;                 \
+    if (n <= b->m_n)                                                    \
+      return 1;                                                         \
+    while (size < n)                                                    \
+      size *= 2;                                                        \
+    if ((a = realloc(b->m_array, sizeof(type##_element) * size)) == 0) { \
+      TJ_ERROR("Could not allocate " #type "_element[%zu].", size);     \
+      return 0;                                                         \
+    }                                                                   \
+    b->m_array = a;                                                     \
+    b->m_n = size;                                                      \
+    return 1;                                                           \
+  }                                                                     \
+  /*                                                                    \
+   * Make sure bucket 0 holds the minimum, scattering the lowest nonempty \
+   * bucket if it does not.  Room in the target buckets is reserved     \
+   * before anything moves, so failing leaves the heap unchanged.       \
+   */                                                                   \
+  static int                                                            \
+  type##__refill(type *h)                                               \
+  {                                                                     \
+    size_t counts[type##__buckets];                                     \
+    type##_bucket *b;                                                   \
+    type##_key min;                                                     \
+    size_t i, j;                                                        \
+    if (h->m_buckets[0].m_used > 0)                                     \
+      return 1;                                                         \
+    for (i = 1; h->m_buckets[i].m_used == 0; i++)                       \
+      ;                                                                 \
+    b = &h->m_buckets[i];                                               \
+    min = b->m_array[0].m_key;                                          \
+    for (j = 1; j < b->m_used; j++)                                     \
+      if (b->m_array[j].m_key < min)                                    \
+        min = b->m_array[j].m_key;                                      \
+    memset(counts, 0, sizeof(size_t) * i);                              \
+    for (j = 0; j < b->m_used; j++)                                     \
+      counts[type##__bucketOf(min, b->m_array[j].m_key)]++;             \
+    for (j = 0; j < i; j++)                                             \
+      if (counts[j] > 0 &&                                              \
+          !type##__reserve(h, &h->m_buckets[j],                         \
+                           h->m_buckets[j].m_used + counts[j]))         \
+        return 0;                                                       \
+    h->m_last = min;                                                    \
+    for (j = 0; j < b->m_used; j++) {                                   \
+      type##_bucket *to =                                               \
+        &h->m_buckets[type##__bucketOf(min, b->m_array[j].m_key)];      \
+      to->m_array[to->m_used++] = b->m_array[j];                        \
+    }                                                                   \
+    b->m_used = 0;                                                      \
+    return 1;                                                           \
+  }                                                                     \
+  type *                                                                \
+  type##_create(int initial)                                            \
+  {                                                                     \
+    type *t;                                                            \
+    if ((t = calloc(1, sizeof(type))) == 0) {                           \
+      TJ_ERROR("Could not allocate " #type ".");                        \
+      return 0;                                                         \
+    }                                                                   \
+    t->m_initial = (initial > 0) ? initial : 1;                         \
+    return t;                                                           \
+  }                                                                     \
+  void                                                                  \
+  type##_finalize(type *x)                                              \
+  {                                                                     \
+    size_t i;                                                           \
+    for (i = 0; i < type##__buckets; i++)                               \
+      free(x->m_buckets[i].m_array);                                    \
+    free(x);                                                            \
+  }                                                                     \
+  size_t                                                                \
+  type##_count(type *h)                                                 \
+  {                                                                     \
+    return h->m_used;                                                   \
+  }                                                                     \
+  int                                                                   \
+  type##_add(type *h, type##_key k, type##_value v)                     \
+  {                                                                     \
+    type##_bucket *b;                                                   \
+    if (h->m_used == 0)                                                 \
+      h->m_last = 0;                                                    \
+    else if (k < h->m_last) {                                           \
+      TJ_ERROR("Key is below the last key popped from " #type ".");     \
+      return 0;                                                         \
+    }                                                                   \
+    b = &h->m_buckets[type##__bucketOf(h->m_last, k)];                  \
+    if (b->m_used == b->m_n && !type##__reserve(h, b, b->m_used+1))     \
+      return 0;                                                         \
+    b->m_array[b->m_used].m_key = k;                                    \
+    b->m_array[b->m_used].m_value = v;                                  \
+    b->m_used++;                                                        \
+    h->m_used++;                                                        \
+    return 1;                                                           \
+  }                                                                     \
+  /*                                                                    \
+   * Peeking only finds the minimum, leaving the buckets and last key   \
+   * alone, so keys between the last popped and the one peeked may     \
+   * still be added.                                                    \
+   */                                                                   \
+  int                                                                   \
+  type##_peek(type *h, type##_key *k, type##_value *v)                  \
+  {                                                                     \
+    type##_bucket *b;                                                   \
+    type##_element *e;                                                  \
+    size_t i, j;                                                        \
+    if (h->m_used == 0) return 0;                                       \
+    for (i = 0; h->m_buckets[i].m_used == 0; i++)                       \
+      ;                                                                 \
+    b = &h->m_buckets[i];                                               \
+    e = &b->m_array[b->m_used-1];                                       \
+    for (j = 0; i > 0 && j < b->m_used - 1; j++)                        \
+      if (b->m_array[j].m_key < e->m_key)                               \
+        e = &b->m_array[j];                                             \
+    (*k) = e->m_key;                                                    \
+    (*v) = e->m_value;                                                  \
+    return 1;                                                           \
+  }                                                                     \
+  int                                                                   \
+  type##_pop(type *h, type##_key *k, type##_value *v)                   \
+  {                                                                     \
+    type##_element *e;                                                  \
+    if (h->m_used == 0 || !type##__refill(h)) return 0;                 \
+    e = &h->m_buckets[0].m_array[--h->m_buckets[0].m_used];             \
+    (*k) = e->m_key;                                                    \
+    (*v) = e->m_value;                                                  \
+    h->m_used--;                                                        \
+    return 1;                                                           \
+  }
+
+//----------------------------------------------------------------------
+//----------------------------------------------------------------------
+
+/**
+ * TJ_TOPK_DECL(type, keytype, valuetype, comparator) and
+ * TJ_TOPK_IMPL(type) declare and define a selector keeping the k
+ * highest ranked elements of a stream, where comparator(a, b) is true
+ * when a ranks below b; with a < b it keeps the k largest keys.
+ *
+ * The elements kept sit in a TJ_HEAP_DECL heap with the lowest ranked
+ * at the top, so once k are held, an element that does not qualify is
+ * turned away with a single comparison against the top, and one that
+ * does replaces it with a single sift.  Memory is fixed at creation.
+ * _drain() hands the elements back highest ranked first.
+ */
+
+#define TJ_TOPK_DECL(type, keytype, valuetype, comparator)              \
+  TJ_HEAP_DECL(type##__heap, keytype, valuetype, comparator)            \
+  typedef type##__heap_element type##_element;                          \
+  typedef struct { type##__heap *m_heap;                                \
+                   size_t m_k;                                          \
+                 } type;                                                \
+  type *                                                                \
+  type##_create(size_t k);                                              \
+  void                                                                  \
+  type##_finalize(type *x);                                             \
+  size_t                                                                \
+  type##_count(type *t);                                                \
+  int                                                                   \
+  type##_offer(type *t, keytype k, valuetype v);                        \
+  int                                                                   \
+  type##_threshold(type *t, keytype *k);                                \
+  size_t                                                                \
+  type##_drain(type *t, type##_element *out);
+
+//----------------------------------------------
+#define TJ_TOPK_IMPL(type)                                              \
+  TJ_HEAP_IMPL(type##__heap)                                            \
+  type *                                                                \
+  type##_create(size_t k)                                               \
+  {                                                                     \
+    type *t;                                                            \
+    if ((t = calloc(1, sizeof(type))) == 0) {                           \
+      TJ_ERROR("Could not allocate " #type ".");                        \
+      return 0;                                                         \
+    }                                                                   \
+    if ((t->m_heap = type##__heap_create((k > 0) ? k : 1)) == 0) {      \
+      free(t);                                                          \
+      return 0;                                                         \
+    }                                                                   \
+    t->m_k = k;                                                         \
+    return t;                                                           \
+  }                                                                     \
+  void                                                                  \
+  type##_finalize(type *x)                                              \
+  {                                                                     \
+    type##__heap_finalize(x->m_heap);                                   \
+    free(x);                                                            \
+  }                                                                     \
+  size_t                                                                \
+  type##_count(type *t)                                                 \
+  {                                                                     \
+    return t->m_heap->m_used;                                           \
+  }                                                                     \
+  /* Returns 1 if the element is kept, 0 if it does not qualify. */     \
+  int                                                                   \
+  type##_offer(type *t, type##__heap_key k, type##__heap_value v)       \
+  {                                                                     \
+    if (t->m_heap->m_used < t->m_k)                                     \
+      return type##__heap_add(t->m_heap, k, v);                         \
+    if (t->m_k == 0 ||                                                  \
+        !type##__heap__less(type##__heap__keyAt(t->m_heap, 0), k))      \
+      return 0;                                                         \
+    return type##__heap_replaceTop(t->m_heap, k, v);                    \
+  }                                                                     \
+  /* The key an element must outrank to be kept, once k are held. */    \
+  int                                                                   \
+  type##_threshold(type *t, type##__heap_key *k)                        \
+  {                                                                     \
+    if (t->m_k == 0 || t->m_heap->m_used < t->m_k) return 0;            \
+    (*k) = type##__heap__keyAt(t->m_heap, 0);                           \
+    return 1;                                                           \
+  }                                                                     \
+  /* Move the elements kept to out, highest ranked first. */            \
+  size_t                                                                \
+  type##_drain(type *t, type##_element *out)                            \
+  {                                                                     \
+    size_t n = t->m_heap->m_used, i = n;                                \
+    while (i-- > 0)                                                     \
+      type##__heap_pop(t->m_heap, &out[i].m_key, &out[i].m_value);      \
+    return n;                                                           \
+  }
 
 #endif // __tj_heap_h__
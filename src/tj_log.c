@@ -22,6 +22,9 @@
  * SOFTWARE.
  */
 
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdarg.h>
@@ -47,8 +50,13 @@ const char *tj_log_level_labels[] =
 struct tj_log_outchannel {
   int m_allocated;
 
+  const tj_allocator *m_allocator;
+
   void *m_data;
 
+  // Lowest level output.
+  tj_log_level m_level;
+
   tj_log_logFunction log;
   tj_log_finalizeFunction finalize;
 
@@ -60,10 +68,74 @@ struct tj_log_outchannel {
 
 //----------------------------------------------------------------------
 //----------------------------------------------------------------------
-void
-tj_log_finalize(void);
+#define TJ_LOG_COMPONENTLENGTH  64
+
+/*
+ * A message buffered for the writer.  Each record's sequence number
+ * says whose turn it is, as in Vyukov's bounded queue: a producer
+ * claiming position p waits for p, the writer reading p waits for p+1,
+ * and freeing it sets p plus the capacity, the next lap's position.
+ */
+typedef struct {
+  size_t m_sequence;
+
+  tj_log_level m_level;
+  const char *m_file;
+  const char *m_func;
+  int m_line;
+
+  // Offset of the error's message after the logged one, or 0.
+  size_t m_errorOffset;
+  tj_error_code m_errorCode;
+
+  char m_component[TJ_LOG_COMPONENTLENGTH];
+  char m_message[TJ_LOG_MAXLENGTH];
+} tj_log_record;
+
+typedef struct {
+  const tj_allocator *m_allocator;
+
+  tj_log_record *m_records;
+  size_t m_mask;
+  tj_log_overflow m_overflow;
+
+  // Next position to claim, contended by producers.
+  size_t m_tail __attribute__((aligned(64)));
+
+  // Next position to read, and dropped messages reported; writer only.
+  size_t m_head __attribute__((aligned(64)));
+  size_t m_reported;
+
+  // Sleepers, set before waiting so the other side knows to signal.
+  int m_sleeping;
+  int m_blocked;
+
+  // Under m_lock.
+  size_t m_done;
+  int m_flushers;
+  int m_stop;
+
+  pthread_mutex_t m_lock;
+  pthread_cond_t m_wake;
+  pthread_cond_t m_space;
+  pthread_cond_t m_flushed;
+  pthread_t m_thread;
+
+  // end tj_log_async
+} tj_log_async;
+
+static tj_log_async *tj_log_asyncRing = 0;
+
+// Logging calls in the midst of using the ring, which stopping awaits.
+static size_t tj_log_asyncUsers = 0;
+
+static size_t tj_log_dropped = 0;
 
+static __thread int tj_log_inWriter = 0;
 
+
+//----------------------------------------------------------------------
+//----------------------------------------------------------------------
 // This is done like this so that you could add the fprintf channel in
 // addition to the logcat channel on Android.
 
@@ -80,6 +152,7 @@ tj_log_outchannel tj_log_fprintfChannel =
   {
     .m_allocated = 0,
     .m_data = 0,
+    .m_level = TJ_LOG_LEVEL_VERBOSE,
     .log = &tj_log_fprintfLog,
     .finalize = &tj_log_fprintfLogFinalize,
     .m_next = 0
@@ -97,6 +170,7 @@ tj_log_outchannel tj_log_logcatChannel =
   {
     .m_allocated = 0,
     .m_data = 0,
+    .m_level = TJ_LOG_LEVEL_VERBOSE,
     .log = &tj_log_logcatLog,
     .finalize = 0,
     .m_next = &tj_log_fprintfChannel,
@@ -110,6 +184,11 @@ tj_log_outchannel *tj_log_channelStack = &tj_log_fprintfChannel;
 
 int tj_log_atexit = 0;
 
+// Every level, as output by the initial channels.
+#define TJ_LOG_LEVELS_ALL  ((1u << (TJ_LOG_LEVEL_OUTPUT + 1)) - 1)
+
+unsigned int tj_log_levelMask = TJ_LOG_LEVELS_ALL;
+
 
 //----------------------------------------------------------------------
 //----------------------------------------------------------------------
@@ -117,22 +196,38 @@ tj_log_outchannel *
 tj_log_outchannel_create(void *data,
                          tj_log_logFunction log,
                          tj_log_finalizeFunction finalize)
+{
+  return tj_log_outchannel_createWithAllocator(0, data, log, finalize);
+  // end tj_log_outchannel_create
+}
+
+tj_log_outchannel *
+tj_log_outchannel_createWithAllocator(const tj_allocator *allocator,
+                                      void *data,
+                                      tj_log_logFunction log,
+                                      tj_log_finalizeFunction finalize)
 {
   tj_log_outchannel *x;
-  if ((x = (tj_log_outchannel *) malloc(sizeof(tj_log_outchannel))) == 0) {
+
+  allocator = tj_allocator_orDefault(allocator);
+
+  if ((x = (tj_log_outchannel *)
+       tj_allocator_alloc(allocator, sizeof(tj_log_outchannel))) == 0) {
     TJ_LOG_CRITICAL("tj_log", "No memory to allocate tj_log_outchannel.");
     return 0;
   }
 
   x->m_allocated = 1;
+  x->m_allocator = allocator;
   x->m_data = data;
+  x->m_level = TJ_LOG_LEVEL_VERBOSE;
   x->log = log;
   x->finalize = finalize;
   x->m_next = 0;
 
   return x;
 
-  // end tj_log_outchannel_finalize
+  // end tj_log_outchannel_createWithAllocator
 }
 
 void
@@ -142,18 +237,33 @@ tj_log_outchannel_finalize(tj_log_outchannel *x)
     x->finalize(x->m_data);
 
   if (x->m_allocated)
-    free(x);
+    tj_allocator_free(x->m_allocator, x, sizeof(tj_log_outchannel));
   // end tj_log_outchannel_finalize
 }
 
 
 //----------------------------------------------------------------------
 //----------------------------------------------------------------------
+static void
+tj_log_updateLevelMask(void)
+{
+  unsigned int mask = 0;
+  tj_log_outchannel *out;
+
+  for (out = tj_log_channelStack; out != 0; out = out->m_next)
+    mask |= TJ_LOG_LEVELS_ALL &
+      (~0u << __atomic_load_n(&out->m_level, __ATOMIC_RELAXED));
+
+  __atomic_store_n(&tj_log_levelMask, mask, __ATOMIC_RELAXED);
+  // end tj_log_updateLevelMask
+}
+
 int
 tj_log_addOutChannel(tj_log_outchannel *out)
 {
   out->m_next = tj_log_channelStack;
   tj_log_channelStack = out;
+  tj_log_updateLevelMask();
 
   if (!tj_log_atexit) {
     atexit(&tj_log_finalize);
@@ -181,6 +291,9 @@ tj_log_removeOutChannel(tj_log_outchannel *out)
 
   if (prev != 0)
     prev->m_next = top->m_next;
+  else
+    tj_log_channelStack = top->m_next;
+  tj_log_updateLevelMask();
 
   tj_log_outchannel_finalize(out);
 
@@ -219,6 +332,8 @@ tj_log_removeLogcatChannel(void)
 void
 tj_log_finalize(void)
 {
+  tj_log_stopAsync();
+
   tj_log_outchannel *next;
   tj_log_outchannel *out = tj_log_channelStack;
   while (out != 0) {
@@ -227,11 +342,365 @@ tj_log_finalize(void)
     out = next;
   }
 
+  tj_log_channelStack = 0;
+  tj_log_updateLevelMask();
   tj_log_atexit = 0;
   // end tj_log_finalize
 }
 
 
+//----------------------------------------------------------------------
+//----------------------------------------------------------------------
+static void
+tj_log_dispatch(tj_log_level level, const char *component,
+                const char *file, const char *func, int line,
+                tj_error *error, const char *msg)
+{
+  tj_log_outchannel *out = tj_log_channelStack;
+  while (out != 0) {
+    if (level >= __atomic_load_n(&out->m_level, __ATOMIC_RELAXED))
+      out->log(out->m_data, level, component, file, func, line, error,
+               msg);
+    out = out->m_next;
+  }
+  // end tj_log_dispatch
+}
+
+/*
+ * Returns the ring if logging asynchronously, other than from the
+ * writer itself, counted as a user until released.
+ */
+static tj_log_async *
+tj_log_asyncAcquire(void)
+{
+  tj_log_async *async;
+
+  if (__atomic_load_n(&tj_log_asyncRing, __ATOMIC_RELAXED) == 0 ||
+      tj_log_inWriter)
+    return 0;
+
+  __atomic_add_fetch(&tj_log_asyncUsers, 1, __ATOMIC_SEQ_CST);
+  if ((async = __atomic_load_n(&tj_log_asyncRing, __ATOMIC_SEQ_CST)) == 0)
+    __atomic_sub_fetch(&tj_log_asyncUsers, 1, __ATOMIC_RELEASE);
+
+  return async;
+  // end tj_log_asyncAcquire
+}
+
+static void
+tj_log_asyncRelease(void)
+{
+  __atomic_sub_fetch(&tj_log_asyncUsers, 1, __ATOMIC_RELEASE);
+  // end tj_log_asyncRelease
+}
+
+static void
+tj_log_asyncPush(tj_log_async *async, tj_log_level level,
+                 const char *component, const char *file, const char *func,
+                 int line, tj_error *error, const char *m, va_list ap)
+{
+  tj_log_record *r;
+  size_t pos, seq;
+  intptr_t diff;
+  int n;
+
+  pos = __atomic_load_n(&async->m_tail, __ATOMIC_RELAXED);
+  for (;;) {
+    r = &async->m_records[pos & async->m_mask];
+    seq = __atomic_load_n(&r->m_sequence, __ATOMIC_ACQUIRE);
+    diff = (intptr_t) seq - (intptr_t) pos;
+
+    if (diff == 0) {
+      if (__atomic_compare_exchange_n(&async->m_tail, &pos, pos + 1, 1,
+                                      __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        break;
+
+    } else if (diff < 0) {
+      // The ring is full, this slot still held from the last lap.
+      if (async->m_overflow == TJ_LOG_OVERFLOW_DROP_COUNT)
+        __atomic_add_fetch(&tj_log_dropped, 1, __ATOMIC_RELAXED);
+      if (async->m_overflow != TJ_LOG_OVERFLOW_BLOCK)
+        return;
+
+      pthread_mutex_lock(&async->m_lock);
+      __atomic_add_fetch(&async->m_blocked, 1, __ATOMIC_SEQ_CST);
+      while ((intptr_t) (__atomic_load_n(&r->m_sequence, __ATOMIC_SEQ_CST) -
+                         pos) < 0)
+        pthread_cond_wait(&async->m_space, &async->m_lock);
+      __atomic_sub_fetch(&async->m_blocked, 1, __ATOMIC_RELAXED);
+      pthread_mutex_unlock(&async->m_lock);
+      pos = __atomic_load_n(&async->m_tail, __ATOMIC_RELAXED);
+
+    } else {
+      pos = __atomic_load_n(&async->m_tail, __ATOMIC_RELAXED);
+    }
+  }
+
+  r->m_level = level;
+  r->m_file = file;
+  r->m_func = func;
+  r->m_line = line;
+  snprintf(r->m_component, TJ_LOG_COMPONENTLENGTH, "%s", component);
+
+  // Leave half the record for the error's message, if there is one.
+  n = vsnprintf(r->m_message,
+                (error == 0) ? TJ_LOG_MAXLENGTH : TJ_LOG_MAXLENGTH / 2,
+                m, ap);
+  if (n < 0)
+    n = 0;
+  else if (n >= TJ_LOG_MAXLENGTH / 2 && error != 0)
+    n = TJ_LOG_MAXLENGTH / 2 - 1;
+
+  r->m_errorOffset = 0;
+  if (error != 0) {
+    // Drop the "[CODE]: " prefix, which recreating the error restores.
+    const char *text = tj_error_getMessage(error);
+    const char *body = strstr(text, "]: ");
+    if (text[0] == '[' && body != 0)
+      text = body + 3;
+
+    r->m_errorOffset = n + 1;
+    r->m_errorCode = tj_error_getCode(error);
+    snprintf(r->m_message + n + 1, TJ_LOG_MAXLENGTH - n - 1, "%s", text);
+  }
+
+  // Publish, then wake the writer if it had already found nothing;
+  // either it sees this record or this sees it sleeping.
+  __atomic_store_n(&r->m_sequence, pos + 1, __ATOMIC_SEQ_CST);
+  if (__atomic_load_n(&async->m_sleeping, __ATOMIC_SEQ_CST)) {
+    pthread_mutex_lock(&async->m_lock);
+    pthread_cond_signal(&async->m_wake);
+    pthread_mutex_unlock(&async->m_lock);
+  }
+
+  // end tj_log_asyncPush
+}
+
+/*
+ * Pass every published record to the channels, first reporting any
+ * newly dropped messages, and return how many were passed.
+ */
+static size_t
+tj_log_asyncDrain(tj_log_async *async)
+{
+  tj_log_record *r;
+  tj_error *error;
+  size_t dropped, n = 0;
+
+  dropped = __atomic_load_n(&tj_log_dropped, __ATOMIC_RELAXED);
+  if (dropped != async->m_reported) {
+    char msg[64];
+    snprintf(msg, sizeof(msg), "Dropped %zu log messages.",
+             dropped - async->m_reported);
+    tj_log_dispatch(TJ_LOG_LEVEL_CRITICAL, "tj_log", __FILE__,
+                    __FUNCTION__, __LINE__, 0, msg);
+    async->m_reported = dropped;
+  }
+
+  for (;;) {
+    r = &async->m_records[async->m_head & async->m_mask];
+    if (__atomic_load_n(&r->m_sequence, __ATOMIC_ACQUIRE) !=
+        async->m_head + 1)
+      break;
+
+    error = 0;
+    if (r->m_errorOffset != 0)
+      error = tj_error_create(r->m_errorCode, "%s",
+                              r->m_message + r->m_errorOffset);
+
+    tj_log_dispatch(r->m_level, r->m_component, r->m_file, r->m_func,
+                    r->m_line, error, r->m_message);
+
+    if (error != 0)
+      tj_error_finalize(error);
+
+    __atomic_store_n(&r->m_sequence, async->m_head + async->m_mask + 1,
+                     __ATOMIC_SEQ_CST);
+    async->m_head++;
+    n++;
+  }
+
+  if (n > 0 && __atomic_load_n(&async->m_blocked, __ATOMIC_SEQ_CST)) {
+    pthread_mutex_lock(&async->m_lock);
+    pthread_cond_broadcast(&async->m_space);
+    pthread_mutex_unlock(&async->m_lock);
+  }
+
+  return n;
+  // end tj_log_asyncDrain
+}
+
+static int
+tj_log_asyncReady(tj_log_async *async)
+{
+  tj_log_record *r = &async->m_records[async->m_head & async->m_mask];
+  return __atomic_load_n(&r->m_sequence, __ATOMIC_SEQ_CST) ==
+    async->m_head + 1;
+  // end tj_log_asyncReady
+}
+
+static void *
+tj_log_asyncWriter(void *arg)
+{
+  tj_log_async *async = (tj_log_async *) arg;
+  size_t n;
+
+  tj_log_inWriter = 1;
+
+  for (;;) {
+    n = tj_log_asyncDrain(async);
+
+    pthread_mutex_lock(&async->m_lock);
+    async->m_done = async->m_head;
+    if (async->m_flushers > 0)
+      pthread_cond_broadcast(&async->m_flushed);
+
+    if (n == 0) {
+      if (async->m_stop) {
+        pthread_mutex_unlock(&async->m_lock);
+        break;
+      }
+
+      __atomic_store_n(&async->m_sleeping, 1, __ATOMIC_SEQ_CST);
+      if (!tj_log_asyncReady(async))
+        pthread_cond_wait(&async->m_wake, &async->m_lock);
+      __atomic_store_n(&async->m_sleeping, 0, __ATOMIC_RELAXED);
+    }
+    pthread_mutex_unlock(&async->m_lock);
+  }
+
+  return 0;
+  // end tj_log_asyncWriter
+}
+
+static void
+tj_log_asyncFinalize(tj_log_async *async)
+{
+  pthread_mutex_destroy(&async->m_lock);
+  pthread_cond_destroy(&async->m_wake);
+  pthread_cond_destroy(&async->m_space);
+  pthread_cond_destroy(&async->m_flushed);
+
+  if (async->m_records != 0)
+    tj_allocator_free(async->m_allocator, async->m_records,
+                      (async->m_mask + 1) * sizeof(tj_log_record));
+  tj_allocator_free(async->m_allocator, async, sizeof(tj_log_async));
+  // end tj_log_asyncFinalize
+}
+
+int
+tj_log_startAsync(size_t capacity, tj_log_overflow overflow)
+{
+  const tj_allocator *allocator = tj_allocator_orDefault(0);
+  tj_log_async *async;
+  size_t size, i;
+
+  if (__atomic_load_n(&tj_log_asyncRing, __ATOMIC_ACQUIRE) != 0) {
+    TJ_ERROR("Asynchronous logging already started.");
+    return 1;
+  }
+
+  if (capacity == 0)
+    capacity = TJ_LOG_ASYNC_CAPACITY;
+  for (size = 2; size < capacity; size *= 2)
+    ;
+
+  if ((async = (tj_log_async *)
+       tj_allocator_calloc(allocator, sizeof(tj_log_async))) == 0) {
+    TJ_ERROR("No memory for tj_log asynchronous ring.");
+    return 1;
+  }
+
+  async->m_allocator = allocator;
+  async->m_mask = size - 1;
+  async->m_overflow = overflow;
+  async->m_reported = __atomic_load_n(&tj_log_dropped, __ATOMIC_RELAXED);
+  pthread_mutex_init(&async->m_lock, 0);
+  pthread_cond_init(&async->m_wake, 0);
+  pthread_cond_init(&async->m_space, 0);
+  pthread_cond_init(&async->m_flushed, 0);
+
+  if ((async->m_records = (tj_log_record *)
+       tj_allocator_alloc(allocator, size * sizeof(tj_log_record))) == 0) {
+    TJ_ERROR("No memory for tj_log asynchronous ring.");
+    tj_log_asyncFinalize(async);
+    return 1;
+  }
+
+  for (i = 0; i < size; i++)
+    async->m_records[i].m_sequence = i;
+
+  if (pthread_create(&async->m_thread, 0, &tj_log_asyncWriter, async) != 0) {
+    TJ_ERROR("Could not start tj_log writer thread.");
+    tj_log_asyncFinalize(async);
+    return 1;
+  }
+
+  if (!tj_log_atexit) {
+    atexit(&tj_log_finalize);
+    tj_log_atexit = 1;
+  }
+
+  __atomic_store_n(&tj_log_asyncRing, async, __ATOMIC_SEQ_CST);
+  return 0;
+
+  // end tj_log_startAsync
+}
+
+void
+tj_log_flush(void)
+{
+  tj_log_async *async;
+  size_t target;
+
+  if ((async = tj_log_asyncAcquire()) == 0)
+    return;
+
+  pthread_mutex_lock(&async->m_lock);
+  target = __atomic_load_n(&async->m_tail, __ATOMIC_RELAXED);
+  async->m_flushers++;
+  pthread_cond_signal(&async->m_wake);
+  while (async->m_done < target)
+    pthread_cond_wait(&async->m_flushed, &async->m_lock);
+  async->m_flushers--;
+  pthread_mutex_unlock(&async->m_lock);
+
+  tj_log_asyncRelease();
+  // end tj_log_flush
+}
+
+void
+tj_log_stopAsync(void)
+{
+  tj_log_async *async;
+
+  if ((async = __atomic_exchange_n(&tj_log_asyncRing, 0,
+                                   __ATOMIC_SEQ_CST)) == 0)
+    return;
+
+  // Calls already using the ring finish with it, the writer still
+  // draining, before it's told to stop.
+  while (__atomic_load_n(&tj_log_asyncUsers, __ATOMIC_SEQ_CST) != 0)
+    sched_yield();
+
+  pthread_mutex_lock(&async->m_lock);
+  async->m_stop = 1;
+  pthread_cond_signal(&async->m_wake);
+  pthread_mutex_unlock(&async->m_lock);
+
+  pthread_join(async->m_thread, 0);
+  tj_log_asyncFinalize(async);
+
+  // end tj_log_stopAsync
+}
+
+size_t
+tj_log_getDropped(void)
+{
+  return __atomic_load_n(&tj_log_dropped, __ATOMIC_RELAXED);
+  // end tj_log_getDropped
+}
+
 //----------------------------------------------------------------------
 //----------------------------------------------------------------------
 void
@@ -240,10 +709,22 @@ tj_log_log(tj_log_level level, const char *component,
            tj_error *error, const char *m, ...)
 {
   tj_buffer *msg = 0;
+  tj_log_async *async;
 
   va_list ap;
+
+  if (!TJ_LOG_ENABLED(level))
+    return;
+
   va_start(ap, m);
 
+  if ((async = tj_log_asyncAcquire()) != 0) {
+    tj_log_asyncPush(async, level, component, file, func, line, error,
+                     m, ap);
+    tj_log_asyncRelease();
+    goto done;
+  }
+
   if ((msg = tj_buffer_create(128)) == 0) {
     TJ_ERROR("No memory for tj_log_log buffer.");
     goto done;
@@ -251,12 +732,8 @@ tj_log_log(tj_log_level level, const char *component,
 
   tj_buffer_vaprintf(msg, m, ap);
 
-  tj_log_outchannel *out = tj_log_channelStack;
-  while (out != 0) {
-    out->log(out->m_data, level, component, file, func, line, error,
-             tj_buffer_getAsString(msg));
-    out = out->m_next;
-  }
+  tj_log_dispatch(level, component, file, func, line, error,
+                  tj_buffer_getAsString(msg));
 
  done:
   if (msg)
@@ -271,6 +748,21 @@ void tj_log_setData(tj_log_outchannel *out, void *data) {
   out->m_data = data;
 }
 
+void
+tj_log_setLevel(tj_log_outchannel *out, tj_log_level level)
+{
+  __atomic_store_n(&out->m_level, level, __ATOMIC_RELAXED);
+  tj_log_updateLevelMask();
+  // end tj_log_setLevel
+}
+
+tj_log_level
+tj_log_getLevel(tj_log_outchannel *out)
+{
+  return __atomic_load_n(&out->m_level, __ATOMIC_RELAXED);
+  // end tj_log_getLevel
+}
+
 //----------------------------------------------------------------------
 //----------------------------------------------------------------------
 void
@@ -44,11 +44,31 @@ typedef enum {
   TJ_LOG_LEVEL_OUTPUT,
 } tj_log_level;
 
+/**
+ * Bit l is set while some channel outputs level l; maintained by the
+ * channel functions, and only read directly through TJ_LOG_ENABLED.
+ */
+extern unsigned int tj_log_levelMask;
+
+/**
+ * Whether any channel outputs the given level.  One load and a test,
+ * so calls at disabled levels cost a predictable branch.
+ */
+#define TJ_LOG_ENABLED(level)                                          \
+  ((__atomic_load_n(&tj_log_levelMask, __ATOMIC_RELAXED) >> (level)) & 1)
+
+/*
+ * The arguments are only evaluated, and the message only formatted,
+ * if some channel outputs the level; level is evaluated twice.  This
+ * remains an expression, for use in comma expressions.
+ */
 #ifndef TJ_LOG_LOG
 #define TJ_LOG_LOG(level, component, e, msg, ...)                      \
-  tj_log_log(level, component,                                         \
-             __FILE__, __FUNCTION__, __LINE__,                         \
-             e, msg, ##__VA_ARGS__)
+  (TJ_LOG_ENABLED(level) ?                                             \
+   tj_log_log(level, component,                                        \
+              __FILE__, __FUNCTION__, __LINE__,                        \
+              e, msg, ##__VA_ARGS__) :                                 \
+   (void) 0)
 #endif
 
 #ifndef TJ_LOG_CRITICAL
@@ -141,6 +161,16 @@ tj_log_outchannel_create(void *data,
                          tj_log_logFunction log,
                          tj_log_finalizeFunction finalize);
 
+/**
+ * As tj_log_outchannel_create(), but the channel is allocated through
+ * the given allocator, or the default allocator if it is 0.
+ */
+tj_log_outchannel *
+tj_log_outchannel_createWithAllocator(const tj_allocator *allocator,
+                                      void *data,
+                                      tj_log_logFunction log,
+                                      tj_log_finalizeFunction finalize);
+
 /**
  * Add a channel through which log messages are output.  Channels
  * stack up, such that the most recently added is the first to be
@@ -176,7 +206,8 @@ tj_log_removeLogcatChannel(void);
 /**
  * The core logging message function.  In general the macros
  * TJ_LOG_VERBOSE, TJ_LOG_LOGIC, TJ_LOG_COMPONENT, and TJ_LOG_CRITICAL
- * should be used instead.
+ * should be used instead.  Messages at levels no channel outputs are
+ * not formatted, but the macros skip the call altogether.
  */
 void tj_log_log(tj_log_level level, const char *component,
                 const char *file, const char *func, int line,
@@ -184,6 +215,81 @@ void tj_log_log(tj_log_level level, const char *component,
 
 void tj_log_setData(tj_log_outchannel *out, void *data);
 
+/**
+ * Set the lowest level a channel outputs; it ignores messages below.
+ * Channels start out outputting every level.  This may be called while
+ * logging, from any one thread at a time.
+ */
+void
+tj_log_setLevel(tj_log_outchannel *out, tj_log_level level);
+
+/** Return the lowest level a channel outputs. */
+tj_log_level
+tj_log_getLevel(tj_log_outchannel *out);
+
+/**
+ * Finalize every output channel, first stopping asynchronous logging
+ * if it is running, leaving the stack empty.  This is registered with
+ * atexit() once a channel is added or asynchronous logging started.
+ */
+void
+tj_log_finalize(void);
+
+
+//----------------------------------------------------------------------
+//----------------------------------------------------------------------
+
+/** The default number of records buffered by asynchronous logging. */
+#define TJ_LOG_ASYNC_CAPACITY  1024
+
+/** What a logging call does when the asynchronous buffer is full. */
+typedef enum {
+  TJ_LOG_OVERFLOW_BLOCK,        // Wait for the writer to make room.
+  TJ_LOG_OVERFLOW_DROP,         // Discard the message.
+  TJ_LOG_OVERFLOW_DROP_COUNT,   // Discard and count it, and log the count.
+} tj_log_overflow;
+
+/**
+ * Switch to asynchronous logging.  Logging calls then format their
+ * message into a record of a bounded, lock-free ring shared by all
+ * threads and return, and a background writer thread passes the
+ * records to the channels in batches.  Messages are truncated to
+ * TJ_LOG_MAXLENGTH, and the file and function names must be static
+ * strings, as __FILE__ and __FUNCTION__ are.
+ *
+ * Channels are then called only from the writer thread, and must not
+ * be added or removed until asynchronous logging is stopped.  Calls
+ * made by channels themselves are output synchronously.
+ *
+ * \param capacity Records buffered, rounded up to a power of two, or 0
+ * for TJ_LOG_ASYNC_CAPACITY.
+ * \param overflow What logging calls do when the buffer is full.
+ * \return 0 on success, 1 otherwise, including if already started.
+ */
+int
+tj_log_startAsync(size_t capacity, tj_log_overflow overflow);
+
+/**
+ * Wait until every message logged before the call has been passed to
+ * the channels.  Returns immediately if not logging asynchronously.
+ */
+void
+tj_log_flush(void);
+
+/**
+ * Return to synchronous logging, first passing every buffered message
+ * to the channels and joining the writer thread.
+ */
+void
+tj_log_stopAsync(void);
+
+/**
+ * Return the number of messages discarded so far under the
+ * TJ_LOG_OVERFLOW_DROP_COUNT policy.
+ */
+size_t
+tj_log_getDropped(void);
+
 //----------------------------------------------------------------------
 //----------------------------------------------------------------------
 
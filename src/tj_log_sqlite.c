@@ -26,7 +26,9 @@
 
 #include <sqlite3.h>
 
+#include "tj_allocator.h"
 #include "tj_log.h"
+#include "tj_log_sqlite.h"
 
 
 #define TJ_LOG_SQLITE_COMPONENT "tj_log_sqlite"
@@ -42,6 +44,7 @@
 //----------------------------------------------------------------------
 typedef struct tj_log_sqlite tj_log_sqlite;
 struct tj_log_sqlite {
+  const tj_allocator *m_allocator;
   sqlite3 *m_db;
   sqlite3_stmt *m_insertStmt;
 };
@@ -61,13 +64,25 @@ tj_log_sqlite_log(void *data,
 tj_log_outchannel *
 tj_log_sqlite_create(const char *dbfile)
 {
+  return tj_log_sqlite_createWithAllocator(0, dbfile);
+  // end tj_log_sqlite_create
+}
 
-  tj_log_sqlite *logger = malloc(sizeof(tj_log_sqlite));
+//----------------------------------------------
+tj_log_outchannel *
+tj_log_sqlite_createWithAllocator(const tj_allocator *allocator,
+                                  const char *dbfile)
+{
+  allocator = tj_allocator_orDefault(allocator);
+
+  tj_log_sqlite *logger = tj_allocator_calloc(allocator,
+                                              sizeof(tj_log_sqlite));
   if (logger == 0) {
     TJ_LOG_CRITICAL(TJ_LOG_SQLITE_COMPONENT,
                     "No memory to allocate tj_log_sqlite.");
     goto error;
   }
+  logger->m_allocator = allocator;
 
   if (dbfile == 0)
     dbfile = TJ_LOG_SQLITE_DEFAULT_DB_FILE;
@@ -105,9 +120,9 @@ tj_log_sqlite_create(const char *dbfile)
   }
 
   tj_log_outchannel *channel =
-    tj_log_outchannel_create(logger,
-                             &tj_log_sqlite_log,
-                             &tj_log_sqlite_finalize);
+    tj_log_outchannel_createWithAllocator(allocator, logger,
+                                          &tj_log_sqlite_log,
+                                          &tj_log_sqlite_finalize);
 
   if (channel != 0)
     return channel;
@@ -119,7 +134,7 @@ tj_log_sqlite_create(const char *dbfile)
 
   return 0;
 
-  // end tj_log_sqlite_create
+  // end tj_log_sqlite_createWithAllocator
 }
 
 //----------------------------------------------
@@ -134,7 +149,7 @@ tj_log_sqlite_finalize(void *x)
   if (data->m_db != 0)
     sqlite3_close(data->m_db);
 
-  free(x);
+  tj_allocator_free(data->m_allocator, data, sizeof(tj_log_sqlite));
   // end tj_log_sqlite_finalize
 }
 
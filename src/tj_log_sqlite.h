@@ -35,4 +35,13 @@
 tj_log_outchannel *
 tj_log_sqlite_create(const char *dbfile);
 
+/**
+ * As tj_log_sqlite_create(), but the channel and its state are
+ * allocated through the given allocator, or the default allocator if
+ * it is 0.  SQLite itself still allocates through its own routines.
+ */
+tj_log_outchannel *
+tj_log_sqlite_createWithAllocator(const tj_allocator *allocator,
+                                  const char *dbfile);
+
 #endif // __tj_log_sqlite_h__
@@ -0,0 +1,257 @@
+/*
+ * Copyright (c) 2013 Bellerophon Mobile, LLC.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+
+#include "tj_allocator.h"
+#include "tj_buffer.h"
+#include "tj_merge.h"
+
+#ifdef UNIT_TESTING
+#   undef assert
+#   define assert(x) mock_assert((int)(x), #x, __FILE__, __LINE__)
+#endif /* UNIT_TESTING */
+
+#define DEFAULT_BATCH 256
+
+typedef struct {
+    tj_merge_read read;
+    void *input;
+
+    /* The current batch, and the next record in it. */
+    tj_merge_record *records;
+    size_t count;
+    size_t pos;
+    int done;
+} input;
+
+struct tj_merge {
+    tj_merge_compare compare;
+    void *data;
+    size_t batch;
+    const tj_allocator *allocator;
+
+    input *inputs;
+    size_t n;
+    size_t capacity;
+
+    /*
+     * The loser tree, with room for treesize inputs: tree[0] is the
+     * winning input, and tree[1] through tree[n-1] the loser at each
+     * internal node.  Input i is the leaf at node n+i, and node j's
+     * parent is j/2.
+     */
+    size_t *tree;
+    size_t treesize;
+
+    /* The tree has been played, and the winner handed out. */
+    int started;
+    int taken;
+};
+
+static void refill(input *in, size_t batch) {
+    in->pos = 0;
+    in->count = in->read(in->input, in->records, batch);
+    in->done = (in->count == 0);
+}
+
+/* Moves an input on to its next record, reading a batch if needed. */
+static void advance(input *in, size_t batch) {
+    if (++in->pos == in->count) {
+        refill(in, batch);
+    }
+}
+
+/* Returns true if input a's record should come out before input b's. */
+static int beats(tj_merge *merge, size_t a, size_t b) {
+    input *x = &merge->inputs[a], *y = &merge->inputs[b];
+    if (x->done || y->done) {
+        return !x->done;
+    }
+    int c = merge->compare(&x->records[x->pos], &y->records[y->pos],
+                           merge->data);
+    return c < 0 || (c == 0 && a < b);
+}
+
+/* Plays the matches below node, recording losers, and returns the winner. */
+static size_t build(tj_merge *merge, size_t node) {
+    if (node >= merge->n) {
+        return node - merge->n;
+    }
+    size_t left = build(merge, 2 * node);
+    size_t right = build(merge, 2 * node + 1);
+    if (beats(merge, left, right)) {
+        merge->tree[node] = right;
+        return left;
+    }
+    merge->tree[node] = left;
+    return right;
+}
+
+/* Reads every input's first batch and plays the initial tournament. */
+static void start(tj_merge *merge) {
+    size_t i;
+    for (i = 0; i < merge->n; i++) {
+        refill(&merge->inputs[i], merge->batch);
+    }
+    merge->tree[0] = build(merge, 1);
+    merge->started = 1;
+}
+
+/* Replaces the winner with its input's next record and replays its path. */
+static void replay(tj_merge *merge) {
+    size_t winner = merge->tree[0];
+    size_t node;
+
+    advance(&merge->inputs[winner], merge->batch);
+    for (node = (winner + merge->n) / 2; node > 0; node /= 2) {
+        if (beats(merge, merge->tree[node], winner)) {
+            size_t loser = winner;
+            winner = merge->tree[node];
+            merge->tree[node] = loser;
+        }
+    }
+    merge->tree[0] = winner;
+}
+
+tj_merge *tj_merge_create(tj_merge_compare compare, void *data, size_t batch) {
+    return tj_merge_createWithAllocator(compare, data, batch, NULL);
+}
+
+tj_merge *tj_merge_createWithAllocator(tj_merge_compare compare, void *data,
+                                       size_t batch,
+                                       const tj_allocator *allocator) {
+    assert(compare != NULL);
+
+    allocator = tj_allocator_orDefault(allocator);
+
+    tj_merge *merge = tj_allocator_calloc(allocator, sizeof(*merge));
+    if (merge == NULL) {
+        return NULL;
+    }
+
+    merge->compare = compare;
+    merge->data = data;
+    merge->batch = (batch > 0) ? batch : DEFAULT_BATCH;
+    merge->allocator = allocator;
+    return merge;
+}
+
+void tj_merge_finalize(tj_merge *merge) {
+    size_t i;
+    for (i = 0; i < merge->n; i++) {
+        tj_allocator_free(merge->allocator, merge->inputs[i].records,
+                          merge->batch * sizeof(tj_merge_record));
+    }
+    tj_allocator_free(merge->allocator, merge->inputs,
+                      merge->capacity * sizeof(input));
+    tj_allocator_free(merge->allocator, merge->tree,
+                      merge->treesize * sizeof(size_t));
+    tj_allocator_free(merge->allocator, merge, sizeof(*merge));
+}
+
+int tj_merge_addInput(tj_merge *merge, tj_merge_read read, void *data) {
+    assert(!merge->started);
+
+    if (merge->n == merge->capacity) {
+        size_t capacity = (merge->capacity > 0) ? merge->capacity * 2 : 8;
+        size_t *tree = tj_allocator_realloc(merge->allocator, merge->tree,
+                                            merge->treesize * sizeof(size_t),
+                                            capacity * sizeof(size_t));
+        if (tree == NULL) {
+            return 0;
+        }
+        merge->tree = tree;
+        merge->treesize = capacity;
+
+        input *inputs = tj_allocator_realloc(merge->allocator, merge->inputs,
+                                             merge->capacity * sizeof(input),
+                                             capacity * sizeof(input));
+        if (inputs == NULL) {
+            return 0;
+        }
+        merge->inputs = inputs;
+        merge->capacity = capacity;
+    }
+
+    input *in = &merge->inputs[merge->n];
+    in->records = tj_allocator_alloc(merge->allocator,
+                                     merge->batch * sizeof(tj_merge_record));
+    if (in->records == NULL) {
+        return 0;
+    }
+    in->read = read;
+    in->input = data;
+    in->count = 0;
+    in->pos = 0;
+    in->done = 0;
+    merge->n++;
+    return 1;
+}
+
+int tj_merge_next(tj_merge *merge, tj_merge_record *record, size_t *index) {
+    if (merge->n == 0) {
+        return 0;
+    }
+
+    if (!merge->started) {
+        start(merge);
+    } else if (merge->taken) {
+        replay(merge);
+    }
+
+    input *in = &merge->inputs[merge->tree[0]];
+    if (in->done) {
+        merge->taken = 0;
+        return 0;
+    }
+
+    *record = in->records[in->pos];
+    if (index != NULL) {
+        *index = merge->tree[0];
+    }
+    merge->taken = 1;
+    return 1;
+}
+
+int tj_merge_toBuffer(tj_merge *merge, tj_buffer *out) {
+    tj_merge_record record;
+    while (tj_merge_next(merge, &record, NULL)) {
+        if (!tj_buffer_append(out, record.data, record.size)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int tj_merge_toFile(tj_merge *merge, FILE *out) {
+    tj_merge_record record;
+    while (tj_merge_next(merge, &record, NULL)) {
+        if (fwrite(record.data, 1, record.size, out) != record.size) {
+            return 0;
+        }
+    }
+    return 1;
+}
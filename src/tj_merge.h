@@ -0,0 +1,131 @@
+/*
+ * Copyright (c) 2013 Bellerophon Mobile, LLC.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * \file tj_merge.h
+ *
+ * Provides an iterator merging any number of sorted input streams into
+ * one sorted stream.
+ *
+ * The inputs are read through callbacks, a batch of records at a time,
+ * and merged with a loser tree: a tournament tree whose internal nodes
+ * hold the loser of each match, so replacing the winner replays only
+ * its path to the root, about log2(K) comparisons per record for K
+ * inputs, against about twice that for a heap's pop and push.
+ *
+ * Records are byte strings of any length, compared by a callback.  The
+ * merge is stable: among records comparing equal, those from inputs
+ * added earlier come first, and each input's own order is kept.  The
+ * merged stream can be pulled a record at a time, or written out whole
+ * to a tj_buffer or a file.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdio.h>
+
+#include "tj_allocator.h"
+#include "tj_buffer.h"
+
+typedef struct tj_merge tj_merge;
+
+/** A record: size bytes at data. */
+typedef struct {
+    const void *data;
+    size_t size;
+} tj_merge_record;
+
+/**
+ * Reads the next records of an input, in order.  The records' data must
+ * stay valid until the next call for the same input.
+ *
+ * \param input The input given to tj_merge_addInput().
+ * \param records Receives up to max records.
+ *
+ * \return The number of records read, 0 at the end of the input.
+ */
+typedef size_t (*tj_merge_read)(void *input, tj_merge_record *records,
+                                size_t max);
+
+/**
+ * Compares two records, returning less than, equal to, or greater than
+ * zero as a sorts before, with, or after b.
+ */
+typedef int (*tj_merge_compare)(const tj_merge_record *a,
+                                const tj_merge_record *b, void *data);
+
+/**
+ * Create a new merge, with no inputs.
+ *
+ * \param compare Orders the records, called with data.
+ * \param batch Number of records read from an input at a time, or 0 for
+ * a default.
+ *
+ * \return The merge, NULL on failure.
+ */
+tj_merge *tj_merge_create(tj_merge_compare compare, void *data, size_t batch);
+
+/** As tj_merge_create(), allocating through allocator. */
+tj_merge *tj_merge_createWithAllocator(tj_merge_compare compare, void *data,
+                                       size_t batch,
+                                       const tj_allocator *allocator);
+
+/** Free the merge.  The inputs are not touched. */
+void tj_merge_finalize(tj_merge *merge);
+
+/**
+ * Add a sorted input.  All inputs must be added before the first record
+ * is taken.
+ *
+ * \return 0 on failure, 1 otherwise.
+ */
+int tj_merge_addInput(tj_merge *merge, tj_merge_read read, void *input);
+
+/**
+ * Get the next record of the merged stream.  Its data stays valid until
+ * the next call.
+ *
+ * \param input If not NULL, receives the index of the record's input,
+ * counting from 0 in the order added.
+ *
+ * \return 0 when all inputs are exhausted, 1 otherwise.
+ */
+int tj_merge_next(tj_merge *merge, tj_merge_record *record, size_t *input);
+
+/**
+ * Append the rest of the merged stream to a buffer, each record's bytes
+ * in turn.
+ *
+ * \return 0 on failure, 1 otherwise.
+ */
+int tj_merge_toBuffer(tj_merge *merge, tj_buffer *out);
+
+/**
+ * Write the rest of the merged stream to a file, each record's bytes in
+ * turn.
+ *
+ * \return 0 on failure, 1 otherwise.
+ */
+int tj_merge_toFile(tj_merge *merge, FILE *out);
@@ -0,0 +1,234 @@
+/*
+ * Copyright (c) 2013 Bellerophon Mobile, LLC.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <assert.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "tj_allocator.h"
+#include "tj_heap.h"
+#include "tj_multiqueue.h"
+
+#ifdef UNIT_TESTING
+#   undef assert
+#   define assert(x) mock_assert((int)(x), #x, __FILE__, __LINE__)
+#endif /* UNIT_TESTING */
+
+#define KEY_LESS(a, b) ((a) < (b))
+
+TJ_HEAP_DECL(mq_heap, uint64_t, void *, KEY_LESS)
+TJ_HEAP_IMPL(mq_heap)
+
+/*
+ * One of the internal heaps, on its own cache line.  The count and top
+ * key are written under the lock but read without it, to choose heaps.
+ */
+typedef struct {
+    int lock;
+    size_t count;
+    uint64_t top;
+    mq_heap *heap;
+} __attribute__((aligned(64))) subheap;
+
+struct tj_multiqueue {
+    const tj_allocator *allocator;
+    size_t n;
+    int choices;
+    subheap *heaps;
+
+    /*
+     * The allocator only promises malloc alignment, so the heaps are
+     * carved out of a block with room to align them to a cache line.
+     */
+    void *block;
+    size_t blocksize;
+};
+
+/* Per thread xorshift state, seeded from the thread's own address. */
+static __thread uint64_t rng;
+
+static size_t pick(size_t n) {
+    if (rng == 0) {
+        rng = (uintptr_t) &rng * 0x9e3779b97f4a7c15ULL | 1;
+    }
+    rng ^= rng << 13;
+    rng ^= rng >> 7;
+    rng ^= rng << 17;
+    return (size_t) ((rng >> 32) * n >> 32);
+}
+
+static int try_lock(subheap *q) {
+    return __atomic_load_n(&q->lock, __ATOMIC_RELAXED) == 0 &&
+        !__atomic_exchange_n(&q->lock, 1, __ATOMIC_ACQUIRE);
+}
+
+static void unlock(subheap *q) {
+    __atomic_store_n(&q->lock, 0, __ATOMIC_RELEASE);
+}
+
+/* Republishes a locked heap's count and top key. */
+static void publish(subheap *q) {
+    uint64_t top = UINT64_MAX;
+    void *value;
+    mq_heap_peek(q->heap, &top, &value);
+    __atomic_store_n(&q->top, top, __ATOMIC_RELAXED);
+    __atomic_store_n(&q->count, q->heap->m_used, __ATOMIC_RELAXED);
+}
+
+tj_multiqueue *tj_multiqueue_create(size_t heaps, int choices) {
+    return tj_multiqueue_createWithAllocator(heaps, choices, NULL);
+}
+
+tj_multiqueue *tj_multiqueue_createWithAllocator(
+    size_t heaps, int choices, const tj_allocator *allocator) {
+    assert(heaps >= 1);
+    assert(choices >= 1);
+
+    allocator = tj_allocator_orDefault(allocator);
+
+    tj_multiqueue *queue = tj_allocator_calloc(allocator, sizeof(*queue));
+    if (queue == NULL) {
+        return NULL;
+    }
+    queue->allocator = allocator;
+
+    queue->blocksize = (heaps + 1) * sizeof(subheap) - 1;
+    if ((queue->block = tj_allocator_alloc(allocator,
+                                           queue->blocksize)) == NULL) {
+        tj_allocator_free(allocator, queue, sizeof(*queue));
+        return NULL;
+    }
+    queue->heaps = (subheap *)
+        (((uintptr_t) queue->block + sizeof(subheap) - 1) &
+         ~(uintptr_t) (sizeof(subheap) - 1));
+
+    for (queue->n = 0; queue->n < heaps; queue->n++) {
+        subheap *q = &queue->heaps[queue->n];
+        q->lock = 0;
+        q->count = 0;
+        q->top = UINT64_MAX;
+        if ((q->heap = mq_heap_create(64)) == NULL) {
+            tj_multiqueue_finalize(queue);
+            return NULL;
+        }
+    }
+
+    queue->choices = choices;
+    return queue;
+}
+
+void tj_multiqueue_finalize(tj_multiqueue *queue) {
+    size_t i;
+    for (i = 0; i < queue->n; i++) {
+        mq_heap_finalize(queue->heaps[i].heap);
+    }
+    tj_allocator_free(queue->allocator, queue->block, queue->blocksize);
+    tj_allocator_free(queue->allocator, queue, sizeof(*queue));
+}
+
+int tj_multiqueue_push(tj_multiqueue *queue, uint64_t key, void *value) {
+    subheap *q;
+    int ok;
+
+    for (;;) {
+        q = &queue->heaps[pick(queue->n)];
+        if (try_lock(q)) {
+            break;
+        }
+        sched_yield();
+    }
+
+    ok = mq_heap_add(q->heap, key, value);
+    publish(q);
+    unlock(q);
+    return ok;
+}
+
+/*
+ * Returns the sampled heap with the smallest top, or NULL if all those
+ * sampled were empty.
+ */
+static subheap *sample(tj_multiqueue *queue) {
+    subheap *best = NULL;
+    int i;
+
+    for (i = 0; i < queue->choices; i++) {
+        subheap *q = &queue->heaps[pick(queue->n)];
+        if (__atomic_load_n(&q->count, __ATOMIC_RELAXED) > 0 &&
+            (best == NULL || __atomic_load_n(&q->top, __ATOMIC_RELAXED) <
+             __atomic_load_n(&best->top, __ATOMIC_RELAXED))) {
+            best = q;
+        }
+    }
+    return best;
+}
+
+/* Returns the nonempty heap with the smallest top, or NULL if none. */
+static subheap *scan(tj_multiqueue *queue) {
+    subheap *best = NULL;
+    size_t i;
+
+    for (i = 0; i < queue->n; i++) {
+        subheap *q = &queue->heaps[i];
+        if (__atomic_load_n(&q->count, __ATOMIC_RELAXED) > 0 &&
+            (best == NULL || __atomic_load_n(&q->top, __ATOMIC_RELAXED) <
+             __atomic_load_n(&best->top, __ATOMIC_RELAXED))) {
+            best = q;
+        }
+    }
+    return best;
+}
+
+int tj_multiqueue_pop(tj_multiqueue *queue, uint64_t *key, void **value) {
+    subheap *q;
+
+    for (;;) {
+        /* Fall back to looking at every heap when the sample was empty. */
+        if ((q = sample(queue)) == NULL && (q = scan(queue)) == NULL) {
+            return 0;
+        }
+
+        if (!try_lock(q)) {
+            sched_yield();
+            continue;
+        }
+
+        /* Another thread may have emptied it since it was sampled. */
+        if (mq_heap_pop(q->heap, key, value)) {
+            publish(q);
+            unlock(q);
+            return 1;
+        }
+        unlock(q);
+    }
+}
+
+size_t tj_multiqueue_count(tj_multiqueue *queue) {
+    size_t i, count = 0;
+    for (i = 0; i < queue->n; i++) {
+        count += __atomic_load_n(&queue->heaps[i].count, __ATOMIC_RELAXED);
+    }
+    return count;
+}
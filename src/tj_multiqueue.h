@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2013 Bellerophon Mobile, LLC.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * \file tj_multiqueue.h
+ *
+ * Provides a concurrent min priority queue, a MultiQueue, which trades
+ * strict ordering for throughput across many threads.
+ *
+ * Elements are spread over a number of internal heaps, each behind its
+ * own lock.  Pushing picks a heap at random.  Popping samples a few
+ * heaps at random and takes the smallest of their minimums, so a pop
+ * returns an element close to, but not necessarily, the global minimum.
+ * Threads only ever try locks, moving on to other heaps when they are
+ * busy, so no thread waits on another.
+ *
+ * Two settings tune the relaxation.  More heaps cut contention, and the
+ * usual choice is two to four per thread; fewer tighten the ordering,
+ * and a single heap gives an exact, if serialized, priority queue.
+ * Sampling more heaps per pop lowers the rank error, the number of
+ * smaller elements passed over, at the cost of reading more of them.
+ * With two choices and c heaps per thread the expected rank error is
+ * O(c * threads), independent of the number of elements.
+ *
+ * Keys are unsigned 64 bit integers, and values opaque pointers.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "tj_allocator.h"
+
+typedef struct tj_multiqueue tj_multiqueue;
+
+/**
+ * Create a new multiqueue.
+ *
+ * \param heaps Number of internal heaps, at least 1.
+ * \param choices Number of heaps sampled per pop, at least 1.
+ *
+ * \return The queue, NULL on failure.
+ */
+tj_multiqueue *tj_multiqueue_create(size_t heaps, int choices);
+
+/**
+ * As tj_multiqueue_create(), allocating the queue through allocator.
+ * The internal TJ_HEAP_DECL heaps still allocate from the C library.
+ */
+tj_multiqueue *tj_multiqueue_createWithAllocator(
+    size_t heaps, int choices, const tj_allocator *allocator);
+
+/** Free the queue.  No other thread may be using it. */
+void tj_multiqueue_finalize(tj_multiqueue *queue);
+
+/**
+ * Add an element.  Safe to call from any number of threads.
+ *
+ * \return 0 on failure, 1 otherwise.
+ */
+int tj_multiqueue_push(tj_multiqueue *queue, uint64_t key, void *value);
+
+/**
+ * Remove an element with a small key, not necessarily the smallest.
+ * Safe to call from any number of threads.
+ *
+ * \return 0 if every heap was seen empty during the call, 1 otherwise.
+ */
+int tj_multiqueue_pop(tj_multiqueue *queue, uint64_t *key, void **value);
+
+/**
+ * Returns the number of elements, which is only a snapshot while other
+ * threads are pushing or popping.
+ */
+size_t tj_multiqueue_count(tj_multiqueue *queue);
@@ -0,0 +1,384 @@
+/*
+ * Copyright (c) 2013 Bellerophon Mobile, LLC.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <assert.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tj_allocator.h"
+#include "tj_quantile.h"
+
+#ifdef UNIT_TESTING
+#   undef assert
+#   define assert(x) mock_assert((int)(x), #x, __FILE__, __LINE__)
+#endif /* UNIT_TESTING */
+
+/* Levels enough for 2^64 values, and the smallest level capacity. */
+#define MAX_LEVELS 64
+#define MIN_WIDTH 8
+
+typedef struct {
+    double value;
+    uint64_t rank;      /* Total weight of this and all smaller values. */
+} entry;
+
+struct tj_quantile {
+    const tj_allocator *allocator;
+    size_t k;
+    uint64_t count;
+    double min;
+    double max;
+    uint64_t rng;
+
+    /*
+     * Level h holds items[start[h]] up to items[start[h+1]], each value
+     * standing for 2^h.  Levels are packed against the end of items,
+     * level 0 lowest and unsorted, the others sorted, and the free space
+     * is below start[0].
+     */
+    int levels;
+    size_t start[MAX_LEVELS + 1];
+    size_t size;
+    double *items;
+
+    /*
+     * capacity[d] is the capacity of the level d below the top, and
+     * budget[n] the total capacity of n levels: when that many values
+     * are held the sketch compacts.
+     */
+    size_t capacity[MAX_LEVELS];
+    size_t budget[MAX_LEVELS + 1];
+
+    /* All values sorted, with their ranks, rebuilt for queries. */
+    entry *view;
+    int stale;
+};
+
+static size_t retained(const tj_quantile *sketch) {
+    return sketch->size - sketch->start[0];
+}
+
+static size_t level_size(const tj_quantile *sketch, int level) {
+    return sketch->start[level + 1] - sketch->start[level];
+}
+
+static int random_bit(tj_quantile *sketch) {
+    sketch->rng ^= sketch->rng << 13;
+    sketch->rng ^= sketch->rng >> 7;
+    sketch->rng ^= sketch->rng << 17;
+    return sketch->rng >> 63;
+}
+
+static int compare_doubles(const void *a, const void *b) {
+    double x = *(const double *) a, y = *(const double *) b;
+    return (x > y) - (x < y);
+}
+
+static int compare_entries(const void *a, const void *b) {
+    return compare_doubles(&((const entry *) a)->value,
+                           &((const entry *) b)->value);
+}
+
+static void add_level(tj_quantile *sketch) {
+    assert(sketch->levels < MAX_LEVELS);
+    sketch->levels++;
+    sketch->start[sketch->levels] = sketch->size;
+}
+
+/*
+ * Halves a level: sorts it, keeps an odd value out, and promotes every
+ * other value of the rest, from a random start, merging them into the
+ * level above.  Then closes the gap left below.
+ */
+static void compact(tj_quantile *sketch, int level) {
+    double *items = sketch->items;
+    size_t i;
+
+    if (level == sketch->levels - 1) {
+        add_level(sketch);
+    }
+
+    size_t a = sketch->start[level];
+    size_t b = sketch->start[level + 1];
+    size_t c = sketch->start[level + 2];
+    if (level == 0) {
+        qsort(items + a, b - a, sizeof(double), &compare_doubles);
+    }
+
+    size_t s = a + ((b - a) & 1);
+    size_t pairs = (b - s) / 2;
+    int offset = random_bit(sketch);
+    for (i = 0; i < pairs; i++) {
+        items[s + i] = items[s + 2 * i + offset];
+    }
+
+    /*
+     * Merge from the bottom up, into the space ending at the level
+     * above's end; the output never overtakes its unread values.
+     */
+    size_t x = s, y = b, out = s + pairs;
+    while (x < s + pairs) {
+        if (y < c && items[y] < items[x]) {
+            items[out++] = items[y++];
+        } else {
+            items[out++] = items[x++];
+        }
+    }
+    sketch->start[level + 1] = s + pairs;
+
+    memmove(items + sketch->start[0] + pairs, items + sketch->start[0],
+            (s - sketch->start[0]) * sizeof(double));
+    for (i = 0; i <= (size_t) level; i++) {
+        sketch->start[i] += pairs;
+    }
+}
+
+/* Compacts the lowest full level until there is room for a value. */
+static void compress(tj_quantile *sketch) {
+    while (retained(sketch) >= sketch->budget[sketch->levels]) {
+        int level = 0;
+        while (level_size(sketch, level) <
+               sketch->capacity[sketch->levels - 1 - level]) {
+            level++;
+        }
+        compact(sketch, level);
+    }
+}
+
+/* Adds a value standing for 2^level values. */
+static void insert(tj_quantile *sketch, int level, double value) {
+    double *items = sketch->items;
+    size_t pos;
+    int i;
+
+    while (sketch->levels <= level) {
+        add_level(sketch);
+    }
+    compress(sketch);
+
+    if (level == 0) {
+        items[--sketch->start[0]] = value;
+        return;
+    }
+
+    /* Shift everything below the insertion point down a slot. */
+    size_t lo = sketch->start[level], hi = sketch->start[level + 1];
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (items[mid] <= value) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    pos = lo;
+    memmove(items + sketch->start[0] - 1, items + sketch->start[0],
+            (pos - sketch->start[0]) * sizeof(double));
+    items[pos - 1] = value;
+    for (i = 0; i <= level; i++) {
+        sketch->start[i]--;
+    }
+}
+
+/* Rebuilds the sorted view, if values have been added since. */
+static void refresh(tj_quantile *sketch) {
+    size_t n = 0;
+    uint64_t rank = 0;
+    int level;
+    size_t i;
+
+    if (!sketch->stale) {
+        return;
+    }
+
+    for (level = 0; level < sketch->levels; level++) {
+        for (i = sketch->start[level]; i < sketch->start[level + 1]; i++) {
+            sketch->view[n].value = sketch->items[i];
+            sketch->view[n].rank = (uint64_t) 1 << level;
+            n++;
+        }
+    }
+    qsort(sketch->view, n, sizeof(entry), &compare_entries);
+    for (i = 0; i < n; i++) {
+        rank += sketch->view[i].rank;
+        sketch->view[i].rank = rank;
+    }
+    sketch->stale = 0;
+}
+
+tj_quantile *tj_quantile_create(size_t k) {
+    return tj_quantile_createWithAllocator(k, NULL);
+}
+
+tj_quantile *tj_quantile_createWithAllocator(size_t k,
+                                             const tj_allocator *allocator) {
+    double width;
+    int d;
+
+    if (k == 0) {
+        k = TJ_QUANTILE_DEFAULT_K;
+    }
+    assert(k >= MIN_WIDTH);
+
+    allocator = tj_allocator_orDefault(allocator);
+
+    tj_quantile *sketch = tj_allocator_calloc(allocator, sizeof(*sketch));
+    if (sketch == NULL) {
+        return NULL;
+    }
+    sketch->allocator = allocator;
+    sketch->k = k;
+    sketch->min = sketch->max = NAN;
+    sketch->rng = 0x2545f4914f6cdd1dULL;
+
+    for (d = 0, width = k; d < MAX_LEVELS; d++, width *= 2.0 / 3) {
+        size_t capacity = (size_t) width + (width > (size_t) width);
+        sketch->capacity[d] = (capacity > MIN_WIDTH) ? capacity : MIN_WIDTH;
+        sketch->budget[d + 1] = sketch->budget[d] + sketch->capacity[d];
+    }
+    sketch->size = sketch->budget[MAX_LEVELS];
+
+    sketch->items = tj_allocator_alloc(allocator,
+                                       sketch->size * sizeof(double));
+    sketch->view = tj_allocator_alloc(allocator,
+                                      sketch->size * sizeof(entry));
+    if (sketch->items == NULL || sketch->view == NULL) {
+        tj_quantile_finalize(sketch);
+        return NULL;
+    }
+
+    sketch->levels = 1;
+    sketch->start[0] = sketch->start[1] = sketch->size;
+    return sketch;
+}
+
+void tj_quantile_finalize(tj_quantile *sketch) {
+    tj_allocator_free(sketch->allocator, sketch->items,
+                      sketch->size * sizeof(double));
+    tj_allocator_free(sketch->allocator, sketch->view,
+                      sketch->size * sizeof(entry));
+    tj_allocator_free(sketch->allocator, sketch, sizeof(*sketch));
+}
+
+void tj_quantile_add(tj_quantile *sketch, double value) {
+    if (isnan(value)) {
+        return;
+    }
+
+    if (sketch->count == 0 || value < sketch->min) {
+        sketch->min = value;
+    }
+    if (sketch->count == 0 || value > sketch->max) {
+        sketch->max = value;
+    }
+    sketch->count++;
+    sketch->stale = 1;
+    insert(sketch, 0, value);
+}
+
+void tj_quantile_merge(tj_quantile *sketch, const tj_quantile *other) {
+    int level;
+    size_t i;
+
+    assert(sketch != other);
+    if (other->count == 0) {
+        return;
+    }
+
+    if (sketch->count == 0 || other->min < sketch->min) {
+        sketch->min = other->min;
+    }
+    if (sketch->count == 0 || other->max > sketch->max) {
+        sketch->max = other->max;
+    }
+    sketch->count += other->count;
+    sketch->stale = 1;
+
+    for (level = other->levels - 1; level >= 0; level--) {
+        for (i = other->start[level]; i < other->start[level + 1]; i++) {
+            insert(sketch, level, other->items[i]);
+        }
+    }
+}
+
+uint64_t tj_quantile_getCount(const tj_quantile *sketch) {
+    return sketch->count;
+}
+
+double tj_quantile_getMin(const tj_quantile *sketch) {
+    return sketch->min;
+}
+
+double tj_quantile_getMax(const tj_quantile *sketch) {
+    return sketch->max;
+}
+
+double tj_quantile_getQuantile(tj_quantile *sketch, double q) {
+    if (sketch->count == 0) {
+        return NAN;
+    }
+    if (q <= 0) {
+        return sketch->min;
+    }
+    if (q >= 1) {
+        return sketch->max;
+    }
+
+    refresh(sketch);
+
+    /* The first value whose rank reaches q of the count. */
+    double target = q * sketch->count;
+    size_t lo = 0, hi = retained(sketch) - 1;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (sketch->view[mid].rank < target) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return sketch->view[lo].value;
+}
+
+double tj_quantile_getRank(tj_quantile *sketch, double value) {
+    if (sketch->count == 0) {
+        return NAN;
+    }
+
+    refresh(sketch);
+
+    /* The rank of the last value at or below the given one. */
+    size_t lo = 0, hi = retained(sketch);
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (sketch->view[mid].value <= value) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return (lo == 0) ? 0 : (double) sketch->view[lo - 1].rank / sketch->count;
+}
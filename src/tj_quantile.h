@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2013 Bellerophon Mobile, LLC.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * \file tj_quantile.h
+ *
+ * Provides a streaming quantile sketch, estimating the quantiles of a
+ * stream of values, such as latency percentiles, in fixed memory.
+ *
+ * It is a KLL sketch (Karnin, Lang and Liberty).  Values are kept in a
+ * stack of compactors, each level's values standing for twice as many
+ * as those of the level below.  When the sketch fills, the lowest full
+ * level is sorted and every other value, from a random start, promoted
+ * to the level above.  Capacities shrink geometrically, by 2/3, going
+ * down from the top level, so the sketch holds about 3k values however
+ * long the stream; all memory is allocated at creation.
+ *
+ * The rank error, as a fraction of the count, is around 1.7/k with high
+ * probability: about 1% for the default k of 200.  Sketches merge, so
+ * streams can be summarized separately, e.g., per thread or per host,
+ * and combined.  The minimum and maximum are tracked exactly.
+ *
+ * A sketch is not thread safe.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "tj_allocator.h"
+
+/** The default accuracy parameter. */
+#define TJ_QUANTILE_DEFAULT_K 200
+
+typedef struct tj_quantile tj_quantile;
+
+/**
+ * Create a new, empty sketch.
+ *
+ * \param k Accuracy parameter, at least 8, or 0 for the default.
+ * Memory grows linearly with k and the error falls as 1/k.
+ *
+ * \return The sketch, NULL on failure.
+ */
+tj_quantile *tj_quantile_create(size_t k);
+
+/** As tj_quantile_create(), allocating through allocator. */
+tj_quantile *tj_quantile_createWithAllocator(size_t k,
+                                             const tj_allocator *allocator);
+
+/** Free the sketch. */
+void tj_quantile_finalize(tj_quantile *sketch);
+
+/** Add a value to the sketch.  NaNs are ignored. */
+void tj_quantile_add(tj_quantile *sketch, double value);
+
+/**
+ * Add everything summarized by another sketch, which is unchanged.  The
+ * sketches need not have the same k; the result's error is at most that
+ * of the less accurate.
+ */
+void tj_quantile_merge(tj_quantile *sketch, const tj_quantile *other);
+
+/** Returns the number of values added, including through merges. */
+uint64_t tj_quantile_getCount(const tj_quantile *sketch);
+
+/** Returns the smallest value added, NaN if none. */
+double tj_quantile_getMin(const tj_quantile *sketch);
+
+/** Returns the largest value added, NaN if none. */
+double tj_quantile_getMax(const tj_quantile *sketch);
+
+/**
+ * Estimate a quantile: the value with about q of the values at or below
+ * it, e.g., 0.99 for the 99th percentile.  Quantiles 0 and 1 give the
+ * exact minimum and maximum.
+ *
+ * \return The estimate, NaN if the sketch is empty.
+ */
+double tj_quantile_getQuantile(tj_quantile *sketch, double q);
+
+/**
+ * Estimate the fraction of the values at or below a value.
+ *
+ * \return The estimate, from 0 to 1, NaN if the sketch is empty.
+ */
+double tj_quantile_getRank(tj_quantile *sketch, double value);
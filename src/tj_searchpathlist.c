@@ -63,6 +63,7 @@ struct tj_searchpathlist_entry {
 
 struct tj_searchpathlist {
   tj_searchpathlist_entry *m_list;
+  const tj_allocator *m_allocator;
 };
 
 
@@ -70,18 +71,29 @@ struct tj_searchpathlist {
 //----------------------------------------------------------------------
 tj_searchpathlist *
 tj_searchpathlist_create(void)
+{
+  return tj_searchpathlist_createWithAllocator(0);
+  // end tj_searchpathlist_create
+}
+
+tj_searchpathlist *
+tj_searchpathlist_createWithAllocator(const tj_allocator *allocator)
 {
   TJ_LOG("Create.");
   tj_searchpathlist *x;
-  if ((x = malloc(sizeof(tj_searchpathlist))) == 0) {
+
+  allocator = tj_allocator_orDefault(allocator);
+
+  if ((x = tj_allocator_alloc(allocator, sizeof(tj_searchpathlist))) == 0) {
     TJ_ERROR("Could not malloc tj_searchpathlist.");
     return 0;
   }
 
   x->m_list = 0;
+  x->m_allocator = allocator;
 
   return x;
-  // end tj_searchpathlist_create
+  // end tj_searchpathlist_createWithAllocator
 }
 
 void
@@ -92,11 +104,11 @@ tj_searchpathlist_finalize(tj_searchpathlist *x)
   while ((e = x->m_list) != 0) {
     x->m_list = x->m_list->next;
     TJ_LOG("  %s", e->m_path);
-    free(e->m_path);
-    free(e);
+    tj_allocator_freeString(x->m_allocator, e->m_path);
+    tj_allocator_free(x->m_allocator, e, sizeof(tj_searchpathlist_entry));
   }
 
-  free(x);
+  tj_allocator_free(x->m_allocator, x, sizeof(tj_searchpathlist));
   // end tj_searchpathlist_finalize
 }
 
@@ -107,14 +119,15 @@ tj_searchpathlist_add(tj_searchpathlist *x, const char *path)
 
   tj_searchpathlist_entry *e;
 
-  if ((e = malloc(sizeof(tj_searchpathlist_entry))) == 0) {
+  if ((e = tj_allocator_alloc(x->m_allocator,
+                              sizeof(tj_searchpathlist_entry))) == 0) {
     TJ_ERROR("Could not allocate tj_searchpathlist_entry.");
     return 0;
   }
 
-  if ((e->m_path = strdup(path)) == 0) {
+  if ((e->m_path = tj_allocator_strdup(x->m_allocator, path)) == 0) {
     TJ_ERROR("Could not strdup tj_searchpathlist_entry path.");
-    free(e);
+    tj_allocator_free(x->m_allocator, e, sizeof(tj_searchpathlist_entry));
     return 0;
   }
 
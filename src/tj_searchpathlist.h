@@ -25,11 +25,15 @@
 #ifndef __tj_searchpathlist_h__
 #define __tj_searchpathlist_h__
 
+#include "tj_allocator.h"
+
 //--------------------------------------------------------------
 typedef struct tj_searchpathlist tj_searchpathlist;
 
 tj_searchpathlist *
 tj_searchpathlist_create(void);
+tj_searchpathlist *
+tj_searchpathlist_createWithAllocator(const tj_allocator *allocator);
 void
 tj_searchpathlist_finalize(tj_searchpathlist *x);
 
@@ -0,0 +1,172 @@
+/*
+ * Copyright (c) 2013 Bellerophon Mobile, LLC.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tj_allocator.h"
+#include "tj_segarray.h"
+
+#ifdef UNIT_TESTING
+#   undef assert
+#   define assert(x) mock_assert((int)(x), #x, __FILE__, __LINE__)
+#endif /* UNIT_TESTING */
+
+/* Chunk k holds FIRST_CHUNK << k elements. */
+#define FIRST_CHUNK_BITS 4
+#define FIRST_CHUNK ((size_t)1 << FIRST_CHUNK_BITS)
+#define MAX_CHUNKS (sizeof(size_t) * 8 - FIRST_CHUNK_BITS)
+
+struct tj_segarray {
+    size_t elemsize;
+    size_t count;
+    size_t chunks;
+    const tj_allocator *allocator;
+
+    char *chunk[MAX_CHUNKS];
+};
+
+static size_t chunk_size(size_t chunk) {
+    return FIRST_CHUNK << chunk;
+}
+
+static void locate(size_t index, size_t *chunk, size_t *offset) {
+    size_t v = index + FIRST_CHUNK;
+    size_t bit = sizeof(unsigned long long) * 8 - 1 - __builtin_clzll(v);
+    *chunk = bit - FIRST_CHUNK_BITS;
+    *offset = v - ((size_t)1 << bit);
+}
+
+tj_segarray *tj_segarray_create(size_t elemsize) {
+    return tj_segarray_createWithAllocator(elemsize, NULL);
+}
+
+tj_segarray *tj_segarray_createWithAllocator(size_t elemsize,
+                                             const tj_allocator *allocator) {
+    assert(elemsize > 0);
+
+    allocator = tj_allocator_orDefault(allocator);
+
+    tj_segarray *array = tj_allocator_calloc(allocator, sizeof(*array));
+    if (array == NULL) {
+        return NULL;
+    }
+
+    array->elemsize = elemsize;
+    array->allocator = allocator;
+    return array;
+}
+
+void tj_segarray_finalize(tj_segarray *array) {
+    size_t i;
+    for (i = 0; i < array->chunks; i++) {
+        tj_allocator_free(array->allocator, array->chunk[i],
+                          chunk_size(i) * array->elemsize);
+    }
+    tj_allocator_free(array->allocator, array, sizeof(*array));
+}
+
+size_t tj_segarray_count(const tj_segarray *array) {
+    return array->count;
+}
+
+size_t tj_segarray_capacity(const tj_segarray *array) {
+    return FIRST_CHUNK * (((size_t)1 << array->chunks) - 1);
+}
+
+void *tj_segarray_get(const tj_segarray *array, size_t index) {
+    assert(index < array->count);
+
+    size_t chunk, offset;
+    locate(index, &chunk, &offset);
+    return array->chunk[chunk] + offset * array->elemsize;
+}
+
+static int add_chunk(tj_segarray *array) {
+    if (array->chunks == MAX_CHUNKS) {
+        return 0;
+    }
+
+    char *chunk = tj_allocator_alloc(array->allocator,
+                                     chunk_size(array->chunks) *
+                                     array->elemsize);
+    if (chunk == NULL) {
+        return 0;
+    }
+    array->chunk[array->chunks] = chunk;
+    array->chunks += 1;
+    return 1;
+}
+
+void *tj_segarray_append(tj_segarray *array, const void *item) {
+    if (array->count == tj_segarray_capacity(array) && !add_chunk(array)) {
+        return NULL;
+    }
+
+    array->count += 1;
+    void *elem = tj_segarray_get(array, array->count - 1);
+    if (item != NULL) {
+        memcpy(elem, item, array->elemsize);
+    } else {
+        memset(elem, 0, array->elemsize);
+    }
+    return elem;
+}
+
+int tj_segarray_reserve(tj_segarray *array, size_t n) {
+    while (tj_segarray_capacity(array) < n) {
+        if (!add_chunk(array)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+void tj_segarray_popBack(tj_segarray *array) {
+    assert(array->count > 0);
+    array->count -= 1;
+}
+
+void tj_segarray_clear(tj_segarray *array) {
+    array->count = 0;
+}
+
+void *tj_segarray_getChunk(const tj_segarray *array, size_t chunk, size_t *n) {
+    *n = 0;
+    if (chunk >= MAX_CHUNKS || chunk >= array->chunks) {
+        return NULL;
+    }
+
+    size_t start = FIRST_CHUNK * (((size_t)1 << chunk) - 1);
+    if (start >= array->count) {
+        return NULL;
+    }
+
+    *n = array->count - start;
+    if (*n > chunk_size(chunk)) {
+        *n = chunk_size(chunk);
+    }
+    return array->chunk[chunk];
+}
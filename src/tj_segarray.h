@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) 2013 Bellerophon Mobile, LLC.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * \file tj_segarray.h
+ *
+ * Provides a dynamically expanding array of fixed size elements whose
+ * addresses never change.
+ *
+ * Elements are stored in chunks that double in size, located through a
+ * fixed table of chunk pointers.  Growing allocates one new chunk and
+ * never copies, so pointers to elements remain valid until the element is
+ * popped or the array is cleared or finalized, and the worst case append
+ * does not stall while a huge array is reallocated.  Indexed access is a
+ * couple of shifts.
+ */
+
+#pragma once
+
+#include <stddef.h>
+
+#include "tj_allocator.h"
+
+typedef struct tj_segarray tj_segarray;
+
+/**
+ * Create a new segmented array.
+ *
+ * \param elemsize Size in bytes of each element, greater than 0.
+ */
+tj_segarray *tj_segarray_create(size_t elemsize);
+
+/**
+ * Create a new segmented array whose chunks are allocated through the
+ * given allocator.
+ *
+ * \param elemsize Size in bytes of each element, greater than 0.
+ * \param allocator The allocator to use, or NULL for the default.
+ */
+tj_segarray *tj_segarray_createWithAllocator(size_t elemsize,
+                                             const tj_allocator *allocator);
+
+/** Frees a segmented array and all of its elements. */
+void tj_segarray_finalize(tj_segarray *array);
+
+/** Returns the number of elements in the array. */
+size_t tj_segarray_count(const tj_segarray *array);
+
+/** Returns the number of elements the array can hold without allocating. */
+size_t tj_segarray_capacity(const tj_segarray *array);
+
+/** Returns the address of an element in the array. */
+void *tj_segarray_get(const tj_segarray *array, size_t index);
+
+/**
+ * Append an element to the array, copying elemsize bytes from item.
+ *
+ * \param item The element to copy, or NULL to zero the new element.
+ *
+ * \return The address of the new element, NULL on failure.
+ */
+void *tj_segarray_append(tj_segarray *array, const void *item);
+
+/**
+ * Ensure the array can hold at least n elements without allocating.
+ *
+ * \return 0 on failure, 1 otherwise.
+ */
+int tj_segarray_reserve(tj_segarray *array, size_t n);
+
+/** Removes the last element of the array. */
+void tj_segarray_popBack(tj_segarray *array);
+
+/** Removes all elements from the array, keeping the memory. */
+void tj_segarray_clear(tj_segarray *array);
+
+/**
+ * Get one chunk of contiguous elements, for scanning the array without
+ * per-element index calculations.
+ *
+ * \code{.c}
+ * size_t chunk, i, n;
+ * int *values;
+ * for (chunk = 0; (values = tj_segarray_getChunk(a, chunk, &n)); chunk++) {
+ *     for (i = 0; i < n; i++) {
+ *         sum += values[i];
+ *     }
+ * }
+ * \endcode
+ *
+ * \param chunk Number of the chunk, starting from 0.
+ * \param n Set to the number of elements in the chunk.
+ *
+ * \return The first element of the chunk, NULL if the chunk holds no
+ * elements.
+ */
+void *tj_segarray_getChunk(const tj_segarray *array, size_t chunk, size_t *n);
@@ -0,0 +1,401 @@
+/*
+ * Copyright (c) 2013 Bellerophon Mobile, LLC.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tj_slab.h"
+
+#ifdef UNIT_TESTING
+#   undef assert
+#   define assert(x) mock_assert((int)(x), #x, __FILE__, __LINE__)
+#endif /* UNIT_TESTING */
+
+#define MIN_SLAB_SIZE 4096
+#define MIN_PER_SLAB 8
+#define MAGAZINE_SIZE 64
+
+/*
+ * Each slab starts with this header, followed by its objects.  A slab is
+ * on the partial list whenever it has a free object.  Objects past
+ * carved have never been handed out, and are not on the free list yet.
+ */
+typedef struct page page;
+struct page {
+    tj_slab *owner;
+    page *prev;
+    page *next;
+    page *prevPartial;
+    page *nextPartial;
+    void *free;
+    size_t used;
+    size_t carved;
+};
+
+#define PAGE_HEADER ((sizeof(page) + 15) & ~(size_t)15)
+
+typedef struct magazine magazine;
+struct magazine {
+    tj_slab *slab;
+    magazine *prev;
+    magazine *next;
+    size_t count;
+    void *objs[MAGAZINE_SIZE];
+};
+
+struct tj_slab {
+    size_t objsize;
+    size_t slabsize;
+    size_t perslab;
+    int flags;
+
+    pthread_mutex_t lock;
+    pthread_key_t key;
+
+    page *all;
+    page *partial;
+    page *empty;
+    size_t slabs;
+    size_t used;
+
+    magazine *magazines;
+};
+
+static void lock(tj_slab *slab) {
+    if (slab->flags & TJ_SLAB_LOCKED) {
+        pthread_mutex_lock(&slab->lock);
+    }
+}
+
+static void unlock(tj_slab *slab) {
+    if (slab->flags & TJ_SLAB_LOCKED) {
+        pthread_mutex_unlock(&slab->lock);
+    }
+}
+
+//----------------------------------------------------------------------
+// Slabs, called with the lock held
+//----------------------------------------------------------------------
+
+static void partial_push(tj_slab *slab, page *p) {
+    p->prevPartial = NULL;
+    p->nextPartial = slab->partial;
+    if (slab->partial != NULL) {
+        slab->partial->prevPartial = p;
+    }
+    slab->partial = p;
+}
+
+static void partial_remove(tj_slab *slab, page *p) {
+    if (p->prevPartial != NULL) {
+        p->prevPartial->nextPartial = p->nextPartial;
+    } else {
+        slab->partial = p->nextPartial;
+    }
+    if (p->nextPartial != NULL) {
+        p->nextPartial->prevPartial = p->prevPartial;
+    }
+}
+
+static page *page_new(tj_slab *slab) {
+    void *mem;
+    if (posix_memalign(&mem, slab->slabsize, slab->slabsize) != 0) {
+        return NULL;
+    }
+
+    page *p = mem;
+    p->owner = slab;
+    p->free = NULL;
+    p->used = 0;
+    p->carved = 0;
+
+    p->prev = NULL;
+    p->next = slab->all;
+    if (slab->all != NULL) {
+        slab->all->prev = p;
+    }
+    slab->all = p;
+    partial_push(slab, p);
+
+    slab->slabs++;
+    return p;
+}
+
+/* The page must be empty, and so on the partial list. */
+static void page_free(tj_slab *slab, page *p) {
+    partial_remove(slab, p);
+    if (p->prev != NULL) {
+        p->prev->next = p->next;
+    } else {
+        slab->all = p->next;
+    }
+    if (p->next != NULL) {
+        p->next->prev = p->prev;
+    }
+
+    slab->slabs--;
+    free(p);
+}
+
+static void *core_alloc(tj_slab *slab) {
+    page *p = slab->partial;
+    if (p == NULL && (p = page_new(slab)) == NULL) {
+        return NULL;
+    }
+
+    void *obj;
+    if (p->free != NULL) {
+        obj = p->free;
+        p->free = *(void **) obj;
+    } else {
+        obj = (char *) p + PAGE_HEADER + p->carved++ * slab->objsize;
+    }
+
+    if (p == slab->empty) {
+        slab->empty = NULL;
+    }
+    if (++p->used == slab->perslab) {
+        partial_remove(slab, p);
+    }
+    slab->used++;
+    return obj;
+}
+
+static void core_free(tj_slab *slab, void *obj) {
+    page *p = (page *) ((uintptr_t) obj & ~(uintptr_t)(slab->slabsize - 1));
+    assert(p->owner == slab);
+
+    *(void **) obj = p->free;
+    p->free = obj;
+    if (p->used-- == slab->perslab) {
+        partial_push(slab, p);
+    }
+    slab->used--;
+
+    /* Keep one empty slab around, to damp alloc/free cycles at a boundary. */
+    if (p->used == 0) {
+        if (slab->empty == NULL) {
+            slab->empty = p;
+        } else if (slab->empty != p) {
+            page_free(slab, p);
+        }
+    }
+}
+
+//----------------------------------------------------------------------
+// Magazines
+//----------------------------------------------------------------------
+
+static void magazine_unlink(tj_slab *slab, magazine *m) {
+    if (m->prev != NULL) {
+        m->prev->next = m->next;
+    } else {
+        slab->magazines = m->next;
+    }
+    if (m->next != NULL) {
+        m->next->prev = m->prev;
+    }
+}
+
+/* Thread exit destructor, returning the thread's objects to the slabs. */
+static void magazine_release(void *arg) {
+    magazine *m = arg;
+    tj_slab *slab = m->slab;
+
+    lock(slab);
+    while (m->count > 0) {
+        core_free(slab, m->objs[--m->count]);
+    }
+    magazine_unlink(slab, m);
+    unlock(slab);
+    free(m);
+}
+
+static magazine *get_magazine(tj_slab *slab) {
+    magazine *m = pthread_getspecific(slab->key);
+    if (m != NULL) {
+        return m;
+    }
+
+    if ((m = calloc(1, sizeof(*m))) == NULL) {
+        return NULL;
+    }
+    m->slab = slab;
+
+    lock(slab);
+    m->next = slab->magazines;
+    if (slab->magazines != NULL) {
+        slab->magazines->prev = m;
+    }
+    slab->magazines = m;
+    unlock(slab);
+
+    if (pthread_setspecific(slab->key, m) != 0) {
+        lock(slab);
+        magazine_unlink(slab, m);
+        unlock(slab);
+        free(m);
+        return NULL;
+    }
+    return m;
+}
+
+//----------------------------------------------------------------------
+//----------------------------------------------------------------------
+
+tj_slab *tj_slab_create(size_t objsize, int flags) {
+    assert(objsize > 0);
+
+    tj_slab *slab = calloc(1, sizeof(*slab));
+    if (slab == NULL) {
+        return NULL;
+    }
+
+    if (objsize < sizeof(void *)) {
+        objsize = sizeof(void *);
+    }
+    size_t align = (objsize > 8) ? 16 : 8;
+    slab->objsize = (objsize + align - 1) & ~(align - 1);
+
+    slab->slabsize = MIN_SLAB_SIZE;
+    while ((slab->slabsize - PAGE_HEADER) / slab->objsize < MIN_PER_SLAB) {
+        slab->slabsize *= 2;
+    }
+    slab->perslab = (slab->slabsize - PAGE_HEADER) / slab->objsize;
+
+    if (flags & TJ_SLAB_MAGAZINES) {
+        flags |= TJ_SLAB_LOCKED;
+        if (pthread_key_create(&slab->key, &magazine_release) != 0) {
+            free(slab);
+            return NULL;
+        }
+    }
+    if ((flags & TJ_SLAB_LOCKED) &&
+            pthread_mutex_init(&slab->lock, NULL) != 0) {
+        if (flags & TJ_SLAB_MAGAZINES) {
+            pthread_key_delete(slab->key);
+        }
+        free(slab);
+        return NULL;
+    }
+    slab->flags = flags;
+
+    return slab;
+}
+
+void tj_slab_finalize(tj_slab *slab) {
+    if (slab->flags & TJ_SLAB_MAGAZINES) {
+        /* Deleting the key stops the exit destructors from running. */
+        pthread_key_delete(slab->key);
+        while (slab->magazines != NULL) {
+            magazine *m = slab->magazines;
+            slab->magazines = m->next;
+            free(m);
+        }
+    }
+
+    while (slab->all != NULL) {
+        page *p = slab->all;
+        slab->all = p->next;
+        free(p);
+    }
+
+    if (slab->flags & TJ_SLAB_LOCKED) {
+        pthread_mutex_destroy(&slab->lock);
+    }
+    free(slab);
+}
+
+void *tj_slab_alloc(tj_slab *slab) {
+    void *obj;
+    magazine *m;
+
+    if ((slab->flags & TJ_SLAB_MAGAZINES) && (m = get_magazine(slab))) {
+        if (m->count == 0) {
+            /* Refill half way, so a following free doesn't flush. */
+            lock(slab);
+            while (m->count < MAGAZINE_SIZE / 2 &&
+                   (obj = core_alloc(slab)) != NULL) {
+                m->objs[m->count++] = obj;
+            }
+            unlock(slab);
+            if (m->count == 0) {
+                return NULL;
+            }
+        }
+        return m->objs[--m->count];
+    }
+
+    lock(slab);
+    obj = core_alloc(slab);
+    unlock(slab);
+    return obj;
+}
+
+void tj_slab_free(tj_slab *slab, void *obj) {
+    magazine *m;
+
+    if ((slab->flags & TJ_SLAB_MAGAZINES) && (m = get_magazine(slab))) {
+        if (m->count == MAGAZINE_SIZE) {
+            lock(slab);
+            while (m->count > MAGAZINE_SIZE / 2) {
+                core_free(slab, m->objs[--m->count]);
+            }
+            unlock(slab);
+        }
+        m->objs[m->count++] = obj;
+        return;
+    }
+
+    lock(slab);
+    core_free(slab, obj);
+    unlock(slab);
+}
+
+void tj_slab_getStats(tj_slab *slab, tj_slab_stats *stats) {
+    lock(slab);
+    stats->objsize = slab->objsize;
+    stats->slabsize = slab->slabsize;
+    stats->perslab = slab->perslab;
+    stats->slabs = slab->slabs;
+    stats->used = slab->used;
+    unlock(slab);
+}
+
+size_t tj_slab_occupancy(tj_slab *slab, size_t *used, size_t n) {
+    size_t i = 0;
+    page *p;
+
+    lock(slab);
+    for (p = slab->all; p != NULL; p = p->next, i++) {
+        if (i < n) {
+            used[i] = p->used;
+        }
+    }
+    unlock(slab);
+    return i;
+}
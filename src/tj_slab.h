@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2013 Bellerophon Mobile, LLC.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * \file tj_slab.h
+ *
+ * Provides an allocator for many objects of a single fixed size.
+ *
+ * Objects are carved from slabs of at least a page, each holding a small
+ * header and an intrusive free list threaded through its free objects.
+ * Slabs are aligned to their size, so freeing an object finds its slab
+ * with a mask.  Allocation prefers partially used slabs, which keeps live
+ * objects packed together, and slabs that empty out are returned to the
+ * system, keeping one spare.
+ *
+ * By default a slab allocator is not thread safe.  TJ_SLAB_LOCKED guards
+ * it with a mutex, and TJ_SLAB_MAGAZINES additionally gives each thread a
+ * small cache, or magazine, of free objects, so most allocations and
+ * frees take no lock.  Objects may be freed from any thread.
+ */
+
+#pragma once
+
+#include <stddef.h>
+
+/** Guard the allocator with a mutex. */
+#define TJ_SLAB_LOCKED    0x1
+
+/** Cache free objects per thread.  Implies TJ_SLAB_LOCKED. */
+#define TJ_SLAB_MAGAZINES 0x2
+
+typedef struct tj_slab tj_slab;
+
+typedef struct {
+    size_t objsize;     /**< Object size, after rounding for alignment. */
+    size_t slabsize;    /**< Bytes per slab. */
+    size_t perslab;     /**< Objects per slab. */
+    size_t slabs;       /**< Slabs allocated. */
+    size_t used;        /**< Objects allocated, including any in magazines. */
+} tj_slab_stats;
+
+/**
+ * Create a new slab allocator.
+ *
+ * \param objsize Size in bytes of each object, greater than 0.  Objects
+ * are aligned to 16 bytes, or 8 if objsize is at most 8.
+ * \param flags A combination of the TJ_SLAB_ flags, or 0.
+ */
+tj_slab *tj_slab_create(size_t objsize, int flags);
+
+/**
+ * Free the allocator and every object allocated from it.  No other thread
+ * may be using it.
+ */
+void tj_slab_finalize(tj_slab *slab);
+
+/**
+ * Allocate an object.  Its contents are undefined.
+ *
+ * \return The object, NULL on failure.
+ */
+void *tj_slab_alloc(tj_slab *slab);
+
+/** Free an object allocated from this allocator. */
+void tj_slab_free(tj_slab *slab, void *obj);
+
+/** Fill in summary statistics. */
+void tj_slab_getStats(tj_slab *slab, tj_slab_stats *stats);
+
+/**
+ * Get the number of objects in use in each slab, most recently allocated
+ * slab first.
+ *
+ * \param used Receives up to n counts.
+ *
+ * \return The total number of slabs, which may exceed n.
+ */
+size_t tj_slab_occupancy(tj_slab *slab, size_t *used, size_t n);
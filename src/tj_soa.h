@@ -0,0 +1,207 @@
+/*
+ * Copyright (c) 2013 Joe Kopena <tjkopena@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __tj_soa_h__
+#define __tj_soa_h__
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+//----------------------------------------------------------------------
+//----------------------------------------------------------------------
+#ifndef TJ_DEBUG_STREAM
+#define TJ_DEBUG_STREAM stdout
+#endif
+
+#ifndef TJ_ERROR_STREAM
+#define TJ_ERROR_STREAM stderr
+#endif
+
+#ifndef TJ_LOG
+#ifdef NDEBUG
+#define TJ_LOG(M, ...)
+#else
+#include <stdio.h>
+#define TJ_LOG(M, ...) fprintf(TJ_DEBUG_STREAM, "%s: " M "\n", __FUNCTION__, ##__VA_ARGS__)
+#endif // ifndef NDEBUG else
+#endif // ifndef TJ_LOG
+
+#ifndef TJ_ERROR
+#include <stdio.h>
+#define TJ_ERROR(M, ...) fprintf(TJ_ERROR_STREAM, "[ERROR] %s:%s:%d: " M "\n", __FUNCTION__, __FILE__, __LINE__, ##__VA_ARGS__)
+#endif
+
+
+//----------------------------------------------------------------------
+//----------------------------------------------------------------------
+
+/**
+ * \file tj_soa.h
+ *
+ * TJ_SOA_DECL generates a struct-of-arrays container: one array per
+ * field of a record, all kept the same length, so that a scan over a
+ * few fields touches only those fields' memory and can be vectorized.
+ *
+ * The fields are given as an X-macro taking (type, name) pairs:
+ *
+ * \code{.c}
+ * #define PARTICLE_FIELDS(X) \
+ *   X(float, x)              \
+ *   X(float, y)              \
+ *   X(int, id)
+ *
+ * TJ_SOA_DECL(particles, PARTICLE_FIELDS)
+ *
+ * particles *p = particles_create(1024);
+ * particles_row r = { .x = 1, .y = 2, .id = 7 };
+ * particles_push(p, &r);
+ *
+ * for (i = 0; i < p->m_used; i++)
+ *   p->x[i] += p->y[i];
+ * \endcode
+ *
+ * This generates:
+ *
+ *  - type, holding a column pointer named after each field, plus
+ *    m_used and m_n giving the length and capacity of every column.
+ *  - type##_row, a struct with one member per field.
+ *  - type##_create(initial), type##_finalize(s), type##_reserve(s, n),
+ *    type##_push(s, row), type##_get(s, index, row),
+ *    type##_set(s, index, row), type##_swapRemove(s, index) and
+ *    type##_clear(s).
+ *
+ * All columns live in a single allocation, each starting on a
+ * TJ_SOA_ALIGN byte boundary.  Growing copies every column into a new
+ * block, so column pointers are only valid until the next push or
+ * reserve.  Functions returning int return 0 on failure and 1 on success.
+ */
+
+#ifndef TJ_SOA_ALIGN
+#define TJ_SOA_ALIGN 64
+#endif
+
+#define TJ_SOA_ROUND(n) (((n) + TJ_SOA_ALIGN - 1) & ~((size_t) TJ_SOA_ALIGN - 1))
+
+// Per-field expansions used by TJ_SOA_DECL.
+#define TJ_SOA_COLUMN_(ftype, name) ftype *name;
+#define TJ_SOA_MEMBER_(ftype, name) ftype name;
+#define TJ_SOA_SIZE_(ftype, name)                                       \
+  size = TJ_SOA_ROUND(size) + sizeof(ftype) * n;
+#define TJ_SOA_MOVE_(ftype, name)                                       \
+  size = TJ_SOA_ROUND(size);                                            \
+  if (s->m_used > 0)                                                    \
+    memcpy(block + size, s->name, sizeof(ftype) * s->m_used);           \
+  s->name = (ftype *) (block + size);                                   \
+  size += sizeof(ftype) * n;
+#define TJ_SOA_PUT_(ftype, name) s->name[index] = row->name;
+#define TJ_SOA_GET_(ftype, name) row->name = s->name[index];
+#define TJ_SOA_LAST_(ftype, name) s->name[index] = s->name[s->m_used];
+
+#define TJ_SOA_DECL(type, fields)                                       \
+  typedef struct { fields(TJ_SOA_MEMBER_) } type##_row;                 \
+  typedef struct { fields(TJ_SOA_COLUMN_)                               \
+                   size_t m_n; size_t m_used;                           \
+                   char *m_block;                                       \
+                 } type;                                                \
+  static inline int                                                     \
+  type##_reserve(type *s, size_t n)                                     \
+  {                                                                     \
+    if (n <= s->m_n) return 1;                                          \
+    if (n < s->m_n * 2) n = s->m_n * 2;                                 \
+    size_t size = 0;                                                    \
+    fields(TJ_SOA_SIZE_)                                                \
+    char *block;                                                        \
+    if (posix_memalign((void **) &block, TJ_SOA_ALIGN,                  \
+                       size ? size : 1) != 0) {                         \
+      TJ_ERROR("Could not allocate " #type " columns[%zu].", n);        \
+      return 0;                                                         \
+    }                                                                   \
+    size = 0;                                                           \
+    fields(TJ_SOA_MOVE_)                                                \
+    free(s->m_block);                                                   \
+    s->m_block = block;                                                 \
+    s->m_n = n;                                                         \
+    return 1;                                                           \
+  }                                                                     \
+  static inline type *                                                  \
+  type##_create(size_t initial)                                         \
+  {                                                                     \
+    type *s;                                                            \
+    if ((s = calloc(1, sizeof(type))) == 0) {                           \
+      TJ_ERROR("Could not allocate " #type ".");                        \
+      return 0;                                                         \
+    }                                                                   \
+    if (!type##_reserve(s, initial ? initial : 16)) {                   \
+      free(s);                                                          \
+      return 0;                                                         \
+    }                                                                   \
+    return s;                                                           \
+  }                                                                     \
+  static inline void                                                    \
+  type##_finalize(type *s)                                              \
+  {                                                                     \
+    free(s->m_block);                                                   \
+    free(s);                                                            \
+  }                                                                     \
+  static inline int                                                     \
+  type##_push(type *s, type##_row const *row)                           \
+  {                                                                     \
+    if (s->m_used == s->m_n && !type##_reserve(s, s->m_used + 1))       \
+      return 0;                                                         \
+    size_t index = s->m_used++;                                         \
+    fields(TJ_SOA_PUT_)                                                 \
+    return 1;                                                           \
+  }                                                                     \
+  static inline int                                                     \
+  type##_get(type const *s, size_t index, type##_row *row)              \
+  {                                                                     \
+    if (index >= s->m_used) return 0;                                   \
+    fields(TJ_SOA_GET_)                                                 \
+    return 1;                                                           \
+  }                                                                     \
+  static inline int                                                     \
+  type##_set(type *s, size_t index, type##_row const *row)              \
+  {                                                                     \
+    if (index >= s->m_used) return 0;                                   \
+    fields(TJ_SOA_PUT_)                                                 \
+    return 1;                                                           \
+  }                                                                     \
+  static inline int                                                     \
+  type##_swapRemove(type *s, size_t index)                              \
+  {                                                                     \
+    if (index >= s->m_used) return 0;                                   \
+    s->m_used--;                                                        \
+    if (index != s->m_used) {                                           \
+      fields(TJ_SOA_LAST_)                                              \
+    }                                                                   \
+    return 1;                                                           \
+  }                                                                     \
+  static inline void                                                    \
+  type##_clear(type *s)                                                 \
+  {                                                                     \
+    s->m_used = 0;                                                      \
+  }
+
+#endif // __tj_soa_h__
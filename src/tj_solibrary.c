@@ -64,6 +64,7 @@ struct tj_solibrary_entry {
 
 struct tj_solibrary {
   tj_solibrary_entry *m_list;
+  const tj_allocator *m_allocator;
 };
 
 
@@ -71,16 +72,27 @@ struct tj_solibrary {
 //----------------------------------------------------------------------
 tj_solibrary *
 tj_solibrary_create(void)
+{
+  return tj_solibrary_createWithAllocator(0);
+  // end tj_solibrary_create
+}
+
+tj_solibrary *
+tj_solibrary_createWithAllocator(const tj_allocator *allocator)
 {
   TJ_LOG("Create.");
   tj_solibrary *x;
-  if ((x = malloc(sizeof(tj_solibrary))) == 0) {
+
+  allocator = tj_allocator_orDefault(allocator);
+
+  if ((x = tj_allocator_alloc(allocator, sizeof(tj_solibrary))) == 0) {
     TJ_ERROR("Could not allocate tj_solibrary.");
     return 0;
   }
   x->m_list = 0;
+  x->m_allocator = allocator;
   return x;
-  // end tj_solibrary_create
+  // end tj_solibrary_createWithAllocator
 }
 
 void
@@ -92,12 +104,12 @@ tj_solibrary_finalize(tj_solibrary *x)
   while ((e = x->m_list) != 0) {
     x->m_list = x->m_list->next;
     TJ_LOG("  %s", e->m_fn);
-    free(e->m_fn);
+    tj_allocator_freeString(x->m_allocator, e->m_fn);
     dlclose(e->m_handle);
-    free(e);
+    tj_allocator_free(x->m_allocator, e, sizeof(tj_solibrary_entry));
   }
 
-  free(x);
+  tj_allocator_free(x->m_allocator, x, sizeof(tj_solibrary));
   // end tj_solibrary_finalize
 }
 
@@ -117,14 +129,15 @@ tj_solibrary_load(tj_solibrary *x, const char *fn)
   const char *error;
 
   tj_solibrary_entry *e;
-  if ((e = malloc(sizeof(tj_solibrary_entry))) == 0) {
+  if ((e = tj_allocator_alloc(x->m_allocator,
+                              sizeof(tj_solibrary_entry))) == 0) {
     TJ_ERROR("Could not allocate tj_solibrary_entry.");
     return 0;
   }
 
-  if ((e->m_fn = strdup(fn)) == 0) {
+  if ((e->m_fn = tj_allocator_strdup(x->m_allocator, fn)) == 0) {
     TJ_ERROR("Could not allocate tj_solibrary_entry fn.");
-    free(e);
+    tj_allocator_free(x->m_allocator, e, sizeof(tj_solibrary_entry));
     return 0;
   }
 
@@ -133,8 +146,8 @@ tj_solibrary_load(tj_solibrary *x, const char *fn)
   error = dlerror();
   if (e->m_handle == 0 || error != 0) {
     TJ_ERROR("Could not open lib file %s:\n%s", fn, error);
-    free(e->m_fn);
-    free(e);
+    tj_allocator_freeString(x->m_allocator, e->m_fn);
+    tj_allocator_free(x->m_allocator, e, sizeof(tj_solibrary_entry));
     return 0;
   }
 
@@ -25,12 +25,16 @@
 #ifndef __tj_solibrary_h__
 #define __tj_solibrary_h__
 
+#include "tj_allocator.h"
+
 //--------------------------------------------------------------
 typedef struct tj_solibrary tj_solibrary;
 typedef struct tj_solibrary_entry tj_solibrary_entry;
 
 tj_solibrary *
 tj_solibrary_create(void);
+tj_solibrary *
+tj_solibrary_createWithAllocator(const tj_allocator *allocator);
 void
 tj_solibrary_finalize(tj_solibrary *x);
 
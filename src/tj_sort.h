@@ -0,0 +1,339 @@
+/*
+ * Copyright (c) 2013 Bellerophon Mobile, LLC.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * \file tj_sort.h
+ *
+ * Macro-ized, compile time type checked sorting of plain C arrays and
+ * tj_arrays.
+ *
+ * TJ_SORT_DECL(name, type, lessthan) generates:
+ *
+ *   int name(type *a, size_t n);
+ *   int name_parallel(type *a, size_t n, int threads);
+ *
+ * Both are stable merge sorts.  lessthan(a, b) may be a function or a
+ * macro; either way it is expanded directly into the sort loops, so the
+ * compiler is free to inline it.  The parallel variant sorts with one
+ * thread per slice and merges the slices pairwise, also in parallel.  It
+ * falls back to the serial sort below TJ_SORT_PARALLEL_MIN elements.
+ *
+ * TJ_RADIX_SORT_DECL(name, type, keyof) generates:
+ *
+ *   int name(type *a, size_t n);
+ *
+ * an LSD radix sort on the unsigned 64 bit key keyof(a).  Passes over
+ * bytes on which every key agrees are skipped.  For signed keys, flip the
+ * sign bit, e.g. with TJ_SORT_SIGNED_KEY().  For pointers, cast to
+ * uintptr_t.
+ *
+ * TJ_ARRAY_SORT_DECL and TJ_ARRAY_RADIX_SORT_DECL generate the same for
+ * the items of a tj_array, keeping any tj_array index in sync.
+ *
+ * All of these return 0 if scratch memory could not be allocated, in
+ * which case the array is left unchanged, and 1 otherwise.
+ */
+
+#ifndef __tj_sort_h__
+#define __tj_sort_h__
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include "tj_array.h"
+
+//----------------------------------------------------------------------
+//----------------------------------------------------------------------
+#ifndef TJ_ERROR_STREAM
+#define TJ_ERROR_STREAM stderr
+#endif
+
+#ifndef TJ_ERROR
+#include <stdio.h>
+#define TJ_ERROR(M, ...) fprintf(TJ_ERROR_STREAM, "[ERROR] %s:%s:%d: " M "\n", __FUNCTION__, __FILE__, __LINE__, ##__VA_ARGS__)
+#endif
+
+/** Runs shorter than this are insertion sorted before merging. */
+#ifndef TJ_SORT_RUN
+#define TJ_SORT_RUN 32
+#endif
+
+/** Below this many elements the parallel sorts run serially. */
+#ifndef TJ_SORT_PARALLEL_MIN
+#define TJ_SORT_PARALLEL_MIN 65536
+#endif
+
+#ifndef TJ_SORT_MAX_THREADS
+#define TJ_SORT_MAX_THREADS 64
+#endif
+
+/** Maps a signed integer onto an unsigned radix key of the same order. */
+#define TJ_SORT_SIGNED_KEY(x) \
+  ((uint64_t) (int64_t) (x) ^ (UINT64_C(1) << 63))
+
+
+//----------------------------------------------------------------------
+//----------------------------------------------------------------------
+#define TJ_SORT_DECL(name, type, lessthan)                              \
+  typedef struct { type const *m_src; type *m_dst;                      \
+                   size_t m_lo; size_t m_mid; size_t m_hi;              \
+                 } name##_task;                                         \
+  static inline void                                                    \
+  name##_insertion(type *a, size_t n)                                   \
+  {                                                                     \
+    size_t i, j;                                                        \
+    type t;                                                             \
+    for (i = 1; i < n; i++) {                                           \
+      t = a[i];                                                         \
+      for (j = i; j > 0 && lessthan(t, a[j-1]); j--)                    \
+        a[j] = a[j-1];                                                  \
+      a[j] = t;                                                         \
+    }                                                                   \
+  }                                                                     \
+  static inline void                                                    \
+  name##_merge(type const *src, type *dst,                              \
+               size_t lo, size_t mid, size_t hi)                        \
+  {                                                                     \
+    size_t i = lo, j = mid, k = lo;                                     \
+    while (i < mid && j < hi)                                           \
+      dst[k++] = lessthan(src[j], src[i]) ? src[j++] : src[i++];        \
+    memcpy(dst+k, src+i, (mid-i) * sizeof(type));                      \
+    k += mid-i;                                                         \
+    memcpy(dst+k, src+j, (hi-j) * sizeof(type));                        \
+  }                                                                     \
+  /* Sorts into a, using tmp as scratch space of at least n. */         \
+  static inline void                                                    \
+  name##_mergesort(type *a, type *tmp, size_t n)                        \
+  {                                                                     \
+    size_t lo, w, mid, hi;                                              \
+    type *src = a;                                                      \
+    type *dst = tmp;                                                    \
+    type *t;                                                            \
+    for (lo = 0; lo < n; lo += TJ_SORT_RUN)                             \
+      name##_insertion(a+lo, (n-lo < TJ_SORT_RUN) ? n-lo : TJ_SORT_RUN); \
+    for (w = TJ_SORT_RUN; w < n; w *= 2) {                              \
+      for (lo = 0; lo < n; lo += 2*w) {                                 \
+        mid = (w < n-lo) ? lo+w : n;                                    \
+        hi = (2*w < n-lo) ? lo+2*w : n;                                 \
+        name##_merge(src, dst, lo, mid, hi);                            \
+      }                                                                 \
+      t = src; src = dst; dst = t;                                      \
+    }                                                                   \
+    if (src != a)                                                       \
+      memcpy(a, src, n * sizeof(type));                                 \
+  }                                                                     \
+  static inline int                                                     \
+  name(type *a, size_t n)                                               \
+  {                                                                     \
+    type *tmp;                                                          \
+    if (n <= TJ_SORT_RUN) {                                             \
+      name##_insertion(a, n);                                           \
+      return 1;                                                         \
+    }                                                                   \
+    if ((tmp = malloc(sizeof(type) * n)) == 0) {                        \
+      TJ_ERROR("Could not allocate " #name " scratch[%zu].", n);        \
+      return 0;                                                         \
+    }                                                                   \
+    name##_mergesort(a, tmp, n);                                        \
+    free(tmp);                                                          \
+    return 1;                                                           \
+  }                                                                     \
+  static inline void *                                                  \
+  name##_sortTask(void *arg)                                            \
+  {                                                                     \
+    name##_task *t = (name##_task *) arg;                               \
+    name##_mergesort(t->m_dst + t->m_lo, (type *) t->m_src + t->m_lo,   \
+                     t->m_hi - t->m_lo);                                \
+    return 0;                                                           \
+  }                                                                     \
+  static inline void *                                                  \
+  name##_mergeTask(void *arg)                                           \
+  {                                                                     \
+    name##_task *t = (name##_task *) arg;                               \
+    name##_merge(t->m_src, t->m_dst, t->m_lo, t->m_mid, t->m_hi);       \
+    return 0;                                                           \
+  }                                                                     \
+  /* Runs each task on its own thread, or inline if one can't start. */ \
+  static inline void                                                    \
+  name##_runTasks(name##_task *tasks, int n, void *(*f)(void *))        \
+  {                                                                     \
+    pthread_t tids[TJ_SORT_MAX_THREADS];                                \
+    char started[TJ_SORT_MAX_THREADS];                                  \
+    int i;                                                              \
+    for (i = 1; i < n; i++)                                             \
+      started[i] = (pthread_create(&tids[i], 0, f, &tasks[i]) == 0);    \
+    f(&tasks[0]);                                                       \
+    for (i = 1; i < n; i++) {                                           \
+      if (started[i])                                                   \
+        pthread_join(tids[i], 0);                                       \
+      else                                                              \
+        f(&tasks[i]);                                                   \
+    }                                                                   \
+  }                                                                     \
+  static inline int                                                     \
+  name##_parallel(type *a, size_t n, int threads)                       \
+  {                                                                     \
+    name##_task tasks[TJ_SORT_MAX_THREADS];                             \
+    size_t bounds[TJ_SORT_MAX_THREADS+1];                               \
+    type *tmp;                                                          \
+    type *src;                                                          \
+    type *dst;                                                          \
+    type *t;                                                            \
+    int i, runs;                                                        \
+    if (threads < 2 || n < TJ_SORT_PARALLEL_MIN)                        \
+      return name(a, n);                                                \
+    if (threads > TJ_SORT_MAX_THREADS)                                  \
+      threads = TJ_SORT_MAX_THREADS;                                    \
+    if ((tmp = malloc(sizeof(type) * n)) == 0) {                        \
+      TJ_ERROR("Could not allocate " #name " scratch[%zu].", n);        \
+      return 0;                                                         \
+    }                                                                   \
+    for (i = 0; i <= threads; i++)                                      \
+      bounds[i] = n / threads * i + (n % threads) * i / threads;        \
+    for (i = 0; i < threads; i++) {                                     \
+      tasks[i].m_src = tmp;                                             \
+      tasks[i].m_dst = a;                                               \
+      tasks[i].m_lo = bounds[i];                                        \
+      tasks[i].m_hi = bounds[i+1];                                      \
+    }                                                                   \
+    name##_runTasks(tasks, threads, &name##_sortTask);                  \
+    src = a;                                                            \
+    dst = tmp;                                                          \
+    for (runs = threads; runs > 1; runs = (runs+1) / 2) {               \
+      for (i = 0; i < runs/2; i++) {                                    \
+        tasks[i].m_src = src;                                           \
+        tasks[i].m_dst = dst;                                           \
+        tasks[i].m_lo = bounds[2*i];                                    \
+        tasks[i].m_mid = bounds[2*i+1];                                 \
+        tasks[i].m_hi = bounds[2*i+2];                                  \
+      }                                                                 \
+      if (runs % 2)                                                     \
+        memcpy(dst + bounds[runs-1], src + bounds[runs-1],              \
+               (n - bounds[runs-1]) * sizeof(type));                    \
+      name##_runTasks(tasks, runs/2, &name##_mergeTask);                \
+      for (i = 0; i <= runs/2; i++)                                     \
+        bounds[i] = bounds[2*i];                                        \
+      bounds[(runs+1)/2] = n;                                           \
+      t = src; src = dst; dst = t;                                      \
+    }                                                                   \
+    if (src != a)                                                       \
+      memcpy(a, src, n * sizeof(type));                                 \
+    free(tmp);                                                          \
+    return 1;                                                           \
+  }
+
+
+//----------------------------------------------------------------------
+//----------------------------------------------------------------------
+#define TJ_RADIX_SORT_DECL(name, type, keyof)                           \
+  static inline int                                                     \
+  name(type *a, size_t n)                                               \
+  {                                                                     \
+    size_t counts[8][256];                                              \
+    size_t i, sum, c;                                                   \
+    uint64_t k, first;                                                  \
+    type *tmp;                                                          \
+    type *src;                                                          \
+    type *dst;                                                          \
+    type *t;                                                            \
+    int b;                                                              \
+    if (n < 2)                                                          \
+      return 1;                                                         \
+    if ((tmp = malloc(sizeof(type) * n)) == 0) {                        \
+      TJ_ERROR("Could not allocate " #name " scratch[%zu].", n);        \
+      return 0;                                                         \
+    }                                                                   \
+    memset(counts, 0, sizeof(counts));                                  \
+    for (i = 0; i < n; i++) {                                           \
+      k = keyof(a[i]);                                                  \
+      for (b = 0; b < 8; b++)                                           \
+        counts[b][(k >> (8*b)) & 0xff]++;                               \
+    }                                                                   \
+    first = keyof(a[0]);                                                \
+    src = a;                                                            \
+    dst = tmp;                                                          \
+    for (b = 0; b < 8; b++) {                                           \
+      if (counts[b][(first >> (8*b)) & 0xff] == n)                      \
+        continue;                                                       \
+      for (sum = 0, i = 0; i < 256; i++) {                              \
+        c = counts[b][i];                                               \
+        counts[b][i] = sum;                                             \
+        sum += c;                                                       \
+      }                                                                 \
+      for (i = 0; i < n; i++)                                           \
+        dst[counts[b][(keyof(src[i]) >> (8*b)) & 0xff]++] = src[i];     \
+      t = src; src = dst; dst = t;                                      \
+    }                                                                   \
+    if (src != a)                                                       \
+      memcpy(a, src, n * sizeof(type));                                 \
+    free(tmp);                                                          \
+    return 1;                                                           \
+  }
+
+
+//----------------------------------------------------------------------
+//----------------------------------------------------------------------
+/**
+ * Generates name(tj_array *) and name_parallel(tj_array *, int threads)
+ * sorting the items of a tj_array by lessthan(a, b) on the void * items.
+ */
+#define TJ_ARRAY_SORT_DECL(name, lessthan)                              \
+  TJ_SORT_DECL(name##_items, void *, lessthan)                          \
+  static inline int                                                     \
+  name##_reorder(void **items, size_t n, void *threads)                 \
+  {                                                                     \
+    return name##_items_parallel(items, n, *(int *) threads);           \
+  }                                                                     \
+  static inline int                                                     \
+  name##_parallel(tj_array *array, int threads)                         \
+  {                                                                     \
+    return tj_array_reorder(array, &name##_reorder, &threads);          \
+  }                                                                     \
+  static inline int                                                     \
+  name(tj_array *array)                                                 \
+  {                                                                     \
+    return name##_parallel(array, 1);                                   \
+  }
+
+/**
+ * Generates name(tj_array *) radix sorting the items of a tj_array by
+ * the unsigned 64 bit key keyof(item).
+ */
+#define TJ_ARRAY_RADIX_SORT_DECL(name, keyof)                           \
+  TJ_RADIX_SORT_DECL(name##_items, void *, keyof)                       \
+  static inline int                                                     \
+  name##_reorder(void **items, size_t n, void *data)                    \
+  {                                                                     \
+    return name##_items(items, n);                                      \
+  }                                                                     \
+  static inline int                                                     \
+  name(tj_array *array)                                                 \
+  {                                                                     \
+    return tj_array_reorder(array, &name##_reorder, 0);                 \
+  }
+
+#endif // __tj_sort_h__
@@ -66,13 +66,15 @@ struct tj_template_variable {
 
 struct tj_template_variables {
   tj_template_variable *m_variables;
+  const tj_allocator *m_allocator;
 };
 
 //----------------------------------
 tj_template_variable *
-tj_template_variable_create(const char *label);
+tj_template_variable_create(const tj_allocator *allocator, const char *label);
 void
-tj_template_variable_finalize(tj_template_variable *x);
+tj_template_variable_finalize(const tj_allocator *allocator,
+                              tj_template_variable *x);
 
 tj_template_variable *
 tj_template_variables_find(tj_template_variables *vars, const char *label);
@@ -81,15 +83,27 @@ tj_template_variables_find(tj_template_variables *vars, const char *label);
 //----------------------------------------------------------------------
 tj_template_variables *
 tj_template_variables_create(void)
+{
+  return tj_template_variables_createWithAllocator(0);
+  // end tj_template_variables_create
+}
+
+tj_template_variables *
+tj_template_variables_createWithAllocator(const tj_allocator *allocator)
 {
   tj_template_variables *vars;
-  if ((vars=malloc(sizeof(tj_template_variables))) == 0) {
+
+  allocator = tj_allocator_orDefault(allocator);
+
+  if ((vars=tj_allocator_alloc(allocator,
+                               sizeof(tj_template_variables))) == 0) {
     TJ_ERROR("No memory for tj_template_variables.");
     return 0;
   }
   vars->m_variables = 0;
+  vars->m_allocator = allocator;
   return vars;
-  // end tj_template_variables
+  // end tj_template_variables_createWithAllocator
 }
 
 void
@@ -98,32 +112,32 @@ tj_template_variables_finalize(tj_template_variables *vars)
   tj_template_variable *var;
   while ((var = vars->m_variables) != 0) {
     vars->m_variables = var->m_next;
-    tj_template_variable_finalize(var);
+    tj_template_variable_finalize(vars->m_allocator, var);
   }
-  free(vars);
+  tj_allocator_free(vars->m_allocator, vars, sizeof(tj_template_variables));
   // end tj_template_variables
 }
 
 //----------------------------------------------
 tj_template_variable *
-tj_template_variable_create(const char *label)
+tj_template_variable_create(const tj_allocator *allocator, const char *label)
 {
   tj_template_variable *v;
-  if ((v = malloc(sizeof(tj_template_variable))) == 0) {
+  if ((v = tj_allocator_alloc(allocator, sizeof(tj_template_variable))) == 0) {
     TJ_ERROR("No memory for tj_template_variable.");
     return 0;
   }
 
-  if ((v->m_substitution = tj_buffer_create(0)) == 0) {
+  if ((v->m_substitution = tj_buffer_createWithAllocator(0, allocator)) == 0) {
     TJ_ERROR("No memory for tj_buffer.");
-    free(v);
+    tj_allocator_free(allocator, v, sizeof(tj_template_variable));
     return 0;
   }
 
-  if ((v->m_label = strdup(label)) == 0) {
+  if ((v->m_label = tj_allocator_strdup(allocator, label)) == 0) {
     TJ_ERROR("No memory for label.");
-    free(v->m_substitution);
-    free(v);
+    tj_buffer_finalize(v->m_substitution);
+    tj_allocator_free(allocator, v, sizeof(tj_template_variable));
     return 0;
   }
 
@@ -135,11 +149,12 @@ tj_template_variable_create(const char *label)
 }
 
 void
-tj_template_variable_finalize(tj_template_variable *x)
+tj_template_variable_finalize(const tj_allocator *allocator,
+                              tj_template_variable *x)
 {
   tj_buffer_finalize(x->m_substitution);
-  free(x->m_label);
-  free(x);
+  tj_allocator_freeString(allocator, x->m_label);
+  tj_allocator_free(allocator, x, sizeof(tj_template_variable));
   // end tj_template_variable_finalize
 }
 
@@ -173,7 +188,7 @@ tj_template_variables_setFromString(tj_template_variables *vars,
   tj_template_variable *v = tj_template_variables_find(vars, label);
 
   if (v == 0) {
-    if ((v = tj_template_variable_create(label)) == 0) {
+    if ((v = tj_template_variable_create(vars->m_allocator, label)) == 0) {
       return 0;
     }
     v->m_next = vars->m_variables;
@@ -200,7 +215,7 @@ tj_template_variables_setFromFileStream(tj_template_variables *vars,
   tj_template_variable *v = tj_template_variables_find(vars, label);
 
   if (v == 0) {
-    if ((v = tj_template_variable_create(label)) == 0) {
+    if ((v = tj_template_variable_create(vars->m_allocator, label)) == 0) {
       return 0;
     }
     v->m_next = vars->m_variables;
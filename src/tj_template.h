@@ -37,6 +37,14 @@ typedef struct tj_template_variables tj_template_variables;
 tj_template_variables *
 tj_template_variables_create(void);
 
+/**
+ * Create a tj_template_variables object whose variables and their
+ * substitution buffers are allocated through the given allocator, or
+ * the default allocator if it is 0.
+ */
+tj_template_variables *
+tj_template_variables_createWithAllocator(const tj_allocator *allocator);
+
 /**
  * Destroy a tj_template_variables object, deallocating it and any
  * substitutions that have been added to it.
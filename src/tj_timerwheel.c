@@ -0,0 +1,367 @@
+/*
+ * Copyright (c) 2013 Bellerophon Mobile, LLC.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <assert.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "tj_allocator.h"
+#include "tj_timerwheel.h"
+
+#ifdef UNIT_TESTING
+#   undef assert
+#   define assert(x) mock_assert((int)(x), #x, __FILE__, __LINE__)
+#endif /* UNIT_TESTING */
+
+#define BITS 6
+#define MASK (TJ_TIMERWHEEL_SLOTS - 1)
+
+struct tj_timerwheel {
+    const tj_allocator *allocator;
+    tj_timerwheel_clock clock;
+    void *clockdata;
+
+    /* Tick length, and the clock time of tick 0. */
+    uint64_t tick;
+    uint64_t origin;
+
+    /* The next tick to process; all before it have fired. */
+    uint64_t current;
+
+    int levels;
+    size_t count;
+
+    /* Bit i of occupied[l] is set if slot i of level l is nonempty. */
+    uint64_t occupied[TJ_TIMERWHEEL_MAX_LEVELS];
+
+    /* List heads, TJ_TIMERWHEEL_SLOTS per level. */
+    tj_timerwheel_timer slots[];
+};
+
+static size_t wheel_size(int levels) {
+    return sizeof(tj_timerwheel) +
+        sizeof(tj_timerwheel_timer) * TJ_TIMERWHEEL_SLOTS * levels;
+}
+
+static void list_init(tj_timerwheel_timer *head) {
+    head->next = head->prev = head;
+}
+
+static int list_empty(const tj_timerwheel_timer *head) {
+    return head->next == head;
+}
+
+static void list_unlink(tj_timerwheel_timer *t) {
+    t->prev->next = t->next;
+    t->next->prev = t->prev;
+    t->next = t->prev = NULL;
+}
+
+/* Converts a clock time to the first tick at or after it. */
+static uint64_t to_tick(const tj_timerwheel *wheel, uint64_t when) {
+    if (when <= wheel->origin) {
+        return 0;
+    }
+    uint64_t d = when - wheel->origin;
+    return d / wheel->tick + (d % wheel->tick != 0);
+}
+
+/* Links a timer into the slot for its expiry, relative to current. */
+static void place(tj_timerwheel *wheel, tj_timerwheel_timer *t) {
+    uint64_t expires = (t->expires > wheel->current) ?
+        t->expires : wheel->current;
+    uint64_t delta = expires - wheel->current;
+    int level = 0;
+
+    if (delta >= TJ_TIMERWHEEL_SLOTS) {
+        level = (63 - __builtin_clzll(delta)) / BITS;
+        if (level >= wheel->levels) {
+            /* Out of reach; park in the top level's furthest slot. */
+            level = wheel->levels - 1;
+            expires = wheel->current +
+                (1ULL << (BITS * wheel->levels)) - 1;
+        }
+    }
+
+    unsigned slot = (expires >> (BITS * level)) & MASK;
+    t->slot = level * TJ_TIMERWHEEL_SLOTS + slot;
+
+    tj_timerwheel_timer *head = &wheel->slots[t->slot];
+    t->next = head;
+    t->prev = head->prev;
+    head->prev->next = t;
+    head->prev = t;
+    wheel->occupied[level] |= 1ULL << slot;
+}
+
+/* Moves the timers in a slot at a level above 0 down the wheel. */
+static void cascade(tj_timerwheel *wheel, int level, unsigned slot) {
+    tj_timerwheel_timer *head =
+        &wheel->slots[level * TJ_TIMERWHEEL_SLOTS + slot];
+    tj_timerwheel_timer list;
+
+    if (list_empty(head)) {
+        return;
+    }
+
+    /* Detach the list first, as timers may land back in this slot. */
+    list.next = head->next;
+    list.prev = head->prev;
+    list.next->prev = list.prev->next = &list;
+    list_init(head);
+    wheel->occupied[level] &= ~(1ULL << slot);
+
+    while (!list_empty(&list)) {
+        tj_timerwheel_timer *t = list.next;
+        list_unlink(t);
+        place(wheel, t);
+    }
+}
+
+/* Fires the timers of the level 0 slot for tick current, then moves on. */
+static size_t fire(tj_timerwheel *wheel) {
+    unsigned slot = wheel->current & MASK;
+    tj_timerwheel_timer *head = &wheel->slots[slot];
+    tj_timerwheel_timer list;
+    size_t fired = 0;
+
+    list.next = head->next;
+    list.prev = head->prev;
+    list.next->prev = list.prev->next = &list;
+    list_init(head);
+    wheel->occupied[0] &= ~(1ULL << slot);
+
+    /* Anything the callbacks schedule goes in from the next tick. */
+    wheel->current++;
+
+    while (!list_empty(&list)) {
+        tj_timerwheel_timer *t = list.next;
+        list_unlink(t);
+
+        /* With a single level, timers out of reach are parked here. */
+        if (t->expires >= wheel->current) {
+            place(wheel, t);
+            continue;
+        }
+
+        wheel->count--;
+        fired++;
+        t->callback(t, t->data);
+    }
+
+    return fired;
+}
+
+uint64_t tj_timerwheel_monotonic(void *data) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+tj_timerwheel *tj_timerwheel_create(uint64_t tick, int levels) {
+    return tj_timerwheel_createWithAllocator(tick, levels, NULL);
+}
+
+tj_timerwheel *tj_timerwheel_createWithAllocator(
+    uint64_t tick, int levels, const tj_allocator *allocator) {
+    assert(tick > 0);
+    assert(levels >= 1 && levels <= TJ_TIMERWHEEL_MAX_LEVELS);
+
+    allocator = tj_allocator_orDefault(allocator);
+
+    tj_timerwheel *wheel = tj_allocator_calloc(allocator, wheel_size(levels));
+    if (wheel == NULL) {
+        return NULL;
+    }
+
+    int i;
+    for (i = 0; i < TJ_TIMERWHEEL_SLOTS * levels; i++) {
+        list_init(&wheel->slots[i]);
+    }
+
+    wheel->allocator = allocator;
+    wheel->tick = tick;
+    wheel->levels = levels;
+    tj_timerwheel_setClock(wheel, &tj_timerwheel_monotonic, NULL);
+    return wheel;
+}
+
+void tj_timerwheel_finalize(tj_timerwheel *wheel) {
+    tj_allocator_free(wheel->allocator, wheel, wheel_size(wheel->levels));
+}
+
+void tj_timerwheel_setClock(tj_timerwheel *wheel, tj_timerwheel_clock clock,
+                            void *data) {
+    assert(wheel->count == 0);
+
+    wheel->clock = clock;
+    wheel->clockdata = data;
+    wheel->origin = clock(data);
+    wheel->current = 0;
+}
+
+uint64_t tj_timerwheel_now(tj_timerwheel *wheel) {
+    return wheel->clock(wheel->clockdata);
+}
+
+void tj_timerwheel_timer_init(tj_timerwheel_timer *timer,
+                              tj_timerwheel_callback callback, void *data) {
+    timer->next = timer->prev = NULL;
+    timer->expires = 0;
+    timer->slot = 0;
+    timer->callback = callback;
+    timer->data = data;
+}
+
+int tj_timerwheel_timer_isPending(const tj_timerwheel_timer *timer) {
+    return timer->next != NULL;
+}
+
+void tj_timerwheel_schedule(tj_timerwheel *wheel, tj_timerwheel_timer *timer,
+                            uint64_t delay) {
+    uint64_t now = tj_timerwheel_now(wheel);
+    tj_timerwheel_scheduleAt(wheel, timer,
+                             (delay > UINT64_MAX - now) ? UINT64_MAX :
+                             now + delay);
+}
+
+void tj_timerwheel_scheduleAt(tj_timerwheel *wheel,
+                              tj_timerwheel_timer *timer, uint64_t when) {
+    tj_timerwheel_cancel(wheel, timer);
+    timer->expires = to_tick(wheel, when);
+    place(wheel, timer);
+    wheel->count++;
+}
+
+int tj_timerwheel_cancel(tj_timerwheel *wheel, tj_timerwheel_timer *timer) {
+    if (timer->next == NULL) {
+        return 0;
+    }
+
+    list_unlink(timer);
+    if (list_empty(&wheel->slots[timer->slot])) {
+        wheel->occupied[timer->slot / TJ_TIMERWHEEL_SLOTS] &=
+            ~(1ULL << (timer->slot & MASK));
+    }
+    wheel->count--;
+    return 1;
+}
+
+size_t tj_timerwheel_advance(tj_timerwheel *wheel) {
+    return tj_timerwheel_advanceTo(wheel, tj_timerwheel_now(wheel));
+}
+
+size_t tj_timerwheel_advanceTo(tj_timerwheel *wheel, uint64_t now) {
+    size_t fired = 0;
+
+    if (now < wheel->origin) {
+        return 0;
+    }
+    uint64_t target = (now - wheel->origin) / wheel->tick;
+
+    while (wheel->current <= target) {
+        if (wheel->count == 0) {
+            wheel->current = target + 1;
+            break;
+        }
+
+        /* As each level wraps, bring down the next slot above it. */
+        if ((wheel->current & MASK) == 0) {
+            int level;
+            for (level = 1; level < wheel->levels; level++) {
+                cascade(wheel, level,
+                        (wheel->current >> (BITS * level)) & MASK);
+                if ((wheel->current >> (BITS * level)) & MASK) {
+                    break;
+                }
+            }
+        }
+
+        /* Skip to the next occupied slot, or to the end of the turn. */
+        uint64_t pending = wheel->occupied[0] >> (wheel->current & MASK);
+        uint64_t next;
+        if (pending == 0) {
+            next = (wheel->current | MASK) + 1;
+        } else if ((pending & 1) == 0) {
+            next = wheel->current + __builtin_ctzll(pending);
+        } else {
+            fired += fire(wheel);
+            continue;
+        }
+        wheel->current = (next <= target) ? next : target + 1;
+    }
+
+    return fired;
+}
+
+int tj_timerwheel_nextExpiry(tj_timerwheel *wheel, uint64_t *when) {
+    if (wheel->count == 0) {
+        return 0;
+    }
+
+    uint64_t best = UINT64_MAX;
+    int level;
+    for (level = 0; level < wheel->levels; level++) {
+        uint64_t mask = wheel->occupied[level];
+        if (mask == 0) {
+            continue;
+        }
+
+        /*
+         * Slots are visited in turn from the current position, so rotate
+         * it to bit 0 and find the nearest.  A level above 0 reaches its
+         * current slot only on the next turn, unless that slot's cascade
+         * is still to come at the current tick.
+         */
+        uint64_t position = wheel->current >> (BITS * level);
+        unsigned shift = position & MASK;
+        uint64_t rotated = (shift == 0) ? mask :
+            (mask >> shift) | (mask << (TJ_TIMERWHEEL_SLOTS - shift));
+        uint64_t distance = __builtin_ctzll(rotated);
+        uint64_t tick;
+
+        if (level == 0) {
+            tick = wheel->current + distance;
+        } else {
+            int due = (wheel->current &
+                       ((1ULL << (BITS * level)) - 1)) == 0;
+            if (distance == 0 && !due) {
+                rotated &= rotated - 1;
+                distance = (rotated == 0) ? TJ_TIMERWHEEL_SLOTS :
+                    __builtin_ctzll(rotated);
+            }
+            tick = (position + distance) << (BITS * level);
+        }
+        if (tick < best) {
+            best = tick;
+        }
+    }
+
+    *when = wheel->origin + best * wheel->tick;
+    return 1;
+}
+
+size_t tj_timerwheel_count(tj_timerwheel *wheel) {
+    return wheel->count;
+}
@@ -0,0 +1,174 @@
+/*
+ * Copyright (c) 2013 Bellerophon Mobile, LLC.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * \file tj_timerwheel.h
+ *
+ * Provides a hierarchical timing wheel, for holding large numbers of
+ * timers of which most are cancelled or rescheduled before they fire.
+ *
+ * Time advances in ticks of a configurable length, read from a
+ * monotonic clock.  Each level of the wheel has TJ_TIMERWHEEL_SLOTS
+ * slots; a slot at level 0 spans one tick, and one at each level above
+ * spans a full turn of the level below.  A timer goes in the lowest
+ * level that reaches its expiry, and when a lower level wraps around
+ * the next slot of the level above is cascaded down into it.  Timers
+ * beyond the top level's reach wait in its furthest slot until they
+ * come in range.
+ *
+ * Scheduling, rescheduling and cancelling are O(1) and allocate
+ * nothing: timers are caller-owned structures linked into the slots.
+ * Advancing fires every timer of each tick passed as a batch, skipping
+ * runs of empty slots, and never fires a timer before its deadline;
+ * it may fire up to a tick after.
+ *
+ * A wheel is not thread safe.  Timer callbacks may schedule, reschedule
+ * and cancel timers, including the one firing, but must not advance or
+ * finalize the wheel.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "tj_allocator.h"
+
+/** Slots per level; fixed so each level's occupancy fits a bitmask. */
+#define TJ_TIMERWHEEL_SLOTS 64
+
+/** The most levels a wheel may have. */
+#define TJ_TIMERWHEEL_MAX_LEVELS 10
+
+typedef struct tj_timerwheel tj_timerwheel;
+typedef struct tj_timerwheel_timer tj_timerwheel_timer;
+
+/** Called when a timer fires, with the data it was initialized with. */
+typedef void (*tj_timerwheel_callback)(tj_timerwheel_timer *timer,
+                                       void *data);
+
+/** Returns the current time in nanoseconds, never going backwards. */
+typedef uint64_t (*tj_timerwheel_clock)(void *data);
+
+/**
+ * A timer, typically embedded in the object it times out.  Initialize
+ * it with tj_timerwheel_timer_init(); the fields are private.
+ */
+struct tj_timerwheel_timer {
+    tj_timerwheel_timer *next;
+    tj_timerwheel_timer *prev;
+    uint64_t expires;
+    unsigned slot;
+    tj_timerwheel_callback callback;
+    void *data;
+};
+
+/** Reads CLOCK_MONOTONIC; the default clock.  data is ignored. */
+uint64_t tj_timerwheel_monotonic(void *data);
+
+/**
+ * Create a new timing wheel, starting at the current time.
+ *
+ * \param tick Length of a tick in nanoseconds, greater than 0.
+ * \param levels Number of levels, from 1 to TJ_TIMERWHEEL_MAX_LEVELS.
+ * Timers up to tick * TJ_TIMERWHEEL_SLOTS^levels out are placed
+ * directly; later ones are carried along at the top level.
+ *
+ * \return The wheel, NULL on failure.
+ */
+tj_timerwheel *tj_timerwheel_create(uint64_t tick, int levels);
+
+/** As tj_timerwheel_create(), allocating through allocator. */
+tj_timerwheel *tj_timerwheel_createWithAllocator(
+    uint64_t tick, int levels, const tj_allocator *allocator);
+
+/**
+ * Free the wheel.  Pending timers are dropped without firing and may be
+ * freed or reused by their owners.
+ */
+void tj_timerwheel_finalize(tj_timerwheel *wheel);
+
+/**
+ * Replace the clock, e.g., with a fake one for testing or an event
+ * loop's cached time.  Only do this while no timers are pending; the
+ * wheel restarts from the new clock's current time.
+ */
+void tj_timerwheel_setClock(tj_timerwheel *wheel, tj_timerwheel_clock clock,
+                            void *data);
+
+/** Returns the wheel's clock time, in nanoseconds. */
+uint64_t tj_timerwheel_now(tj_timerwheel *wheel);
+
+/** Prepare a timer for use, not pending. */
+void tj_timerwheel_timer_init(tj_timerwheel_timer *timer,
+                              tj_timerwheel_callback callback, void *data);
+
+/** Returns true if the timer is scheduled and has not fired. */
+int tj_timerwheel_timer_isPending(const tj_timerwheel_timer *timer);
+
+/**
+ * Schedule a timer to fire delay nanoseconds from now.  A pending timer
+ * is rescheduled.
+ */
+void tj_timerwheel_schedule(tj_timerwheel *wheel, tj_timerwheel_timer *timer,
+                            uint64_t delay);
+
+/**
+ * Schedule a timer to fire at the given clock time, in nanoseconds.  A
+ * pending timer is rescheduled; a time already passed fires at the next
+ * tick.
+ */
+void tj_timerwheel_scheduleAt(tj_timerwheel *wheel,
+                              tj_timerwheel_timer *timer, uint64_t when);
+
+/**
+ * Cancel a timer.
+ *
+ * \return True if it was pending.
+ */
+int tj_timerwheel_cancel(tj_timerwheel *wheel, tj_timerwheel_timer *timer);
+
+/**
+ * Fire all timers due by the current clock time.
+ *
+ * \return The number of timers fired.
+ */
+size_t tj_timerwheel_advance(tj_timerwheel *wheel);
+
+/** As tj_timerwheel_advance(), up to the given clock time. */
+size_t tj_timerwheel_advanceTo(tj_timerwheel *wheel, uint64_t now);
+
+/**
+ * Get a lower bound on when the next timer fires, to bound an event
+ * loop's wait.  It is exact for timers within a turn of level 0, and
+ * otherwise the time of the cascade that brings the next one closer.
+ *
+ * \param when Receives the clock time in nanoseconds.
+ *
+ * \return False if no timers are pending.
+ */
+int tj_timerwheel_nextExpiry(tj_timerwheel *wheel, uint64_t *when);
+
+/** Returns the number of pending timers. */
+size_t tj_timerwheel_count(tj_timerwheel *wheel);
@@ -26,16 +26,49 @@
 #define __tj_util_h__
 
 #include <stdlib.h>
+#include <string.h>
 
 #define TJ_UTIL_ABORT(msg) CRITICAL(msg), abort()
 
+/**
+ * With TJ_ALLOCPROF defined, the allocation macros below go through
+ * tj_allocprof, recording their file and line as the call site.  Memory
+ * from them should then be released with TJ_FREE so it is counted as
+ * freed.  Without it, they call the C library directly and TJ_FREE is
+ * free().
+ */
+#ifdef TJ_ALLOCPROF
+#include "tj_allocprof.h"
+
+#define TJ_UTIL_SITE(call) ({ \
+    static tj_allocprof_site tj_util_site = TJ_ALLOCPROF_SITE; \
+    call; \
+})
+
+#define TJ_UTIL_CALLOC(size) \
+  TJ_UTIL_SITE(tj_allocprof_calloc(&tj_util_site, (size)))
+#define TJ_UTIL_MALLOC(size) \
+  TJ_UTIL_SITE(tj_allocprof_malloc(&tj_util_site, (size)))
+#define TJ_UTIL_STRDUP(str) \
+  TJ_UTIL_SITE(tj_allocprof_strdup(&tj_util_site, (str)))
+#define TJ_UTIL_STRNDUP(str, n) \
+  TJ_UTIL_SITE(tj_allocprof_strndup(&tj_util_site, (str), (n)))
+#define TJ_FREE(ptr) tj_allocprof_free(ptr)
+#else
+#define TJ_UTIL_CALLOC(size) calloc(1, (size))
+#define TJ_UTIL_MALLOC(size) malloc(size)
+#define TJ_UTIL_STRDUP(str) strdup(str)
+#define TJ_UTIL_STRNDUP(str, n) strndup((str), (n))
+#define TJ_FREE(ptr) free(ptr)
+#endif // ifdef TJ_ALLOCPROF
+
 /**
  * Convenience macro to malloc, and check the result, aborting on failure.
  *
  * You should have the TAG macro defined, this uses tj_log to print errors.
  */
 #define TJ_ALLOC(type) \
-  ((calloc(1, sizeof(type))) ? : \
+  ((TJ_UTIL_CALLOC(sizeof(type))) ? : \
    (TJ_UTIL_ABORT("Could not allocate " #type "."), NULL))
 
 // E.g.: tj_kb_naivesqlite *naive;
@@ -61,14 +94,14 @@
  * \endcode
  */
 #define TJ_CALLOC(var) do { \
-    if (((var) = calloc(1, sizeof(*(var)))) == NULL) { \
+    if (((var) = TJ_UTIL_CALLOC(sizeof(*(var)))) == NULL) { \
         CRITICAL("Could not allocate " #var "."); \
         goto error; \
     } \
 } while (0)
 
 #define TJ_MALLOC(var, size) do { \
-    if (((var) = malloc(size)) == NULL) { \
+    if (((var) = TJ_UTIL_MALLOC(size)) == NULL) { \
         CRITICAL("Could not allocate " #var "."); \
         goto error; \
     } \
@@ -80,7 +113,7 @@
  * Jumps to "error" label on error.
  */
 #define TJ_STRDUP(var, str) do { \
-    if (((var) = strdup(str)) == NULL) { \
+    if (((var) = TJ_UTIL_STRDUP(str)) == NULL) { \
         CRITICAL("Could not duplicate " #str "."); \
         goto error; \
     } \
@@ -92,7 +125,7 @@
  * Jumps to "error" label on error.
  */
 #define TJ_STRNDUP(var, str, n) do { \
-    if (((var) = strndup(str, n)) == NULL) { \
+    if (((var) = TJ_UTIL_STRNDUP(str, n)) == NULL) { \
         CRITICAL("Could not duplicate " #str "."); \
         goto error; \
     } \
@@ -0,0 +1,284 @@
+/*
+ * Copyright (c) 2013 Bellerophon Mobile, LLC.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cmocka.h"
+
+#include "tj_allocator.h"
+#include "tj_arena.h"
+#include "tj_array.h"
+#include "tj_bitset.h"
+#include "tj_buffer.h"
+#include "tj_concarray.h"
+#include "tj_error.h"
+#include "tj_log.h"
+#include "tj_multiqueue.h"
+#include "tj_searchpathlist.h"
+#include "tj_segarray.h"
+#include "tj_template.h"
+
+/*
+ * Tracks live allocations, and checks that every realloc and free is
+ * given the size the block was allocated with.
+ */
+typedef struct {
+    size_t live;
+    size_t bytes;
+    size_t calls;
+} counter;
+
+typedef union {
+    size_t size;
+    long double align;
+} header;
+
+static void *counting_alloc(void *ctx, size_t size) {
+    counter *c = ctx;
+    header *h = malloc(sizeof(header) + size);
+    if (h == NULL) {
+        return NULL;
+    }
+    h->size = size;
+    c->live += 1;
+    c->bytes += size;
+    c->calls += 1;
+    return h + 1;
+}
+
+static void *counting_realloc(void *ctx, void *ptr, size_t oldsize,
+                              size_t size) {
+    counter *c = ctx;
+    if (ptr == NULL) {
+        assert_int_equal(oldsize, 0);
+        return counting_alloc(ctx, size);
+    }
+
+    header *h = (header *) ptr - 1;
+    assert_int_equal(h->size, oldsize);
+    h = realloc(h, sizeof(header) + size);
+    if (h == NULL) {
+        return NULL;
+    }
+    h->size = size;
+    c->bytes += size - oldsize;
+    c->calls += 1;
+    return h + 1;
+}
+
+static void counting_free(void *ctx, void *ptr, size_t size) {
+    counter *c = ctx;
+    if (ptr == NULL) {
+        return;
+    }
+
+    header *h = (header *) ptr - 1;
+    assert_int_equal(h->size, size);
+    c->live -= 1;
+    c->bytes -= size;
+    free(h);
+}
+
+static void setup(void **state) {
+    counter *c = calloc(1, sizeof(counter));
+    tj_allocator *a = calloc(1, sizeof(tj_allocator));
+    a->alloc = &counting_alloc;
+    a->realloc = &counting_realloc;
+    a->free = &counting_free;
+    a->ctx = c;
+    *state = a;
+}
+
+static void teardown(void **state) {
+    tj_allocator *a = *state;
+    tj_allocator_setDefault(NULL);
+    free(a->ctx);
+    free(a);
+}
+
+static void test_allocator_wrappers(void **state) {
+    tj_allocator *a = *state;
+    counter *c = a->ctx;
+    char *p, *s;
+
+    p = tj_allocator_calloc(a, 10);
+    assert_non_null(p);
+    assert_int_equal(p[9], 0);
+    p = tj_allocator_realloc(a, p, 10, 100);
+    assert_non_null(p);
+    s = tj_allocator_strdup(a, "allocator");
+    assert_string_equal(s, "allocator");
+    assert_int_equal(c->live, 2);
+    assert_int_equal(c->bytes, 110);
+
+    tj_allocator_freeString(a, s);
+    tj_allocator_free(a, p, 100);
+    tj_allocator_freeString(a, NULL);
+    assert_int_equal(c->live, 0);
+    assert_int_equal(c->bytes, 0);
+
+    assert_true(tj_allocator_getDefault() == &tj_allocator_stdlib);
+    assert_true(tj_allocator_orDefault(NULL) == &tj_allocator_stdlib);
+    assert_true(tj_allocator_orDefault(a) == a);
+}
+
+static void test_allocator_modules(void **state) {
+    tj_allocator *a = *state;
+    counter *c = a->ctx;
+    int items[100];
+    size_t i;
+
+    tj_buffer *b = tj_buffer_createWithAllocator(4, a);
+    assert_non_null(b);
+    assert_true(tj_buffer_printf(b, "%s %d", "grown past four bytes", 42));
+    assert_string_equal(tj_buffer_getAsString(b), "grown past four bytes 42");
+
+    tj_array *array = tj_array_createWithAllocator(0, a);
+    assert_non_null(array);
+    assert_true(tj_array_enableIndex(array));
+    for (i = 0; i < 100; i++) {
+        assert_true(tj_array_append(array, &items[i]));
+    }
+    assert_int_equal(tj_array_find(array, &items[50]), 50);
+
+    tj_error *e = tj_error_createWithAllocator(a, TJ_ERROR_PARSING,
+                                               "line %d", 7);
+    tj_error_appendMessage(e, "and more");
+    assert_string_equal(tj_error_getMessage(e),
+                        "[PARSING ERROR]: line 7\n[PARSING ERROR]: and more");
+
+    tj_template_variables *vars = tj_template_variables_createWithAllocator(a);
+    assert_true(tj_template_variables_setFromString(vars, "NAME", "value"));
+    assert_true(tj_template_variables_setFromString(vars, "NAME", "again"));
+
+    tj_searchpathlist *paths = tj_searchpathlist_createWithAllocator(a);
+    assert_true(tj_searchpathlist_add(paths, "/tmp"));
+
+    tj_log_outchannel *out =
+        tj_log_outchannel_createWithAllocator(a, NULL, NULL, NULL);
+    assert_non_null(out);
+    tj_log_addOutChannel(out);
+
+    tj_segarray *seg = tj_segarray_createWithAllocator(sizeof(int), a);
+    tj_concarray *conc = tj_concarray_createWithAllocator(sizeof(int), a);
+    for (i = 0; i < 100; i++) {
+        assert_non_null(tj_segarray_append(seg, &items[i]));
+        assert_true(tj_concarray_append(conc, &items[i]));
+    }
+
+    tj_bitset *bits = tj_bitset_createWithAllocator(0, a);
+    for (i = 0; i < 100; i++) {
+        assert_true(tj_bitset_set(bits, 1000 + i));
+    }
+    tj_bitset *runs = tj_bitset_copy(bits);
+    assert_true(tj_bitset_optimize(runs));
+    assert_true(tj_bitset_isCompressed(runs));
+    assert_true(tj_bitset_clear(runs, 1050));
+    assert_true(tj_bitset_xor(runs, bits));
+    assert_int_equal(tj_bitset_count(runs), 1);
+
+    tj_multiqueue *queue = tj_multiqueue_createWithAllocator(3, 2, a);
+    assert_non_null(queue);
+    assert_true(tj_multiqueue_push(queue, 1, &items[0]));
+
+    assert_true(c->live > 0);
+
+    tj_multiqueue_finalize(queue);
+    tj_bitset_finalize(runs);
+    tj_bitset_finalize(bits);
+    tj_concarray_finalize(conc);
+    tj_segarray_finalize(seg);
+    tj_log_removeOutChannel(out);
+    tj_searchpathlist_finalize(paths);
+    tj_template_variables_finalize(vars);
+    tj_error_finalize(e);
+    tj_array_finalize(array);
+    tj_buffer_finalize(b);
+
+    assert_int_equal(c->live, 0);
+    assert_int_equal(c->bytes, 0);
+}
+
+static void test_allocator_default(void **state) {
+    tj_allocator *a = *state;
+    counter *c = a->ctx;
+
+    tj_allocator_setDefault(a);
+    assert_true(tj_allocator_getDefault() == a);
+
+    tj_buffer *b = tj_buffer_create(0);
+    tj_array *array = tj_array_create(8);
+    assert_true(tj_buffer_appendString(b, "default"));
+    assert_true(c->calls >= 3);
+
+    /* Objects keep their allocator when the default changes. */
+    tj_allocator_setDefault(NULL);
+    assert_true(tj_allocator_getDefault() == &tj_allocator_stdlib);
+    tj_array_finalize(array);
+    tj_buffer_finalize(b);
+    assert_int_equal(c->live, 0);
+}
+
+static void test_allocator_arena(void **state) {
+    tj_allocator *a = *state;
+    counter *c = a->ctx;
+    size_t i;
+
+    tj_arena *arena = tj_arena_createWithAllocator(1024, a);
+    assert_non_null(arena);
+    size_t chunks = c->live;
+
+    const tj_allocator *from = tj_arena_getAllocator(arena);
+    tj_buffer *b = tj_buffer_createWithAllocator(0, from);
+    for (i = 0; i < 100; i++) {
+        assert_true(tj_buffer_printf(b, "%zu,", i));
+    }
+    tj_template_variables *vars =
+        tj_template_variables_createWithAllocator(from);
+    assert_true(tj_template_variables_setFromString(vars, "A", "b"));
+
+    /* Everything came out of the arena's chunks. */
+    assert_true(c->live > chunks);
+    tj_template_variables_finalize(vars);
+    tj_buffer_finalize(b);
+
+    tj_arena_finalize(arena);
+    assert_int_equal(c->live, 0);
+}
+
+int main(int argc, char *argv[]) {
+    const UnitTest tests[] = {
+        unit_test_setup_teardown(test_allocator_wrappers, setup, teardown),
+        unit_test_setup_teardown(test_allocator_modules, setup, teardown),
+        unit_test_setup_teardown(test_allocator_default, setup, teardown),
+        unit_test_setup_teardown(test_allocator_arena, setup, teardown),
+    };
+
+    return run_tests(tests);
+}
@@ -0,0 +1,242 @@
+/*
+ * Copyright (c) 2013 Bellerophon Mobile, LLC.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <pthread.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cmocka.h"
+
+#define TJ_ALLOCPROF
+#define TAG "test-tj_allocprof"
+#include "tj_log.h"
+#include "tj_util.h"
+
+#define THREADS 4
+#define PER_THREAD 10000
+
+static void setup(void **state) {
+    tj_allocprof_reset();
+}
+
+static void teardown(void **state) {
+    tj_allocprof_setSampleRate(0);
+    tj_allocprof_reset();
+}
+
+static void *alloc_block(size_t size) {
+    char *p;
+    TJ_MALLOC(p, size);
+    return p;
+
+error:
+    return NULL;
+}
+
+static char *copy_string(const char *str) {
+    char *s;
+    TJ_STRDUP(s, str);
+    return s;
+
+error:
+    return NULL;
+}
+
+typedef struct {
+    const char *file;
+    size_t count;
+    size_t live_bytes;
+} site_check;
+
+static void count_site(const tj_allocprof_site *site, void *arg) {
+    site_check *check = arg;
+    assert_string_equal(site->file, check->file);
+    check->count += 1;
+    check->live_bytes += site->live_bytes;
+}
+
+static void test_allocprof_off(void **state) {
+    tj_allocprof_stats stats;
+    void *p = alloc_block(100);
+    assert_non_null(p);
+    TJ_FREE(p);
+
+    tj_allocprof_getStats(&stats);
+    assert_int_equal(stats.rate, 0);
+    assert_int_equal(stats.allocs, 0);
+    assert_int_equal(stats.sites, 0);
+}
+
+static void test_allocprof_sites(void **state) {
+    tj_allocprof_stats stats;
+    site_check check = { __FILE__, 0, 0 };
+    void *blocks[10];
+    char *s, *t;
+    size_t i;
+
+    tj_allocprof_setSampleRate(1);
+
+    for (i = 0; i < 10; i++) {
+        blocks[i] = alloc_block(1000);
+        assert_non_null(blocks[i]);
+    }
+    s = copy_string("profiled");
+    assert_string_equal(s, "profiled");
+    TJ_STRNDUP(t, "profiled", 3);
+    assert_string_equal(t, "pro");
+    int *x = TJ_ALLOC(int);
+
+    tj_allocprof_getStats(&stats);
+    assert_int_equal(stats.sites, 4);
+    assert_int_equal(stats.allocs, 13);
+    assert_int_equal(stats.live_bytes, 10000 + 9 + 4 + sizeof(int));
+    assert_int_equal(stats.peak_bytes, stats.live_bytes);
+
+    tj_allocprof_forEachSite(&count_site, &check);
+    assert_int_equal(check.count, 4);
+    assert_int_equal(check.live_bytes, stats.live_bytes);
+
+    for (i = 0; i < 5; i++) {
+        TJ_FREE(blocks[i]);
+    }
+    TJ_FREE(s);
+    TJ_FREE(t);
+    TJ_FREE(x);
+    tj_allocprof_getStats(&stats);
+    assert_int_equal(stats.live_bytes, 5000);
+    assert_int_equal(stats.peak_bytes, 10000 + 9 + 4 + sizeof(int));
+    assert_int_equal(stats.bytes, stats.peak_bytes);
+
+    /* The biggest live site is listed first. */
+    FILE *out = tmpfile();
+    assert_true(tj_allocprof_dump(out));
+    char line[256];
+    int lines = 0;
+    rewind(out);
+    while (fgets(line, sizeof(line), out) != NULL) {
+        if (strstr(line, __FILE__) != NULL) {
+            if (lines == 0) {
+                assert_non_null(strstr(line, "  5000 "));
+            }
+            lines += 1;
+        }
+    }
+    assert_int_equal(lines, 4);
+    fclose(out);
+
+    for (i = 5; i < 10; i++) {
+        TJ_FREE(blocks[i]);
+    }
+    tj_allocprof_getStats(&stats);
+    assert_int_equal(stats.live_bytes, 0);
+
+    /* Unsampled and unknown pointers are simply freed. */
+    TJ_FREE(malloc(10));
+    TJ_FREE(NULL);
+
+    return;
+
+error:
+    assert_true(0);
+}
+
+static void test_allocprof_sampling(void **state) {
+    tj_allocprof_stats stats;
+    void *blocks[1000];
+    size_t i;
+
+    tj_allocprof_setSampleRate(4);
+    for (i = 0; i < 1000; i++) {
+        blocks[i] = alloc_block(100);
+    }
+
+    tj_allocprof_getStats(&stats);
+    assert_int_equal(stats.rate, 4);
+    assert_true(stats.allocs >= 996 && stats.allocs <= 1004);
+    assert_int_equal(stats.bytes, stats.allocs * 100);
+    assert_int_equal(stats.live_bytes, stats.bytes);
+
+    for (i = 0; i < 1000; i++) {
+        TJ_FREE(blocks[i]);
+    }
+    tj_allocprof_getStats(&stats);
+    assert_int_equal(stats.live_bytes, 0);
+}
+
+static void *churn(void *arg) {
+    void *blocks[64];
+    size_t i;
+
+    for (i = 0; i < PER_THREAD; i++) {
+        size_t slot = i % 64;
+        if (i >= 64) {
+            TJ_FREE(blocks[slot]);
+        }
+        blocks[slot] = alloc_block(16 + slot);
+        if (blocks[slot] == NULL) {
+            return NULL;
+        }
+    }
+    for (i = 0; i < 64; i++) {
+        TJ_FREE(blocks[i]);
+    }
+    return arg;
+}
+
+static void test_allocprof_threads(void **state) {
+    tj_allocprof_stats stats;
+    pthread_t threads[THREADS];
+    int ok = 1;
+    size_t i;
+
+    tj_allocprof_setSampleRate(1);
+    for (i = 0; i < THREADS; i++) {
+        assert_int_equal(pthread_create(&threads[i], NULL, &churn, &ok), 0);
+    }
+    for (i = 0; i < THREADS; i++) {
+        void *res;
+        pthread_join(threads[i], &res);
+        assert_true(res == &ok);
+    }
+
+    tj_allocprof_getStats(&stats);
+    assert_int_equal(stats.allocs, THREADS * PER_THREAD);
+    assert_int_equal(stats.live_bytes, 0);
+    assert_true(stats.peak_bytes >= 64 * 16);
+    assert_true(stats.seconds > 0);
+}
+
+int main(int argc, char *argv[]) {
+    const UnitTest tests[] = {
+        unit_test_setup_teardown(test_allocprof_off, setup, teardown),
+        unit_test_setup_teardown(test_allocprof_sites, setup, teardown),
+        unit_test_setup_teardown(test_allocprof_sampling, setup, teardown),
+        unit_test_setup_teardown(test_allocprof_threads, setup, teardown),
+    };
+
+    return run_tests(tests);
+}
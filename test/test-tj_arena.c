@@ -0,0 +1,163 @@
+/*
+ * Copyright (c) 2013 Bellerophon Mobile, LLC.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cmocka.h"
+
+#define UNIT_TESTING
+#include "tj_arena.c"
+
+#define CHUNK 1024
+
+static void setup(void **state) {
+    tj_arena *arena = tj_arena_create(CHUNK);
+    assert_non_null(arena);
+
+    *state = (void*)arena;
+}
+
+static void teardown(void **state) {
+    tj_arena *arena = *state;
+    if (arena != NULL) {
+        tj_arena_finalize(arena);
+    }
+}
+
+static void test_arena_alloc(void **state) {
+    tj_arena *arena = *state;
+    char *p, *q;
+    size_t i;
+
+    assert_int_equal(tj_arena_getAllocated(arena), 0);
+
+    p = tj_arena_alloc(arena, 3);
+    q = tj_arena_alloc(arena, 5);
+    assert_non_null(p);
+    assert_int_equal((uintptr_t) p % TJ_ARENA_ALIGN, 0);
+    assert_int_equal((uintptr_t) q % TJ_ARENA_ALIGN, 0);
+    assert_true(q == p + TJ_ARENA_ALIGN);
+    assert_int_equal(tj_arena_getAllocated(arena), CHUNK);
+
+    /* Chains new chunks as it fills. */
+    for (i = 0; i < 100; i++) {
+        p = tj_arena_alloc(arena, 100);
+        assert_non_null(p);
+        memset(p, 0xab, 100);
+    }
+    assert_true(tj_arena_getAllocated(arena) >= 100 * 100);
+
+    /* Oversized allocations get their own chunk. */
+    p = tj_arena_alloc(arena, CHUNK * 4);
+    assert_non_null(p);
+    memset(p, 0, CHUNK * 4);
+
+    p = tj_arena_allocAligned(arena, 10, 256);
+    assert_int_equal((uintptr_t) p % 256, 0);
+    p = tj_arena_allocAligned(arena, 1, 1);
+    q = tj_arena_allocAligned(arena, 1, 1);
+    assert_true(q == p + 1);
+    p = tj_arena_allocAligned(arena, CHUNK, 4096);
+    assert_int_equal((uintptr_t) p % 4096, 0);
+
+    expect_assert_failure(tj_arena_allocAligned(arena, 1, 3));
+
+    q = tj_arena_strdup(arena, "mushi mushi");
+    assert_string_equal(q, "mushi mushi");
+}
+
+static void test_arena_realloc(void **state) {
+    tj_arena *arena = *state;
+    char *p, *q;
+
+    p = tj_arena_realloc(arena, NULL, 0, 10);
+    strcpy(p, "123456789");
+
+    /* The latest allocation grows in place. */
+    q = tj_arena_realloc(arena, p, 10, 100);
+    assert_true(q == p);
+    q = tj_arena_realloc(arena, p, 100, 20);
+    assert_true(q == p);
+
+    /* Otherwise it moves. */
+    tj_arena_alloc(arena, 1);
+    q = tj_arena_realloc(arena, p, 20, 40);
+    assert_true(q != p);
+    assert_string_equal(q, "123456789");
+
+    /* Growing past the chunk moves it to a new one. */
+    p = tj_arena_realloc(arena, q, 40, CHUNK * 2);
+    assert_non_null(p);
+    assert_string_equal(p, "123456789");
+}
+
+static void test_arena_rewind(void **state) {
+    tj_arena *arena = *state;
+    tj_arena_savepoint empty, point;
+    char *p, *q;
+    size_t i, allocated;
+
+    empty = tj_arena_mark(arena);
+    p = tj_arena_alloc(arena, 100);
+
+    point = tj_arena_mark(arena);
+    for (i = 0; i < 50; i++) {
+        tj_arena_alloc(arena, 100);
+    }
+    tj_arena_alloc(arena, CHUNK * 8);
+    allocated = tj_arena_getAllocated(arena);
+
+    /* Rewinding reuses the same memory, keeping standard chunks. */
+    tj_arena_rewind(arena, point);
+    assert_int_equal(tj_arena_getAllocated(arena), allocated - CHUNK * 8);
+    q = tj_arena_alloc(arena, 100);
+    assert_true(q == p + 112);
+
+    for (i = 0; i < 50; i++) {
+        tj_arena_alloc(arena, 100);
+    }
+    assert_int_equal(tj_arena_getAllocated(arena), allocated - CHUNK * 8);
+
+    tj_arena_rewind(arena, empty);
+    assert_true(tj_arena_alloc(arena, 100) == p);
+
+    tj_arena_reset(arena);
+    assert_true(tj_arena_alloc(arena, 100) != NULL);
+    assert_int_equal(tj_arena_getAllocated(arena), allocated - CHUNK * 8);
+}
+
+int main(int argc, char *argv[]) {
+    const UnitTest tests[] = {
+        unit_test_setup_teardown(test_arena_alloc, setup, teardown),
+        unit_test_setup_teardown(test_arena_realloc, setup, teardown),
+        unit_test_setup_teardown(test_arena_rewind, setup, teardown),
+    };
+
+    return run_tests(tests);
+}
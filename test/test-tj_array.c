@@ -39,6 +39,9 @@
 #define VALUE_C 15
 #define VALUE_D 16
 
+/* Large enough that a quadratic removal would be noticeably slow. */
+#define SCALE_COUNT 100000
+
 static void setup(void **state) {
     struct tj_array *array = tj_array_create(0);
     assert_non_null(array);
@@ -357,6 +360,479 @@ static void test_array_clear2(void **state) {
     assert_int_equal(tj_array_count(array), 0);
 }
 
+static void test_array_swapRemove1(void **state) {
+    struct tj_array *array = *state;
+    int a, b, c, d;
+    init_array(array, &a, &b, &c, &d);
+
+    tj_array_swapRemove(array, 0);
+
+    assert_int_equal(tj_array_count(array), 3);
+    assert_int_equal(*(int*)tj_array_get(array, 0), VALUE_D);
+    assert_int_equal(*(int*)tj_array_get(array, 1), VALUE_B);
+    assert_int_equal(*(int*)tj_array_get(array, 2), VALUE_C);
+
+    tj_array_swapRemove(array, 2);
+
+    assert_int_equal(tj_array_count(array), 2);
+    assert_int_equal(*(int*)tj_array_get(array, 0), VALUE_D);
+    assert_int_equal(*(int*)tj_array_get(array, 1), VALUE_B);
+    expect_assert_failure(tj_array_swapRemove(array, 2));
+}
+
+static void test_array_swapRemove2(void **state) {
+    struct tj_array *array = *state;
+    static int values[SCALE_COUNT];
+    size_t i;
+
+    for (i = 0; i < SCALE_COUNT; i++) {
+        values[i] = i;
+        assert_true(tj_array_append(array, &values[i]));
+    }
+
+    while (tj_array_count(array) > 0) {
+        tj_array_swapRemove(array, 0);
+    }
+    expect_assert_failure(tj_array_swapRemove(array, 0));
+}
+
+static void test_array_removeRange1(void **state) {
+    struct tj_array *array = *state;
+    int a, b, c, d;
+    init_array(array, &a, &b, &c, &d);
+
+    tj_array_removeRange(array, 1, 2);
+
+    assert_int_equal(tj_array_count(array), 2);
+    assert_int_equal(*(int*)tj_array_get(array, 0), VALUE_A);
+    assert_int_equal(*(int*)tj_array_get(array, 1), VALUE_D);
+
+    tj_array_removeRange(array, 2, 0);
+    assert_int_equal(tj_array_count(array), 2);
+
+    expect_assert_failure(tj_array_removeRange(array, 1, 2));
+    expect_assert_failure(tj_array_removeRange(array, 3, 0));
+
+    tj_array_removeRange(array, 0, 2);
+    assert_int_equal(tj_array_count(array), 0);
+}
+
+static void test_array_removeRange2(void **state) {
+    struct tj_array *array = *state;
+    static int values[SCALE_COUNT];
+    size_t i;
+
+    for (i = 0; i < SCALE_COUNT; i++) {
+        values[i] = i;
+        assert_true(tj_array_append(array, &values[i]));
+    }
+
+    tj_array_removeRange(array, 10, SCALE_COUNT - 20);
+
+    assert_int_equal(tj_array_count(array), 20);
+    for (i = 0; i < 10; i++) {
+        assert_int_equal(*(int*)tj_array_get(array, i), i);
+        assert_int_equal(*(int*)tj_array_get(array, i + 10),
+                         SCALE_COUNT - 10 + i);
+    }
+}
+
+static int is_odd(void *data, void *item) {
+    (*(size_t*)data)++;
+    return (*(int*)item) % 2;
+}
+
+static void test_array_removeIf1(void **state) {
+    struct tj_array *array = *state;
+    int a, b, c, d;
+    init_array(array, &a, &b, &c, &d);
+
+    size_t calls = 0;
+    assert_int_equal(tj_array_removeIf(array, &is_odd, &calls), 1);
+    assert_int_equal(calls, 4);
+
+    assert_int_equal(tj_array_count(array), 3);
+    assert_int_equal(*(int*)tj_array_get(array, 0), VALUE_A);
+    assert_int_equal(*(int*)tj_array_get(array, 1), VALUE_B);
+    assert_int_equal(*(int*)tj_array_get(array, 2), VALUE_D);
+}
+
+static void test_array_removeIf2(void **state) {
+    struct tj_array *array = *state;
+    static int values[SCALE_COUNT];
+    size_t i;
+
+    for (i = 0; i < SCALE_COUNT; i++) {
+        values[i] = i;
+        assert_true(tj_array_append(array, &values[i]));
+    }
+
+    size_t calls = 0;
+    assert_int_equal(tj_array_removeIf(array, &is_odd, &calls),
+                     SCALE_COUNT / 2);
+    assert_int_equal(calls, SCALE_COUNT);
+
+    assert_int_equal(tj_array_count(array), SCALE_COUNT / 2);
+    for (i = 0; i < SCALE_COUNT / 2; i++) {
+        assert_int_equal(*(int*)tj_array_get(array, i), i * 2);
+    }
+}
+
+/* Every item must be found at its lowest position. */
+static void check_index(struct tj_array *array) {
+    size_t i;
+    for (i = 0; i < tj_array_count(array); i++) {
+        void *item = tj_array_get(array, i);
+        ssize_t found = tj_array_find(array, item);
+        assert_true(found >= 0 && found <= i);
+        assert_true(tj_array_get(array, found) == item);
+        if (found < i) {
+            continue;
+        }
+        size_t j;
+        for (j = 0; j < i; j++) {
+            assert_true(tj_array_get(array, j) != item);
+        }
+    }
+}
+
+static void test_array_index1(void **state) {
+    struct tj_array *array = *state;
+    int a, b, c, d;
+    init_array(array, &a, &b, &c, &d);
+
+    assert_true(tj_array_enableIndex(array));
+    assert_true(tj_array_enableIndex(array));
+
+    int e = 0;
+    assert_int_equal(tj_array_find(array, &a), 0);
+    assert_int_equal(tj_array_find(array, &b), 1);
+    assert_int_equal(tj_array_find(array, &c), 2);
+    assert_int_equal(tj_array_find(array, &d), 3);
+    assert_int_equal(tj_array_find(array, &e), -1);
+
+    tj_array_swapRemoveItem(array, &a);
+    assert_int_equal(tj_array_find(array, &a), -1);
+    assert_int_equal(tj_array_find(array, &d), 0);
+    expect_assert_failure(tj_array_swapRemoveItem(array, &e));
+
+    tj_array_removeItem(array, &d);
+    assert_int_equal(tj_array_find(array, &b), 0);
+    assert_int_equal(tj_array_find(array, &c), 1);
+
+    tj_array_clear(array);
+    assert_int_equal(tj_array_find(array, &b), -1);
+    assert_true(tj_array_append(array, &c));
+    assert_int_equal(tj_array_find(array, &c), 0);
+
+    tj_array_disableIndex(array);
+    assert_int_equal(tj_array_find(array, &c), 0);
+}
+
+static void test_array_index2(void **state) {
+    struct tj_array *array = *state;
+    int a, b, c, d;
+
+    assert_true(tj_array_enableIndex(array));
+
+    assert_true(tj_array_append(array, &a));
+    assert_true(tj_array_append(array, NULL));
+    assert_true(tj_array_append(array, &b));
+    assert_true(tj_array_append(array, &a));
+    assert_true(tj_array_append(array, &c));
+    assert_true(tj_array_append(array, &a));
+    assert_true(tj_array_append(array, NULL));
+    assert_true(tj_array_append(array, &d));
+    check_index(array);
+
+    assert_int_equal(tj_array_find(array, NULL), 1);
+
+    tj_array_remove(array, 0);
+    assert_int_equal(tj_array_find(array, &a), 2);
+    check_index(array);
+
+    tj_array_swapRemove(array, 0);
+    assert_int_equal(tj_array_find(array, NULL), 5);
+    check_index(array);
+
+    tj_array_removeRange(array, 1, 3);
+    check_index(array);
+
+    tj_array_swapRemoveItem(array, &d);
+    check_index(array);
+
+    tj_array_swapRemoveItem(array, NULL);
+    assert_int_equal(tj_array_find(array, NULL), -1);
+    check_index(array);
+}
+
+static void test_array_index3(void **state) {
+    struct tj_array *array = *state;
+    static int values[SCALE_COUNT];
+    size_t i;
+
+    for (i = 0; i < SCALE_COUNT / 2; i++) {
+        values[i] = i;
+        assert_true(tj_array_append(array, &values[i]));
+    }
+    assert_true(tj_array_enableIndex(array));
+    for (; i < SCALE_COUNT; i++) {
+        values[i] = i;
+        assert_true(tj_array_append(array, &values[i]));
+    }
+
+    for (i = 0; i < SCALE_COUNT; i++) {
+        assert_int_equal(tj_array_find(array, &values[i]), i);
+    }
+
+    /* Disconnect every third handle, in a scattered order. */
+    for (i = 0; i < SCALE_COUNT; i += 3) {
+        tj_array_swapRemoveItem(array, &values[(i * 7919) % SCALE_COUNT]);
+    }
+    assert_int_equal(tj_array_count(array), SCALE_COUNT - SCALE_COUNT / 3 - 1);
+
+    for (i = 0; i < tj_array_count(array); i++) {
+        assert_int_equal(tj_array_find(array, tj_array_get(array, i)), i);
+    }
+    for (i = 0; i < SCALE_COUNT; i += 3) {
+        assert_int_equal(tj_array_find(array,
+                                       &values[(i * 7919) % SCALE_COUNT]), -1);
+    }
+
+    size_t calls = 0;
+    tj_array_removeIf(array, &is_odd, &calls);
+    for (i = 0; i < tj_array_count(array); i++) {
+        assert_int_equal(*(int*)tj_array_get(array, i) % 2, 0);
+        assert_int_equal(tj_array_find(array, tj_array_get(array, i)), i);
+    }
+}
+
+static int int_cmp(const void *a, const void *b) {
+    return *(const int*)a - *(const int*)b;
+}
+
+static void check_sorted(struct tj_array *array) {
+    size_t i;
+    for (i = 1; i < tj_array_count(array); i++) {
+        assert_true(*(int*)tj_array_get(array, i - 1) <=
+                    *(int*)tj_array_get(array, i));
+    }
+}
+
+static void test_array_bounds(void **state) {
+    struct tj_array *array = *state;
+    int values[] = { 1, 3, 3, 3, 7, 9 };
+    int key;
+    size_t i;
+
+    for (i = 0; i < 6; i++) {
+        assert_true(tj_array_append(array, &values[i]));
+    }
+
+    key = 3;
+    assert_int_equal(tj_array_lowerBound(array, &key, &int_cmp), 1);
+    assert_int_equal(tj_array_upperBound(array, &key, &int_cmp), 4);
+    assert_int_equal(tj_array_bsearch(array, &key, &int_cmp), 1);
+
+    key = 0;
+    assert_int_equal(tj_array_lowerBound(array, &key, &int_cmp), 0);
+    assert_int_equal(tj_array_upperBound(array, &key, &int_cmp), 0);
+    assert_int_equal(tj_array_bsearch(array, &key, &int_cmp), -1);
+
+    key = 8;
+    assert_int_equal(tj_array_lowerBound(array, &key, &int_cmp), 5);
+    assert_int_equal(tj_array_bsearch(array, &key, &int_cmp), -1);
+
+    key = 10;
+    assert_int_equal(tj_array_lowerBound(array, &key, &int_cmp), 6);
+    assert_int_equal(tj_array_upperBound(array, &key, &int_cmp), 6);
+
+    tj_array_clear(array);
+    assert_int_equal(tj_array_lowerBound(array, &key, &int_cmp), 0);
+    assert_int_equal(tj_array_bsearch(array, &key, &int_cmp), -1);
+}
+
+static void test_array_insertSorted(void **state) {
+    struct tj_array *array = *state;
+    static int values[1000];
+    size_t i;
+
+    srand(7);
+    for (i = 0; i < 1000; i++) {
+        values[i] = rand() % 100;
+        assert_true(tj_array_insertSorted(array, &values[i], &int_cmp));
+    }
+    assert_int_equal(tj_array_count(array), 1000);
+    check_sorted(array);
+
+    /* Equal items stay in insertion order. */
+    for (i = 1; i < 1000; i++) {
+        int *a = tj_array_get(array, i - 1), *b = tj_array_get(array, i);
+        if (*a == *b) {
+            assert_true(a < b);
+        }
+    }
+}
+
+static void test_array_mergeSorted(void **state) {
+    struct tj_array *array = *state;
+    static int values[SCALE_COUNT];
+    static void *batch[SCALE_COUNT / 2];
+    size_t i;
+
+    for (i = 0; i < SCALE_COUNT; i++) {
+        values[i] = i;
+    }
+    for (i = 0; i < SCALE_COUNT / 2; i++) {
+        assert_true(tj_array_append(array, &values[2 * i]));
+        batch[i] = &values[2 * i + 1];
+    }
+    assert_true(tj_array_enableIndex(array));
+
+    assert_true(tj_array_mergeSorted(array, batch, SCALE_COUNT / 2,
+                                     &int_cmp));
+    assert_int_equal(tj_array_count(array), SCALE_COUNT);
+    for (i = 0; i < SCALE_COUNT; i++) {
+        assert_true(tj_array_get(array, i) == &values[i]);
+        assert_int_equal(tj_array_find(array, &values[i]), i);
+    }
+
+    assert_true(tj_array_mergeSorted(array, batch, 0, &int_cmp));
+    assert_int_equal(tj_array_count(array), SCALE_COUNT);
+}
+
+/* Counts multiples of x and y below n, in the manner of the set ops. */
+static void check_setop(struct tj_array *result, int n, int x, int y,
+                        int both, int either, int first) {
+    int v;
+    size_t i = 0;
+    for (v = 0; v < n; v++) {
+        int inx = (v % x == 0), iny = (v % y == 0);
+        if ((both && inx && iny) || (either && (inx || iny)) ||
+                (first && inx && !iny)) {
+            assert_true(i < tj_array_count(result));
+            assert_int_equal(*(int*)tj_array_get(result, i), v);
+            i++;
+        }
+    }
+    assert_int_equal(i, tj_array_count(result));
+}
+
+static void test_array_setops(void **state) {
+    static int values[SCALE_COUNT];
+    struct tj_array *a = tj_array_create(0);
+    struct tj_array *b = tj_array_create(0);
+    struct tj_array *skew = tj_array_create(0);
+    struct tj_array *out = *state;
+    size_t i;
+
+    for (i = 0; i < SCALE_COUNT; i++) {
+        values[i] = i;
+        if (i % 2 == 0) {
+            assert_true(tj_array_append(a, &values[i]));
+        }
+        if (i % 3 == 0) {
+            assert_true(tj_array_append(b, &values[i]));
+        }
+        if (i % 9973 == 0) {
+            assert_true(tj_array_append(skew, &values[i]));
+        }
+    }
+
+    assert_true(tj_array_union(out, a, b, &int_cmp));
+    check_setop(out, SCALE_COUNT, 2, 3, 0, 1, 0);
+    tj_array_clear(out);
+
+    assert_true(tj_array_intersection(out, a, b, &int_cmp));
+    check_setop(out, SCALE_COUNT, 2, 3, 1, 0, 0);
+    tj_array_clear(out);
+
+    assert_true(tj_array_difference(out, a, b, &int_cmp));
+    check_setop(out, SCALE_COUNT, 2, 3, 0, 0, 1);
+    tj_array_clear(out);
+
+    assert_true(tj_array_intersection(out, a, skew, &int_cmp));
+    check_setop(out, SCALE_COUNT, 2, 9973, 1, 0, 0);
+    tj_array_clear(out);
+
+    assert_true(tj_array_intersection(out, skew, a, &int_cmp));
+    check_setop(out, SCALE_COUNT, 9973, 2, 1, 0, 0);
+    tj_array_clear(out);
+
+    assert_true(tj_array_difference(out, skew, a, &int_cmp));
+    check_setop(out, SCALE_COUNT, 9973, 2, 0, 0, 1);
+    tj_array_clear(out);
+
+    assert_true(tj_array_union(out, skew, b, &int_cmp));
+    check_setop(out, SCALE_COUNT, 9973, 3, 0, 1, 0);
+    tj_array_clear(out);
+
+    expect_assert_failure(tj_array_union(a, a, b, &int_cmp));
+
+    tj_array_finalize(a);
+    tj_array_finalize(b);
+    tj_array_finalize(skew);
+}
+
+static void test_array_setops_duplicates(void **state) {
+    struct tj_array *a = tj_array_create(0);
+    struct tj_array *b = tj_array_create(0);
+    struct tj_array *out = *state;
+    int values[] = { 1, 2, 2, 2, 5 };
+
+    assert_true(tj_array_append(a, &values[0]));
+    assert_true(tj_array_append(a, &values[1]));
+    assert_true(tj_array_append(a, &values[2]));
+    assert_true(tj_array_append(b, &values[3]));
+    assert_true(tj_array_append(b, &values[4]));
+
+    assert_true(tj_array_union(out, a, b, &int_cmp));
+    assert_int_equal(tj_array_count(out), 4);
+    tj_array_clear(out);
+
+    assert_true(tj_array_intersection(out, a, b, &int_cmp));
+    assert_int_equal(tj_array_count(out), 1);
+    assert_true(tj_array_get(out, 0) == &values[1]);
+    tj_array_clear(out);
+
+    assert_true(tj_array_difference(out, a, b, &int_cmp));
+    assert_int_equal(tj_array_count(out), 2);
+    assert_true(tj_array_get(out, 0) == &values[0]);
+    assert_true(tj_array_get(out, 1) == &values[2]);
+
+    tj_array_finalize(a);
+    tj_array_finalize(b);
+}
+
+static void test_array_arena(void **state) {
+    static int values[SCALE_COUNT];
+    tj_arena *arena = tj_arena_create(0);
+    tj_arena_savepoint point = tj_arena_mark(arena);
+    size_t i;
+
+    struct tj_array *array = tj_array_createWithArena(2, arena);
+    assert_non_null(array);
+    assert_true(tj_array_enableIndex(array));
+    for (i = 0; i < SCALE_COUNT; i++) {
+        assert_true(tj_array_append(array, &values[i]));
+    }
+    for (i = 0; i < SCALE_COUNT; i += 1000) {
+        assert_int_equal(tj_array_find(array, &values[i]), i);
+    }
+    tj_array_finalize(array);
+
+    /* Rewinding releases everything the array used, for reuse. */
+    size_t allocated = tj_arena_getAllocated(arena);
+    tj_arena_rewind(arena, point);
+    array = tj_array_createWithArena(0, arena);
+    for (i = 0; i < SCALE_COUNT; i++) {
+        assert_true(tj_array_append(array, &values[i]));
+    }
+    assert_true(tj_arena_getAllocated(arena) <= allocated);
+
+    tj_arena_finalize(arena);
+}
+
 int main(int argc, char **argv) {
     const UnitTest tests[] = {
         unit_test(test_array_empty),
@@ -380,6 +856,22 @@ int main(int argc, char **argv) {
         unit_test_setup_teardown(test_array_find5, setup, teardown),
         unit_test_setup_teardown(test_array_clear1, setup, teardown),
         unit_test_setup_teardown(test_array_clear2, setup, teardown),
+        unit_test_setup_teardown(test_array_swapRemove1, setup, teardown),
+        unit_test_setup_teardown(test_array_swapRemove2, setup, teardown),
+        unit_test_setup_teardown(test_array_removeRange1, setup, teardown),
+        unit_test_setup_teardown(test_array_removeRange2, setup, teardown),
+        unit_test_setup_teardown(test_array_removeIf1, setup, teardown),
+        unit_test_setup_teardown(test_array_removeIf2, setup, teardown),
+        unit_test_setup_teardown(test_array_index1, setup, teardown),
+        unit_test_setup_teardown(test_array_index2, setup, teardown),
+        unit_test_setup_teardown(test_array_index3, setup, teardown),
+        unit_test_setup_teardown(test_array_bounds, setup, teardown),
+        unit_test_setup_teardown(test_array_insertSorted, setup, teardown),
+        unit_test_setup_teardown(test_array_mergeSorted, setup, teardown),
+        unit_test_setup_teardown(test_array_setops, setup, teardown),
+        unit_test(test_array_arena),
+        unit_test_setup_teardown(test_array_setops_duplicates, setup,
+                                 teardown),
     };
 
     return run_tests(tests);
@@ -0,0 +1,274 @@
+/*
+ * Copyright (c) 2013 Bellerophon Mobile, LLC.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cmocka.h"
+
+#define UNIT_TESTING
+#include "tj_bitset.c"
+
+#define NBITS 100000
+
+/* Reference set, one byte per bit. */
+static unsigned char ref[NBITS];
+
+static void check_ref(const tj_bitset *set) {
+    size_t i, count = 0;
+    for (i = 0; i < NBITS; i++) {
+        assert_int_equal(tj_bitset_test(set, i), ref[i]);
+        count += ref[i];
+    }
+    assert_int_equal(tj_bitset_count(set), count);
+
+    ssize_t bit = tj_bitset_next(set, 0);
+    for (i = 0; i < NBITS; i++) {
+        if (ref[i]) {
+            assert_int_equal(bit, i);
+            bit = tj_bitset_next(set, i + 1);
+        }
+    }
+    assert_int_equal(bit, -1);
+}
+
+/* Fills the reference with a mix of clusters and scattered bits. */
+static void fill(unsigned char *r, unsigned seed) {
+    size_t i;
+    srand(seed);
+    memset(r, 0, NBITS);
+    for (i = 0; i < 200; i++) {
+        size_t start = rand() % NBITS, len = rand() % 300, j;
+        for (j = start; j < start + len && j < NBITS; j++) {
+            r[j] = 1;
+        }
+    }
+    for (i = 0; i < 2000; i++) {
+        r[rand() % NBITS] = 1;
+    }
+}
+
+static tj_bitset *make(const unsigned char *r, int compressed) {
+    tj_bitset *set = tj_bitset_create(0);
+    size_t i;
+
+    assert_non_null(set);
+    if (compressed) {
+        assert_true(tj_bitset_optimize(set));
+        assert_true(tj_bitset_isCompressed(set));
+    }
+    for (i = 0; i < NBITS; i++) {
+        if (r[i]) {
+            assert_true(tj_bitset_set(set, i));
+        }
+    }
+    return set;
+}
+
+static void test_bitset_basic(void **state) {
+    tj_bitset *set = tj_bitset_create(10);
+
+    assert_int_equal(tj_bitset_count(set), 0);
+    assert_int_equal(tj_bitset_next(set, 0), -1);
+    assert_false(tj_bitset_test(set, 1000000));
+    assert_true(tj_bitset_clear(set, 1000000));
+
+    assert_true(tj_bitset_set(set, 0));
+    assert_true(tj_bitset_set(set, 63));
+    assert_true(tj_bitset_set(set, 64));
+    assert_true(tj_bitset_set(set, 1000000));
+    assert_true(tj_bitset_set(set, 1000000));
+    assert_int_equal(tj_bitset_count(set), 4);
+    assert_true(tj_bitset_test(set, 63));
+    assert_false(tj_bitset_test(set, 62));
+
+    assert_int_equal(tj_bitset_next(set, 0), 0);
+    assert_int_equal(tj_bitset_next(set, 1), 63);
+    assert_int_equal(tj_bitset_next(set, 65), 1000000);
+    assert_int_equal(tj_bitset_next(set, 1000001), -1);
+
+    assert_true(tj_bitset_clear(set, 63));
+    assert_false(tj_bitset_test(set, 63));
+    assert_int_equal(tj_bitset_count(set), 3);
+
+    tj_bitset_reset(set);
+    assert_int_equal(tj_bitset_count(set), 0);
+    assert_true(tj_bitset_memoryUsage(set) > 0);
+
+    tj_bitset_finalize(set);
+}
+
+static void test_bitset_runs(void **state) {
+    memset(ref, 0, NBITS);
+    tj_bitset *set = make(ref, 1);
+
+    /* Runs extend, merge and split. */
+    assert_true(tj_bitset_set(set, 10));
+    assert_true(tj_bitset_set(set, 12));
+    assert_true(tj_bitset_set(set, 11));
+    assert_true(tj_bitset_set(set, 9));
+    assert_true(tj_bitset_set(set, 13));
+    assert_int_equal(set->nruns, 1);
+    assert_true(tj_bitset_clear(set, 11));
+    assert_int_equal(set->nruns, 2);
+    assert_true(tj_bitset_clear(set, 9));
+    assert_true(tj_bitset_clear(set, 13));
+    assert_int_equal(tj_bitset_count(set), 2);
+    assert_int_equal(tj_bitset_next(set, 0), 10);
+    assert_int_equal(tj_bitset_next(set, 11), 12);
+    assert_true(tj_bitset_clear(set, 10));
+    assert_true(tj_bitset_clear(set, 12));
+    assert_int_equal(set->nruns, 0);
+    tj_bitset_finalize(set);
+
+    /* Random changes against the reference, in both modes. */
+    int compressed;
+    for (compressed = 0; compressed < 2; compressed++) {
+        size_t i;
+        fill(ref, 7);
+        set = make(ref, compressed);
+        check_ref(set);
+
+        srand(11);
+        for (i = 0; i < 20000; i++) {
+            size_t bit = rand() % NBITS;
+            if (rand() % 2) {
+                assert_true(tj_bitset_set(set, bit));
+                ref[bit] = 1;
+            } else {
+                assert_true(tj_bitset_clear(set, bit));
+                ref[bit] = 0;
+            }
+        }
+        check_ref(set);
+        assert_int_equal(tj_bitset_isCompressed(set), compressed);
+        tj_bitset_finalize(set);
+    }
+}
+
+static void test_bitset_ops(void **state) {
+    static unsigned char a[NBITS], b[NBITS];
+    int (*ops[])(tj_bitset *, const tj_bitset *) = {
+        &tj_bitset_and, &tj_bitset_or, &tj_bitset_xor, &tj_bitset_andNot,
+    };
+    size_t op, i;
+    int mode;
+
+    fill(a, 1);
+    fill(b, 2);
+    /* Give b a longer tail than a, to cover sets of different sizes. */
+    for (i = NBITS - 100; i < NBITS; i++) {
+        a[i] = 0;
+    }
+
+    for (op = 0; op < 4; op++) {
+        for (mode = 0; mode < 4; mode++) {
+            tj_bitset *dest = make(a, mode & 1);
+            tj_bitset *src = make(b, mode & 2);
+
+            assert_true(ops[op](dest, src));
+            assert_int_equal(tj_bitset_isCompressed(dest), mode & 1);
+            for (i = 0; i < NBITS; i++) {
+                switch (op) {
+                case 0: ref[i] = a[i] & b[i]; break;
+                case 1: ref[i] = a[i] | b[i]; break;
+                case 2: ref[i] = a[i] ^ b[i]; break;
+                case 3: ref[i] = a[i] & !b[i]; break;
+                }
+            }
+            check_ref(dest);
+
+            tj_bitset_finalize(dest);
+            tj_bitset_finalize(src);
+        }
+    }
+}
+
+static void test_bitset_self(void **state) {
+    int mode;
+    for (mode = 0; mode < 2; mode++) {
+        fill(ref, 3);
+        tj_bitset *set = make(ref, mode);
+
+        assert_true(tj_bitset_or(set, set));
+        assert_true(tj_bitset_and(set, set));
+        check_ref(set);
+        assert_true(tj_bitset_xor(set, set));
+        assert_int_equal(tj_bitset_count(set), 0);
+
+        tj_bitset_finalize(set);
+    }
+}
+
+static void test_bitset_optimize(void **state) {
+    size_t i;
+
+    /* A few long runs compress. */
+    memset(ref, 0, NBITS);
+    for (i = 1000; i < 50000; i++) {
+        ref[i] = 1;
+    }
+    tj_bitset *set = make(ref, 0);
+    size_t before = tj_bitset_memoryUsage(set);
+    assert_false(tj_bitset_isCompressed(set));
+    assert_true(tj_bitset_optimize(set));
+    assert_true(tj_bitset_isCompressed(set));
+    assert_true(tj_bitset_memoryUsage(set) < before);
+    check_ref(set);
+
+    tj_bitset *copy = tj_bitset_copy(set);
+    assert_true(tj_bitset_isCompressed(copy));
+    check_ref(copy);
+    tj_bitset_finalize(copy);
+
+    /* Alternating bits go back to a bitmap. */
+    for (i = 0; i < NBITS; i += 2) {
+        assert_true(tj_bitset_set(set, i));
+        ref[i] = 1;
+    }
+    assert_true(tj_bitset_optimize(set));
+    assert_false(tj_bitset_isCompressed(set));
+    check_ref(set);
+
+    copy = tj_bitset_copy(set);
+    check_ref(copy);
+    tj_bitset_finalize(copy);
+    tj_bitset_finalize(set);
+}
+
+int main(int argc, char *argv[]) {
+    const UnitTest tests[] = {
+        unit_test(test_bitset_basic),
+        unit_test(test_bitset_runs),
+        unit_test(test_bitset_ops),
+        unit_test(test_bitset_self),
+        unit_test(test_bitset_optimize),
+    };
+
+    return run_tests(tests);
+}
@@ -438,6 +438,32 @@ static void test_escape4(void **state) {
 }
 
 
+static void test_arena(void **state) {
+  tj_arena *arena = tj_arena_create(0);
+  tj_arena_savepoint point = tj_arena_mark(arena);
+  int i;
+
+  tj_buffer *buff = tj_buffer_createWithArena(4, arena);
+  assert_non_null(buff);
+  assert_int_equal(tj_buffer_getAllocated(buff), 4);
+
+  for (i = 0; i < 1000; i++)
+    assert_true(tj_buffer_printf(buff, "%d,", i));
+  assert_memory_equal(tj_buffer_getBytes(buff), "0,1,2,", 6);
+  assert_true(tj_buffer_getAllocated(buff) < 2 * tj_buffer_getUsed(buff));
+
+  // The data grows in place at the end of the arena's first chunk.
+  assert_true(tj_arena_getAllocated(arena) <= 64 * 1024);
+  tj_buffer_finalize(buff);
+
+  tj_arena_rewind(arena, point);
+  buff = tj_buffer_createWithArena(0, arena);
+  assert_true(tj_buffer_appendAsString(buff, "HELLO"));
+  assert_string_equal(tj_buffer_getBytes(buff), "HELLO");
+
+  tj_arena_finalize(arena);
+}
+
 int main(int argc, char *argv[]) {
     if (argc > 0) {
         argv0 = argv[0];
@@ -487,6 +513,8 @@ int main(int argc, char *argv[]) {
         unit_test_setup_teardown(test_escape2, setup, teardown),
         unit_test_setup_teardown(test_escape3, setup, teardown),
         unit_test_setup_teardown(test_escape4, setup, teardown),
+
+        unit_test(test_arena),
     };
 
     return run_tests(tests);
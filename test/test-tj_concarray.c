@@ -0,0 +1,189 @@
+/*
+ * Copyright (c) 2013 Bellerophon Mobile, LLC.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <pthread.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cmocka.h"
+
+#define UNIT_TESTING
+#include "tj_concarray.c"
+
+#define THREADS 8
+#define PER_THREAD 100000
+
+typedef struct {
+    int thread;
+    int seq;
+} record;
+
+typedef struct {
+    tj_concarray *array;
+    int thread;
+    int done;
+    int failed;
+} worker;
+
+static void setup(void **state) {
+    tj_concarray *array = tj_concarray_create(sizeof(record));
+    assert_non_null(array);
+
+    *state = (void*)array;
+}
+
+static void teardown(void **state) {
+    tj_concarray *array = *state;
+    if (array != NULL) {
+        tj_concarray_finalize(array);
+    }
+}
+
+static void *append_worker(void *arg) {
+    worker *w = arg;
+    record r;
+    r.thread = w->thread;
+    for (r.seq = 1; r.seq <= PER_THREAD; r.seq++) {
+        if (!tj_concarray_append(w->array, &r)) {
+            w->failed = 1;
+        }
+    }
+    __atomic_store_n(&w->done, 1, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+/* Checks every element below each snapshot is fully written. */
+static void *read_worker(void *arg) {
+    worker *w = arg;
+    size_t count, prev = 0, i;
+    do {
+        count = tj_concarray_count(w->array);
+        if (count < prev) {
+            w->failed = 1;
+        }
+        for (i = prev; i < count; i++) {
+            record *r = tj_concarray_get(w->array, i);
+            if (r->seq < 1 || r->seq > PER_THREAD ||
+                    r->thread < 0 || r->thread >= THREADS) {
+                w->failed = 1;
+            }
+        }
+        prev = count;
+    } while (count < THREADS * PER_THREAD && !w->failed);
+    return NULL;
+}
+
+static void test_concarray_empty(void **state) {
+    tj_concarray *array = *state;
+    size_t n = 1;
+
+    assert_int_equal(tj_concarray_count(array), 0);
+    assert_null(tj_concarray_getChunk(array, 0, 0, &n));
+    assert_int_equal(n, 0);
+    expect_assert_failure(tj_concarray_get(array, 0));
+    expect_assert_failure(tj_concarray_getChunk(array, 1, 0, &n));
+    expect_assert_failure(tj_concarray_create(0));
+}
+
+static void test_concarray_append(void **state) {
+    tj_concarray *array = *state;
+    record r;
+    size_t i, chunk, n, seen = 0;
+
+    assert_true(tj_concarray_reserve(array, 1000));
+    for (r.seq = 0; r.seq < 1000; r.seq++) {
+        r.thread = 0;
+        assert_true(tj_concarray_append(array, &r));
+    }
+    assert_int_equal(tj_concarray_count(array), 1000);
+
+    for (i = 0; i < 1000; i++) {
+        assert_int_equal(((record*)tj_concarray_get(array, i))->seq, i);
+    }
+    expect_assert_failure(tj_concarray_get(array, 1000));
+
+    record *chunkp;
+    for (chunk = 0; (chunkp = tj_concarray_getChunk(array, 1000, chunk, &n));
+            chunk++) {
+        for (i = 0; i < n; i++) {
+            assert_int_equal(chunkp[i].seq, seen + i);
+        }
+        seen += n;
+    }
+    assert_int_equal(seen, 1000);
+}
+
+static void test_concarray_threads(void **state) {
+    tj_concarray *array = *state;
+    pthread_t tids[THREADS + 1];
+    worker workers[THREADS + 1];
+    int i;
+
+    for (i = 0; i <= THREADS; i++) {
+        workers[i].array = array;
+        workers[i].thread = i;
+        workers[i].done = 0;
+        workers[i].failed = 0;
+    }
+
+    assert_int_equal(pthread_create(&tids[THREADS], NULL, &read_worker,
+                                    &workers[THREADS]), 0);
+    for (i = 0; i < THREADS; i++) {
+        assert_int_equal(pthread_create(&tids[i], NULL, &append_worker,
+                                        &workers[i]), 0);
+    }
+    for (i = 0; i <= THREADS; i++) {
+        pthread_join(tids[i], NULL);
+        assert_false(workers[i].failed);
+    }
+
+    size_t count = tj_concarray_count(array);
+    assert_int_equal(count, THREADS * PER_THREAD);
+
+    /* Each thread's elements appear in the order it appended them. */
+    int last[THREADS];
+    memset(last, 0, sizeof(last));
+    size_t j;
+    for (j = 0; j < count; j++) {
+        record *r = tj_concarray_get(array, j);
+        assert_int_equal(r->seq, last[r->thread] + 1);
+        last[r->thread] = r->seq;
+    }
+    for (i = 0; i < THREADS; i++) {
+        assert_int_equal(last[i], PER_THREAD);
+    }
+}
+
+int main(int argc, char **argv) {
+    const UnitTest tests[] = {
+        unit_test_setup_teardown(test_concarray_empty, setup, teardown),
+        unit_test_setup_teardown(test_concarray_append, setup, teardown),
+        unit_test_setup_teardown(test_concarray_threads, setup, teardown),
+    };
+
+    return run_tests(tests);
+}
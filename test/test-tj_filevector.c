@@ -0,0 +1,153 @@
+/*
+ * Copyright (c) 2013 Bellerophon Mobile, LLC.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cmocka.h"
+
+#define UNIT_TESTING
+#include "tj_filevector.c"
+
+#define COUNT 100000
+
+typedef struct {
+    int id;
+    double value;
+} record;
+
+static char path[] = "/tmp/test-tj_filevectorXXXXXX";
+
+static void setup(void **state) {
+    int fd = mkstemp(path);
+    assert_true(fd >= 0);
+    close(fd);
+}
+
+static void teardown(void **state) {
+    unlink(path);
+    strcpy(path + strlen(path) - 6, "XXXXXX");
+}
+
+static void fill(tj_filevector *v, size_t n) {
+    size_t i;
+    for (i = 0; i < n; i++) {
+        record r = { i, i * 0.5 };
+        assert_non_null(tj_filevector_append(v, &r));
+    }
+}
+
+static void test_filevector_reopen(void **state) {
+    tj_filevector *v = tj_filevector_open(path, sizeof(record), 0);
+    size_t i;
+
+    assert_non_null(v);
+    assert_int_equal(tj_filevector_count(v), 0);
+    fill(v, COUNT);
+    assert_int_equal(tj_filevector_count(v), COUNT);
+    assert_true(tj_filevector_capacity(v) >= COUNT);
+    assert_true(tj_filevector_close(v));
+
+    v = tj_filevector_open(path, sizeof(record),
+                           TJ_FILEVECTOR_READONLY | TJ_FILEVECTOR_VERIFY);
+    assert_non_null(v);
+    assert_int_equal(tj_filevector_count(v), COUNT);
+    for (i = 0; i < COUNT; i++) {
+        record *r = tj_filevector_get(v, i);
+        assert_int_equal(r->id, i);
+        assert_true(r->value == i * 0.5);
+    }
+    assert_null(tj_filevector_append(v, NULL));
+    assert_false(tj_filevector_sync(v));
+    expect_assert_failure(tj_filevector_get(v, COUNT));
+    assert_true(tj_filevector_close(v));
+
+    /* Reopened for writing, appends continue from the end. */
+    v = tj_filevector_open(path, sizeof(record), TJ_FILEVECTOR_VERIFY);
+    assert_non_null(v);
+    record *r = tj_filevector_append(v, NULL);
+    assert_non_null(r);
+    assert_int_equal(r->id, 0);
+    tj_filevector_truncate(v, 10);
+    assert_int_equal(tj_filevector_count(v), 10);
+    assert_int_equal(((record *) tj_filevector_data(v))[9].id, 9);
+    assert_true(tj_filevector_close(v));
+
+    v = tj_filevector_open(path, sizeof(record), TJ_FILEVECTOR_VERIFY);
+    assert_non_null(v);
+    assert_int_equal(tj_filevector_count(v), 10);
+    assert_true(tj_filevector_close(v));
+}
+
+static void test_filevector_invalid(void **state) {
+    tj_filevector *v;
+
+    assert_null(tj_filevector_open("/nonexistent/dir/file", 4,
+                                   TJ_FILEVECTOR_CREATE));
+    assert_null(tj_filevector_open(path, 4, TJ_FILEVECTOR_READONLY));
+
+    v = tj_filevector_open(path, sizeof(record), 0);
+    fill(v, 100);
+    assert_true(tj_filevector_reserve(v, 1000));
+    assert_true(tj_filevector_capacity(v) >= 1000);
+
+    /* Still open for writing, so not clean. */
+    assert_null(tj_filevector_open(path, sizeof(record),
+                                   TJ_FILEVECTOR_VERIFY));
+    assert_true(tj_filevector_close(v));
+
+    assert_null(tj_filevector_open(path, sizeof(record) + 1, 0));
+
+    /* Corrupt an element behind the vector's back. */
+    int fd = open(path, O_RDWR);
+    int bad = 12345;
+    assert_int_equal(pwrite(fd, &bad, sizeof(bad),
+                            HEADER_SIZE + 50 * sizeof(record)), sizeof(bad));
+    close(fd);
+
+    assert_null(tj_filevector_open(path, sizeof(record),
+                                   TJ_FILEVECTOR_VERIFY));
+    v = tj_filevector_open(path, sizeof(record), 0);
+    assert_non_null(v);
+    assert_int_equal(((record *) tj_filevector_get(v, 50))->id, bad);
+    assert_true(tj_filevector_close(v));
+
+    /* Not a vector file at all. */
+    fd = open(path, O_RDWR | O_TRUNC);
+    assert_int_equal(write(fd, "hello", 5), 5);
+    close(fd);
+    assert_null(tj_filevector_open(path, sizeof(record), 0));
+}
+
+int main(int argc, char *argv[]) {
+    const UnitTest tests[] = {
+        unit_test_setup_teardown(test_filevector_reopen, setup, teardown),
+        unit_test_setup_teardown(test_filevector_invalid, setup, teardown),
+    };
+
+    return run_tests(tests);
+}
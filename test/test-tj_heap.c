@@ -25,6 +25,7 @@
 #include <setjmp.h>
 #include <stdarg.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -41,6 +42,21 @@
     assert_string_equal(v, value); \
 } while (0)
 
+/* Elements with equal keys may come out in either order. */
+#define INT_POP_PAIR(key, value1, value2) do { \
+    char *first = NULL; \
+    assert_true(intheap_pop(heap, &k, &first)); \
+    assert_int_equal(k, key); \
+    assert_true(intheap_pop(heap, &k, &v)); \
+    assert_int_equal(k, key); \
+    if (strcmp(first, value1) == 0) { \
+        assert_string_equal(v, value2); \
+    } else { \
+        assert_string_equal(first, value2); \
+        assert_string_equal(v, value1); \
+    } \
+} while (0)
+
 #define FLT_PEEK_POP(key) do { \
     assert_true(floatheap_peek(heap, &k, &v)); \
     assert_in_range(k, key, key + 0.1); \
@@ -53,9 +69,67 @@
 static int intless(int a, int b) { return a  < b; }
 static int intfind(void *d, int k, char *v) { return (strcmp(v, d) == 0); }
 TJ_HEAP_DECL(intheap, int, char *, intless);
+TJ_HEAP_IMPL(intheap);
 
 static int floatmore(float a, float b) { return a  > b; }
 TJ_HEAP_DECL(floatheap, float, char *, floatmore);
+TJ_HEAP_IMPL(floatheap);
+
+#define INT_GREATER(a, b) ((a) > (b))
+TJ_HEAP_DECL(maxheap, int, int, INT_GREATER);
+TJ_HEAP_IMPL(maxheap);
+
+TJ_HEAP_DECL(quadheap, int, int, intless);
+TJ_HEAP_IMPL(quadheap);
+TJ_HEAP_DECL_ARITY(binheap, int, int, intless, 2);
+TJ_HEAP_IMPL(binheap);
+TJ_HEAP_DECL_ARITY(octheap, int, int, intless, 8);
+TJ_HEAP_IMPL(octheap);
+TJ_HEAP_DECL_SPLIT(splitheap, int, int, intless, 4);
+TJ_HEAP_IMPL(splitheap);
+
+TJ_INDEXED_HEAP_DECL(pqueue, int, int, intless);
+TJ_INDEXED_HEAP_IMPL(pqueue);
+
+TJ_TOPK_DECL(topk, int, int, intless);
+TJ_TOPK_IMPL(topk);
+
+TJ_RADIX_HEAP_DECL(radixheap, unsigned int, int);
+TJ_RADIX_HEAP_IMPL(radixheap);
+TJ_RADIX_HEAP_DECL(radix64, uint64_t, uint64_t);
+TJ_RADIX_HEAP_IMPL(radix64);
+
+#define RANDOM_COUNT 10000
+
+/*
+ * Fill a heap with random keys, each valued with its own negation,
+ * remove a scattering of elements from the middle, then check that
+ * everything left comes out in order.
+ */
+#define CHECK_RANDOM(heaptype) do { \
+    heaptype *h = heaptype##_create(0); \
+    int i, k, v, prev, count = 0; \
+    assert_non_null(h); \
+    srand(42); \
+    for (i = 0; i < RANDOM_COUNT; i++) { \
+        k = rand() % 1000; \
+        assert_true(heaptype##_add(h, k, -k)); \
+    } \
+    for (i = 0; i < RANDOM_COUNT / 10; i++) { \
+        assert_true(heaptype##_remove(h, rand() % (RANDOM_COUNT - i), \
+                                      &k, &v)); \
+        assert_int_equal(v, -k); \
+    } \
+    prev = -1; \
+    while (heaptype##_pop(h, &k, &v)) { \
+        assert_true(prev <= k); \
+        assert_int_equal(v, -k); \
+        prev = k; \
+        count++; \
+    } \
+    assert_int_equal(count, RANDOM_COUNT - RANDOM_COUNT / 10); \
+    heaptype##_finalize(h); \
+} while (0)
 
 static void int_setup(void **state) {
     intheap *heap = intheap_create(4);
@@ -103,15 +177,13 @@ static void test_int_min(void **state) {
     int k = 0;
     char *v = NULL;
 
-    INT_PEEK_POP(23, "a1");
-    INT_PEEK_POP(23, "a2");
+    INT_POP_PAIR(23, "a1", "a2");
     INT_PEEK_POP(80, "b");
     INT_PEEK_POP(90, "c");
     INT_PEEK_POP(234, "d");
     INT_PEEK_POP(467, "d");
     INT_PEEK_POP(468, "e");
-    INT_PEEK_POP(500, "f1");
-    INT_PEEK_POP(500, "f2");
+    INT_POP_PAIR(500, "f1", "f2");
     INT_PEEK_POP(900, "g");
     INT_PEEK_POP(923, "h");
 
@@ -162,8 +234,8 @@ static void test_float_max(void **state) {
     floatheap_add(heap, 7.8, "7.8");
     floatheap_add(heap, 4.0, "4.0");
 
-    float k;
-    char *v;
+    float k = 0;
+    char *v = NULL;
 
     FLT_PEEK_POP(7.8);
     FLT_PEEK_POP(4.0);
@@ -175,11 +247,360 @@ static void test_float_max(void **state) {
     assert_false(floatheap_pop(heap, &k, &v));
 }
 
+static void test_arity(void **state) {
+    CHECK_RANDOM(quadheap);
+    CHECK_RANDOM(binheap);
+    CHECK_RANDOM(octheap);
+    CHECK_RANDOM(splitheap);
+}
+
+static void test_macro_comparator(void **state) {
+    maxheap *h = maxheap_create(2);
+    int i, k = 0, v = 0;
+
+    for (i = 0; i < 100; i++) {
+        assert_true(maxheap_add(h, (i * 37) % 100, i));
+    }
+    for (i = 99; i >= 0; i--) {
+        assert_true(maxheap_pop(h, &k, &v));
+        assert_int_equal(k, i);
+        assert_int_equal((v * 37) % 100, i);
+    }
+    assert_false(maxheap_pop(h, &k, &v));
+
+    maxheap_finalize(h);
+}
+
+/* Bulk operations, on heaps of each layout. */
+#define CHECK_BULK(heaptype) do { \
+    heaptype *h = heaptype##_create(1); \
+    heaptype##_element *in = malloc(RANDOM_COUNT * sizeof(*in)); \
+    heaptype##_element *out = malloc(RANDOM_COUNT * sizeof(*out)); \
+    size_t i, n; \
+    srand(11); \
+    for (i = 0; i < RANDOM_COUNT; i++) { \
+        in[i].m_key = rand() % 5000; \
+        in[i].m_value = -in[i].m_key; \
+    } \
+    assert_true(heaptype##_add(h, -1, 1)); \
+    assert_true(heaptype##_buildFrom(h, in, RANDOM_COUNT)); \
+    assert_true(h->m_n >= RANDOM_COUNT); \
+    n = heaptype##_popN(h, out, 100); \
+    assert_int_equal(n, 100); \
+    for (i = 1; i < n; i++) { \
+        assert_true(out[i-1].m_key <= out[i].m_key); \
+        assert_int_equal(out[i].m_value, -out[i].m_key); \
+    } \
+    /* A small batch is sifted in, a large one heapified. */ \
+    assert_true(heaptype##_addBatch(h, out, 10)); \
+    assert_true(heaptype##_addBatch(h, in, RANDOM_COUNT)); \
+    n = heaptype##_popN(h, out, RANDOM_COUNT); \
+    assert_int_equal(n, RANDOM_COUNT); \
+    for (i = 1; i < n; i++) { \
+        assert_true(out[i-1].m_key <= out[i].m_key); \
+    } \
+    n = heaptype##_popN(h, out, RANDOM_COUNT); \
+    assert_int_equal(n, RANDOM_COUNT - 100 + 10); \
+    assert_int_equal(heaptype##_popN(h, out, 1), 0); \
+    /* Clearing keeps the capacity. */ \
+    assert_true(heaptype##_reserve(h, 3 * RANDOM_COUNT)); \
+    size_t capacity = h->m_n; \
+    assert_true(heaptype##_addBatch(h, in, 5)); \
+    heaptype##_clear(h); \
+    assert_int_equal(h->m_used, 0); \
+    assert_int_equal(h->m_n, capacity); \
+    assert_true(heaptype##_buildFrom(h, in, 0)); \
+    assert_int_equal(heaptype##_popN(h, out, 1), 0); \
+    free(in); \
+    free(out); \
+    heaptype##_finalize(h); \
+} while (0)
+
+static void test_bulk(void **state) {
+    CHECK_BULK(quadheap);
+    CHECK_BULK(binheap);
+    CHECK_BULK(octheap);
+    CHECK_BULK(splitheap);
+}
+
+static void test_indexed(void **state) {
+    pqueue *q = pqueue_create(0);
+    pqueue_handle a, b, c, handle = 0;
+    int k = 0, v = 0;
+
+    assert_true(pqueue_add(q, 30, 3, &a));
+    assert_true(pqueue_add(q, 10, 1, &b));
+    assert_true(pqueue_add(q, 20, 2, &c));
+    assert_int_equal(pqueue_count(q), 3);
+
+    assert_true(pqueue_peek(q, &k, &v, &handle));
+    assert_int_equal(k, 10);
+    assert_true(handle == b);
+
+    /* Raise the minimum, and lower another past it. */
+    assert_true(pqueue_updateKey(q, b, 40));
+    assert_true(pqueue_updateKey(q, a, 5));
+    assert_true(pqueue_get(q, b, &k, &v));
+    assert_int_equal(k, 40);
+    assert_int_equal(v, 1);
+
+    assert_true(pqueue_removeHandle(q, c, &k, &v));
+    assert_int_equal(k, 20);
+    assert_int_equal(v, 2);
+    assert_false(pqueue_contains(q, c));
+    assert_false(pqueue_removeHandle(q, c, &k, &v));
+    assert_false(pqueue_updateKey(q, c, 1));
+
+    assert_true(pqueue_pop(q, &k, &v));
+    assert_int_equal(k, 5);
+    assert_int_equal(v, 3);
+    assert_false(pqueue_contains(q, a));
+    assert_true(pqueue_contains(q, b));
+    assert_true(pqueue_pop(q, &k, &v));
+    assert_int_equal(k, 40);
+    assert_false(pqueue_pop(q, &k, &v));
+    assert_false(pqueue_contains(q, 12345));
+
+    pqueue_finalize(q);
+}
+
+/* Random adds, rekeys, removes and pops, checked against a plain array. */
+static void test_indexed_random(void **state) {
+    static int keys[RANDOM_COUNT];
+    static pqueue_handle handles[RANDOM_COUNT];
+    pqueue *q = pqueue_create(16);
+    pqueue_handle top = 0;
+    int live = 0, i, j, k = 0, v = 0, min;
+
+    srand(7);
+    for (i = 0; i < 20 * RANDOM_COUNT; i++) {
+        int op = rand() % 4;
+        if (live < RANDOM_COUNT && (op == 0 || live == 0)) {
+            keys[live] = rand() % 100000;
+            assert_true(pqueue_add(q, keys[live], 0, &handles[live]));
+            live++;
+            continue;
+        }
+
+        j = rand() % live;
+        if (op == 1) {
+            keys[j] = rand() % 100000;
+            assert_true(pqueue_updateKey(q, handles[j], keys[j]));
+            continue;
+        }
+
+        if (op == 2) {
+            assert_true(pqueue_removeHandle(q, handles[j], &k, &v));
+            assert_int_equal(k, keys[j]);
+        } else {
+            min = 0;
+            for (j = 1; j < live; j++) {
+                if (keys[j] < keys[min]) {
+                    min = j;
+                }
+            }
+            /* Ties may come out in any order, so see which did. */
+            assert_true(pqueue_peek(q, &k, &v, &top));
+            assert_int_equal(k, keys[min]);
+            for (j = 0; j < live && handles[j] != top; j++) {
+            }
+            assert_true(j < live);
+            assert_int_equal(keys[j], k);
+            assert_true(pqueue_pop(q, &k, &v));
+        }
+        assert_false(pqueue_contains(q, handles[j]));
+
+        live--;
+        keys[j] = keys[live];
+        handles[j] = handles[live];
+        assert_int_equal((int) pqueue_count(q), live);
+    }
+
+    pqueue_finalize(q);
+}
+
+static int intdesc(const void *a, const void *b) {
+    return *(const int *) b - *(const int *) a;
+}
+
+static void test_topk(void **state) {
+    static int keys[RANDOM_COUNT];
+    topk *t = topk_create(100);
+    topk_element out[100];
+    int i, k = 0;
+
+    /* Fewer than k come back as they are, in order. */
+    assert_false(topk_threshold(t, &k));
+    assert_true(topk_offer(t, 5, -5));
+    assert_true(topk_offer(t, 9, -9));
+    assert_true(topk_offer(t, 7, -7));
+    assert_int_equal(topk_drain(t, out), 3);
+    assert_int_equal(out[0].m_key, 9);
+    assert_int_equal(out[1].m_key, 7);
+    assert_int_equal(out[2].m_key, 5);
+    assert_int_equal(topk_count(t), 0);
+
+    srand(13);
+    for (i = 0; i < RANDOM_COUNT; i++) {
+        keys[i] = rand() % 100000;
+        topk_offer(t, keys[i], -keys[i]);
+    }
+    assert_int_equal(topk_count(t), 100);
+    qsort(keys, RANDOM_COUNT, sizeof(int), &intdesc);
+
+    /* Anything not above the threshold is turned away. */
+    assert_true(topk_threshold(t, &k));
+    assert_int_equal(k, keys[99]);
+    assert_false(topk_offer(t, k, 0));
+    assert_false(topk_offer(t, -1, 0));
+
+    assert_int_equal(topk_drain(t, out), 100);
+    for (i = 0; i < 100; i++) {
+        assert_int_equal(out[i].m_key, keys[i]);
+        assert_int_equal(out[i].m_value, -keys[i]);
+    }
+    topk_finalize(t);
+
+    t = topk_create(0);
+    assert_false(topk_offer(t, 1, 1));
+    assert_int_equal(topk_count(t), 0);
+    topk_finalize(t);
+}
+
+static void test_replace_top(void **state) {
+    quadheap *h = quadheap_create(4);
+    int k = 0, v = 0;
+
+    assert_false(quadheap_replaceTop(h, 1, 1));
+    assert_true(quadheap_add(h, 3, 3));
+    assert_true(quadheap_add(h, 5, 5));
+    assert_true(quadheap_add(h, 4, 4));
+    assert_true(quadheap_replaceTop(h, 6, 6));
+    assert_true(quadheap_pop(h, &k, &v));
+    assert_int_equal(k, 4);
+    assert_true(quadheap_replaceTop(h, 1, 1));
+    assert_true(quadheap_pop(h, &k, &v));
+    assert_int_equal(k, 1);
+    assert_true(quadheap_pop(h, &k, &v));
+    assert_int_equal(k, 6);
+    assert_false(quadheap_pop(h, &k, &v));
+    quadheap_finalize(h);
+}
+
+static void test_radix(void **state) {
+    radixheap *r = radixheap_create(4);
+    quadheap *q = quadheap_create(4);
+    unsigned int last = 0, rk = 0;
+    int i, qk = 0, qv = 0, rv = 0;
+
+    /* Check the order against a comparison heap under a mixed load. */
+    srand(5);
+    for (i = 0; i < 20 * RANDOM_COUNT; i++) {
+        if (rand() % 3 != 0 || q->m_used == 0) {
+            unsigned int k = last + rand() % ((i % 2) ? 1000 : 1000000);
+            assert_true(radixheap_add(r, k, -(int) k));
+            assert_true(quadheap_add(q, k, -(int) k));
+            continue;
+        }
+        assert_true(quadheap_pop(q, &qk, &qv));
+        assert_true(radixheap_peek(r, &rk, &rv));
+        assert_int_equal(rk, qk);
+        assert_true(radixheap_pop(r, &rk, &rv));
+        assert_int_equal(rk, qk);
+        assert_int_equal(rv, qv);
+        assert_int_equal(radixheap_count(r), q->m_used);
+        last = rk;
+    }
+
+    /* Keys may repeat the last one popped but not go below it. */
+    assert_true(radixheap_add(r, last, 1));
+    assert_false(last > 0 && radixheap_add(r, last - 1, 1));
+    assert_true(radixheap_pop(r, &rk, &rv));
+    assert_int_equal(rk, last);
+    while (radixheap_pop(r, &rk, &rv)) {
+        assert_true(rk >= last);
+        last = rk;
+    }
+    assert_int_equal(radixheap_count(r), 0);
+    assert_false(radixheap_peek(r, &rk, &rv));
+
+    radixheap_finalize(r);
+    quadheap_finalize(q);
+}
+
+static void test_radix64(void **state) {
+    radix64 *r = radix64_create(0);
+    uint64_t keys[] = { UINT64_MAX, 0, UINT64_MAX - 1, 1ULL << 63,
+                        (1ULL << 63) - 1, 42, 42, 1ULL << 32 };
+    uint64_t sorted[] = { 0, 42, 42, 1ULL << 32, (1ULL << 63) - 1,
+                          1ULL << 63, UINT64_MAX - 1, UINT64_MAX };
+    uint64_t k = 0, v = 0;
+    size_t i;
+
+    for (i = 0; i < sizeof(keys) / sizeof(keys[0]); i++) {
+        assert_true(radix64_add(r, keys[i], keys[i] ^ 1));
+    }
+    for (i = 0; i < sizeof(sorted) / sizeof(sorted[0]); i++) {
+        assert_true(radix64_pop(r, &k, &v));
+        assert_true(k == sorted[i]);
+        assert_true(v == (k ^ 1));
+    }
+    assert_false(radix64_pop(r, &k, &v));
+
+    /* Once empty, the heap takes any key again. */
+    assert_true(radix64_add(r, 10, 0));
+    assert_true(radix64_add(r, 20, 0));
+    assert_true(radix64_pop(r, &k, &v));
+    assert_true(k == 10);
+    assert_false(radix64_add(r, 5, 0));
+    assert_true(radix64_add(r, 10, 0));
+
+    /* Peeking does not raise the floor for adds. */
+    assert_true(radix64_pop(r, &k, &v));
+    assert_true(k == 10);
+    assert_true(radix64_peek(r, &k, &v));
+    assert_true(k == 20);
+    assert_true(radix64_add(r, 15, 0));
+    assert_false(radix64_add(r, 5, 0));
+    assert_true(radix64_peek(r, &k, &v));
+    assert_true(k == 15);
+    assert_true(radix64_pop(r, &k, &v));
+    assert_true(k == 15);
+    assert_true(radix64_pop(r, &k, &v));
+    assert_true(k == 20);
+
+    radix64_finalize(r);
+}
+
+static void test_layout(void **state) {
+    octheap *h = octheap_create(100);
+    splitheap *s = splitheap_create(100);
+
+    /* Each node's children are aligned to their combined size. */
+    assert_int_equal((size_t) &h->m_array[1] % TJ_HEAP_ALIGN, 0);
+    assert_int_equal((size_t) &h->m_array[8*5+1] % TJ_HEAP_ALIGN, 0);
+    assert_int_equal((size_t) &s->m_keys[1] % (4 * sizeof(int)), 0);
+    assert_int_equal((size_t) &s->m_keys[4*3+1] % (4 * sizeof(int)), 0);
+
+    octheap_finalize(h);
+    splitheap_finalize(s);
+}
+
 int main(int argc, char *argv[0]) {
     const UnitTest tests[] = {
         unit_test_setup_teardown(test_int_min, int_setup, int_teardown),
         unit_test_setup_teardown(test_int_find, int_setup, int_teardown),
         unit_test_setup_teardown(test_float_max, float_setup, float_teardown),
+        unit_test(test_arity),
+        unit_test(test_macro_comparator),
+        unit_test(test_bulk),
+        unit_test(test_indexed),
+        unit_test(test_indexed_random),
+        unit_test(test_replace_top),
+        unit_test(test_topk),
+        unit_test(test_radix),
+        unit_test(test_radix64),
+        unit_test(test_layout),
     };
 
     return run_tests(tests);
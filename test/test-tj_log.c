@@ -22,9 +22,12 @@
  * SOFTWARE.
  */
 
+#include <pthread.h>
 #include <setjmp.h>
 #include <stdarg.h>
 #include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -89,11 +92,277 @@ static void test_1(void **state) {
     free(args.file);
     free(args.func);
     free(args.msg);
+
+    tj_log_removeOutChannel(out);
+}
+
+#define THREADS 4
+#define PER_THREAD 20000
+
+/*
+ * Collects asynchronously logged messages, "thread seq", checking each
+ * thread's arrive in order.  It can hold the writer in its first call
+ * until released, to fill the ring.
+ */
+struct collector {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int hold;
+    int held;
+
+    size_t count;
+    size_t reports;
+    int next[THREADS];
+    int disordered;
+    char error[64];
+};
+
+static void collect_func(void *data, tj_log_level level,
+        const char *component, const char *file, const char *func, int line,
+        tj_error *error, const char *msg) {
+    struct collector *c = data;
+    int thread, seq;
+
+    pthread_mutex_lock(&c->lock);
+    c->held = 1;
+    pthread_cond_broadcast(&c->cond);
+    while (c->hold) {
+        pthread_cond_wait(&c->cond, &c->lock);
+    }
+    pthread_mutex_unlock(&c->lock);
+
+    if (strcmp(component, "tj_log") == 0) {
+        c->reports++;
+        return;
+    }
+
+    c->count++;
+    if (sscanf(msg, "%d %d", &thread, &seq) == 2 &&
+        thread >= 0 && thread < THREADS) {
+        c->disordered |= (seq != c->next[thread]);
+        c->next[thread] = seq + 1;
+    }
+    if (error != NULL) {
+        snprintf(c->error, sizeof(c->error), "%s",
+                 tj_error_getMessage(error));
+    }
+}
+
+static tj_log_outchannel *collect(struct collector *c) {
+    memset(c, 0, sizeof(*c));
+    pthread_mutex_init(&c->lock, NULL);
+    pthread_cond_init(&c->cond, NULL);
+
+    tj_log_outchannel *out = tj_log_outchannel_create(c, &collect_func,
+                                                      NULL);
+    assert_non_null(out);
+    assert_false(tj_log_addOutChannel(out));
+    return out;
+}
+
+static void hold(struct collector *c) {
+    pthread_mutex_lock(&c->lock);
+    c->hold = 1;
+    pthread_mutex_unlock(&c->lock);
+}
+
+/* Waits for the writer to be held in the channel, then logs n. */
+static void log_while_held(struct collector *c, int n) {
+    int i;
+
+    tj_log_log(TJ_LOG_LEVEL_OUTPUT, "test", __FILE__, __FUNCTION__,
+               __LINE__, NULL, "0 0");
+    pthread_mutex_lock(&c->lock);
+    while (!c->held) {
+        pthread_cond_wait(&c->cond, &c->lock);
+    }
+    pthread_mutex_unlock(&c->lock);
+
+    for (i = 1; i < n; i++) {
+        tj_log_log(TJ_LOG_LEVEL_OUTPUT, "test", __FILE__, __FUNCTION__,
+                   __LINE__, NULL, "0 %d", i);
+    }
+}
+
+static void release(struct collector *c) {
+    pthread_mutex_lock(&c->lock);
+    c->hold = 0;
+    pthread_cond_broadcast(&c->cond);
+    pthread_mutex_unlock(&c->lock);
+}
+
+static void *log_thread(void *arg) {
+    int thread = (int) (intptr_t) arg;
+    int i;
+
+    for (i = 0; i < PER_THREAD; i++) {
+        tj_log_log(TJ_LOG_LEVEL_OUTPUT, "test", __FILE__, __FUNCTION__,
+                   __LINE__, NULL, "%d %d", thread, i);
+    }
+    return NULL;
+}
+
+static void test_async_block(void **state) {
+    struct collector c;
+    pthread_t threads[THREADS];
+    intptr_t i;
+
+    tj_log_removePrintfChannel();
+    tj_log_outchannel *out = collect(&c);
+
+    /* A small ring, so producers block on the writer. */
+    assert_false(tj_log_startAsync(16, TJ_LOG_OVERFLOW_BLOCK));
+    assert_true(tj_log_startAsync(16, TJ_LOG_OVERFLOW_BLOCK));
+
+    for (i = 0; i < THREADS; i++) {
+        assert_int_equal(pthread_create(&threads[i], NULL, &log_thread,
+                                        (void *) i), 0);
+    }
+    for (i = 0; i < THREADS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    tj_log_flush();
+    assert_int_equal(c.count, THREADS * PER_THREAD);
+    assert_false(c.disordered);
+
+    /* Stopping delivers whatever is still buffered. */
+    for (i = 0; i < 10; i++) {
+        tj_log_log(TJ_LOG_LEVEL_OUTPUT, "test", __FILE__, __FUNCTION__,
+                   __LINE__, NULL, "0 %d", (int) (PER_THREAD + i));
+    }
+    tj_log_stopAsync();
+    assert_int_equal(c.count, THREADS * PER_THREAD + 10);
+    assert_false(c.disordered);
+    assert_int_equal(c.reports, 0);
+
+    /* And logging is synchronous again. */
+    tj_log_log(TJ_LOG_LEVEL_OUTPUT, "test", __FILE__, __FUNCTION__,
+               __LINE__, NULL, "1 %d", PER_THREAD);
+    assert_int_equal(c.count, THREADS * PER_THREAD + 11);
+    tj_log_stopAsync();
+    tj_log_flush();
+
+    tj_log_removeOutChannel(out);
+}
+
+static void test_async_drop(void **state) {
+    struct collector c;
+    size_t dropped = tj_log_getDropped();
+
+    tj_log_removePrintfChannel();
+    tj_log_outchannel *out = collect(&c);
+
+    /*
+     * The writer holds the first record's slot while held in the
+     * channel, so 7 more fit and 92 are dropped.
+     */
+    assert_false(tj_log_startAsync(8, TJ_LOG_OVERFLOW_DROP_COUNT));
+    hold(&c);
+    log_while_held(&c, 100);
+    release(&c);
+    tj_log_flush();
+    assert_int_equal(c.count, 8);
+    assert_false(c.disordered);
+    assert_int_equal(tj_log_getDropped() - dropped, 92);
+
+    /* The count is reported to the channels on the writer's next pass. */
+    tj_log_log(TJ_LOG_LEVEL_OUTPUT, "test", __FILE__, __FUNCTION__,
+               __LINE__, NULL, "1 0");
+    tj_log_flush();
+    assert_int_equal(c.reports, 1);
+    tj_log_stopAsync();
+
+    /* Plain dropping is not counted. */
+    memset(c.next, 0, sizeof(c.next));
+    c.held = 0;
+    c.count = 0;
+    dropped = tj_log_getDropped();
+    assert_false(tj_log_startAsync(8, TJ_LOG_OVERFLOW_DROP));
+    hold(&c);
+    log_while_held(&c, 100);
+    release(&c);
+    tj_log_stopAsync();
+    assert_int_equal(c.count, 8);
+    assert_int_equal(tj_log_getDropped(), dropped);
+    assert_int_equal(c.reports, 1);
+
+    tj_log_removeOutChannel(out);
+}
+
+static void test_async_error(void **state) {
+    struct collector c;
+    char long_message[2 * TJ_LOG_MAXLENGTH];
+
+    tj_log_removePrintfChannel();
+    tj_log_outchannel *out = collect(&c);
+    assert_false(tj_log_startAsync(0, TJ_LOG_OVERFLOW_BLOCK));
+
+    /* The error is copied, so may be freed as soon as the call returns. */
+    memset(long_message, 'x', sizeof(long_message) - 1);
+    long_message[sizeof(long_message) - 1] = '\0';
+    tj_error *e = tj_error_create(TJ_ERROR_FAILURE, "Oh no.");
+    TJ_LOG_ERROR("test", e, "%s", long_message);
+    tj_error_finalize(e);
+
+    tj_log_flush();
+    assert_int_equal(c.count, 1);
+    assert_string_equal(c.error, "[FAILURE]: Oh no.");
+
+    tj_log_stopAsync();
+    tj_log_removeOutChannel(out);
+}
+
+static int evaluated;
+
+static int evaluate(void) {
+    return ++evaluated;
+}
+
+static void test_levels(void **state) {
+    struct collector c, d;
+
+    tj_log_removePrintfChannel();
+    tj_log_outchannel *critical = collect(&c);
+    tj_log_setLevel(critical, TJ_LOG_LEVEL_CRITICAL);
+    assert_int_equal(tj_log_getLevel(critical), TJ_LOG_LEVEL_CRITICAL);
+
+    /* Disabled levels don't evaluate their arguments. */
+    assert_false(TJ_LOG_ENABLED(TJ_LOG_LEVEL_LOGIC));
+    TJ_LOG_LOG(TJ_LOG_LEVEL_LOGIC, "test", 0, "0 %d", evaluate());
+    assert_int_equal(evaluated, 0);
+    assert_int_equal(c.count, 0);
+
+    assert_true(TJ_LOG_ENABLED(TJ_LOG_LEVEL_CRITICAL));
+    assert_true(TJ_LOG_ENABLED(TJ_LOG_LEVEL_OUTPUT));
+    TJ_LOG_CRITICAL("test", "0 %d", evaluate() - 1);
+    assert_int_equal(evaluated, 1);
+    assert_int_equal(c.count, 1);
+
+    /* Each channel filters for itself. */
+    tj_log_outchannel *verbose = collect(&d);
+    assert_true(TJ_LOG_ENABLED(TJ_LOG_LEVEL_VERBOSE));
+    tj_log_log(TJ_LOG_LEVEL_LOGIC, "test", __FILE__, __FUNCTION__,
+               __LINE__, NULL, "0 0");
+    assert_int_equal(c.count, 1);
+    assert_int_equal(d.count, 1);
+
+    tj_log_setLevel(verbose, TJ_LOG_LEVEL_COMPONENT);
+    assert_false(TJ_LOG_ENABLED(TJ_LOG_LEVEL_LOGIC));
+    assert_true(TJ_LOG_ENABLED(TJ_LOG_LEVEL_COMPONENT));
+
+    tj_log_removeOutChannel(verbose);
+    assert_false(TJ_LOG_ENABLED(TJ_LOG_LEVEL_COMPONENT));
+    tj_log_removeOutChannel(critical);
+    assert_false(TJ_LOG_ENABLED(TJ_LOG_LEVEL_OUTPUT));
 }
 
 int main(int argc, char **argv) {
     const UnitTest tests[] = {
         unit_test(test_1),
+        unit_test(test_async_block),
+        unit_test(test_async_drop),
+        unit_test(test_async_error),
+        unit_test(test_levels),
     };
 
     return run_tests(tests);
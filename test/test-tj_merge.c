@@ -0,0 +1,229 @@
+/*
+ * Copyright (c) 2013 Bellerophon Mobile, LLC.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cmocka.h"
+
+#define UNIT_TESTING
+#include "tj_merge.c"
+
+#define MAX_INPUTS 17
+#define PER_INPUT 1000
+
+/* An input over an array of records, each an int key and its origin. */
+typedef struct {
+    int key;
+    int input;
+    int seq;
+} item;
+
+typedef struct {
+    item *items;
+    size_t n;
+    size_t next;
+} array_input;
+
+static size_t comparisons;
+
+static size_t read_array(void *arg, tj_merge_record *records, size_t max) {
+    array_input *a = arg;
+    size_t i;
+    for (i = 0; i < max && a->next < a->n; i++, a->next++) {
+        records[i].data = &a->items[a->next];
+        records[i].size = sizeof(item);
+    }
+    return i;
+}
+
+static int compare_items(const tj_merge_record *a, const tj_merge_record *b,
+                         void *data) {
+    const item *x = a->data, *y = b->data;
+    comparisons++;
+    return (x->key > y->key) - (x->key < y->key);
+}
+
+static int compare_ints(const void *a, const void *b) {
+    return *(const int *) a - *(const int *) b;
+}
+
+static void check_merge(size_t k, size_t batch) {
+    static item items[MAX_INPUTS][PER_INPUT];
+    array_input inputs[MAX_INPUTS];
+    tj_merge *merge = tj_merge_create(&compare_items, NULL, batch);
+    tj_merge_record record;
+    const item *last = NULL;
+    size_t i, j, index, total = 0, out = 0, depth = 0;
+
+    assert_non_null(merge);
+    srand(k * 100 + batch);
+    for (i = 0; i < k; i++) {
+        /* Input lengths vary, with some empty. */
+        inputs[i].items = items[i];
+        inputs[i].n = (i % 4 == 3) ? 0 : rand() % PER_INPUT;
+        inputs[i].next = 0;
+        for (j = 0; j < inputs[i].n; j++) {
+            items[i][j].key = rand() % 200;
+            items[i][j].input = i;
+        }
+        qsort(items[i], inputs[i].n, sizeof(item), &compare_ints);
+        for (j = 0; j < inputs[i].n; j++) {
+            items[i][j].seq = j;
+        }
+        total += inputs[i].n;
+        assert_true(tj_merge_addInput(merge, &read_array, &inputs[i]));
+    }
+    while ((1U << depth) < k) {
+        depth++;
+    }
+
+    comparisons = 0;
+    while (tj_merge_next(merge, &record, &index)) {
+        const item *x = record.data;
+        assert_int_equal(record.size, sizeof(item));
+        assert_int_equal(index, x->input);
+
+        /* Sorted, and stable across and within inputs. */
+        if (last != NULL) {
+            assert_true(last->key <= x->key);
+            if (last->key == x->key) {
+                assert_true(last->input < x->input ||
+                            (last->input == x->input &&
+                             last->seq < x->seq));
+            }
+        }
+        last = x;
+        out++;
+    }
+    assert_int_equal(out, total);
+    assert_false(tj_merge_next(merge, &record, &index));
+
+    /* About log2(k) comparisons per record, after building the tree. */
+    assert_true(comparisons <= k + total * depth);
+
+    tj_merge_finalize(merge);
+}
+
+static void test_merge_inputs(void **state) {
+    size_t counts[] = { 1, 2, 3, 5, 8, 16, 17 };
+    size_t batches[] = { 1, 3, 0 };
+    size_t c, b;
+
+    for (c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+        for (b = 0; b < sizeof(batches) / sizeof(batches[0]); b++) {
+            check_merge(counts[c], batches[b]);
+        }
+    }
+}
+
+static void test_merge_empty(void **state) {
+    tj_merge *merge = tj_merge_create(&compare_items, NULL, 0);
+    array_input empty = { NULL, 0, 0 };
+    tj_merge_record record;
+
+    assert_false(tj_merge_next(merge, &record, NULL));
+    tj_merge_finalize(merge);
+
+    merge = tj_merge_create(&compare_items, NULL, 0);
+    assert_true(tj_merge_addInput(merge, &read_array, &empty));
+    assert_true(tj_merge_addInput(merge, &read_array, &empty));
+    assert_false(tj_merge_next(merge, &record, NULL));
+    tj_merge_finalize(merge);
+}
+
+/* An input over the lines of a string, each record a line and newline. */
+static size_t read_lines(void *arg, tj_merge_record *records, size_t max) {
+    const char **s = arg;
+    size_t i;
+    for (i = 0; i < max && **s != '\0'; i++) {
+        const char *end = strchr(*s, '\n');
+        records[i].data = *s;
+        records[i].size = end - *s + 1;
+        *s = end + 1;
+    }
+    return i;
+}
+
+static int compare_lines(const tj_merge_record *a, const tj_merge_record *b,
+                         void *data) {
+    size_t n = (a->size < b->size) ? a->size : b->size;
+    int c = memcmp(a->data, b->data, n);
+    return (c != 0) ? c : (a->size > b->size) - (a->size < b->size);
+}
+
+#define LINES_A "apple\ncherry\nfig\n"
+#define LINES_B "banana\ncherry\ngrape\nkiwi\n"
+#define LINES_C "date\n"
+#define MERGED "apple\nbanana\ncherry\ncherry\ndate\nfig\ngrape\nkiwi\n"
+
+static tj_merge *merge_lines(const char **inputs) {
+    tj_merge *merge = tj_merge_create(&compare_lines, NULL, 2);
+    inputs[0] = LINES_A;
+    inputs[1] = LINES_B;
+    inputs[2] = LINES_C;
+    assert_true(tj_merge_addInput(merge, &read_lines, &inputs[0]));
+    assert_true(tj_merge_addInput(merge, &read_lines, &inputs[1]));
+    assert_true(tj_merge_addInput(merge, &read_lines, &inputs[2]));
+    return merge;
+}
+
+static void test_merge_output(void **state) {
+    const char *inputs[3];
+    tj_buffer *buffer = tj_buffer_create(0);
+    tj_merge *merge = merge_lines(inputs);
+    char contents[sizeof(MERGED)];
+    FILE *file;
+
+    assert_true(tj_merge_toBuffer(merge, buffer));
+    assert_int_equal(tj_buffer_getUsed(buffer), strlen(MERGED));
+    assert_memory_equal(tj_buffer_getBytes(buffer), MERGED, strlen(MERGED));
+    tj_merge_finalize(merge);
+    tj_buffer_finalize(buffer);
+
+    merge = merge_lines(inputs);
+    file = tmpfile();
+    assert_non_null(file);
+    assert_true(tj_merge_toFile(merge, file));
+    rewind(file);
+    assert_int_equal(fread(contents, 1, sizeof(contents), file),
+                     strlen(MERGED));
+    assert_memory_equal(contents, MERGED, strlen(MERGED));
+    fclose(file);
+    tj_merge_finalize(merge);
+}
+
+int main(int argc, char *argv[]) {
+    const UnitTest tests[] = {
+        unit_test(test_merge_inputs),
+        unit_test(test_merge_empty),
+        unit_test(test_merge_output),
+    };
+
+    return run_tests(tests);
+}
@@ -0,0 +1,165 @@
+/*
+ * Copyright (c) 2013 Bellerophon Mobile, LLC.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <pthread.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cmocka.h"
+
+#define UNIT_TESTING
+#include "tj_multiqueue.c"
+
+#define THREADS 8
+#define PER_THREAD 20000
+
+static void test_multiqueue_exact(void **state) {
+    tj_multiqueue *queue = tj_multiqueue_create(1, 1);
+    uint64_t key, last = 0;
+    void *value;
+    int i;
+
+    srand(3);
+    for (i = 0; i < 1000; i++) {
+        uint64_t k = rand() % 500;
+        assert_true(tj_multiqueue_push(queue, k, (void *) (uintptr_t) k));
+    }
+    assert_int_equal(tj_multiqueue_count(queue), 1000);
+
+    /* A single heap comes out in order. */
+    for (i = 0; i < 1000; i++) {
+        assert_true(tj_multiqueue_pop(queue, &key, &value));
+        assert_true(key >= last);
+        assert_true((uintptr_t) value == key);
+        last = key;
+    }
+    assert_false(tj_multiqueue_pop(queue, &key, &value));
+    assert_int_equal(tj_multiqueue_count(queue), 0);
+
+    tj_multiqueue_finalize(queue);
+}
+
+static void test_multiqueue_relaxed(void **state) {
+    tj_multiqueue *queue = tj_multiqueue_create(16, 2);
+    static char seen[1000];
+    uint64_t key;
+    void *value;
+    int i;
+
+    for (i = 0; i < 1000; i++) {
+        assert_true(tj_multiqueue_push(queue, i, NULL));
+    }
+
+    /* Everything comes out once, even when most heaps are empty. */
+    memset(seen, 0, sizeof(seen));
+    for (i = 0; i < 1000; i++) {
+        assert_true(tj_multiqueue_pop(queue, &key, &value));
+        assert_true(key < 1000);
+        assert_false(seen[key]);
+        seen[key] = 1;
+    }
+    assert_false(tj_multiqueue_pop(queue, &key, &value));
+
+    tj_multiqueue_finalize(queue);
+}
+
+typedef struct {
+    tj_multiqueue *queue;
+    int thread;
+    char *seen;
+    size_t popped;
+} worker;
+
+/* Pushes its own keys, popping one for every two pushed. */
+static void *run_worker(void *arg) {
+    worker *w = arg;
+    uint64_t key;
+    void *value;
+    int i;
+
+    for (i = 0; i < PER_THREAD; i++) {
+        uint64_t k = (uint64_t) w->thread * PER_THREAD + i;
+        if (!tj_multiqueue_push(w->queue, k, (void *) (uintptr_t) k)) {
+            return NULL;
+        }
+        if (i % 2 && tj_multiqueue_pop(w->queue, &key, &value)) {
+            if ((uintptr_t) value != key ||
+                __atomic_exchange_n(&w->seen[key], 1, __ATOMIC_RELAXED)) {
+                return NULL;
+            }
+            w->popped++;
+        }
+    }
+    return w;
+}
+
+static void test_multiqueue_threads(void **state) {
+    tj_multiqueue *queue = tj_multiqueue_create(2 * THREADS, 2);
+    char *seen = calloc(THREADS * PER_THREAD, 1);
+    pthread_t tids[THREADS];
+    worker workers[THREADS];
+    size_t popped = 0;
+    uint64_t key;
+    void *value;
+    void *result;
+    int i;
+
+    for (i = 0; i < THREADS; i++) {
+        workers[i].queue = queue;
+        workers[i].thread = i;
+        workers[i].seen = seen;
+        workers[i].popped = 0;
+        assert_int_equal(pthread_create(&tids[i], NULL, &run_worker,
+                                        &workers[i]), 0);
+    }
+    for (i = 0; i < THREADS; i++) {
+        pthread_join(tids[i], &result);
+        assert_true(result == &workers[i]);
+        popped += workers[i].popped;
+    }
+
+    assert_int_equal(tj_multiqueue_count(queue), THREADS * PER_THREAD - popped);
+    while (tj_multiqueue_pop(queue, &key, &value)) {
+        assert_false(seen[key]);
+        seen[key] = 1;
+        popped++;
+    }
+    assert_int_equal(popped, THREADS * PER_THREAD);
+
+    free(seen);
+    tj_multiqueue_finalize(queue);
+}
+
+int main(int argc, char *argv[]) {
+    const UnitTest tests[] = {
+        unit_test(test_multiqueue_exact),
+        unit_test(test_multiqueue_relaxed),
+        unit_test(test_multiqueue_threads),
+    };
+
+    return run_tests(tests);
+}
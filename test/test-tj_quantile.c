@@ -0,0 +1,160 @@
+/*
+ * Copyright (c) 2013 Bellerophon Mobile, LLC.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <math.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cmocka.h"
+
+#define UNIT_TESTING
+#include "tj_quantile.c"
+
+#define COUNT 1000000
+#define PARTS 8
+
+/* Allowed rank error, generously above the typical 1.7/k for k = 200. */
+#define TOLERANCE 0.025
+
+static const double qs[] = { 0.001, 0.01, 0.1, 0.25, 0.5, 0.75, 0.9,
+                             0.99, 0.999 };
+
+/* Checks estimates against a stream of the values 0 to n-1. */
+static void check_uniform(tj_quantile *sketch, size_t n) {
+    size_t i;
+    for (i = 0; i < sizeof(qs) / sizeof(qs[0]); i++) {
+        double v = tj_quantile_getQuantile(sketch, qs[i]);
+        assert_true(fabs(v / n - qs[i]) < TOLERANCE);
+        assert_true(fabs(tj_quantile_getRank(sketch, qs[i] * n) - qs[i]) <
+                    TOLERANCE);
+    }
+    assert_true(tj_quantile_getMin(sketch) == 0);
+    assert_true(tj_quantile_getMax(sketch) == n - 1);
+    assert_true(tj_quantile_getQuantile(sketch, 0) == 0);
+    assert_true(tj_quantile_getQuantile(sketch, 1) == n - 1);
+}
+
+/* A pseudo-random permutation of 0 to COUNT-1. */
+static uint64_t permute(uint64_t i) {
+    return (i * 611953) % COUNT;
+}
+
+static void test_quantile_empty(void **state) {
+    tj_quantile *sketch = tj_quantile_create(0);
+
+    assert_int_equal(tj_quantile_getCount(sketch), 0);
+    assert_true(isnan(tj_quantile_getQuantile(sketch, 0.5)));
+    assert_true(isnan(tj_quantile_getRank(sketch, 1)));
+    assert_true(isnan(tj_quantile_getMin(sketch)));
+
+    tj_quantile_add(sketch, NAN);
+    assert_int_equal(tj_quantile_getCount(sketch), 0);
+
+    tj_quantile_finalize(sketch);
+}
+
+static void test_quantile_exact(void **state) {
+    tj_quantile *sketch = tj_quantile_create(200);
+    int i;
+
+    /* Below k values nothing is compacted, so answers are exact. */
+    for (i = 100; i >= 1; i--) {
+        tj_quantile_add(sketch, i);
+    }
+    assert_int_equal(tj_quantile_getCount(sketch), 100);
+    assert_true(tj_quantile_getQuantile(sketch, 0.5) == 50);
+    assert_true(tj_quantile_getQuantile(sketch, 0.99) == 99);
+    assert_true(tj_quantile_getQuantile(sketch, 0.995) == 100);
+    assert_true(tj_quantile_getRank(sketch, 25) == 0.25);
+    assert_true(tj_quantile_getRank(sketch, 25.5) == 0.25);
+    assert_true(tj_quantile_getRank(sketch, 0) == 0);
+    assert_true(tj_quantile_getRank(sketch, 1000) == 1);
+
+    tj_quantile_finalize(sketch);
+}
+
+static void test_quantile_stream(void **state) {
+    tj_quantile *random = tj_quantile_create(200);
+    tj_quantile *sorted = tj_quantile_create(200);
+    size_t i, size = random->size;
+
+    for (i = 0; i < COUNT; i++) {
+        tj_quantile_add(random, permute(i));
+        tj_quantile_add(sorted, i);
+    }
+    assert_int_equal(tj_quantile_getCount(random), COUNT);
+    check_uniform(random, COUNT);
+    check_uniform(sorted, COUNT);
+
+    /* Memory stays as allocated, about 3k values. */
+    assert_int_equal(random->size, size);
+    assert_true(retained(random) <= random->budget[random->levels]);
+    assert_true(size < 4 * 200 + MAX_LEVELS * MIN_WIDTH);
+
+    tj_quantile_finalize(random);
+    tj_quantile_finalize(sorted);
+}
+
+static void test_quantile_merge(void **state) {
+    tj_quantile *parts[PARTS];
+    tj_quantile *all = tj_quantile_create(200);
+    size_t i;
+
+    for (i = 0; i < PARTS; i++) {
+        parts[i] = tj_quantile_create(i % 2 ? 200 : 400);
+    }
+    for (i = 0; i < COUNT; i++) {
+        tj_quantile_add(parts[i % PARTS], permute(i));
+    }
+
+    for (i = 0; i < PARTS; i++) {
+        tj_quantile_merge(all, parts[i]);
+        tj_quantile_finalize(parts[i]);
+    }
+    assert_int_equal(tj_quantile_getCount(all), COUNT);
+    check_uniform(all, COUNT);
+
+    /* Merging an empty sketch changes nothing. */
+    parts[0] = tj_quantile_create(0);
+    tj_quantile_merge(all, parts[0]);
+    tj_quantile_finalize(parts[0]);
+    assert_int_equal(tj_quantile_getCount(all), COUNT);
+
+    tj_quantile_finalize(all);
+}
+
+int main(int argc, char *argv[]) {
+    const UnitTest tests[] = {
+        unit_test(test_quantile_empty),
+        unit_test(test_quantile_exact),
+        unit_test(test_quantile_stream),
+        unit_test(test_quantile_merge),
+    };
+
+    return run_tests(tests);
+}
@@ -0,0 +1,173 @@
+/*
+ * Copyright (c) 2013 Bellerophon Mobile, LLC.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cmocka.h"
+
+#define UNIT_TESTING
+#include "tj_segarray.c"
+
+#define SCALE_COUNT 1000000
+
+typedef struct {
+    int id;
+    double weight;
+} record;
+
+static void setup(void **state) {
+    tj_segarray *array = tj_segarray_create(sizeof(record));
+    assert_non_null(array);
+
+    *state = (void*)array;
+}
+
+static void teardown(void **state) {
+    tj_segarray *array = *state;
+    if (array != NULL) {
+        tj_segarray_finalize(array);
+    }
+}
+
+static void test_segarray_empty(void **state) {
+    tj_segarray *array = *state;
+    size_t n = 1;
+
+    assert_int_equal(tj_segarray_count(array), 0);
+    assert_int_equal(tj_segarray_capacity(array), 0);
+    assert_null(tj_segarray_getChunk(array, 0, &n));
+    assert_int_equal(n, 0);
+    assert_null(tj_segarray_getChunk(array, 100, &n));
+    expect_assert_failure(tj_segarray_get(array, 0));
+    expect_assert_failure(tj_segarray_popBack(array));
+    expect_assert_failure(tj_segarray_create(0));
+}
+
+static void test_segarray_append_get(void **state) {
+    tj_segarray *array = *state;
+    record r = { 4, 8.15 };
+
+    record *first = tj_segarray_append(array, &r);
+    assert_non_null(first);
+    assert_int_equal(first->id, 4);
+
+    record *second = tj_segarray_append(array, NULL);
+    assert_non_null(second);
+    assert_int_equal(second->id, 0);
+    assert_true(second->weight == 0);
+
+    assert_int_equal(tj_segarray_count(array), 2);
+    assert_true(tj_segarray_get(array, 0) == first);
+    assert_true(tj_segarray_get(array, 1) == second);
+    expect_assert_failure(tj_segarray_get(array, 2));
+
+    tj_segarray_popBack(array);
+    assert_int_equal(tj_segarray_count(array), 1);
+    expect_assert_failure(tj_segarray_get(array, 1));
+
+    tj_segarray_clear(array);
+    assert_int_equal(tj_segarray_count(array), 0);
+    assert_true(tj_segarray_capacity(array) > 0);
+}
+
+static void test_segarray_stable(void **state) {
+    tj_segarray *array = *state;
+    record *early[100];
+    record r;
+    size_t i;
+
+    for (i = 0; i < SCALE_COUNT; i++) {
+        r.id = i;
+        r.weight = i / 2.0;
+        record *added = tj_segarray_append(array, &r);
+        assert_non_null(added);
+        if (i < 100) {
+            early[i] = added;
+        }
+    }
+    assert_int_equal(tj_segarray_count(array), SCALE_COUNT);
+    assert_true(tj_segarray_capacity(array) >= SCALE_COUNT);
+    assert_true(tj_segarray_capacity(array) < 2 * SCALE_COUNT + 16);
+
+    for (i = 0; i < 100; i++) {
+        assert_true(tj_segarray_get(array, i) == early[i]);
+        assert_int_equal(early[i]->id, i);
+    }
+    for (i = 0; i < SCALE_COUNT; i++) {
+        assert_int_equal(((record*)tj_segarray_get(array, i))->id, i);
+    }
+}
+
+static void test_segarray_chunks(void **state) {
+    tj_segarray *array = *state;
+    record r;
+    size_t i, chunk, n, seen = 0;
+
+    for (i = 0; i < SCALE_COUNT; i++) {
+        r.id = i;
+        assert_non_null(tj_segarray_append(array, &r));
+    }
+
+    record *chunkp;
+    for (chunk = 0; (chunkp = tj_segarray_getChunk(array, chunk, &n));
+            chunk++) {
+        assert_true(n > 0);
+        for (i = 0; i < n; i++) {
+            assert_int_equal(chunkp[i].id, seen + i);
+        }
+        seen += n;
+    }
+    assert_int_equal(seen, SCALE_COUNT);
+}
+
+static void test_segarray_reserve(void **state) {
+    tj_segarray *array = *state;
+    record r = { 1, 1 };
+
+    assert_true(tj_segarray_reserve(array, 1000));
+    size_t capacity = tj_segarray_capacity(array);
+    assert_true(capacity >= 1000);
+
+    size_t i;
+    for (i = 0; i < capacity; i++) {
+        assert_non_null(tj_segarray_append(array, &r));
+    }
+    assert_int_equal(tj_segarray_capacity(array), capacity);
+}
+
+int main(int argc, char **argv) {
+    const UnitTest tests[] = {
+        unit_test_setup_teardown(test_segarray_empty, setup, teardown),
+        unit_test_setup_teardown(test_segarray_append_get, setup, teardown),
+        unit_test_setup_teardown(test_segarray_stable, setup, teardown),
+        unit_test_setup_teardown(test_segarray_chunks, setup, teardown),
+        unit_test_setup_teardown(test_segarray_reserve, setup, teardown),
+    };
+
+    return run_tests(tests);
+}
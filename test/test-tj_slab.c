@@ -0,0 +1,208 @@
+/*
+ * Copyright (c) 2013 Bellerophon Mobile, LLC.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <pthread.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cmocka.h"
+
+#define UNIT_TESTING
+#include "tj_slab.c"
+
+#define COUNT 10000
+#define THREADS 4
+#define PER_THREAD 20000
+
+static void test_slab_alloc_free(void **state) {
+    static void *objs[COUNT];
+    tj_slab *slab = tj_slab_create(24, 0);
+    tj_slab_stats stats;
+    size_t i, j;
+
+    assert_non_null(slab);
+    tj_slab_getStats(slab, &stats);
+    assert_int_equal(stats.objsize, 32);
+    assert_int_equal(stats.slabsize, MIN_SLAB_SIZE);
+    assert_int_equal(stats.slabs, 0);
+
+    for (i = 0; i < COUNT; i++) {
+        objs[i] = tj_slab_alloc(slab);
+        assert_non_null(objs[i]);
+        assert_int_equal((uintptr_t) objs[i] % 16, 0);
+        memset(objs[i], (int) i, 24);
+    }
+    for (i = 0; i < COUNT; i++) {
+        unsigned char *p = objs[i];
+        for (j = 0; j < 24; j++) {
+            assert_int_equal(p[j], (unsigned char) i);
+        }
+    }
+
+    tj_slab_getStats(slab, &stats);
+    assert_int_equal(stats.used, COUNT);
+    assert_int_equal(stats.slabs,
+                     (COUNT + stats.perslab - 1) / stats.perslab);
+
+    /* Free every other object; the slabs stay, half full. */
+    for (i = 0; i < COUNT; i += 2) {
+        tj_slab_free(slab, objs[i]);
+    }
+    tj_slab_getStats(slab, &stats);
+    assert_int_equal(stats.used, COUNT / 2);
+
+    /* Reallocation reuses the holes rather than new slabs. */
+    size_t slabs = stats.slabs;
+    for (i = 0; i < COUNT; i += 2) {
+        objs[i] = tj_slab_alloc(slab);
+    }
+    tj_slab_getStats(slab, &stats);
+    assert_int_equal(stats.slabs, slabs);
+
+    /* Emptying everything keeps just one spare slab. */
+    for (i = 0; i < COUNT; i++) {
+        tj_slab_free(slab, objs[i]);
+    }
+    tj_slab_getStats(slab, &stats);
+    assert_int_equal(stats.used, 0);
+    assert_int_equal(stats.slabs, 1);
+
+    tj_slab_finalize(slab);
+}
+
+static void test_slab_occupancy(void **state) {
+    tj_slab *slab = tj_slab_create(1, 0);
+    tj_slab_stats stats;
+    size_t used[4];
+    void *last = NULL;
+    size_t i;
+
+    tj_slab_getStats(slab, &stats);
+    assert_int_equal(stats.objsize, sizeof(void *));
+
+    for (i = 0; i < stats.perslab + 3; i++) {
+        last = tj_slab_alloc(slab);
+    }
+    assert_int_equal(tj_slab_occupancy(slab, used, 4), 2);
+    assert_int_equal(used[0], 3);
+    assert_int_equal(used[1], stats.perslab);
+    assert_int_equal(tj_slab_occupancy(slab, NULL, 0), 2);
+
+    tj_slab_free(slab, last);
+    assert_int_equal(tj_slab_occupancy(slab, used, 1), 2);
+    assert_int_equal(used[0], 2);
+
+    tj_slab_finalize(slab);
+
+    /* Large objects get larger slabs. */
+    slab = tj_slab_create(3000, 0);
+    tj_slab_getStats(slab, &stats);
+    assert_true(stats.perslab >= MIN_PER_SLAB);
+    assert_true(stats.slabsize > MIN_SLAB_SIZE);
+    assert_non_null(tj_slab_alloc(slab));
+    tj_slab_finalize(slab);
+}
+
+static void *churn(void *arg) {
+    tj_slab *slab = arg;
+    void *live[64] = { NULL };
+    unsigned seed = (unsigned) (uintptr_t) &live;
+    int i;
+
+    for (i = 0; i < PER_THREAD; i++) {
+        int k = rand_r(&seed) % 64;
+        if (live[k] != NULL) {
+            if (*(void **) ((char *) live[k] + 8) != live[k]) {
+                return live[k];
+            }
+            tj_slab_free(slab, live[k]);
+        }
+        if ((live[k] = tj_slab_alloc(slab)) == NULL) {
+            return slab;
+        }
+        *(void **) ((char *) live[k] + 8) = live[k];
+    }
+    for (i = 0; i < 64; i++) {
+        if (live[i] != NULL) {
+            tj_slab_free(slab, live[i]);
+        }
+    }
+    return NULL;
+}
+
+static void test_slab_threads(void **state) {
+    int flags[] = { TJ_SLAB_LOCKED, TJ_SLAB_MAGAZINES };
+    pthread_t threads[THREADS];
+    tj_slab_stats stats;
+    void *res;
+    size_t f;
+    int i;
+
+    for (f = 0; f < 2; f++) {
+        tj_slab *slab = tj_slab_create(32, flags[f]);
+        for (i = 0; i < THREADS; i++) {
+            assert_int_equal(pthread_create(&threads[i], NULL, &churn, slab), 0);
+        }
+        for (i = 0; i < THREADS; i++) {
+            assert_int_equal(pthread_join(threads[i], &res), 0);
+            assert_null(res);
+        }
+
+        /* Exiting threads hand their magazines back. */
+        tj_slab_getStats(slab, &stats);
+        assert_int_equal(stats.used, 0);
+
+        /* The main thread's magazine is freed with the allocator. */
+        void *obj = tj_slab_alloc(slab);
+        assert_non_null(obj);
+        tj_slab_free(slab, obj);
+        tj_slab_finalize(slab);
+    }
+}
+
+static void test_slab_foreign(void **state) {
+    tj_slab *a = tj_slab_create(16, 0);
+    tj_slab *b = tj_slab_create(16, 0);
+    void *obj = tj_slab_alloc(a);
+
+    expect_assert_failure(tj_slab_free(b, obj));
+    tj_slab_free(a, obj);
+
+    tj_slab_finalize(a);
+    tj_slab_finalize(b);
+}
+
+int main(int argc, char *argv[]) {
+    const UnitTest tests[] = {
+        unit_test(test_slab_alloc_free),
+        unit_test(test_slab_occupancy),
+        unit_test(test_slab_threads),
+        unit_test(test_slab_foreign),
+    };
+
+    return run_tests(tests);
+}
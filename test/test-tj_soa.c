@@ -0,0 +1,155 @@
+/*
+ * Copyright (c) 2013 Joe Kopena <tjkopena@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cmocka.h"
+
+#include "tj_soa.h"
+
+#define PARTICLE_FIELDS(X) \
+    X(float, x) \
+    X(double, mass) \
+    X(char, flag) \
+    X(int, id)
+
+TJ_SOA_DECL(particles, PARTICLE_FIELDS)
+
+static void setup(void **state) {
+    particles *p = particles_create(2);
+    assert_non_null(p);
+
+    *state = (void*)p;
+}
+
+static void teardown(void **state) {
+    particles *p = *state;
+    if (p != NULL) {
+        particles_finalize(p);
+    }
+}
+
+static void push_n(particles *p, int n) {
+    particles_row r;
+    int i;
+    for (i = 0; i < n; i++) {
+        r.x = i * 0.5f;
+        r.mass = i * 2.0;
+        r.flag = i % 2;
+        r.id = i;
+        assert_true(particles_push(p, &r));
+    }
+}
+
+static void test_soa_push_grow(void **state) {
+    particles *p = *state;
+    particles_row r = {0};
+    int i;
+
+    push_n(p, 1000);
+    assert_int_equal(p->m_used, 1000);
+    assert_true(p->m_n >= 1000);
+
+    for (i = 0; i < 1000; i++) {
+        assert_true(p->x[i] == i * 0.5f);
+        assert_true(p->mass[i] == i * 2.0);
+        assert_int_equal(p->flag[i], i % 2);
+        assert_int_equal(p->id[i], i);
+    }
+
+    /* Every column is aligned, and carved from the one block. */
+    assert_int_equal((uintptr_t) p->x % TJ_SOA_ALIGN, 0);
+    assert_int_equal((uintptr_t) p->mass % TJ_SOA_ALIGN, 0);
+    assert_int_equal((uintptr_t) p->flag % TJ_SOA_ALIGN, 0);
+    assert_int_equal((uintptr_t) p->id % TJ_SOA_ALIGN, 0);
+    assert_true((char *) p->x == p->m_block);
+    assert_true((char *) p->mass > (char *) p->x);
+    assert_true((char *) p->flag > (char *) p->mass);
+    assert_true((char *) p->id > (char *) p->flag);
+
+    assert_true(particles_get(p, 999, &r));
+    assert_int_equal(r.id, 999);
+    assert_false(particles_get(p, 1000, &r));
+
+    r.id = -1;
+    assert_true(particles_set(p, 10, &r));
+    assert_int_equal(p->id[10], -1);
+    assert_true(p->mass[10] == 999 * 2.0);
+    assert_false(particles_set(p, 1000, &r));
+}
+
+static void test_soa_swap_remove(void **state) {
+    particles *p = *state;
+    particles_row r = {0};
+
+    push_n(p, 5);
+
+    assert_true(particles_swapRemove(p, 1));
+    assert_int_equal(p->m_used, 4);
+    assert_int_equal(p->id[1], 4);
+    assert_true(p->x[1] == 2.0f);
+    assert_int_equal(p->flag[1], 0);
+
+    /* Removing the last element just shrinks. */
+    assert_true(particles_swapRemove(p, 3));
+    assert_int_equal(p->m_used, 3);
+    assert_true(particles_get(p, 2, &r));
+    assert_int_equal(r.id, 2);
+
+    assert_false(particles_swapRemove(p, 3));
+
+    particles_clear(p);
+    assert_int_equal(p->m_used, 0);
+    assert_false(particles_swapRemove(p, 0));
+}
+
+static void test_soa_reserve(void **state) {
+    particles *p = *state;
+    float *x;
+
+    push_n(p, 2);
+    assert_true(particles_reserve(p, 100));
+    assert_true(p->m_n >= 100);
+    assert_int_equal(p->id[1], 1);
+
+    x = p->x;
+    push_n(p, 98);
+    assert_true(p->x == x);
+    assert_int_equal(p->m_used, 100);
+}
+
+int main(int argc, char *argv[]) {
+    const UnitTest tests[] = {
+        unit_test_setup_teardown(test_soa_push_grow, setup, teardown),
+        unit_test_setup_teardown(test_soa_swap_remove, setup, teardown),
+        unit_test_setup_teardown(test_soa_reserve, setup, teardown),
+    };
+
+    return run_tests(tests);
+}
@@ -0,0 +1,203 @@
+/*
+ * Copyright (c) 2013 Bellerophon Mobile, LLC.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cmocka.h"
+
+#include "tj_array.h"
+#include "tj_sort.h"
+
+#define LARGE_COUNT 200000
+
+typedef struct {
+    int key;
+    int seq;
+} record;
+
+#define INT_LESS(a, b) ((a) < (b))
+#define RECORD_LESS(a, b) ((a).key < (b).key)
+#define RECORD_KEY(a) TJ_SORT_SIGNED_KEY((a).key)
+#define ITEM_LESS(a, b) (*(int *) (a) < *(int *) (b))
+#define ITEM_KEY(a) ((uint64_t) *(int *) (a))
+#define POINTER_KEY(a) ((uint64_t) (uintptr_t) (a))
+
+TJ_SORT_DECL(int_sort, int, INT_LESS)
+TJ_SORT_DECL(record_sort, record, RECORD_LESS)
+TJ_RADIX_SORT_DECL(record_radix, record, RECORD_KEY)
+TJ_ARRAY_SORT_DECL(item_sort, ITEM_LESS)
+TJ_ARRAY_RADIX_SORT_DECL(item_radix, ITEM_KEY)
+TJ_ARRAY_RADIX_SORT_DECL(pointer_radix, POINTER_KEY)
+
+static int int_cmp(const void *a, const void *b) {
+    return *(const int *) a - *(const int *) b;
+}
+
+static int item_cmp(const void *a, const void *b) {
+    return *(const int *) a - *(const int *) b;
+}
+
+static void fill_records(record *r, size_t n, int range) {
+    size_t i;
+    srand(1234);
+    for (i = 0; i < n; i++) {
+        r[i].key = rand() % range - range / 2;
+        r[i].seq = i;
+    }
+}
+
+static void check_records(const record *r, size_t n) {
+    size_t i;
+    for (i = 1; i < n; i++) {
+        assert_true(r[i-1].key <= r[i].key);
+        if (r[i-1].key == r[i].key) {
+            assert_true(r[i-1].seq < r[i].seq);
+        }
+    }
+}
+
+static void test_sort_ints(void **state) {
+    static int a[LARGE_COUNT], b[LARGE_COUNT];
+    size_t sizes[] = { 0, 1, 2, 31, 32, 33, 1000, LARGE_COUNT };
+    size_t s, i;
+
+    for (s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        srand(s);
+        for (i = 0; i < sizes[s]; i++) {
+            a[i] = b[i] = rand();
+        }
+        qsort(b, sizes[s], sizeof(int), &int_cmp);
+        assert_true(int_sort(a, sizes[s]));
+        assert_memory_equal(a, b, sizes[s] * sizeof(int));
+    }
+}
+
+static void test_sort_stable(void **state) {
+    static record r[LARGE_COUNT];
+
+    fill_records(r, 1000, 10);
+    assert_true(record_sort(r, 1000));
+    check_records(r, 1000);
+
+    fill_records(r, LARGE_COUNT, 1000);
+    assert_true(record_sort(r, LARGE_COUNT));
+    check_records(r, LARGE_COUNT);
+}
+
+static void test_sort_parallel(void **state) {
+    static record r[LARGE_COUNT];
+    int threads[] = { 1, 2, 3, 4, 7, 8 };
+    size_t t;
+
+    for (t = 0; t < sizeof(threads) / sizeof(threads[0]); t++) {
+        fill_records(r, LARGE_COUNT, 5000);
+        assert_true(record_sort_parallel(r, LARGE_COUNT, threads[t]));
+        check_records(r, LARGE_COUNT);
+    }
+
+    /* Below the threshold this runs serially. */
+    fill_records(r, 100, 10);
+    assert_true(record_sort_parallel(r, 100, 4));
+    check_records(r, 100);
+}
+
+static void test_sort_radix(void **state) {
+    static record r[LARGE_COUNT];
+
+    fill_records(r, LARGE_COUNT, 1 << 30);
+    assert_true(record_radix(r, LARGE_COUNT));
+    check_records(r, LARGE_COUNT);
+
+    /* All keys share their upper bytes, exercising skipped passes. */
+    fill_records(r, LARGE_COUNT, 200);
+    assert_true(record_radix(r, LARGE_COUNT));
+    check_records(r, LARGE_COUNT);
+
+    fill_records(r, 1, 200);
+    assert_true(record_radix(r, 1));
+    assert_true(record_radix(r, 0));
+}
+
+static void test_sort_array(void **state) {
+    static int values[LARGE_COUNT];
+    tj_array *array = tj_array_create(0);
+    size_t i;
+
+    srand(99);
+    for (i = 0; i < LARGE_COUNT; i++) {
+        values[i] = rand() % 100000;
+        assert_true(tj_array_append(array, &values[i]));
+    }
+    assert_true(tj_array_enableIndex(array));
+
+    assert_true(tj_array_sort(array, &item_cmp));
+    for (i = 1; i < LARGE_COUNT; i++) {
+        assert_true(*(int *) tj_array_get(array, i-1) <=
+                    *(int *) tj_array_get(array, i));
+        assert_int_equal(tj_array_find(array, tj_array_get(array, i)), i);
+    }
+
+    assert_true(pointer_radix(array));
+    for (i = 0; i < LARGE_COUNT; i++) {
+        assert_true(tj_array_get(array, i) == &values[i]);
+        assert_int_equal(tj_array_find(array, &values[i]), i);
+    }
+
+    assert_true(item_sort_parallel(array, 4));
+    for (i = 1; i < LARGE_COUNT; i++) {
+        assert_true(*(int *) tj_array_get(array, i-1) <=
+                    *(int *) tj_array_get(array, i));
+    }
+
+    assert_true(pointer_radix(array));
+    assert_true(item_radix(array));
+    for (i = 1; i < LARGE_COUNT; i++) {
+        assert_true(*(int *) tj_array_get(array, i-1) <=
+                    *(int *) tj_array_get(array, i));
+    }
+
+    tj_array_clear(array);
+    assert_true(item_sort(array));
+    assert_true(item_radix(array));
+    assert_true(tj_array_sort(array, &item_cmp));
+
+    tj_array_finalize(array);
+}
+
+int main(int argc, char *argv[]) {
+    const UnitTest tests[] = {
+        unit_test(test_sort_ints),
+        unit_test(test_sort_stable),
+        unit_test(test_sort_parallel),
+        unit_test(test_sort_radix),
+        unit_test(test_sort_array),
+    };
+
+    return run_tests(tests);
+}
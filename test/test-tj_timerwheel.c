@@ -0,0 +1,302 @@
+/*
+ * Copyright (c) 2013 Bellerophon Mobile, LLC.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cmocka.h"
+
+#define UNIT_TESTING
+#include "tj_timerwheel.c"
+
+#define TICK 1000
+#define TIMERS 5000
+
+static uint64_t fake_now;
+
+static uint64_t fake_clock(void *data) {
+    return fake_now;
+}
+
+typedef struct {
+    tj_timerwheel_timer timer;
+    uint64_t deadline;
+    int fired;
+} entry;
+
+static void on_fire(tj_timerwheel_timer *timer, void *data) {
+    entry *e = data;
+    assert_true(fake_now >= e->deadline);
+    e->fired++;
+}
+
+static void setup(void **state) {
+    tj_timerwheel *wheel = tj_timerwheel_create(TICK, 3);
+    assert_non_null(wheel);
+
+    fake_now = 1000000;
+    tj_timerwheel_setClock(wheel, &fake_clock, NULL);
+    *state = (void*)wheel;
+}
+
+static void teardown(void **state) {
+    tj_timerwheel *wheel = *state;
+    if (wheel != NULL) {
+        tj_timerwheel_finalize(wheel);
+    }
+}
+
+static void schedule(tj_timerwheel *wheel, entry *e, uint64_t delay) {
+    e->deadline = fake_now + delay;
+    tj_timerwheel_schedule(wheel, &e->timer, delay);
+}
+
+static void test_timerwheel_fire(void **state) {
+    tj_timerwheel *wheel = *state;
+    entry e[4];
+    uint64_t start = fake_now, when;
+    int i;
+
+    for (i = 0; i < 4; i++) {
+        tj_timerwheel_timer_init(&e[i].timer, &on_fire, &e[i]);
+        e[i].fired = 0;
+        assert_false(tj_timerwheel_timer_isPending(&e[i].timer));
+    }
+    assert_false(tj_timerwheel_nextExpiry(wheel, &when));
+
+    /* Level 0, level 1, level 2, and beyond the wheel's reach. */
+    schedule(wheel, &e[0], 10 * TICK + 1);
+    schedule(wheel, &e[1], 1000 * TICK);
+    schedule(wheel, &e[2], 100000 * TICK);
+    schedule(wheel, &e[3], 1000000 * TICK);
+    assert_int_equal(tj_timerwheel_count(wheel), 4);
+    assert_true(tj_timerwheel_timer_isPending(&e[0].timer));
+
+    /* Timers never fire early, and at most a tick late. */
+    assert_true(tj_timerwheel_nextExpiry(wheel, &when));
+    assert_true(when == start + 11 * TICK);
+    fake_now = start + 10 * TICK + 1;
+    assert_int_equal(tj_timerwheel_advance(wheel), 0);
+    fake_now = start + 11 * TICK;
+    assert_int_equal(tj_timerwheel_advance(wheel), 1);
+    assert_int_equal(e[0].fired, 1);
+    assert_false(tj_timerwheel_timer_isPending(&e[0].timer));
+
+    /* Cascades give lower bounds on the rest. */
+    assert_true(tj_timerwheel_nextExpiry(wheel, &when));
+    assert_true(when <= e[1].deadline && when > fake_now);
+
+    for (i = 1; i < 4; i++) {
+        fake_now = e[i].deadline - 1;
+        assert_int_equal(tj_timerwheel_advance(wheel), 0);
+        fake_now = e[i].deadline;
+        assert_int_equal(tj_timerwheel_advance(wheel), 1);
+        assert_int_equal(e[i].fired, 1);
+    }
+    assert_int_equal(tj_timerwheel_count(wheel), 0);
+    assert_false(tj_timerwheel_nextExpiry(wheel, &when));
+
+    /* A deadline already passed fires at the next tick. */
+    tj_timerwheel_scheduleAt(wheel, &e[0].timer, 0);
+    e[0].deadline = 0;
+    assert_int_equal(tj_timerwheel_advance(wheel), 0);
+    fake_now += TICK;
+    assert_int_equal(tj_timerwheel_advance(wheel), 1);
+    assert_int_equal(e[0].fired, 2);
+}
+
+static void test_timerwheel_single_level(void **state) {
+    tj_timerwheel *wheel = tj_timerwheel_create(TICK, 1);
+    entry e;
+    uint64_t start;
+
+    assert_non_null(wheel);
+    tj_timerwheel_setClock(wheel, &fake_clock, NULL);
+    start = fake_now;
+
+    /* Out of reach, the timer goes round the only level until due. */
+    tj_timerwheel_timer_init(&e.timer, &on_fire, &e);
+    e.fired = 0;
+    schedule(wheel, &e, 1000 * TICK);
+
+    fake_now = start + 63 * TICK;
+    assert_int_equal(tj_timerwheel_advance(wheel), 0);
+    fake_now = start + 999 * TICK;
+    assert_int_equal(tj_timerwheel_advance(wheel), 0);
+    assert_int_equal(tj_timerwheel_count(wheel), 1);
+    fake_now = start + 1000 * TICK;
+    assert_int_equal(tj_timerwheel_advance(wheel), 1);
+    assert_int_equal(e.fired, 1);
+    assert_int_equal(tj_timerwheel_count(wheel), 0);
+
+    tj_timerwheel_finalize(wheel);
+}
+
+static void test_timerwheel_cancel(void **state) {
+    tj_timerwheel *wheel = *state;
+    entry e[3];
+    uint64_t start = fake_now;
+    int i;
+
+    for (i = 0; i < 3; i++) {
+        tj_timerwheel_timer_init(&e[i].timer, &on_fire, &e[i]);
+        e[i].fired = 0;
+        schedule(wheel, &e[i], 5 * TICK);
+    }
+
+    assert_true(tj_timerwheel_cancel(wheel, &e[1].timer));
+    assert_false(tj_timerwheel_cancel(wheel, &e[1].timer));
+    assert_false(tj_timerwheel_timer_isPending(&e[1].timer));
+
+    /* Rescheduling a pending timer moves it. */
+    schedule(wheel, &e[2], 5000 * TICK);
+    assert_int_equal(tj_timerwheel_count(wheel), 2);
+
+    fake_now = start + 10 * TICK;
+    assert_int_equal(tj_timerwheel_advance(wheel), 1);
+    assert_int_equal(e[0].fired, 1);
+    assert_int_equal(e[1].fired, 0);
+    assert_int_equal(e[2].fired, 0);
+
+    assert_true(tj_timerwheel_cancel(wheel, &e[2].timer));
+    fake_now = start + 10000 * TICK;
+    assert_int_equal(tj_timerwheel_advance(wheel), 0);
+    assert_int_equal(tj_timerwheel_count(wheel), 0);
+}
+
+/* Reschedules itself, and cancels the timer in data after a few runs. */
+typedef struct {
+    tj_timerwheel *wheel;
+    tj_timerwheel_timer timer;
+    tj_timerwheel_timer *victim;
+    int runs;
+} periodic;
+
+static void on_periodic(tj_timerwheel_timer *timer, void *data) {
+    periodic *p = data;
+    p->runs++;
+    if (p->runs == 3) {
+        assert_true(tj_timerwheel_cancel(p->wheel, p->victim));
+    }
+    tj_timerwheel_schedule(p->wheel, timer, TICK);
+}
+
+static void test_timerwheel_callbacks(void **state) {
+    tj_timerwheel *wheel = *state;
+    periodic p = { wheel };
+    entry victim;
+    int i;
+
+    tj_timerwheel_timer_init(&p.timer, &on_periodic, &p);
+    tj_timerwheel_timer_init(&victim.timer, &on_fire, &victim);
+    victim.fired = 0;
+    p.victim = &victim.timer;
+
+    tj_timerwheel_schedule(wheel, &p.timer, TICK);
+    schedule(wheel, &victim, 5 * TICK);
+
+    for (i = 1; i <= 10; i++) {
+        fake_now += TICK;
+        assert_int_equal(tj_timerwheel_advance(wheel), 1);
+        assert_int_equal(p.runs, i);
+    }
+    assert_int_equal(victim.fired, 0);
+
+    /* A timer rescheduled while firing waits for the next tick. */
+    fake_now += 100 * TICK;
+    assert_int_equal(tj_timerwheel_advance(wheel), 1);
+    assert_int_equal(p.runs, 11);
+    assert_int_equal(tj_timerwheel_count(wheel), 1);
+}
+
+static void test_timerwheel_random(void **state) {
+    tj_timerwheel *wheel = *state;
+    static entry e[TIMERS];
+    uint64_t delays[] = { 50 * TICK, 5000 * TICK, 300000 * TICK,
+                          30000000ULL * TICK };
+    size_t pending = 0, fired = 0;
+    int i, round;
+
+    srand(17);
+    for (i = 0; i < TIMERS; i++) {
+        tj_timerwheel_timer_init(&e[i].timer, &on_fire, &e[i]);
+        e[i].fired = 0;
+    }
+
+    for (round = 0; round < 2000; round++) {
+        uint64_t when;
+
+        /* Schedule, reschedule or cancel a scattering of timers. */
+        for (i = 0; i < 20; i++) {
+            entry *x = &e[rand() % TIMERS];
+            int pend = tj_timerwheel_timer_isPending(&x->timer);
+            if (rand() % 4 == 0) {
+                assert_int_equal(tj_timerwheel_cancel(wheel, &x->timer),
+                                 pend);
+                pending -= pend;
+            } else {
+                schedule(wheel, x, rand() % delays[rand() % 4]);
+                pending += !pend;
+            }
+        }
+        assert_int_equal(tj_timerwheel_count(wheel), pending);
+
+        if (tj_timerwheel_nextExpiry(wheel, &when)) {
+            for (i = 0; i < TIMERS; i++) {
+                if (tj_timerwheel_timer_isPending(&e[i].timer)) {
+                    assert_true(when <= e[i].deadline + TICK);
+                }
+            }
+        }
+
+        fake_now += rand() % (round % 2 ? 3000 * TICK : 30 * TICK);
+        size_t n = tj_timerwheel_advance(wheel);
+        fired += n;
+        pending -= n;
+
+        /* Everything due has fired; nothing else has. */
+        for (i = 0; i < TIMERS; i++) {
+            if (tj_timerwheel_timer_isPending(&e[i].timer)) {
+                assert_true(fake_now < e[i].deadline + TICK);
+            }
+        }
+    }
+    assert_true(fired > 0);
+}
+
+int main(int argc, char *argv[]) {
+    const UnitTest tests[] = {
+        unit_test_setup_teardown(test_timerwheel_fire, setup, teardown),
+        unit_test(test_timerwheel_single_level),
+        unit_test_setup_teardown(test_timerwheel_cancel, setup, teardown),
+        unit_test_setup_teardown(test_timerwheel_callbacks, setup, teardown),
+        unit_test_setup_teardown(test_timerwheel_random, setup, teardown),
+    };
+
+    return run_tests(tests);
+}